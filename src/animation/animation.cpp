@@ -2,10 +2,13 @@
 #include "engine/blob.h"
 #include "engine/fs/file_system.h"
 #include "engine/log.h"
+#include "engine/math_utils.h"
 #include "engine/matrix.h"
 #include "engine/profiler.h"
 #include "engine/quat.h"
 #include "engine/resource_manager.h"
+#include "engine/simd.h"
+#include "engine/string.h"
 #include "engine/vec.h"
 #include "renderer/model.h"
 #include "renderer/pose.h"
@@ -20,6 +23,7 @@ enum class Version
 	FIRST = 0,
 	COMPRESSION = 1,
 	ROOT_MOTION,
+	QUANTIZED,
 
 	LAST
 };
@@ -46,17 +50,165 @@ Animation::Animation(const Path& path, ResourceManagerBase& resource_manager, IA
 	, m_fps(30)
 	, m_mem(allocator)
 	, m_bones(allocator)
+	, m_quantized_groups(allocator)
 	, m_root_motion_bone_idx(-1)
+	, m_model_bone_indices(allocator)
+	, m_model_bone_indices_mutex(false)
 {
 }
 
 
+Animation::~Animation()
+{
+	clearModelBoneIndices();
+}
+
+
+BoneMask::BoneMask(IAllocator& allocator)
+	: bones(allocator)
+	, m_allocator(allocator)
+	, m_model_bones(allocator)
+	, m_model_bones_mutex(false)
+{
+}
+
+
+BoneMask::~BoneMask()
+{
+	for (ModelBones& model_bones : m_model_bones)
+	{
+		m_allocator.deallocate(model_bones.bits);
+	}
+}
+
+
+const u64* BoneMask::getModelBones(Model& model)
+{
+	MT::SpinLock lock(m_model_bones_mutex);
+	u32 skeleton_id = model.getSkeletonId();
+	ModelBones* entry = nullptr;
+	for (ModelBones& model_bones : m_model_bones)
+	{
+		if (model_bones.model != &model) continue;
+		if (model_bones.skeleton_id == skeleton_id) return model_bones.bits;
+		// the model was reloaded, its bones can be different
+		entry = &model_bones;
+		m_allocator.deallocate(entry->bits);
+		break;
+	}
+
+	int words_count = (model.getBoneCount() + 63) >> 6;
+	u64* bits = (u64*)m_allocator.allocate(sizeof(u64) * Math::maximum(1, words_count));
+	setMemory(bits, 0, sizeof(u64) * Math::maximum(1, words_count));
+	for (auto iter = bones.begin(), end = bones.end(); iter != end; ++iter)
+	{
+		Model::BoneMap::iterator bone_iter = model.getBoneIndex(iter.key());
+		if (!bone_iter.isValid()) continue;
+		int idx = bone_iter.value();
+		bits[idx >> 6] |= 1ULL << (idx & 63);
+	}
+	if (entry)
+	{
+		entry->skeleton_id = skeleton_id;
+		entry->bits = bits;
+	}
+	else
+	{
+		m_model_bones.push({&model, skeleton_id, bits});
+	}
+	return bits;
+}
+
+
+const int* Animation::getModelBoneIndices(Model& model) const
+{
+	MT::SpinLock lock(m_model_bone_indices_mutex);
+	u32 skeleton_id = model.getSkeletonId();
+	ModelBoneIndices* entry = nullptr;
+	for (ModelBoneIndices& model_bones : m_model_bone_indices)
+	{
+		if (model_bones.model != &model) continue;
+		if (model_bones.skeleton_id == skeleton_id) return model_bones.indices;
+		// the model was reloaded, models are not reloaded while poses are sampled, so nobody uses the old table
+		entry = &model_bones;
+		getAllocator().deallocate(entry->indices);
+		break;
+	}
+
+	// tables are freed only on unload or when their model is reloaded, so other threads can keep using returned ones
+	int* indices = (int*)getAllocator().allocate(sizeof(int) * Math::maximum(1, m_bones.size()));
+	for (int i = 0, c = m_bones.size(); i < c; ++i)
+	{
+		Model::BoneMap::iterator iter = model.getBoneIndex(m_bones[i].name);
+		indices[i] = iter.isValid() ? iter.value() : -1;
+	}
+	if (entry)
+	{
+		entry->skeleton_id = skeleton_id;
+		entry->indices = indices;
+	}
+	else
+	{
+		m_model_bone_indices.push({&model, skeleton_id, indices});
+	}
+	return indices;
+}
+
+
+void Animation::clearModelBoneIndices()
+{
+	for (ModelBoneIndices& model_bones : m_model_bone_indices)
+	{
+		getAllocator().deallocate(model_bones.indices);
+	}
+	m_model_bone_indices.clear();
+}
+
+
+// index of the first key after the frame, or of the last key
+static int findNextKey(const u16* times, int count, int frame)
+{
+	if (count < 2) return 1;
+	// key times are strictly increasing from 0, so the last key at count - 1 means there is a key on every frame
+	if (times[count - 1] == count - 1) return Math::minimum(frame + 1, count - 1);
+
+	int from = 1;
+	int to = count - 1;
+	while (from < to)
+	{
+		int mid = (from + to) >> 1;
+		if (times[mid] > frame) to = mid;
+		else from = mid + 1;
+	}
+	return from;
+}
+
+
+static bool isMasked(const u64* mask_bits, int model_bone_index)
+{
+	return mask_bits && (mask_bits[model_bone_index >> 6] & (1ULL << (model_bone_index & 63))) == 0;
+}
+
+
 void Animation::getRelativePose(float time, Pose& pose, Model& model, float weight, BoneMask* mask) const
+{
+	if (!model.isReady()) return;
+
+	const u64* mask_bits = mask ? mask->getModelBones(model) : nullptr;
+	getRelativePose(time, pose, getModelBoneIndices(model), mask_bits, weight);
+}
+
+
+void Animation::getRelativePose(float time, Pose& pose, const int* model_bones, const u64* mask_bits, float weight) const
 {
 	PROFILE_FUNCTION();
 	ASSERT(!pose.is_absolute);
 
-	if (!model.isReady()) return;
+	if (isQuantized())
+	{
+		getQuantizedPose(time, pose, model_bones, mask_bits, weight);
+		return;
+	}
 
 	int frame = (int)(time * m_fps);
 	float rcp_fps = 1.0f / m_fps;
@@ -66,31 +218,23 @@ void Animation::getRelativePose(float time, Pose& pose, Model& model, float weig
 
 	if (frame < m_frame_count)
 	{
-		for (Bone& bone : m_bones)
+		for (int i = 0, bones_count = m_bones.size(); i < bones_count; ++i)
 		{
-			Model::BoneMap::iterator iter = model.getBoneIndex(bone.name);
-			if (!iter.isValid()) continue;
-			if (mask && mask->bones.find(bone.name) == mask->bones.end()) continue;
+			int model_bone_index = model_bones[i];
+			if (model_bone_index < 0 || isMasked(mask_bits, model_bone_index)) continue;
 
-			int idx = 1;
-			for (int c = bone.pos_count; idx < c; ++idx)
-			{
-				if (bone.pos_times[idx] > frame) break;
-			}
+			const Bone& bone = m_bones[i];
+
+			int idx = findNextKey(bone.pos_times, bone.pos_count, frame);
 
 			float t = float(time - bone.pos_times[idx - 1] * rcp_fps) /
 					  ((bone.pos_times[idx] - bone.pos_times[idx - 1]) * rcp_fps);
 
-			int model_bone_index = iter.value();
 			Vec3 anim_pos;
 			lerp(bone.pos[idx - 1], bone.pos[idx], &anim_pos, t);
 			lerp(pos[model_bone_index], anim_pos, &pos[model_bone_index], weight);
 
-			idx = 1;
-			for (int c = bone.rot_count; idx < c; ++idx)
-			{
-				if (bone.rot_times[idx] > frame) break;
-			}
+			idx = findNextKey(bone.rot_times, bone.rot_count, frame);
 
 			t = float(time - bone.rot_times[idx - 1] * rcp_fps) /
 				((bone.rot_times[idx] - bone.rot_times[idx - 1]) * rcp_fps);
@@ -102,13 +246,12 @@ void Animation::getRelativePose(float time, Pose& pose, Model& model, float weig
 	}
 	else
 	{
-		for (Bone& bone : m_bones)
+		for (int i = 0, bones_count = m_bones.size(); i < bones_count; ++i)
 		{
-			Model::BoneMap::iterator iter = model.getBoneIndex(bone.name);
-			if (!iter.isValid()) continue;
-			if (mask && mask->bones.find(bone.name) == mask->bones.end()) continue;
+			int model_bone_index = model_bones[i];
+			if (model_bone_index < 0 || isMasked(mask_bits, model_bone_index)) continue;
 
-			int model_bone_index = iter.value();
+			const Bone& bone = m_bones[i];
 			lerp(pos[model_bone_index], bone.pos[bone.pos_count - 1], &pos[model_bone_index], weight);
 			nlerp(rot[model_bone_index], bone.rot[bone.rot_count - 1], &rot[model_bone_index], weight);
 		}
@@ -118,6 +261,8 @@ void Animation::getRelativePose(float time, Pose& pose, Model& model, float weig
 
 RigidTransform Animation::getBoneTransform(float time, int bone_idx) const
 {
+	if (isQuantized()) return getQuantizedBoneTransform(time, bone_idx);
+
 	RigidTransform ret;
 	int frame = (int)(time * m_fps);
 	float rcp_fps = 1.0f / m_fps;
@@ -126,21 +271,13 @@ RigidTransform Animation::getBoneTransform(float time, int bone_idx) const
 	const Bone& bone = m_bones[bone_idx];
 	if (frame < m_frame_count)
 	{
-		int idx = 1;
-		for (int c = bone.pos_count; idx < c; ++idx)
-		{
-			if (bone.pos_times[idx] > frame) break;
-		}
+		int idx = findNextKey(bone.pos_times, bone.pos_count, frame);
 
 		float t = float(time - bone.pos_times[idx - 1] * rcp_fps) /
 			((bone.pos_times[idx] - bone.pos_times[idx - 1]) * rcp_fps);
 		lerp(bone.pos[idx - 1], bone.pos[idx], &ret.pos, t);
 
-		idx = 1;
-		for (int c = bone.rot_count; idx < c; ++idx)
-		{
-			if (bone.rot_times[idx] > frame) break;
-		}
+		idx = findNextKey(bone.rot_times, bone.rot_count, frame);
 
 		t = float(time - bone.rot_times[idx - 1] * rcp_fps) /
 			((bone.rot_times[idx] - bone.rot_times[idx - 1]) * rcp_fps);
@@ -155,6 +292,168 @@ RigidTransform Animation::getBoneTransform(float time, int bone_idx) const
 }
 
 
+// decodes one key of a group of four bones, positions are range dequantized and rotations rebuilt from
+// the smallest three components, the fourth one is sqrt(1 - a^2 - b^2 - c^2)
+static void decodeQuantizedKey(const u8* key,
+	const u8* pos_bytes,
+	const float* pos_min,
+	const float* pos_scale,
+	float4* pos,
+	float4* rot)
+{
+	static const int GROUP_SIZE = Animation::QUANTIZED_GROUP_SIZE;
+	float values[GROUP_SIZE * 6];
+	float largest[GROUP_SIZE];
+	for (int i = 0; i < 3; ++i)
+	{
+		float* row = &values[i * GROUP_SIZE];
+		switch (pos_bytes[i])
+		{
+			case 0: for (int j = 0; j < GROUP_SIZE; ++j) row[j] = 0; break;
+			case 1: for (int j = 0; j < GROUP_SIZE; ++j) row[j] = key[j]; break;
+			default: for (int j = 0; j < GROUP_SIZE; ++j) row[j] = ((const u16*)key)[j]; break;
+		}
+		key += pos_bytes[i] * GROUP_SIZE;
+	}
+	const u16* rot_key = (const u16*)key;
+	for (int i = 0; i < GROUP_SIZE * 3; ++i) values[GROUP_SIZE * 3 + i] = float(rot_key[i] & 0x7fff);
+	for (int i = 0; i < GROUP_SIZE; ++i)
+	{
+		largest[i] = float(((rot_key[i] >> 15) << 1) | (rot_key[GROUP_SIZE + i] >> 15));
+	}
+
+	for (int i = 0; i < 3; ++i)
+	{
+		float4 q = f4LoadUnaligned(&values[i * 4]);
+		pos[i] = f4Add(f4LoadUnaligned(&pos_min[i * 4]), f4Mul(q, f4LoadUnaligned(&pos_scale[i * 4])));
+	}
+
+	const float4 scale = f4Splat(1.41421356f / 32767);
+	const float4 offset = f4Splat(0.70710678f);
+	float4 a = f4Sub(f4Mul(f4LoadUnaligned(&values[12]), scale), offset);
+	float4 b = f4Sub(f4Mul(f4LoadUnaligned(&values[16]), scale), offset);
+	float4 c = f4Sub(f4Mul(f4LoadUnaligned(&values[20]), scale), offset);
+	float4 big = f4Sub(f4Splat(1), f4Add(f4Mul(a, a), f4Add(f4Mul(b, b), f4Mul(c, c))));
+	big = f4Sqrt(f4Max(big, f4Splat(0)));
+
+	float4 m = f4LoadUnaligned(largest);
+	float4 is_x = f4CmpLT(m, f4Splat(0.5f));
+	float4 up_to_y = f4CmpLT(m, f4Splat(1.5f));
+	float4 up_to_z = f4CmpLT(m, f4Splat(2.5f));
+	rot[0] = f4Blend(a, big, is_x);
+	rot[1] = f4Blend(f4Blend(b, big, up_to_y), a, is_x);
+	rot[2] = f4Blend(f4Blend(c, big, up_to_z), b, up_to_y);
+	rot[3] = f4Blend(big, c, up_to_z);
+}
+
+
+void Animation::sampleQuantizedGroup(int group_idx, float time, Vec3* pos, Quat* rot) const
+{
+	const QuantizedGroup& group = m_quantized_groups[group_idx];
+	int frame = Math::clamp((int)(time * m_fps), 0, m_frame_count);
+
+	float4 pos0[3], rot0[4];
+	float4 pos1[3], rot1[4];
+	float t = 0;
+	int idx = findNextKey(group.times, group.keys_count, frame);
+	if (group.keys_count < 2 || frame >= m_frame_count)
+	{
+		int last = group.keys_count - 1;
+		decodeQuantizedKey(group.keys + last * group.key_size, group.pos_bytes, group.pos_min, group.pos_scale, pos0, rot0);
+		for (int i = 0; i < 3; ++i) pos1[i] = pos0[i];
+		for (int i = 0; i < 4; ++i) rot1[i] = rot0[i];
+	}
+	else
+	{
+		const u8* key = group.keys + (idx - 1) * group.key_size;
+		decodeQuantizedKey(key, group.pos_bytes, group.pos_min, group.pos_scale, pos0, rot0);
+		decodeQuantizedKey(key + group.key_size, group.pos_bytes, group.pos_min, group.pos_scale, pos1, rot1);
+		t = (time * m_fps - group.times[idx - 1]) / (group.times[idx] - group.times[idx - 1]);
+		t = Math::clamp(t, 0.0f, 1.0f);
+	}
+
+	const float4 t4 = f4Splat(t);
+	float res[7][QUANTIZED_GROUP_SIZE];
+	for (int i = 0; i < 3; ++i)
+	{
+		f4Store(res[i], f4Add(pos0[i], f4Mul(f4Sub(pos1[i], pos0[i]), t4)));
+	}
+
+	// nlerp, the second rotation is flipped in lanes where it is in the other hemisphere
+	float4 dot = f4Add(f4Add(f4Mul(rot0[0], rot1[0]), f4Mul(rot0[1], rot1[1])),
+		f4Add(f4Mul(rot0[2], rot1[2]), f4Mul(rot0[3], rot1[3])));
+	float4 flip = f4CmpLT(dot, f4Splat(0));
+	float4 r[4];
+	float4 len_sq = f4Splat(0);
+	for (int i = 0; i < 4; ++i)
+	{
+		float4 to = f4Blend(rot1[i], f4Sub(f4Splat(0), rot1[i]), flip);
+		r[i] = f4Add(rot0[i], f4Mul(f4Sub(to, rot0[i]), t4));
+		len_sq = f4Add(len_sq, f4Mul(r[i], r[i]));
+	}
+	float4 len = f4Sqrt(len_sq);
+	for (int i = 0; i < 4; ++i) f4Store(res[3 + i], f4Div(r[i], len));
+
+	for (int i = 0; i < QUANTIZED_GROUP_SIZE; ++i)
+	{
+		pos[i].set(res[0][i], res[1][i], res[2][i]);
+		rot[i].set(res[3][i], res[4][i], res[5][i], res[6][i]);
+	}
+}
+
+
+void Animation::getQuantizedPose(float time, Pose& pose, const int* model_bones, const u64* mask_bits, float weight) const
+{
+	Vec3* pose_pos = pose.positions;
+	Quat* pose_rot = pose.rotations;
+	const int bones_count = m_bones.size();
+	for (int g = 0, groups_count = m_quantized_groups.size(); g < groups_count; ++g)
+	{
+		int first = g * QUANTIZED_GROUP_SIZE;
+		int lanes = Math::minimum(QUANTIZED_GROUP_SIZE, bones_count - first);
+		int targets[QUANTIZED_GROUP_SIZE];
+		bool any = false;
+		for (int i = 0; i < lanes; ++i)
+		{
+			targets[i] = model_bones[first + i];
+			if (targets[i] >= 0 && isMasked(mask_bits, targets[i])) targets[i] = -1;
+			any = any || targets[i] >= 0;
+		}
+		if (!any) continue;
+
+		Vec3 pos[QUANTIZED_GROUP_SIZE];
+		Quat rot[QUANTIZED_GROUP_SIZE];
+		sampleQuantizedGroup(g, time, pos, rot);
+		for (int i = 0; i < lanes; ++i)
+		{
+			int model_bone_index = targets[i];
+			if (model_bone_index < 0) continue;
+
+			const Bone& bone = m_bones[first + i];
+			if (weight < 1)
+			{
+				if (bone.pos_count > 0) lerp(pose_pos[model_bone_index], pos[i], &pose_pos[model_bone_index], weight);
+				if (bone.rot_count > 0) nlerp(pose_rot[model_bone_index], rot[i], &pose_rot[model_bone_index], weight);
+			}
+			else
+			{
+				if (bone.pos_count > 0) pose_pos[model_bone_index] = pos[i];
+				if (bone.rot_count > 0) pose_rot[model_bone_index] = rot[i];
+			}
+		}
+	}
+}
+
+
+RigidTransform Animation::getQuantizedBoneTransform(float time, int bone_idx) const
+{
+	Vec3 pos[QUANTIZED_GROUP_SIZE];
+	Quat rot[QUANTIZED_GROUP_SIZE];
+	sampleQuantizedGroup(bone_idx / QUANTIZED_GROUP_SIZE, time, pos, rot);
+	return { pos[bone_idx % QUANTIZED_GROUP_SIZE], rot[bone_idx % QUANTIZED_GROUP_SIZE] };
+}
+
+
 int Animation::getBoneIndex(u32 name) const
 {
 	for (int i = 0, c = m_bones.size(); i < c; ++i)
@@ -166,11 +465,24 @@ int Animation::getBoneIndex(u32 name) const
 
 
 void Animation::getRelativePose(float time, Pose& pose, Model& model, BoneMask* mask) const
+{
+	if (!model.isReady()) return;
+
+	const u64* mask_bits = mask ? mask->getModelBones(model) : nullptr;
+	getRelativePose(time, pose, getModelBoneIndices(model), mask_bits);
+}
+
+
+void Animation::getRelativePose(float time, Pose& pose, const int* model_bones, const u64* mask_bits) const
 {
 	PROFILE_FUNCTION();
 	ASSERT(!pose.is_absolute);
 
-	if (!model.isReady()) return;
+	if (isQuantized())
+	{
+		getQuantizedPose(time, pose, model_bones, mask_bits, 1);
+		return;
+	}
 
 	int frame = (int)(time * m_fps);
 	float rcp_fps = 1.0f / m_fps;
@@ -180,20 +492,16 @@ void Animation::getRelativePose(float time, Pose& pose, Model& model, BoneMask*
 
 	if (frame < m_frame_count)
 	{
-		for (Bone& bone : m_bones)
+		for (int i = 0, bones_count = m_bones.size(); i < bones_count; ++i)
 		{
-			Model::BoneMap::iterator iter = model.getBoneIndex(bone.name);
-			if (!iter.isValid()) continue;
-			if (mask && mask->bones.find(bone.name) == mask->bones.end()) continue;
+			int model_bone_index = model_bones[i];
+			if (model_bone_index < 0 || isMasked(mask_bits, model_bone_index)) continue;
+
+			const Bone& bone = m_bones[i];
 
-			int model_bone_index = iter.value();
 			if (bone.pos_count > 1)
 			{
-				int idx = 1;
-				for (int c = bone.pos_count; idx < c; ++idx)
-				{
-					if (bone.pos_times[idx] > frame) break;
-				}
+				int idx = findNextKey(bone.pos_times, bone.pos_count, frame);
 
 				float t = float(time - bone.pos_times[idx - 1] * rcp_fps) /
 					((bone.pos_times[idx] - bone.pos_times[idx - 1]) * rcp_fps);
@@ -206,11 +514,7 @@ void Animation::getRelativePose(float time, Pose& pose, Model& model, BoneMask*
 			
 			if (bone.rot_count > 1)
 			{
-				int idx = 1;
-				for (int c = bone.rot_count; idx < c; ++idx)
-				{
-					if (bone.rot_times[idx] > frame) break;
-				}
+				int idx = findNextKey(bone.rot_times, bone.rot_count, frame);
 
 				float t = float(time - bone.rot_times[idx - 1] * rcp_fps) /
 					((bone.rot_times[idx] - bone.rot_times[idx - 1]) * rcp_fps);
@@ -224,13 +528,12 @@ void Animation::getRelativePose(float time, Pose& pose, Model& model, BoneMask*
 	}
 	else
 	{
-		for (Bone& bone : m_bones)
+		for (int i = 0, bones_count = m_bones.size(); i < bones_count; ++i)
 		{
-			Model::BoneMap::iterator iter = model.getBoneIndex(bone.name);
-			if (!iter.isValid()) continue;
-			if (mask && mask->bones.find(bone.name) == mask->bones.end()) continue;
+			int model_bone_index = model_bones[i];
+			if (model_bone_index < 0 || isMasked(mask_bits, model_bone_index)) continue;
 
-			int model_bone_index = iter.value();
+			const Bone& bone = m_bones[i];
 			pos[model_bone_index] = bone.pos[bone.pos_count - 1];
 			rot[model_bone_index] = bone.rot[bone.rot_count - 1];
 		}
@@ -241,6 +544,7 @@ void Animation::getRelativePose(float time, Pose& pose, Model& model, BoneMask*
 bool Animation::load(FS::IFile& file)
 {
 	m_bones.clear();
+	m_quantized_groups.clear();
 	m_mem.clear();
 	Header header;
 	file.read(&header, sizeof(header));
@@ -263,6 +567,11 @@ bool Animation::load(FS::IFile& file)
 	{
 		m_root_motion_bone_idx = -1;
 	}
+	u32 flags = 0;
+	if (header.version > (int)Version::QUANTIZED)
+	{
+		file.read(&flags, sizeof(flags));
+	}
 	m_fps = header.fps;
 	file.read(&m_frame_count, sizeof(m_frame_count));
 	int bone_count;
@@ -274,6 +583,17 @@ bool Animation::load(FS::IFile& file)
 	m_mem.resize(size);
 	file.read(&m_mem[0], size);
 	InputBlob blob(&m_mem[0], size);
+	if (flags & (u32)Flags::QUANTIZED)
+	{
+		if (!loadQuantized(blob))
+		{
+			g_log_error.log("Animation") << "Corrupted quantized animation " << getPath();
+			return false;
+		}
+		m_size = file.size();
+		return true;
+	}
+
 	for (int i = 0; i < m_bones.size(); ++i)
 	{
 		m_bones[i].name = blob.read<u32>();
@@ -292,6 +612,44 @@ bool Animation::load(FS::IFile& file)
 }
 
 
+bool Animation::loadQuantized(InputBlob& blob)
+{
+	for (Bone& bone : m_bones)
+	{
+		bone.name = blob.read<u32>();
+		u8 channels = blob.read<u8>();
+		bone.pos_count = (channels & POSITION) ? 1 : 0;
+		bone.rot_count = (channels & ROTATION) ? 1 : 0;
+		bone.pos_times = bone.rot_times = nullptr;
+		bone.pos = nullptr;
+		bone.rot = nullptr;
+	}
+
+	const int groups_count = (m_bones.size() + QUANTIZED_GROUP_SIZE - 1) / QUANTIZED_GROUP_SIZE;
+	m_quantized_groups.resize(groups_count);
+	for (QuantizedGroup& group : m_quantized_groups)
+	{
+		group.keys_count = blob.read<int>();
+		blob.read(group.pos_bytes, sizeof(group.pos_bytes));
+		group.key_size = QUANTIZED_ROTATION_SIZE;
+		for (int i = 0; i < 3; ++i)
+		{
+			if (group.pos_bytes[i] > sizeof(u16)) return false;
+			group.key_size += group.pos_bytes[i] * QUANTIZED_GROUP_SIZE;
+		}
+		const int range_size = sizeof(float) * 3 * QUANTIZED_GROUP_SIZE;
+		const int keys_size = group.keys_count * (sizeof(u16) + group.key_size);
+		if (group.keys_count <= 0 || blob.getSize() - blob.getPosition() < 2 * range_size + keys_size) return false;
+
+		group.pos_min = (const float*)blob.skip(range_size);
+		group.pos_scale = (const float*)blob.skip(range_size);
+		group.times = (const u16*)blob.skip(group.keys_count * sizeof(u16));
+		group.keys = (const u8*)blob.skip(group.keys_count * group.key_size);
+	}
+	return true;
+}
+
+
 IAllocator& Animation::getAllocator() const
 {
 	return static_cast<AnimationManager&>(m_resource_manager).getAllocator();
@@ -300,7 +658,9 @@ IAllocator& Animation::getAllocator() const
 
 void Animation::unload()
 {
+	clearModelBoneIndices();
 	m_bones.clear();
+	m_quantized_groups.clear();
 	m_mem.clear();
 	m_frame_count = 0;
 }
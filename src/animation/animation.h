@@ -1,12 +1,17 @@
 #pragma once
 
+#include "engine/math_utils.h"
 #include "engine/matrix.h"
+#include "engine/mt/sync.h"
+#include "engine/quat.h"
 #include "engine/resource.h"
 #include "engine/resource_manager_base.h"
 
 namespace Lumix
 {
 
+class InputBlob;
+
 namespace FS
 {
 	class FileSystem;
@@ -40,9 +45,26 @@ private:
 
 struct BoneMask
 {
-	BoneMask(IAllocator& allocator) : bones(allocator) {}
+	explicit BoneMask(IAllocator& allocator);
+	~BoneMask();
+
+	// one bit per model bone, set for bones in the mask; built once for each model and rebuilt when it's reloaded
+	const u64* getModelBones(Model& model);
+
 	u32 name;
 	HashMap<u32, u8> bones;
+
+private:
+	struct ModelBones
+	{
+		const Model* model;
+		u32 skeleton_id;
+		u64* bits;
+	};
+
+	IAllocator& m_allocator;
+	Array<ModelBones> m_model_bones;
+	MT::SpinMutex m_model_bones_mutex;
 };
 
 
@@ -51,6 +73,12 @@ class Animation LUMIX_FINAL : public Resource
 	public:
 		static const u32 HEADER_MAGIC = 0x5f4c4146; // '_LAF'
 		static const ResourceType TYPE;
+		// bones in a quantized clip are stored in groups of four sharing key times, each key is
+		// positions x[4], y[4], z[4] followed by rotations in smallest three format a[4], b[4], c[4];
+		// a position row takes 0 (constant), 1 or 2 bytes per value, as set for each group
+		static const int QUANTIZED_GROUP_SIZE = 4;
+		static const int QUANTIZED_ROTATION_SIZE = QUANTIZED_GROUP_SIZE * 3 * sizeof(u16);
+		static const int QUANTIZED_MAX_KEY_SIZE = QUANTIZED_GROUP_SIZE * 3 * sizeof(u16) + QUANTIZED_ROTATION_SIZE;
 
 	public:
 		struct Header
@@ -60,8 +88,42 @@ class Animation LUMIX_FINAL : public Resource
 			u32 fps;
 		};
 
+		enum class Flags : u32
+		{
+			QUANTIZED = 1 << 0
+		};
+
+		enum QuantizedChannels : u8
+		{
+			POSITION = 1 << 0,
+			ROTATION = 1 << 1
+		};
+
+		// 48 bit smallest three, 15 bits for each of the three smaller components, the index of the largest one
+		// is in the top bits of the first two components
+		static void quantizeRotation(const Quat& rot, u16* out)
+		{
+			const float* values = &rot.x;
+			int largest = 0;
+			for (int i = 1; i < 4; ++i)
+			{
+				if (Math::abs(values[i]) > Math::abs(values[largest])) largest = i;
+			}
+			float sign = values[largest] < 0 ? -1.0f : 1.0f;
+			for (int i = 0, j = 0; i < 4; ++i)
+			{
+				if (i == largest) continue;
+				float v = (sign * values[i] + 0.70710678f) / 1.41421356f * 32767 + 0.5f;
+				out[j] = u16(Math::clamp(v, 0.0f, 32767.0f));
+				++j;
+			}
+			out[0] |= u16((largest >> 1) << 15);
+			out[1] |= u16((largest & 1) << 15);
+		}
+
 	public:
 		Animation(const Path& path, ResourceManagerBase& resource_manager, IAllocator& allocator);
+		~Animation();
 
 		ResourceType getType() const override { return TYPE; }
 
@@ -69,14 +131,26 @@ class Animation LUMIX_FINAL : public Resource
 		RigidTransform getBoneTransform(float time, int bone_idx) const;
 		void getRelativePose(float time, Pose& pose, Model& model, BoneMask* mask) const;
 		void getRelativePose(float time, Pose& pose, Model& model, float weight, BoneMask* mask) const;
+		// model_bones and mask_bits are the tables returned by getModelBoneIndices and BoneMask::getModelBones
+		void getRelativePose(float time, Pose& pose, const int* model_bones, const u64* mask_bits) const;
+		void getRelativePose(float time, Pose& pose, const int* model_bones, const u64* mask_bits, float weight) const;
+		// model bone index for each animation bone, -1 if the model does not have the bone; built once for each model
+		// and rebuilt when it's reloaded
+		const int* getModelBoneIndices(Model& model) const;
 		int getFrameCount() const { return m_frame_count; }
 		float getLength() const { return m_frame_count / (float)m_fps; }
 		int getFPS() const { return m_fps; }
 		int getBoneCount() const { return m_bones.size(); }
 		int getBoneIndex(u32 name) const;
+		bool isQuantized() const { return !m_quantized_groups.empty(); }
 
 	private:
 		IAllocator& getAllocator() const;
+		void clearModelBoneIndices();
+		bool loadQuantized(InputBlob& blob);
+		void getQuantizedPose(float time, Pose& pose, const int* model_bones, const u64* mask_bits, float weight) const;
+		RigidTransform getQuantizedBoneTransform(float time, int bone_idx) const;
+		void sampleQuantizedGroup(int group_idx, float time, Vec3* pos, Quat* rot) const;
 
 		void unload() override;
 		bool load(FS::IFile& file) override;
@@ -94,9 +168,28 @@ class Animation LUMIX_FINAL : public Resource
 			const Quat* rot;
 		};
 		Array<Bone> m_bones;
+		struct QuantizedGroup
+		{
+			int keys_count;
+			int key_size;
+			u8 pos_bytes[4];
+			const float* pos_min;
+			const float* pos_scale;
+			const u16* times;
+			const u8* keys;
+		};
+		Array<QuantizedGroup> m_quantized_groups;
 		Array<u8> m_mem;
 		int m_fps;
 		int m_root_motion_bone_idx;
+		struct ModelBoneIndices
+		{
+			const Model* model;
+			u32 skeleton_id;
+			int* indices;
+		};
+		mutable Array<ModelBoneIndices> m_model_bone_indices;
+		mutable MT::SpinMutex m_model_bone_indices_mutex;
 };
 
 
@@ -4,12 +4,15 @@
 #include "animation/controller.h"
 #include "animation/events.h"
 #include "animation/property_animation.h"
+#include "engine/associative_array.h"
 #include "engine/base_proxy_allocator.h"
 #include "engine/blob.h"
 #include "engine/crc32.h"
 #include "engine/engine.h"
 #include "engine/lua_wrapper.h"
 #include "engine/job_system.h"
+#include "engine/mt/atomic.h"
+#include "engine/mt/sync.h"
 #include "engine/profiler.h"
 #include "engine/reflection.h"
 #include "engine/resource_manager.h"
@@ -41,6 +44,13 @@ static const ComponentType PROPERTY_ANIMATOR_TYPE = Reflection::getComponentType
 static const ComponentType CONTROLLER_TYPE = Reflection::getComponentType("anim_controller");
 static const ComponentType SHARED_CONTROLLER_TYPE = Reflection::getComponentType("shared_anim_controller");
 
+// animation LODs, selected by the distance from the main camera; LODs after the first one do not solve IK,
+// the last one samples only bones close to the root of the hierarchy
+enum { ANIMATION_LOD_COUNT = 4 };
+// in frames, poses between updates are interpolated
+static const u8 ANIMATION_LOD_UPDATE_INTERVALS[ANIMATION_LOD_COUNT] = { 1, 2, 4, 8 };
+static const int REDUCED_BONE_DEPTH = 4;
+
 
 namespace FS
 {
@@ -58,6 +68,19 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 {
 	friend struct AnimationSystemImpl;
 
+	struct LODState
+	{
+		u8 lod = 0;
+		u8 frame = 0;
+		float time_delta = 0;
+		BoneMask* bone_mask = nullptr;
+		// relative poses of the last two updates, the current one is interpolated between them and made
+		// absolute in SoA layout, it's converted to the model instance's pose only at the end
+		PoseSoA* prev = nullptr;
+		PoseSoA* next = nullptr;
+		PoseSoA* current = nullptr;
+	};
+
 	struct SharedController
 	{
 		Entity entity;
@@ -71,9 +94,13 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		Entity entity;
 		Anim::ControllerResource* resource = nullptr;
 		Anim::ComponentInstance* root = nullptr;
+		Anim::InstancePool* instance_pool = nullptr;
 		u32 default_set = 0;
 		Array<u8> input;
+		// see InputDecl::getDirtyMask, inputs changed since the last update
+		u32 dirty_inputs = 0;
 		HashMap<u32, Animation*> animations;
+		LODState lod;
 
 		struct IK
 		{
@@ -87,32 +114,61 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	};
 
 
-	struct PropertyAnimator
+	// output of one controller update job, merged on the main thread in entity order
+	struct ControllerJobOutput
 	{
-		struct Key
-		{
-			int frame0;
-			int frame1;
-			float value0;
-			float value1;
-		};
+		explicit ControllerJobOutput(IAllocator& allocator) : event_stream(allocator), updated_poses(allocator) {}
+
+		OutputBlob event_stream;
+		Array<Entity> updated_poses;
+	};
 
+
+	// values of one property written by all property animators in a frame
+	struct PropertyBatch
+	{
+		explicit PropertyBatch(IAllocator& allocator) : entities(allocator), values(allocator) {}
+
+		const Reflection::Property<float>* property;
+		IScene* scene;
+		Array<Entity> entities;
+		Array<float> values;
+	};
+
+
+	struct PropertyAnimator
+	{
 		enum Flags
 		{
 			LOOPED = 1 << 0,
 			DISABLED = 1 << 1
 		};
 
-		PropertyAnimator(IAllocator& allocator) : keys(allocator) {}
+		PropertyAnimator(IAllocator& allocator) : cursors(allocator) {}
 
 		PropertyAnimation* animation;
-		Array<Key> keys;
+		// for each curve, index of the key where the last lookup ended
+		Array<int> cursors;
 
 		FlagSet<Flags, u32> flags;
 		float time;
 	};
 
 
+	// pose sampled this frame, animables with the same animation, model, bone mask and time copy it
+	struct PoseCacheEntry
+	{
+		explicit PoseCacheEntry(IAllocator& allocator) : pose(allocator) {}
+
+		Animation* animation;
+		Model* model;
+		BoneMask* bone_mask;
+		float time;
+		Pose pose;
+		volatile i32 is_ready;
+	};
+
+
 	struct Animable
 	{
 		float time;
@@ -120,6 +176,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		float start_time;
 		Animation* animation;
 		Entity entity;
+		LODState lod;
 	};
 
 
@@ -129,12 +186,27 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		, m_anim_system(anim_system)
 		, m_animables(allocator)
 		, m_property_animators(allocator)
+		, m_property_batches(allocator)
+		, m_property_batch_indices(allocator)
 		, m_controllers(allocator)
+		, m_controller_job_outputs(allocator)
 		, m_shared_controllers(allocator)
+		, m_reduced_bone_masks(allocator)
+		, m_pose_cache(allocator)
+		, m_pose_cache_entries(allocator)
+		, m_pose_cache_mutex(false)
 		, m_event_stream(allocator)
 		, m_allocator(allocator)
 	{
 		m_is_game_running = false;
+		m_pose_cache_entries_count = 0;
+		m_pose_cache_time_quantum = 0;
+		m_pose_cache_hits = 0;
+		m_pose_cache_misses = 0;
+		m_lod_distances[0] = 0;
+		m_lod_distances[1] = 15;
+		m_lod_distances[2] = 40;
+		m_lod_distances[3] = 100;
 		m_render_scene = static_cast<RenderScene*>(universe.getScene(crc32("renderer")));
 		universe.registerComponentType(PROPERTY_ANIMATOR_TYPE
 			, this
@@ -268,6 +340,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		for (Animable& animable : m_animables)
 		{
 			unloadResource(animable.animation);
+			destroyLODPoses(animable.lod);
 		}
 		m_animables.clear();
 
@@ -275,8 +348,25 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		{
 			unloadResource(controller.resource);
 			setControllerResource(controller, nullptr);
+			destroyLODPoses(controller.lod);
 		}
 		m_controllers.clear();
+
+		for (int i = 0, c = m_reduced_bone_masks.size(); i < c; ++i)
+		{
+			Model* model = m_reduced_bone_masks.getKey(i);
+			model->getObserverCb().unbind<AnimationSceneImpl, &AnimationSceneImpl::onReducedBoneMaskModelChanged>(this);
+			LUMIX_DELETE(m_allocator, m_reduced_bone_masks.at(i));
+		}
+		m_reduced_bone_masks.clear();
+
+		m_pose_cache.clear();
+		for (PoseCacheEntry* entry : m_pose_cache_entries)
+		{
+			LUMIX_DELETE(m_allocator, entry);
+		}
+		m_pose_cache_entries.clear();
+		m_pose_cache_entries_count = 0;
 	}
 
 
@@ -318,6 +408,16 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	}
 
 
+	template <typename T>
+	static void setInput(Controller& controller, const Anim::InputDecl::Input& input, T value)
+	{
+		T& current = *(T*)&controller.input[input.offset];
+		if (current == value) return;
+		current = value;
+		controller.dirty_inputs |= Anim::InputDecl::getDirtyMask(input.offset, input.type);
+	}
+
+
 	void setControllerFloatInput(Entity entity, int input_idx, float value)
 	{
 		Controller& controller = m_controllers.get(entity);
@@ -330,7 +430,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		if (input_idx < 0 || input_idx >= lengthOf(decl.inputs)) return;
 		if (decl.inputs[input_idx].type == Anim::InputDecl::FLOAT)
 		{
-			*(float*)&controller.input[decl.inputs[input_idx].offset] = value;
+			setInput(controller, decl.inputs[input_idx], value);
 		}
 		else
 		{
@@ -350,7 +450,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		Anim::InputDecl& decl = controller.resource->m_input_decl;
 		if (decl.inputs[input_idx].type == Anim::InputDecl::INT)
 		{
-			*(int*)&controller.input[decl.inputs[input_idx].offset] = value;
+			setInput(controller, decl.inputs[input_idx], value);
 		}
 		else
 		{
@@ -370,7 +470,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		Anim::InputDecl& decl = controller.resource->m_input_decl;
 		if (decl.inputs[input_idx].type == Anim::InputDecl::BOOL)
 		{
-			*(bool*)&controller.input[decl.inputs[input_idx].offset] = value;
+			setInput(controller, decl.inputs[input_idx], value);
 		}
 		else
 		{
@@ -409,7 +509,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	{
 		for (auto& controller : m_controllers)
 		{
-			initControllerRuntime(controller);
+			initControllerRuntime(controller, m_event_stream);
 		}
 		m_is_game_running = true;
 	}
@@ -419,8 +519,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	{
 		for (auto& controller : m_controllers)
 		{
-			LUMIX_DELETE(m_allocator, controller.root);
-			controller.root = nullptr;
+			destroyControllerRuntime(controller);
 		}
 		m_is_game_running = false;
 	}
@@ -446,8 +545,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		}
 		if (controller.root != nullptr)
 		{
-			LUMIX_DELETE(m_engine.getAllocator(), controller.root);
-			controller.root = nullptr;
+			destroyControllerRuntime(controller);
 			controller.default_set = 0;
 			controller.animations.clear();
 			controller.input.clear();
@@ -466,8 +564,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		{
 			if (controller.resource == &resource && controller.root != nullptr && new_state != Resource::State::READY)
 			{
-				LUMIX_DELETE(m_engine.getAllocator(), controller.root);
-				controller.root = nullptr;
+				destroyControllerRuntime(controller);
 				controller.default_set = 0;
 				controller.animations.clear();
 				controller.input.clear();
@@ -490,6 +587,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	{
 		auto& animable = m_animables[entity];
 		unloadResource(animable.animation);
+		destroyLODPoses(animable.lod);
 		m_animables.erase(entity);
 		m_universe.onComponentDestroyed(entity, ANIMABLE_TYPE, this);
 	}
@@ -500,6 +598,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		auto& controller = m_controllers.get(entity);
 		unloadResource(controller.resource);
 		setControllerResource(controller, nullptr);
+		destroyLODPoses(controller.lod);
 		m_controllers.erase(entity);
 		m_universe.onComponentDestroyed(entity, CONTROLLER_TYPE, this);
 	}
@@ -636,7 +735,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		setControllerResource(controller, loadController(path));
 		if (controller.resource->isReady() && m_is_game_running)
 		{
-			initControllerRuntime(controller);
+			initControllerRuntime(controller, m_event_stream);
 		}
 	}
 
@@ -661,6 +760,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		if (!enabled)
 		{
 			applyPropertyAnimator(entity, animator);
+			applyPropertyBatches();
 		}
 	}
 
@@ -697,7 +797,259 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	}
 
 
-	void updateAnimable(Animable& animable, float time_delta) const
+	void destroyLODPoses(LODState& lod)
+	{
+		LUMIX_DELETE(m_allocator, lod.prev);
+		LUMIX_DELETE(m_allocator, lod.next);
+		LUMIX_DELETE(m_allocator, lod.current);
+		lod.prev = lod.next = lod.current = nullptr;
+	}
+
+
+	// returns true if the pose should be sampled this frame, otherwise it is interpolated
+	static bool advanceLOD(LODState& lod, float time_delta, const Pose* pose)
+	{
+		lod.time_delta += time_delta;
+		++lod.frame;
+		if (pose && lod.frame < ANIMATION_LOD_UPDATE_INTERVALS[lod.lod] && lod.next && lod.next->count == pose->count)
+		{
+			return false;
+		}
+		lod.frame = 0;
+		return true;
+	}
+
+
+	static void copyPose(Pose& dst, const Pose& src)
+	{
+		copyMemory(dst.positions, src.positions, sizeof(dst.positions[0]) * src.count);
+		copyMemory(dst.rotations, src.rotations, sizeof(dst.rotations[0]) * src.count);
+		dst.is_absolute = src.is_absolute;
+	}
+
+
+	// the result is absolute
+	static void interpolateLODPose(const LODState& lod, Model& model, Pose& pose)
+	{
+		PoseSoA& current = *lod.current;
+		current.copy(*lod.prev);
+		current.blend(*lod.next, (lod.frame + 1) / (float)ANIMATION_LOD_UPDATE_INTERVALS[lod.lod]);
+		current.computeAbsolute(model);
+		current.toPose(pose);
+	}
+
+
+	// pose is the just sampled relative pose, it's replaced by the one to display
+	void onLODPoseSampled(LODState& lod, Model& model, Pose& pose)
+	{
+		if (ANIMATION_LOD_UPDATE_INTERVALS[lod.lod] == 1) return;
+
+		if (!lod.next || lod.next->count != pose.count)
+		{
+			destroyLODPoses(lod);
+			lod.prev = LUMIX_NEW(m_allocator, PoseSoA)(m_allocator);
+			lod.next = LUMIX_NEW(m_allocator, PoseSoA)(m_allocator);
+			lod.current = LUMIX_NEW(m_allocator, PoseSoA)(m_allocator);
+			lod.prev->fromPose(pose);
+		}
+		else
+		{
+			PoseSoA* tmp = lod.prev;
+			lod.prev = lod.next;
+			lod.next = tmp;
+		}
+		lod.next->fromPose(pose);
+		interpolateLODPose(lod, model, pose);
+	}
+
+
+	// the mask is freed when its model unloads, the entry stays bound to the model until the scene is cleared
+	void onReducedBoneMaskModelChanged(Resource::State, Resource::State new_state, Resource& resource)
+	{
+		if (new_state == Resource::State::READY) return;
+		int idx = m_reduced_bone_masks.find(static_cast<Model*>(&resource));
+		if (idx < 0) return;
+		LUMIX_DELETE(m_allocator, m_reduced_bone_masks.at(idx));
+		m_reduced_bone_masks.at(idx) = nullptr;
+	}
+
+
+	BoneMask* getReducedBoneMask(Model& model)
+	{
+		int idx = m_reduced_bone_masks.find(&model);
+		if (idx >= 0 && m_reduced_bone_masks.at(idx)) return m_reduced_bone_masks.at(idx);
+
+		BoneMask* mask = LUMIX_NEW(m_allocator, BoneMask)(m_allocator);
+		Array<int> depths(m_allocator);
+		depths.resize(model.getBoneCount());
+		for (int i = 0, c = model.getBoneCount(); i < c; ++i)
+		{
+			const Model::Bone& bone = model.getBone(i);
+			depths[i] = bone.parent_idx < 0 ? 0 : depths[bone.parent_idx] + 1;
+			if (depths[i] < REDUCED_BONE_DEPTH) mask->bones.insert(crc32(bone.name.c_str()), 1);
+		}
+		if (idx >= 0)
+		{
+			m_reduced_bone_masks.at(idx) = mask;
+		}
+		else
+		{
+			m_reduced_bone_masks.insert(&model, mask);
+			model.getObserverCb().bind<AnimationSceneImpl, &AnimationSceneImpl::onReducedBoneMaskModelChanged>(this);
+		}
+		return mask;
+	}
+
+
+	void selectLOD(Entity entity, LODState& lod, const Vec3& camera_pos)
+	{
+		float dist_squared = (m_universe.getPosition(entity) - camera_pos).squaredLength();
+		u8 new_lod = 0;
+		while (new_lod + 1 < ANIMATION_LOD_COUNT && dist_squared >= m_lod_distances[new_lod + 1] * m_lod_distances[new_lod + 1])
+		{
+			++new_lod;
+		}
+		if (new_lod != lod.lod)
+		{
+			// interpolation restarts from the next sampled pose
+			lod.lod = new_lod;
+			lod.frame = 0;
+			destroyLODPoses(lod);
+		}
+
+		lod.bone_mask = nullptr;
+		if (new_lod == ANIMATION_LOD_COUNT - 1 && m_universe.hasComponent(entity, MODEL_INSTANCE_TYPE))
+		{
+			Model* model = m_render_scene->getModelInstanceModel(entity);
+			if (model && model->isReady()) lod.bone_mask = getReducedBoneMask(*model);
+		}
+	}
+
+
+	// serial, so the jobs only read the reduced bone masks
+	void updateLODs()
+	{
+		PROFILE_FUNCTION();
+		Entity camera = m_render_scene->getCameraInSlot("main");
+		if (!camera.isValid()) camera = m_render_scene->getCameraInSlot("editor");
+		Vec3 camera_pos = camera.isValid() ? m_universe.getPosition(camera) : Vec3::ZERO;
+
+		int counts[ANIMATION_LOD_COUNT] = {};
+		for (Animable& animable : m_animables)
+		{
+			selectLOD(animable.entity, animable.lod, camera_pos);
+			++counts[animable.lod.lod];
+		}
+		for (Controller& controller : m_controllers)
+		{
+			selectLOD(controller.entity, controller.lod, camera_pos);
+			++counts[controller.lod.lod];
+		}
+		PROFILE_INT("lod 0", counts[0]);
+		PROFILE_INT("lod 1", counts[1]);
+		PROFILE_INT("lod 2", counts[2]);
+		PROFILE_INT("lod 3", counts[3]);
+	}
+
+
+	float getAnimationLODDistance(int lod) override
+	{
+		return m_lod_distances[lod];
+	}
+
+
+	void setAnimationLODDistance(int lod, float distance) override
+	{
+		if (lod <= 0 || lod >= ANIMATION_LOD_COUNT) return;
+		m_lod_distances[lod] = distance;
+	}
+
+
+	float getPoseCacheTimeQuantum() override
+	{
+		return m_pose_cache_time_quantum;
+	}
+
+
+	void setPoseCacheTimeQuantum(float quantum) override
+	{
+		m_pose_cache_time_quantum = Math::maximum(quantum, 0.0f);
+	}
+
+
+	PoseCacheStats getPoseCacheStats() override
+	{
+		return { m_pose_cache_hits, m_pose_cache_misses };
+	}
+
+
+	void clearPoseCache()
+	{
+		m_pose_cache.clear();
+		m_pose_cache.rehash(m_pose_cache_entries_count);
+		m_pose_cache_entries_count = 0;
+		m_pose_cache_hits = 0;
+		m_pose_cache_misses = 0;
+	}
+
+
+	// the first animable with a key samples the pose, later ones copy it if it's ready, otherwise they sample too
+	void sampleCachedPose(Animation& animation, Model& model, BoneMask* bone_mask, float time, Pose& pose)
+	{
+		if (m_pose_cache_time_quantum > 0) time = floorf(time / m_pose_cache_time_quantum) * m_pose_cache_time_quantum;
+		uintptr key_values[] = { (uintptr)&animation, (uintptr)&model, (uintptr)bone_mask, (uintptr)*(u32*)&time };
+		u32 key = crc32(key_values, sizeof(key_values));
+
+		PoseCacheEntry* entry;
+		bool is_owner = false;
+		{
+			MT::SpinLock lock(m_pose_cache_mutex);
+			auto iter = m_pose_cache.find(key);
+			if (iter.isValid())
+			{
+				entry = iter.value();
+			}
+			else
+			{
+				if (m_pose_cache_entries_count == m_pose_cache_entries.size())
+				{
+					m_pose_cache_entries.push(LUMIX_NEW(m_allocator, PoseCacheEntry)(m_allocator));
+				}
+				entry = m_pose_cache_entries[m_pose_cache_entries_count];
+				++m_pose_cache_entries_count;
+				entry->animation = &animation;
+				entry->model = &model;
+				entry->bone_mask = bone_mask;
+				entry->time = time;
+				entry->is_ready = 0;
+				m_pose_cache.insert(key, entry);
+				is_owner = true;
+			}
+		}
+
+		bool is_ready = !is_owner && entry->is_ready;
+		MT::memoryBarrier();
+		if (is_ready && entry->animation == &animation && entry->model == &model && entry->bone_mask == bone_mask &&
+			entry->time == time && entry->pose.count == pose.count)
+		{
+			copyPose(pose, entry->pose);
+			MT::atomicIncrement(&m_pose_cache_hits);
+			return;
+		}
+
+		model.getRelativePose(pose);
+		animation.getRelativePose(time, pose, model, bone_mask);
+		MT::atomicIncrement(&m_pose_cache_misses);
+		if (!is_owner) return;
+
+		if (entry->pose.count != pose.count) entry->pose.resize(pose.count);
+		copyPose(entry->pose, pose);
+		MT::memoryBarrier();
+		entry->is_ready = 1;
+	}
+
+
+	void updateAnimable(Animable& animable, float time_delta)
 	{
 		if (!animable.animation || !animable.animation->isReady()) return;
 		Entity entity = animable.entity;
@@ -709,8 +1061,17 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		Pose* pose = m_render_scene->lockPose(entity);
 		if (!pose) return;
 
-		model->getRelativePose(*pose);
-		animable.animation->getRelativePose(animable.time, *pose, *model, nullptr);
+		LODState& lod = animable.lod;
+		if (advanceLOD(lod, time_delta, pose))
+		{
+			lod.time_delta = 0;
+			sampleCachedPose(*animable.animation, *model, lod.bone_mask, animable.time, *pose);
+			onLODPoseSampled(lod, *model, *pose);
+		}
+		else
+		{
+			interpolateLODPose(lod, *model, *pose);
+		}
 		pose->computeAbsolute(*model);
 
 		float t = animable.time + time_delta * animable.time_scale;
@@ -724,6 +1085,8 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 
 	void updateAnimable(Entity entity, float time_delta) override
 	{
+		// the cache is valid only during one update, resources can change between updates
+		clearPoseCache();
 		Animable& animable = m_animables[entity];
 		updateAnimable(animable, time_delta);
 	}
@@ -732,7 +1095,8 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	void updateController(Entity entity, float time_delta) override
 	{
 		Controller& controller = m_controllers.get(entity);
-		updateController(controller, time_delta);
+		prepareControllerRuntime(controller, m_event_stream);
+		if (updateController(controller, time_delta, m_event_stream)) m_render_scene->unlockPose(entity, true);
 		processEventStream();
 		m_event_stream.clear();
 	}
@@ -745,7 +1109,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		if (!ctrl.root) return;
 		if (input_idx >= lengthOf(decl.inputs)) return;
 		if (decl.inputs[input_idx].type != Anim::InputDecl::FLOAT) return;
-		*(float*)&ctrl.input[decl.inputs[input_idx].offset] = value;
+		setInput(ctrl, decl.inputs[input_idx], value);
 	}
 
 
@@ -756,7 +1120,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		if (!ctrl.root) return;
 		if (input_idx >= lengthOf(decl.inputs)) return;
 		if (decl.inputs[input_idx].type != Anim::InputDecl::BOOL) return;
-		*(bool*)&ctrl.input[decl.inputs[input_idx].offset] = value;
+		setInput(ctrl, decl.inputs[input_idx], value);
 	}
 
 
@@ -767,7 +1131,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		if (!ctrl.root) return;
 		if (input_idx >= lengthOf(decl.inputs)) return;
 		if (decl.inputs[input_idx].type != Anim::InputDecl::INT) return;
-		*(int*)&ctrl.input[decl.inputs[input_idx].offset] = value;
+		setInput(ctrl, decl.inputs[input_idx], value);
 	}
 
 
@@ -786,8 +1150,10 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	
 	u8* getControllerInput(Entity entity) override
 	{
-		auto& input = m_controllers.get(entity).input;
-		return input.empty() ? nullptr : &input[0];
+		Controller& controller = m_controllers.get(entity);
+		// the caller can write to the inputs directly
+		controller.dirty_inputs = 0xffFFffFF;
+		return controller.input.empty() ? nullptr : &controller.input[0];
 	}
 
 
@@ -834,11 +1200,22 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	}
 
 
-	bool initControllerRuntime(Controller& controller)
+	void destroyControllerRuntime(Controller& controller)
+	{
+		if (controller.instance_pool) LUMIX_DELETE(*controller.instance_pool, controller.root);
+		LUMIX_DELETE(m_allocator, controller.instance_pool);
+		controller.root = nullptr;
+		controller.instance_pool = nullptr;
+	}
+
+
+	bool initControllerRuntime(Controller& controller, OutputBlob& event_stream)
 	{
 		if (!controller.resource->isReady()) return false;
 		if (controller.resource->m_input_decl.getSize() == 0) return false;
-		controller.root = controller.resource->createInstance(m_allocator);
+		if (!controller.resource->m_root) return false;
+		controller.instance_pool = LUMIX_NEW(m_allocator, Anim::InstancePool)(*controller.resource, m_allocator);
+		controller.root = controller.resource->createInstance(*controller.instance_pool);
 		controller.input.resize(controller.resource->m_input_decl.getSize());
 		int set_idx = 0;
 		for (int i = 0; i < controller.resource->m_sets_names.size(); ++i)
@@ -857,11 +1234,12 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		setMemory(&controller.input[0], 0, controller.input.size());
 		Anim::RunningContext rc;
 		rc.time_delta = 0;
-		rc.allocator = &m_allocator;
+		rc.allocator = controller.instance_pool;
 		rc.input = &controller.input[0];
+		rc.dirty_inputs = 0xffFFffFF;
 		rc.current = nullptr;
 		rc.anim_set = &controller.animations;
-		rc.event_stream = &m_event_stream;
+		rc.event_stream = &event_stream;
 		rc.controller = {controller.entity.index};
 		controller.root->enter(rc, nullptr);
 		return true;
@@ -896,49 +1274,73 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	}
 
 
-	void updateController(Controller& controller, float time_delta)
+	// destroys the runtime of a controller whose resource is not ready and creates a missing one;
+	// main thread only, it deletes and creates the instance pool with the scene allocator
+	void prepareControllerRuntime(Controller& controller, OutputBlob& event_stream)
 	{
 		if (!controller.resource->isReady())
 		{
-			LUMIX_DELETE(m_allocator, controller.root);
-			controller.root = nullptr;
+			destroyControllerRuntime(controller);
 			return;
 		}
+		if (!controller.root) initControllerRuntime(controller, event_stream);
+	}
 
-		if (!controller.root && !initControllerRuntime(controller)) return;
+
+	// returns true if the pose was changed, the caller unlocks it; runs in jobs, so it only advances
+	// a runtime created by prepareControllerRuntime, allocations go to the controller's own instance pool
+	bool updateController(Controller& controller, float time_delta, OutputBlob& event_stream)
+	{
+		if (!controller.root) return false;
+
+		Entity entity = controller.entity;
+		Model* model = nullptr;
+		Pose* pose = nullptr;
+		if (m_universe.hasComponent(entity, MODEL_INSTANCE_TYPE))
+		{
+			model = m_render_scene->getModelInstanceModel(entity);
+			if (model && model->isReady()) pose = m_render_scene->lockPose(entity);
+		}
+
+		LODState& lod = controller.lod;
+		if (!advanceLOD(lod, time_delta, pose))
+		{
+			interpolateLODPose(lod, *model, *pose);
+			return true;
+		}
 
 		Anim::RunningContext rc;
-		rc.time_delta = time_delta;
+		rc.time_delta = lod.time_delta;
 		rc.current = controller.root;
-		rc.allocator = &m_allocator;
+		rc.allocator = controller.instance_pool;
 		rc.input = &controller.input[0];
+		rc.dirty_inputs = controller.dirty_inputs;
 		rc.anim_set = &controller.animations;
-		rc.event_stream = &m_event_stream;
+		rc.event_stream = &event_stream;
 		rc.controller = {controller.entity.index};
 		controller.root = controller.root->update(rc, true);
+		controller.dirty_inputs = 0;
+		lod.time_delta = 0;
 
-		Entity entity = controller.entity;
-		if (!m_universe.hasComponent(entity, MODEL_INSTANCE_TYPE)) return;
-
-		Model* model = m_render_scene->getModelInstanceModel(entity);
-		if (!model || !model->isReady()) return;
-			
-		Pose* pose = m_render_scene->lockPose(entity);
-		if (!pose) return;
+		if (!pose) return false;
 
 		model->getRelativePose(*pose);
 
-		controller.root->fillPose(m_engine, *pose, *model, 1, nullptr);
+		controller.root->fillPose(m_engine, *pose, *model, 1, lod.bone_mask);
 
-		for (Controller::IK& ik : controller.inverse_kinematics)
+		if (lod.lod == 0)
 		{
-			if (ik.weight == 0) break;
+			for (Controller::IK& ik : controller.inverse_kinematics)
+			{
+				if (ik.weight == 0) break;
 
-			updateIK(ik, *pose, *model);
+				updateIK(ik, *pose, *model);
+			}
 		}
 
+		onLODPoseSampled(lod, *model, *pose);
 		pose->computeAbsolute(*model);
-		m_render_scene->unlockPose(entity, true);
+		return true;
 	}
 
 	static RigidTransform getAbsolutePosition(const Pose& pose, const Model& model, int bone_index)
@@ -1057,29 +1459,66 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	}
 
 
+	// first key at or after frame, the search starts at cursor since the time usually moves forward
+	static int findKey(const PropertyAnimation::Curve& curve, int frame, int cursor)
+	{
+		int count = curve.frames.size();
+		if (cursor < 1 || cursor > count || (cursor > 1 && curve.frames[cursor - 1] >= frame)) cursor = 1;
+		while (cursor < count && curve.frames[cursor] < frame) ++cursor;
+		return cursor;
+	}
+
+
+	PropertyBatch& getPropertyBatch(const PropertyAnimation::Curve& curve)
+	{
+		auto iter = m_property_batch_indices.find(curve.property);
+		if (iter.isValid()) return m_property_batches[iter.value()];
+
+		m_property_batch_indices.insert(curve.property, m_property_batches.size());
+		PropertyBatch& batch = m_property_batches.emplace(m_allocator);
+		batch.property = curve.property;
+		batch.scene = m_universe.getScene(curve.cmp_type);
+		return batch;
+	}
+
+
+	// one virtual call for each animated property, instead of one for each value
+	void applyPropertyBatches()
+	{
+		for (PropertyBatch& batch : m_property_batches)
+		{
+			if (batch.entities.empty()) continue;
+			batch.property->setValues(batch.scene, &batch.entities[0], &batch.values[0], batch.entities.size(), -1);
+			batch.entities.clear();
+			batch.values.clear();
+		}
+	}
+
+
+	// the values are written by applyPropertyBatches
 	void applyPropertyAnimator(Entity entity, PropertyAnimator& animator)
 	{
 		const PropertyAnimation* animation = animator.animation;
 		int frame = int(animator.time * animation->fps + 0.5f);
 		frame = frame % animation->curves[0].frames.back();
-		for (PropertyAnimation::Curve& curve : animation->curves)
+		if (animator.cursors.size() != animation->curves.size())
 		{
-			if (curve.frames.size() < 2) continue;
-			for (int i = 1, n = curve.frames.size(); i < n; ++i)
-			{
-				if (frame <= curve.frames[i])
-				{
-					float t = (frame - curve.frames[i - 1]) / float(curve.frames[i] - curve.frames[i - 1]);
-					float v = curve.values[i] * t + curve.values[i - 1] * (1 - t);
-					ComponentUID cmp;
-					cmp.type = curve.cmp_type;
-					cmp.scene = m_universe.getScene(cmp.type);
-					cmp.entity = entity;
-					InputBlob blob(&v, sizeof(v));
-					curve.property->setValue(cmp, -1, blob);
-					break;
-				}
-			}
+			animator.cursors.resize(animation->curves.size());
+			setMemory(&animator.cursors[0], 0, animator.cursors.size() * sizeof(animator.cursors[0]));
+		}
+		for (int curve_idx = 0, c = animation->curves.size(); curve_idx < c; ++curve_idx)
+		{
+			const PropertyAnimation::Curve& curve = animation->curves[curve_idx];
+			if (curve.frames.size() < 2 || !curve.property) continue;
+
+			int i = findKey(curve, frame, animator.cursors[curve_idx]);
+			animator.cursors[curve_idx] = i;
+			if (i == curve.frames.size()) continue;
+
+			float t = (frame - curve.frames[i - 1]) / float(curve.frames[i] - curve.frames[i - 1]);
+			PropertyBatch& batch = getPropertyBatch(curve);
+			batch.entities.push(entity);
+			batch.values.push(curve.values[i] * t + curve.values[i - 1] * (1 - t));
 		}
 	}
 
@@ -1101,6 +1540,7 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 			
 			applyPropertyAnimator(entity, animator);
 		}
+		applyPropertyBatches();
 	}
 
 
@@ -1131,6 +1571,64 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 		}
 		JobSystem::runJobs(jobs, job_count, &counter);
 		JobSystem::wait(&counter);
+		PROFILE_INT("pose cache hits", m_pose_cache_hits);
+		PROFILE_INT("pose cache misses", m_pose_cache_misses);
+	}
+
+
+	// controllers are updated in jobs, events and pose unlocks (which can move bone attachments)
+	// are collected per job and applied in entity order, the same order as a serial update;
+	// runtimes are destroyed and created before the jobs start, the jobs only read the universe's component
+	// masks and the render scene's model instances, neither changes until the jobs are finished;
+	// the instance pools and job outputs grow from the engine allocator, which is thread safe
+	void updateControllers(float time_delta)
+	{
+		PROFILE_FUNCTION();
+		if (m_controllers.size() == 0) return;
+
+		for (Controller& controller : m_controllers)
+		{
+			prepareControllerRuntime(controller, m_event_stream);
+		}
+
+		JobSystem::JobDecl jobs[16];
+		JobSystem::LambdaJob job_storage[16];
+
+		int job_count = Math::minimum(lengthOf(jobs), m_controllers.size());
+		while (m_controller_job_outputs.size() < job_count) m_controller_job_outputs.emplace(m_allocator);
+		volatile int counter = 0;
+		for (int i = 0; i < job_count; ++i)
+		{
+			JobSystem::fromLambda([time_delta, this, i, job_count]() {
+				PROFILE_BLOCK("Update Controllers Job");
+				ControllerJobOutput& output = m_controller_job_outputs[i];
+				output.event_stream.clear();
+				output.updated_poses.clear();
+				int all_count = m_controllers.size();
+				int from = i * all_count / job_count;
+				int to = (i + 1) * all_count / job_count;
+				for (int j = from; j < to; ++j)
+				{
+					Controller& controller = m_controllers.at(j);
+					if (updateController(controller, time_delta, output.event_stream))
+					{
+						output.updated_poses.push(controller.entity);
+					}
+				}
+			}, &job_storage[i], &jobs[i], nullptr);
+		}
+		JobSystem::runJobs(jobs, job_count, &counter);
+		JobSystem::wait(&counter);
+
+		for (int i = 0; i < job_count; ++i)
+		{
+			ControllerJobOutput& output = m_controller_job_outputs[i];
+			for (Entity entity : output.updated_poses) m_render_scene->unlockPose(entity, true);
+			if (output.event_stream.getPos() > 0)
+			{
+				m_event_stream.write(output.event_stream.getData(), output.event_stream.getPos());
+			}
+		}
 	}
 
 
@@ -1142,13 +1640,12 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 
 		m_event_stream.clear();
 
+		updateLODs();
+		clearPoseCache();
 		updateAnimables(time_delta);
 		updatePropertyAnimators(time_delta);
 
-		for (Controller& controller : m_controllers)
-		{
-			AnimationSceneImpl::updateController(controller, time_delta);
-		}
+		updateControllers(time_delta);
 
 		for (SharedController& controller : m_shared_controllers)
 		{
@@ -1182,9 +1679,9 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 					Anim::InputDecl::Input& input = decl.inputs[event.input_idx];
 					switch (input.type)
 					{
-						case Anim::InputDecl::BOOL: *(bool*)&ctrl.input[input.offset] = event.b_value; break;
-						case Anim::InputDecl::INT: *(int*)&ctrl.input[input.offset] = event.i_value; break;
-						case Anim::InputDecl::FLOAT: *(float*)&ctrl.input[input.offset] = event.f_value; break;
+						case Anim::InputDecl::BOOL: setInput(ctrl, input, event.b_value); break;
+						case Anim::InputDecl::INT: setInput(ctrl, input, event.i_value); break;
+						case Anim::InputDecl::FLOAT: setInput(ctrl, input, event.f_value); break;
 						default: ASSERT(false); break;
 					}
 				}
@@ -1267,7 +1764,19 @@ struct AnimationSceneImpl LUMIX_FINAL : public AnimationScene
 	Engine& m_engine;
 	AssociativeArray<Entity, Animable> m_animables;
 	AssociativeArray<Entity, PropertyAnimator> m_property_animators;
+	Array<PropertyBatch> m_property_batches;
+	HashMap<const void*, int, HashFunc<void*>> m_property_batch_indices;
 	AssociativeArray<Entity, Controller> m_controllers;
+	Array<ControllerJobOutput> m_controller_job_outputs;
+	AssociativeArray<Model*, BoneMask*> m_reduced_bone_masks;
+	float m_lod_distances[ANIMATION_LOD_COUNT];
+	HashMap<u32, PoseCacheEntry*> m_pose_cache;
+	Array<PoseCacheEntry*> m_pose_cache_entries;
+	int m_pose_cache_entries_count;
+	MT::SpinMutex m_pose_cache_mutex;
+	float m_pose_cache_time_quantum;
+	volatile i32 m_pose_cache_hits;
+	volatile i32 m_pose_cache_misses;
 	AssociativeArray<Entity, SharedController> m_shared_controllers;
 	RenderScene* m_render_scene;
 	bool m_is_game_running;
@@ -1301,6 +1810,8 @@ void AnimationScene::registerLuaAPI(lua_State* L)
 	REGISTER_FUNCTION(setControllerBoolInput);
 	REGISTER_FUNCTION(setControllerFloatInput);
 	REGISTER_FUNCTION(getControllerInputIndex);
+	REGISTER_FUNCTION(setAnimationLODDistance);
+	REGISTER_FUNCTION(setPoseCacheTimeQuantum);
 
 	#undef REGISTER_FUNCTION
 
@@ -22,6 +22,13 @@ class ControllerResource;
 }
 
 
+struct PoseCacheStats
+{
+	int hits;
+	int misses;
+};
+
+
 struct AnimationScene : public IScene
 {
 	static AnimationScene* create(Engine& engine, IPlugin& plugin, Universe& universe, IAllocator& allocator);
@@ -60,6 +67,14 @@ struct AnimationScene : public IScene
 	virtual int getControllerDefaultSet(Entity entity) = 0;
 	virtual Anim::ControllerResource* getControllerResource(Entity entity) = 0;
 	virtual float getAnimationLength(int animation_idx) = 0;
+	// distance from the main camera where the lod starts, lod 0 starts at the camera
+	virtual float getAnimationLODDistance(int lod) = 0;
+	virtual void setAnimationLODDistance(int lod, float distance) = 0;
+	// animables are sampled at multiples of the quantum so they can share poses, 0 shares only equal times
+	virtual float getPoseCacheTimeQuantum() = 0;
+	virtual void setPoseCacheTimeQuantum(float quantum) = 0;
+	// of the poses sampled in the last update
+	virtual PoseCacheStats getPoseCacheStats() = 0;
 };
 
 
@@ -1,5 +1,6 @@
 #include "condition.h"
 #include "state_machine.h"
+#include "engine/mt/atomic.h"
 #include <cmath>
 #include <cstdlib>
 
@@ -22,6 +23,9 @@ enum class Types : u8
 };
 
 
+static const int MAX_REGISTERS = 64;
+
+
 namespace Instruction
 {
 	enum Type : u8
@@ -191,140 +195,6 @@ private:
 };
 
 
-class ExpressionVM
-{
-public:
-	static const int STACK_SIZE = 50;
-
-	struct ReturnValue
-	{
-		ReturnValue()
-		{
-			type = Types::NONE;
-		}
-
-		explicit ReturnValue(float f)
-		{
-			f_value = f;
-			type = Types::FLOAT;
-		}
-
-		explicit ReturnValue(bool b)
-		{
-			b_value = b;
-			type = Types::BOOL;
-		}
-
-		Types type;
-		union
-		{
-			float f_value;
-			bool b_value;
-		};
-	};
-
-public:
-	ReturnValue evaluate(const u8* code, RunningContext& rc);
-
-private:
-	void callFunction(u16 idx, RunningContext& rc);
-
-	template<typename T>
-	T& pop()
-	{
-		m_stack_pointer -= sizeof(T);
-		return *(T*)(m_stack + m_stack_pointer);
-	}
-
-
-	template <typename T>
-	const u8* pushStackConst(const u8* cp)
-	{
-		*(T*)(m_stack + m_stack_pointer) = *(T*)cp;
-		m_stack_pointer += sizeof(T);
-		return cp + sizeof(T);
-	}
-
-
-	template <typename T>
-	void push(T value)
-	{
-		*(T*)(m_stack + m_stack_pointer) = value;
-		m_stack_pointer += sizeof(T);
-	}
-
-private:
-	u8 m_stack[STACK_SIZE];
-	int m_stack_pointer;
-};
-
-
-ExpressionVM::ReturnValue ExpressionVM::evaluate(const u8* code, RunningContext& rc)
-{
-	m_stack_pointer = 0;
-	const u8* cp = code;
-	for (;;)
-	{
-		u8 type = *cp;
-		++cp;
-		switch (type)
-		{
-			case Instruction::CALL:
-				callFunction(*(u16*)cp, rc);
-				cp += sizeof(u16);
-				break;
-			case Instruction::INPUT_FLOAT:
-				push<float>(*(float*)(rc.input + *(int*)cp));
-				cp += sizeof(int);
-				break;
-			case Instruction::INPUT_BOOL:
-				push<bool>(*(bool*)(rc.input + *(int*)cp));
-				cp += sizeof(int);
-				break;
-			case Instruction::INPUT_INT:
-				push<int>(*(int*)(rc.input + *(int*)cp));
-				cp += sizeof(int);
-				break;
-			case Instruction::RET_FLOAT: return ExpressionVM::ReturnValue(pop<float>());
-			case Instruction::RET_BOOL: return ExpressionVM::ReturnValue(pop<bool>());
-			case Instruction::ADD_FLOAT: push<float>(pop<float>() + pop<float>()); break;
-			case Instruction::SUB_FLOAT: push<float>(-pop<float>() + pop<float>()); break;
-			case Instruction::PUSH_BOOL: cp = pushStackConst<bool>(cp); break;
-			case Instruction::PUSH_FLOAT: cp = pushStackConst<float>(cp); break;
-			case Instruction::PUSH_INT: cp = pushStackConst<int>(cp); break;
-			case Instruction::FLOAT_LT: push<bool>(pop<float>() > pop<float>()); break;
-			case Instruction::FLOAT_GT: push<bool>(pop<float>() < pop<float>()); break;
-			case Instruction::INT_EQ: push<bool>(pop<int>() == pop<int>()); break;
-			case Instruction::INT_NEQ: push<bool>(pop<int>() != pop<int>()); break;
-			case Instruction::MUL_FLOAT: push<float>(pop<float>() * pop<float>()); break;
-			case Instruction::DIV_FLOAT:
-			{
-				float f = pop<float>();
-				push<float>(pop<float>() / f);
-			}
-			break;
-			case Instruction::UNARY_MINUS: push<float>(-pop<float>()); break;
-			case Instruction::OR:
-			{
-				bool b1 = pop<bool>();
-				bool b2 = pop<bool>();
-				push<bool>(b1 || b2);
-			}
-			break;
-			case Instruction::AND:
-			{
-				bool b1 = pop<bool>();
-				bool b2 = pop<bool>();
-				push<bool>(b1 && b2);
-			}
-			break;
-			case Instruction::NOT: push<bool>(!pop<bool>()); break;
-			default: ASSERT(false); break;
-		}
-	}
-}
-
-
 int ExpressionCompiler::toPostfix(const Token* input, Token* output, int count)
 {
 	Token func_stack[64];
@@ -397,20 +267,6 @@ int ExpressionCompiler::toPostfix(const Token* input, Token* output, int count)
 }
 
 
-void ExpressionVM::callFunction(u16 idx, RunningContext& rc)
-{
-	switch(idx)
-	{
-		case 0: push<float>(sin(pop<float>())); break;
-		case 1: push<float>(cos(pop<float>())); break;
-		case 2: push<float>(rc.current->getTime()); break;
-		case 3: push<float>(rc.current->getLength()); break;
-		case 4: push<bool>(rc.current->getTime() > rc.current->getLength() - rc.edge->length); break;
-		default: ASSERT(false); break;
-	}
-}
-
-
 static const struct
 {
 	ExpressionCompiler::Token::Operator op;
@@ -687,12 +543,15 @@ int ExpressionCompiler::compile(const char* src,
 								*(bool*)out = bool_const_value;
 								out += sizeof(bool);
 							}
-							*out = Instruction::PUSH_FLOAT;
-							type_stack[type_stack_idx] = Types::FLOAT;
-							++type_stack_idx;
-							++out;
-							*(float*)out = float_const_value;
-							out += sizeof(float);
+							else
+							{
+								*out = Instruction::PUSH_FLOAT;
+								type_stack[type_stack_idx] = Types::FLOAT;
+								++type_stack_idx;
+								++out;
+								*(float*)out = float_const_value;
+								out += sizeof(float);
+							}
 						}
 					}
 				}
@@ -855,14 +714,134 @@ const char* Condition::errorToString(Error error)
 
 Condition::Condition(IAllocator& allocator)
 	: bytecode(allocator)
+	, program(allocator)
+	, inputs_mask(0)
+	, uses_instance(false)
+	, generation(0)
 {}
 
 
-bool Condition::operator()(RunningContext& rc)
+static volatile i32 s_last_generation = 0;
+
+
+void Condition::createProgram()
 {
-	ExpressionVM vm;
-	auto ret = vm.evaluate(&bytecode[0], rc);
-	return ret.b_value;
+	generation = (u32)MT::atomicIncrement(&s_last_generation);
+	program.clear();
+	inputs_mask = 0;
+	uses_instance = false;
+	if (bytecode.empty()) return;
+
+	int depth = 0;
+	const u8* cp = &bytecode[0];
+	const u8* end = cp + bytecode.size();
+	while (cp < end)
+	{
+		Operation& op = program.emplace();
+		op.type = *cp;
+		op.i_value = 0;
+		++cp;
+		switch (op.type)
+		{
+			case Instruction::PUSH_BOOL:
+				op.b_value = *(bool*)cp;
+				cp += sizeof(bool);
+				op.dst = depth++;
+				break;
+			case Instruction::PUSH_FLOAT:
+			case Instruction::PUSH_INT:
+				op.i_value = *(int*)cp;
+				cp += sizeof(int);
+				op.dst = depth++;
+				break;
+			case Instruction::INPUT_FLOAT:
+			case Instruction::INPUT_INT:
+			case Instruction::INPUT_BOOL:
+			{
+				static const InputDecl::Type types[] = { InputDecl::FLOAT, InputDecl::INT, InputDecl::BOOL };
+				op.offset = *(int*)cp;
+				cp += sizeof(int);
+				op.dst = depth++;
+				inputs_mask |= InputDecl::getDirtyMask(op.offset, types[op.type - Instruction::INPUT_FLOAT]);
+				break;
+			}
+			case Instruction::CALL:
+				op.i_value = *(u16*)cp;
+				cp += sizeof(u16);
+				depth -= FUNCTIONS[op.i_value].arity();
+				op.dst = depth++;
+				// functions without arguments read the current instance, e.g. time()
+				uses_instance = uses_instance || FUNCTIONS[op.i_value].arity() == 0;
+				break;
+			case Instruction::UNARY_MINUS:
+			case Instruction::NOT:
+			case Instruction::RET_FLOAT:
+			case Instruction::RET_BOOL:
+				op.dst = depth - 1;
+				break;
+			default:
+				--depth;
+				op.dst = depth - 1;
+				break;
+		}
+		ASSERT(depth > 0 && depth <= MAX_REGISTERS);
+	}
+}
+
+
+bool Condition::operator()(RunningContext& rc) const
+{
+	if (program.empty()) return true;
+
+	union
+	{
+		float f_value;
+		int i_value;
+		bool b_value;
+	} regs[MAX_REGISTERS + 1];
+
+	for (const Operation& op : program)
+	{
+		auto& r = regs[op.dst];
+		auto& arg = regs[op.dst + 1];
+		switch (op.type)
+		{
+			case Instruction::PUSH_BOOL:
+			case Instruction::PUSH_FLOAT:
+			case Instruction::PUSH_INT: r.i_value = op.i_value; break;
+			case Instruction::INPUT_FLOAT: r.f_value = *(float*)(rc.input + op.offset); break;
+			case Instruction::INPUT_INT: r.i_value = *(int*)(rc.input + op.offset); break;
+			case Instruction::INPUT_BOOL: r.b_value = *(bool*)(rc.input + op.offset); break;
+			case Instruction::RET_FLOAT:
+			case Instruction::RET_BOOL: return r.b_value;
+			case Instruction::ADD_FLOAT: r.f_value = r.f_value + arg.f_value; break;
+			case Instruction::SUB_FLOAT: r.f_value = r.f_value - arg.f_value; break;
+			case Instruction::MUL_FLOAT: r.f_value = r.f_value * arg.f_value; break;
+			case Instruction::DIV_FLOAT: r.f_value = r.f_value / arg.f_value; break;
+			case Instruction::UNARY_MINUS: r.f_value = -r.f_value; break;
+			case Instruction::FLOAT_LT: r.b_value = r.f_value < arg.f_value; break;
+			case Instruction::FLOAT_GT: r.b_value = r.f_value > arg.f_value; break;
+			case Instruction::INT_EQ: r.b_value = r.i_value == arg.i_value; break;
+			case Instruction::INT_NEQ: r.b_value = r.i_value != arg.i_value; break;
+			case Instruction::AND: r.b_value = r.b_value && arg.b_value; break;
+			case Instruction::OR: r.b_value = r.b_value || arg.b_value; break;
+			case Instruction::NOT: r.b_value = !r.b_value; break;
+			case Instruction::CALL:
+				switch (op.i_value)
+				{
+					case 0: r.f_value = sin(r.f_value); break;
+					case 1: r.f_value = cos(r.f_value); break;
+					case 2: r.f_value = rc.current->getTime(); break;
+					case 3: r.f_value = rc.current->getLength(); break;
+					case 4: r.b_value = rc.current->getTime() > rc.current->getLength() - rc.edge->length; break;
+					default: ASSERT(false); break;
+				}
+				break;
+			default: ASSERT(false); break;
+		}
+	}
+	ASSERT(false);
+	return false;
 }
 
 
@@ -891,6 +870,7 @@ Condition::Error Condition::compile(const char* expression, InputDecl& decl)
 		return compiler.getError();
 	}
 	bytecode.resize(size);
+	createProgram();
 	return Condition::Error::NONE;
 }
 
@@ -27,6 +27,7 @@ struct RunningContext
 {
 	float time_delta;
 	u8* input;
+	u32 dirty_inputs;
 	IAllocator* allocator;
 	struct ComponentInstance* current;
 	struct Edge* edge;
@@ -196,6 +197,15 @@ struct InputDecl
 		}
 	}
 
+	// one bit for every 4 bytes of input data, inputs sharing 4 bytes are marked dirty together
+	static u32 getDirtyMask(int offset, Type type)
+	{
+		int first = offset >> 2;
+		int last = (offset + getSize(type) - 1) >> 2;
+		ASSERT(last < 32);
+		return ((2u << last) - 1) & ~((1u << first) - 1);
+	}
+
 	void recalculateOffsets()
 	{
 		if (inputs_count == 0) return;
@@ -250,10 +260,33 @@ struct Condition
 
 	explicit Condition(IAllocator& allocator);
 
-	bool operator()(RunningContext& rc);
+	bool operator()(RunningContext& rc) const;
 	Error compile(const char* expression, InputDecl& decl);
+	// translates bytecode to program, call after bytecode is changed
+	void createProgram();
+	// false if the result is the same as the last time, when only inputs not in dirty_inputs changed
+	bool needsUpdate(u32 dirty_inputs) const { return uses_instance || (inputs_mask & dirty_inputs) != 0; }
+
+	// stack of the bytecode is mapped to registers, every operation writes to register dst
+	struct Operation
+	{
+		u8 type;
+		u8 dst;
+		union
+		{
+			float f_value;
+			int i_value;
+			bool b_value;
+			int offset;
+		};
+	};
 
 	Array<u8> bytecode;
+	Array<Operation> program;
+	u32 inputs_mask;
+	bool uses_instance;
+	// unique for each created program, results cached for an older one are stale
+	u32 generation;
 };
 
 
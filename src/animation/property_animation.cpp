@@ -25,6 +25,45 @@ void PropertyAnimationManager::destroyResource(Resource& resource)
 const ResourceType PropertyAnimation::TYPE("property_animation");
 
 
+static const Reflection::Property<float>* getFloatProperty(ComponentType cmp_type, u32 property_name_hash)
+{
+	const Reflection::ComponentBase* cmp = Reflection::getComponent(cmp_type);
+	if (!cmp) return nullptr;
+	struct : Reflection::ISimpleComponentVisitor
+	{
+		void visitProperty(const Reflection::PropertyBase& prop) override {}
+		void visit(const Reflection::Property<float>& prop) override
+		{
+			if (crc32(prop.name) == property_name_hash) result = &prop;
+		}
+
+		u32 property_name_hash;
+		const Reflection::Property<float>* result = nullptr;
+	} visitor;
+	visitor.property_name_hash = property_name_hash;
+	cmp->visit(visitor);
+	return visitor.result;
+}
+
+
+static void sortKeys(PropertyAnimation::Curve& curve)
+{
+	for (int i = 1, c = curve.frames.size(); i < c; ++i)
+	{
+		int frame = curve.frames[i];
+		float value = curve.values[i];
+		int j = i;
+		for (; j > 0 && curve.frames[j - 1] > frame; --j)
+		{
+			curve.frames[j] = curve.frames[j - 1];
+			curve.values[j] = curve.values[j - 1];
+		}
+		curve.frames[j] = frame;
+		curve.values[j] = value;
+	}
+}
+
+
 PropertyAnimation::PropertyAnimation(const Path& path, ResourceManagerBase& resource_manager, IAllocator& allocator)
 	: Resource(path, resource_manager, allocator)
 	, fps(30)
@@ -142,7 +181,9 @@ bool PropertyAnimation::load(FS::IFile& file)
 			}
 		}
 		serializer.deserializeObjectEnd();
-		curve.property = Reflection::getProperty(curve.cmp_type, prop_hash);
+		curve.property = getFloatProperty(curve.cmp_type, prop_hash);
+		if (!curve.property) g_log_error.log("Animation") << "Unknown float property in " << getPath().c_str();
+		sortKeys(curve);
 	}
 	serializer.deserializeArrayEnd();
 
@@ -16,7 +16,7 @@ namespace FS
 
 namespace Reflection
 {
-	struct  PropertyBase;
+	template <typename T> struct Property;
 }
 
 
@@ -50,8 +50,9 @@ public:
 		Curve(IAllocator& allocator) : frames(allocator), values(allocator) {}
 
 		ComponentType cmp_type;
-		const Reflection::PropertyBase* property;
+		const Reflection::Property<float>* property;
 		
+		// sorted by frame
 		Array<int> frames;
 		Array<float> values;
 	};
@@ -147,6 +147,7 @@ void Edge::deserialize(InputBlob& blob, Container* parent, int version)
 	blob.read(size);
 	condition.bytecode.resize(size);
 	if(size > 0) blob.read(&condition.bytecode[0], size);
+	condition.createProgram();
 	from->out_edges.push(this);
 }
 
@@ -241,10 +242,18 @@ void Node::deserialize(InputBlob& blob, Container* parent, int version)
 }
 
 
-Blend1DNodeInstance::Blend1DNodeInstance(Blend1DNode& _node)
+Blend1DNodeInstance::Blend1DNodeInstance(Blend1DNode& _node, IAllocator& _allocator)
 	: NodeInstance(_node)
 	, node(_node)
+	, allocator(_allocator)
+{
+	for (NodeInstance*& instance : instances) instance = nullptr;
+}
+
+
+Blend1DNodeInstance::~Blend1DNodeInstance()
 {
+	for (NodeInstance* instance : instances) LUMIX_DELETE(allocator, instance);
 }
 
 
@@ -329,9 +338,10 @@ void Blend1DNodeInstance::enter(RunningContext& rc, ComponentInstance* from)
 }
 
 
-LayersNodeInstance::LayersNodeInstance(LayersNode& _node)
+LayersNodeInstance::LayersNodeInstance(LayersNode& _node, IAllocator& _allocator)
 	: NodeInstance(_node)
 	, node(_node)
+	, allocator(_allocator)
 {
 	static_assert(sizeof(_node.masks) / sizeof(_node.masks[0]) == sizeof(masks) / sizeof(masks[0]), "");
 	for (int i = 0; i < lengthOf(masks); ++i)
@@ -348,6 +358,12 @@ LayersNodeInstance::LayersNodeInstance(LayersNode& _node)
 }
 
 
+LayersNodeInstance::~LayersNodeInstance()
+{
+	for (int i = 0; i < layers_count; ++i) LUMIX_DELETE(allocator, layers[i]);
+}
+
+
 RigidTransform LayersNodeInstance::getRootMotion() const
 {
 	if (layers_count == 0) return {{0, 0, 0}, {0, 0, 0, 1}};
@@ -426,7 +442,7 @@ LayersNode::LayersNode(ControllerResource& controller, IAllocator& allocator)
 
 ComponentInstance* LayersNode::createInstance(IAllocator& allocator)
 {
-	return LUMIX_NEW(allocator, LayersNodeInstance)(*this);
+	return LUMIX_NEW(allocator, LayersNodeInstance)(*this, allocator);
 }
 
 
@@ -453,7 +469,7 @@ Blend1DNode::Blend1DNode(ControllerResource& controller, IAllocator& allocator)
 
 ComponentInstance* Blend1DNode::createInstance(IAllocator& allocator)
 {
-	return LUMIX_NEW(allocator, Blend1DNodeInstance)(*this);
+	return LUMIX_NEW(allocator, Blend1DNodeInstance)(*this, allocator);
 }
 
 
@@ -611,8 +627,17 @@ ComponentInstance* NodeInstance::checkOutEdges(Node& node, RunningContext& rc)
 	rc.current = this;
 	Edge* options[16];
 	int options_count = 0;
-	for (auto* edge : node.out_edges)
+	for (int i = 0, c = node.out_edges.size(); i < c; ++i)
 	{
+		Edge* edge = node.out_edges[i];
+		if (edge->condition.generation > false_edges_generation)
+		{
+			false_edges = 0;
+			false_edges_generation = edge->condition.generation;
+		}
+		u32 edge_bit = i < 32 ? 1u << i : 0;
+		if ((false_edges & edge_bit) && !edge->condition.needsUpdate(rc.dirty_inputs)) continue;
+
 		rc.edge = edge;
 		if (edge->condition(rc))
 		{
@@ -620,6 +645,10 @@ ComponentInstance* NodeInstance::checkOutEdges(Node& node, RunningContext& rc)
 			++options_count;
 			if (options_count == lengthOf(options)) break;
 		}
+		else
+		{
+			false_edges |= edge_bit;
+		}
 	}
 	if (options_count > 0)
 	{
@@ -868,6 +897,7 @@ void StateMachine::deserialize(InputBlob& blob, Container* parent, int version)
 		{
 			blob.read(&entry.condition.bytecode[0], size);
 		}
+		entry.condition.createProgram();
 	}
 }
 
@@ -912,6 +942,17 @@ Component* Container::getByUID(int _uid)
 }
 
 
+int Container::getComponentsCount() const
+{
+	int count = 1;
+	for (auto* child : children)
+	{
+		count += child->getComponentsCount();
+	}
+	return count;
+}
+
+
 void Container::serialize(OutputBlob& blob)
 {
 	Node::serialize(blob);
@@ -940,6 +981,100 @@ void Container::deserialize(InputBlob& blob, Container* parent, int version)
 }
 
 
+static const size_t INSTANCE_SLOT_ALIGN = 16;
+
+
+static size_t getInstanceSlotSize()
+{
+	size_t size = Math::maximum(sizeof(EdgeInstance),
+		sizeof(AnimationNodeInstance),
+		sizeof(Blend1DNodeInstance),
+		sizeof(LayersNodeInstance),
+		sizeof(StateMachineInstance));
+	return (size + INSTANCE_SLOT_ALIGN - 1) & ~(INSTANCE_SLOT_ALIGN - 1);
+}
+
+
+InstancePool::InstancePool(const ControllerResource& resource, IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_chunks(allocator)
+	, m_free(nullptr)
+	, m_slots_count(0)
+{
+	// a transition keeps both of its nodes alive, so there is room for every component of the resource twice
+	grow(resource.m_root ? resource.m_root->getComponentsCount() * 2 : 1);
+}
+
+
+InstancePool::~InstancePool()
+{
+	for (u8* chunk : m_chunks)
+	{
+		m_allocator.deallocate_aligned(chunk);
+	}
+}
+
+
+void InstancePool::grow(int slots_count)
+{
+	size_t slot_size = getInstanceSlotSize();
+	u8* chunk = (u8*)m_allocator.allocate_aligned(slot_size * slots_count, INSTANCE_SLOT_ALIGN);
+	m_chunks.push(chunk);
+	for (int i = slots_count - 1; i >= 0; --i)
+	{
+		void** slot = (void**)(chunk + i * slot_size);
+		*slot = m_free;
+		m_free = slot;
+	}
+	m_slots_count += slots_count;
+}
+
+
+void* InstancePool::allocate(size_t size)
+{
+	ASSERT(size <= getInstanceSlotSize());
+	if (!m_free) grow(m_slots_count);
+	void** slot = (void**)m_free;
+	m_free = *slot;
+	return slot;
+}
+
+
+void InstancePool::deallocate(void* ptr)
+{
+	if (!ptr) return;
+	*(void**)ptr = m_free;
+	m_free = ptr;
+}
+
+
+void* InstancePool::reallocate(void*, size_t)
+{
+	ASSERT(false);
+	return nullptr;
+}
+
+
+void* InstancePool::allocate_aligned(size_t size, size_t align)
+{
+	ASSERT(align <= INSTANCE_SLOT_ALIGN);
+	return allocate(size);
+}
+
+
+void InstancePool::deallocate_aligned(void* ptr)
+{
+	deallocate(ptr);
+}
+
+
+void* InstancePool::reallocate_aligned(void*, size_t, size_t)
+{
+	ASSERT(false);
+	return nullptr;
+}
+
+
 Component* createComponent(ControllerResource& controller, Component::Type type, IAllocator& allocator)
 {
 	switch (type)
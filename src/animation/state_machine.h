@@ -74,6 +74,7 @@ struct Component
 	virtual void serialize(OutputBlob& blob);
 	virtual void deserialize(InputBlob& blob, Container* parent, int version);
 	virtual Component* getByUID(int _uid) { return (uid == _uid) ? this : nullptr; }
+	virtual int getComponentsCount() const { return 1; }
 
 	ControllerResource& controller;
 	int uid;
@@ -106,6 +107,7 @@ struct Container : public Node
 	void deserialize(InputBlob& blob, Container* parent, int version) override;
 	Component* getChildByUID(int uid);
 	Component* getByUID(int _uid) override;
+	int getComponentsCount() const override;
 
 	IAllocator& allocator;
 	Array<Component*> children;
@@ -137,6 +139,11 @@ struct NodeInstance : public ComponentInstance
 	void queueExitEvents(RunningContext& rc);
 protected:
 	void queueEventArray(RunningContext& rc, const EventArray& events);
+
+	// one bit for each of the first 32 out edges, set if its condition was false and inputs did not change since
+	u32 false_edges = 0;
+	// the newest condition generation false_edges were cached with, a newer one means a condition was recompiled
+	u32 false_edges_generation = 0;
 };
 
 
@@ -158,7 +165,8 @@ struct AnimationNode : public Node
 
 struct Blend1DNodeInstance : public NodeInstance
 {
-	explicit Blend1DNodeInstance(Blend1DNode& _node);
+	Blend1DNodeInstance(Blend1DNode& _node, IAllocator& _allocator);
+	~Blend1DNodeInstance();
 
 	RigidTransform getRootMotion() const override;
 	float getTime() const override { return time; }
@@ -174,6 +182,7 @@ struct Blend1DNodeInstance : public NodeInstance
 	float current_weight = 1;
 	NodeInstance* instances[16];
 	Blend1DNode& node;
+	IAllocator& allocator;
 	float time;
 };
 
@@ -198,7 +207,8 @@ struct Blend1DNode : public Container
 
 struct LayersNodeInstance : public NodeInstance
 {
-	explicit LayersNodeInstance(LayersNode& _node);
+	LayersNodeInstance(LayersNode& _node, IAllocator& _allocator);
+	~LayersNodeInstance();
 
 	RigidTransform getRootMotion() const override;
 	float getTime() const override;
@@ -212,6 +222,7 @@ struct LayersNodeInstance : public NodeInstance
 	struct BoneMask* masks[16];
 	int layers_count = 0;
 	LayersNode& node;
+	IAllocator& allocator;
 	float time;
 };
 
@@ -266,6 +277,31 @@ struct StateMachine : public Container
 };
 
 
+// all instances of one controller live in fixed size slots allocated in one block sized from the resource,
+// freed slots are reused, so transitions do not touch the backing allocator
+class InstancePool LUMIX_FINAL : public IAllocator
+{
+public:
+	InstancePool(const ControllerResource& resource, IAllocator& allocator);
+	~InstancePool();
+
+	void* allocate(size_t size) override;
+	void deallocate(void* ptr) override;
+	void* reallocate(void* ptr, size_t size) override;
+	void* allocate_aligned(size_t size, size_t align) override;
+	void deallocate_aligned(void* ptr) override;
+	void* reallocate_aligned(void* ptr, size_t size, size_t align) override;
+
+private:
+	void grow(int slots_count);
+
+	IAllocator& m_allocator;
+	Array<u8*> m_chunks;
+	void* m_free;
+	int m_slots_count;
+};
+
+
 Component* createComponent(ControllerResource& controller, Component::Type type, IAllocator& allocator);
 
 
@@ -3,6 +3,7 @@
 #include "audio_device.h"
 #include "audio_system.h"
 #include "clip_manager.h"
+#include "engine/associative_array.h"
 #include "engine/blob.h"
 #include "engine/crc32.h"
 #include "engine/iallocator.h"
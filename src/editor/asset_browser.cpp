@@ -12,6 +12,7 @@
 #include "engine/resource_manager.h"
 #include "engine/resource_manager_base.h"
 #include "engine/string.h"
+#include "engine/timer.h"
 #include "file_system_watcher.h"
 #include "imgui/imgui.h"
 #include "metadata.h"
@@ -23,6 +24,13 @@ namespace Lumix
 {
 
 
+// changed files are collected until nothing changes for this long (in seconds),
+// so e.g. a whole batch of reexported assets is reloaded at once
+static const float CHANGED_FILES_DELAY = 0.3f;
+// files are reloaded after this long (in seconds) even if other files keep changing
+static const float CHANGED_FILES_MAX_DELAY = 2.0f;
+
+
 static const u32 SOURCE_HASH = crc32("source");
 
 
@@ -51,6 +59,8 @@ AssetBrowser::AssetBrowser(StudioApp& app)
 	, m_selected_resource(nullptr)
 	, m_autoreload_changed_resource(true)
 	, m_changed_files(app.getWorldEditor().getAllocator())
+	, m_changed_files_set(app.getWorldEditor().getAllocator())
+	, m_first_file_changed_time(0)
 	, m_is_focus_requested(false)
 	, m_changed_files_mutex(false)
 	, m_history(app.getWorldEditor().getAllocator())
@@ -71,6 +81,7 @@ AssetBrowser::AssetBrowser(StudioApp& app)
 {
 	IAllocator& allocator = m_editor.getAllocator();
 	m_filter[0] = '\0';
+	m_changed_files_timer = Timer::create(allocator);
 
 	const char* base_path = m_editor.getEngine().getDiskFileDevice()->getBasePath();
 
@@ -132,6 +143,7 @@ AssetBrowser::~AssetBrowser()
 
 	FileSystemWatcher::destroy(m_watchers[0]);
 	FileSystemWatcher::destroy(m_watchers[1]);
+	Timer::destroy(m_changed_files_timer);
 }
 
 
@@ -140,8 +152,14 @@ void AssetBrowser::onFileChanged(const char* path)
 	ResourceType resource_type = getResourceType(path);
 	if (!isValid(resource_type)) return;
 
+	Path path_obj(path);
 	MT::SpinLock lock(m_changed_files_mutex);
-	m_changed_files.push(Path(path));
+	m_changed_files_timer->tick();
+	if (m_changed_files_set.find(path_obj.getHash()).isValid()) return;
+
+	if (m_changed_files.empty()) m_first_file_changed_time = m_changed_files_timer->getTimeSinceStart();
+	m_changed_files_set.insert(path_obj.getHash(), true);
+	m_changed_files.push(path_obj);
 }
 
 
@@ -172,23 +190,21 @@ void AssetBrowser::update()
 		findResources();
 	}
 	if (!m_is_update_enabled) return;
-	bool is_empty;
+
+	IAllocator& allocator = m_editor.getAllocator();
+	Array<Path> changed_files(allocator);
 	{
 		MT::SpinLock lock(m_changed_files_mutex);
-		is_empty = m_changed_files.empty();
+		if (m_changed_files.empty()) return;
+		float pending_time = m_changed_files_timer->getTimeSinceStart() - m_first_file_changed_time;
+		if (m_changed_files_timer->getTimeSinceTick() < CHANGED_FILES_DELAY && pending_time < CHANGED_FILES_MAX_DELAY) return;
+		changed_files.swap(m_changed_files);
+		m_changed_files_set.clear();
 	}
 
-	while (!is_empty)
+	Array<Path> reloaded_files(allocator);
+	for (const Path& path : changed_files)
 	{
-		Path path;
-		{
-			MT::SpinLock lock(m_changed_files_mutex);
-			
-			path = m_changed_files.back();
-			m_changed_files.pop();
-			is_empty = m_changed_files.empty();
-		}
-
 		char ext[10];
 		PathUtils::getExtension(ext, lengthOf(ext), path.c_str());
 		m_on_resource_changed.invoke(path, ext);
@@ -196,7 +212,7 @@ void AssetBrowser::update()
 		ResourceType resource_type = getResourceType(path.c_str());
 		if (!isValid(resource_type)) continue;
 
-		if (m_autoreload_changed_resource) m_editor.getEngine().getResourceManager().reload(path);
+		if (m_autoreload_changed_resource) reloaded_files.push(path);
 
 		char tmp_path[MAX_PATH_LENGTH];
 		if (m_editor.getEngine().getPatchFileDevice())
@@ -223,7 +239,11 @@ void AssetBrowser::update()
 		PathUtils::getFilename(filename, sizeof(filename), path.c_str());
 		addResource(dir, filename);
 	}
-	m_changed_files.clear();
+
+	if (!reloaded_files.empty())
+	{
+		m_editor.getEngine().getResourceManager().reload(&reloaded_files[0], reloaded_files.size());
+	}
 }
 
 
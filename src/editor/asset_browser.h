@@ -2,6 +2,7 @@
 
 
 #include "engine/array.h"
+#include "engine/associative_array.h"
 #include "engine/hash_map.h"
 #include "engine/delegate_list.h"
 #include "engine/path.h"
@@ -20,6 +21,7 @@ struct Action;
 class FileSystemWatcher;
 class Metadata;
 class StudioApp;
+class Timer;
 
 
 template<>
@@ -125,6 +127,9 @@ private:
 	AssociativeArray<ResourceType, IPlugin*> m_plugins;
 	HashMap<u32, ResourceType> m_registered_extensions;
 	MT::SpinMutex m_changed_files_mutex;
+	HashMap<u32, bool> m_changed_files_set;
+	Timer* m_changed_files_timer;
+	float m_first_file_changed_time;
 	HashMap<ResourceType, Array<Path>> m_resources;
 	Resource* m_selected_resource;
 	WorldEditor& m_editor;
@@ -4,6 +4,7 @@
 #include "editor/studio_app.h"
 #include "editor/world_editor.h"
 #include "engine/array.h"
+#include "engine/associative_array.h"
 #include "engine/blob.h"
 #include "engine/crc32.h"
 #include "engine/engine.h"
@@ -7,6 +7,7 @@
 #include "editor/prefab_system.h"
 #include "editor/render_interface.h"
 #include "editor/world_editor.h"
+#include "engine/blob.h"
 #include "engine/command_line_parser.h"
 #include "engine/crc32.h"
 #include "engine/debug/debug.h"
@@ -178,6 +179,8 @@ public:
 		char data_dir_path[MAX_PATH_LENGTH] = {};
 		checkDataDirCommandLine(data_dir_path, lengthOf(data_dir_path));
 		m_engine = Engine::create(current_dir, data_dir_path, nullptr, m_allocator);
+		// the manifest is kept between sessions, so it covers everything ever loaded in the editor
+		m_engine->getResourceManager().enableManifestRecording(true);
 		createLua();
 
 		m_window = SDL_CreateWindow("Lumix Studio", 0, 0, 800, 600, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI);
@@ -1411,6 +1414,11 @@ public:
 		{
 			g_log_warning.log("Editor") << "Could not save metadata";
 		}
+
+		if (!saveDependencyManifest())
+		{
+			g_log_warning.log("Editor") << "Could not save " << ResourceManager::DEPENDENCY_MANIFEST_PATH;
+		}
 	}
 
 
@@ -2222,7 +2230,27 @@ public:
 		out_info.hash = hash;
 		out_info.size = PlatformInterface::getFileSize(unv_path);
 		out_info.offset = ~0UL;
-		
+
+		const char* manifest_path = ResourceManager::DEPENDENCY_MANIFEST_PATH;
+		hash = crc32(manifest_path);
+		auto& manifest_info = infos.emplace(hash);
+		copyString(manifest_info.path, MAX_PATH_LENGTH, manifest_path);
+		manifest_info.hash = hash;
+		manifest_info.size = PlatformInterface::getFileSize(manifest_path);
+		manifest_info.offset = ~0UL;
+	}
+
+
+	bool saveDependencyManifest()
+	{
+		OutputBlob blob(m_allocator);
+		m_editor->getEngine().getResourceManager().serializeManifest(blob);
+
+		FS::OsFile file;
+		if (!file.open(ResourceManager::DEPENDENCY_MANIFEST_PATH, FS::Mode::CREATE_AND_WRITE)) return false;
+		bool success = file.write(blob.getData(), blob.getPos());
+		file.close();
+		return success;
 	}
 
 
@@ -2265,6 +2293,12 @@ public:
 		catString(dest, OUT_FILENAME);
 		AssociativeArray<u32, PackFileInfo> infos(m_allocator);
 		infos.reserve(10000);
+
+		// dependencies recorded by the editor, so the game can preload whole trees
+		if (!saveDependencyManifest())
+		{
+			g_log_error.log("Editor") << "Could not save " << ResourceManager::DEPENDENCY_MANIFEST_PATH;
+		}
 		
 		switch (m_pack.mode)
 		{
@@ -178,10 +178,12 @@ struct WorkerTask : MT::Task
 				ready_sleeping_fiber.fiber->worker_task = that;
 				ready_sleeping_fiber.fiber->switch_state = nullptr;
 				PROFILE_BLOCK("work");
+				// "work" is not necessarily the latest root block, "wait" can be created after it
+				Profiler::Block* work_block = Profiler::getCurrentBlock();
 				that->m_current_fiber = ready_sleeping_fiber.fiber;
 				Fiber::switchTo(&that->m_primary_fiber, ready_sleeping_fiber.fiber->fiber);
 				that->m_current_fiber = nullptr;
-				ASSERT(Profiler::getCurrentBlock() == Profiler::getRootBlock(MT::getCurrentThreadID()));
+				ASSERT(Profiler::getCurrentBlock() == work_block);
 				handleSwitch(*ready_sleeping_fiber.fiber);
 				continue;
 			}
@@ -194,10 +196,11 @@ struct WorkerTask : MT::Task
 				fiber_decl.current_job = job;
 				fiber_decl.switch_state = nullptr;
 				PROFILE_BLOCK("work");
+				Profiler::Block* work_block = Profiler::getCurrentBlock();
 				that->m_current_fiber = &fiber_decl;
 				Fiber::switchTo(&that->m_primary_fiber, fiber_decl.fiber);
 				that->m_current_fiber = nullptr;
-				ASSERT(Profiler::getCurrentBlock() == Profiler::getRootBlock(MT::getCurrentThreadID()));
+				ASSERT(Profiler::getCurrentBlock() == work_block);
 				handleSwitch(fiber_decl);
 			}
 			else 
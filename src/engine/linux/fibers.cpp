@@ -16,10 +16,17 @@ thread_local Handle g_finisher;
 
 void initThread(FiberProc proc, Handle* out)
 {
-	*out = create(64*1024, proc, nullptr);
-	getcontext(&g_finisher);
+	static const int STACK_SIZE = 64 * 1024;
+	void* stack = (::malloc)(STACK_SIZE);
+	getcontext(out);
+	out->uc_stack.ss_sp = stack;
+	out->uc_stack.ss_size = STACK_SIZE;
+	// makecontext stores uc_link on the new stack, so it must be set before the call,
+	// otherwise the process exits when proc returns
 	out->uc_link = &g_finisher;
-	switchTo(&g_finisher, *out);
+	makecontext(out, (void(*)())proc, 1, nullptr);
+	swapcontext(&g_finisher, out);
+	(::free)(stack);
 }
 
 
@@ -37,7 +44,7 @@ Handle create(int stack_size, FiberProc proc, void* parameter)
 
 void destroy(Handle fiber)
 {
-	ASSERT(false);
+	(::free)(fiber.uc_stack.ss_sp);
 }
 
 
@@ -210,10 +210,11 @@ static std::mt19937_64& getGUIDRandomGenerator()
 	return gen;
 }
 
+// each thread has its own generator, so random numbers can be used in jobs
 static std::mt19937& getRandomGenerator()
 {
-	static std::random_device seed;
-	static std::mt19937 gen(seed());
+	static thread_local std::random_device seed;
+	static thread_local std::mt19937 gen(seed());
 
 	return gen;
 }
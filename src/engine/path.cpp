@@ -3,6 +3,7 @@
 
 #include "engine/blob.h"
 #include "engine/crc32.h"
+#include "engine/mt/atomic.h"
 #include "engine/mt/sync.h"
 #include "engine/path_utils.h"
 #include "engine/string.h"
@@ -12,14 +13,81 @@ namespace Lumix
 {
 
 	static PathManager* g_path_manager = nullptr;
+	static const u32 MIN_TABLE_CAPACITY = 256;
+	static const i32 DEAD_REF_COUNT = -0x40000000;
+	static const int MAX_EPOCH_THREADS = 128;
+
+
+	// Epoch based reclamation: a thread announces the epoch in which it started to look into the table,
+	// tables and paths removed during that epoch are not freed until the thread leaves.
+	struct ThreadEpoch
+	{
+		volatile i32 epoch; // 0 == not inside
+		volatile i32 is_used;
+		u8 padding[64 - 2 * sizeof(i32)];
+	};
+
+
+	static ThreadEpoch g_thread_epochs[MAX_EPOCH_THREADS];
+
+
+	struct EpochSlot
+	{
+		EpochSlot() : index(-1) {}
+
+		~EpochSlot()
+		{
+			if (index >= 0) g_thread_epochs[index].is_used = 0;
+		}
+
+		ThreadEpoch* get()
+		{
+			if (index >= 0) return &g_thread_epochs[index];
+			for (int i = 0; i < MAX_EPOCH_THREADS; ++i)
+			{
+				if (MT::compareAndExchange(&g_thread_epochs[i].is_used, 1, 0))
+				{
+					index = i;
+					return &g_thread_epochs[i];
+				}
+			}
+			return nullptr;
+		}
+
+		int index;
+	};
+
+
+	static thread_local EpochSlot g_epoch_slot;
+
+
+	static PathInternal* acquire(PathInternal* volatile* slots, u32 mask, u32 hash)
+	{
+		for (u32 i = hash & mask;; i = (i + 1) & mask)
+		{
+			PathInternal* path = (PathInternal*)slots[i];
+			if (!path) return nullptr;
+			if (path->m_id != hash) continue;
+
+			for (;;)
+			{
+				i32 ref_count = path->m_ref_count;
+				// the path is being collected, caller has to take the lock and create it again
+				if (ref_count < 0) return nullptr;
+				if (MT::compareAndExchange(&path->m_ref_count, ref_count + 1, ref_count)) return path;
+			}
+		}
+	}
 
 
 	PathManager::PathManager(IAllocator& allocator)
-		: m_paths(allocator)
+		: m_retired(allocator)
 		, m_mutex(false)
 		, m_allocator(allocator)
+		, m_epoch(1)
 	{
 		g_path_manager = this;
+		m_table = createTable(MIN_TABLE_CAPACITY);
 		m_empty_path = LUMIX_NEW(m_allocator, Path)();
 	}
 
@@ -27,7 +95,20 @@ namespace Lumix
 	PathManager::~PathManager()
 	{
 		LUMIX_DELETE(m_allocator, m_empty_path);
-		ASSERT(m_paths.size() == 0);
+		Table* table = m_table;
+		for (u32 i = 0; i <= table->mask; ++i)
+		{
+			PathInternal* path = (PathInternal*)table->slots[i];
+			if (!path) continue;
+			ASSERT(path->m_ref_count == 0);
+			LUMIX_DELETE(m_allocator, path);
+		}
+		destroyTable(table);
+		for (Retired& retired : m_retired)
+		{
+			if (retired.table) destroyTable(retired.table);
+			if (retired.path) LUMIX_DELETE(m_allocator, retired.path);
+		}
 		g_path_manager = nullptr;
 	}
 
@@ -38,14 +119,100 @@ namespace Lumix
 	}
 
 
+	PathManager::Table* PathManager::createTable(u32 capacity)
+	{
+		ASSERT((capacity & (capacity - 1)) == 0);
+		Table* table = LUMIX_NEW(m_allocator, Table);
+		table->slots = (PathInternal* volatile*)m_allocator.allocate(sizeof(table->slots[0]) * capacity);
+		setMemory((void*)table->slots, 0, sizeof(table->slots[0]) * capacity);
+		table->mask = capacity - 1;
+		table->count = 0;
+		return table;
+	}
+
+
+	void PathManager::destroyTable(Table* table)
+	{
+		m_allocator.deallocate((void*)table->slots);
+		LUMIX_DELETE(m_allocator, table);
+	}
+
+
+	// must be called with m_mutex locked
+	void PathManager::collectGarbage(u32 min_capacity)
+	{
+		Table* old_table = m_table;
+		int alive_count = 0;
+		for (u32 i = 0; i <= old_table->mask; ++i)
+		{
+			PathInternal* path = (PathInternal*)old_table->slots[i];
+			if (!path) continue;
+			if (MT::compareAndExchange(&path->m_ref_count, DEAD_REF_COUNT, 0)) continue;
+			++alive_count;
+		}
+
+		u32 capacity = MIN_TABLE_CAPACITY;
+		while (capacity < min_capacity || capacity < u32(alive_count) * 4) capacity <<= 1;
+
+		Table* table = createTable(capacity);
+		for (u32 i = 0; i <= old_table->mask; ++i)
+		{
+			PathInternal* path = (PathInternal*)old_table->slots[i];
+			if (!path) continue;
+			if (path->m_ref_count == DEAD_REF_COUNT)
+			{
+				m_retired.push({m_epoch, nullptr, path});
+				continue;
+			}
+			u32 j = path->m_id & table->mask;
+			while (table->slots[j]) j = (j + 1) & table->mask;
+			table->slots[j] = path;
+			++table->count;
+		}
+
+		// readers which have seen the old table have announced an epoch <= m_epoch
+		MT::memoryBarrier();
+		m_table = table;
+		m_retired.push({m_epoch, old_table, nullptr});
+		MT::atomicIncrement(&m_epoch);
+		MT::memoryBarrier();
+		reclaim();
+	}
+
+
+	// must be called with m_mutex locked
+	void PathManager::reclaim()
+	{
+		if (m_retired.empty()) return;
+
+		i32 min_epoch = m_epoch;
+		for (const ThreadEpoch& thread_epoch : g_thread_epochs)
+		{
+			i32 epoch = thread_epoch.epoch;
+			if (epoch != 0 && epoch < min_epoch) min_epoch = epoch;
+		}
+
+		for (int i = m_retired.size() - 1; i >= 0; --i)
+		{
+			Retired& retired = m_retired[i];
+			if (retired.epoch >= min_epoch) continue;
+			if (retired.table) destroyTable(retired.table);
+			if (retired.path) LUMIX_DELETE(m_allocator, retired.path);
+			m_retired.eraseFast(i);
+		}
+	}
+
+
 	void PathManager::serialize(OutputBlob& serializer)
 	{
 		MT::SpinLock lock(m_mutex);
-		clear();
-		serializer.write((i32)m_paths.size());
-		for (int i = 0; i < m_paths.size(); ++i)
+		collectGarbage(0);
+		Table* table = m_table;
+		serializer.write((i32)table->count);
+		for (u32 i = 0; i <= table->mask; ++i)
 		{
-			serializer.writeString(m_paths.at(i)->m_path);
+			PathInternal* path = (PathInternal*)table->slots[i];
+			if (path) serializer.writeString(path->m_path);
 		}
 	}
 
@@ -61,7 +228,7 @@ namespace Lumix
 			serializer.readString(path, sizeof(path));
 			u32 hash = crc32(path);
 			PathInternal* internal = getPathMultithreadUnsafe(hash, path);
-			--internal->m_ref_count;
+			MT::atomicDecrement(&internal->m_ref_count);
 		}
 	}
 
@@ -81,19 +248,37 @@ namespace Lumix
 
 	PathInternal* PathManager::getPath(u32 hash)
 	{
-		MT::SpinLock lock(m_mutex);
-		int index = m_paths.find(hash);
-		if (index < 0)
+		ThreadEpoch* thread_epoch = g_epoch_slot.get();
+		if (thread_epoch)
 		{
-			return nullptr;
+			thread_epoch->epoch = m_epoch;
+			MT::memoryBarrier();
+			Table* table = m_table;
+			PathInternal* path = acquire(table->slots, table->mask, hash);
+			MT::memoryBarrier();
+			thread_epoch->epoch = 0;
+			if (path) return path;
 		}
-		++m_paths.at(index)->m_ref_count;
-		return m_paths.at(index);
+
+		MT::SpinLock lock(m_mutex);
+		return acquire(m_table->slots, m_table->mask, hash);
 	}
 
 
 	PathInternal* PathManager::getPath(u32 hash, const char* path)
 	{
+		ThreadEpoch* thread_epoch = g_epoch_slot.get();
+		if (thread_epoch)
+		{
+			thread_epoch->epoch = m_epoch;
+			MT::memoryBarrier();
+			Table* table = m_table;
+			PathInternal* internal = acquire(table->slots, table->mask, hash);
+			MT::memoryBarrier();
+			thread_epoch->epoch = 0;
+			if (internal) return internal;
+		}
+
 		MT::SpinLock lock(m_mutex);
 		return getPathMultithreadUnsafe(hash, path);
 	}
@@ -101,50 +286,52 @@ namespace Lumix
 
 	void PathManager::clear()
 	{
-		for (int i = m_paths.size() - 1; i >= 0; --i)
-		{
-			if (m_paths.at(i)->m_ref_count == 0)
-			{
-				LUMIX_DELETE(m_allocator, m_paths.at(i));
-				m_paths.eraseAt(i);
-			}
-		}
+		MT::SpinLock lock(m_mutex);
+		collectGarbage(0);
 	}
 
 
 	PathInternal* PathManager::getPathMultithreadUnsafe(u32 hash, const char* path)
 	{
-		int index = m_paths.find(hash);
-		if (index < 0)
+		Table* table = m_table;
+		PathInternal* internal = acquire(table->slots, table->mask, hash);
+		if (internal) return internal;
+
+		if (u32(table->count + 1) * 2 > table->mask + 1)
 		{
-			PathInternal* internal = LUMIX_NEW(m_allocator, PathInternal);
-			internal->m_ref_count = 1;
-			internal->m_id = hash;
-			copyString(internal->m_path, path);
-			m_paths.insert(hash, internal);
-			return internal;
+			collectGarbage(table->mask + 1);
+			table = m_table;
 		}
-		++m_paths.at(index)->m_ref_count;
-		return m_paths.at(index);
+		else
+		{
+			reclaim();
+		}
+
+		internal = LUMIX_NEW(m_allocator, PathInternal);
+		internal->m_ref_count = 1;
+		internal->m_id = hash;
+		copyString(internal->m_path, path);
+
+		u32 i = hash & table->mask;
+		while (table->slots[i]) i = (i + 1) & table->mask;
+		// readers must not see the path before it's initialized
+		MT::memoryBarrier();
+		table->slots[i] = internal;
+		++table->count;
+		return internal;
 	}
 
 
 	void PathManager::incrementRefCount(PathInternal* path)
 	{
-		MT::SpinLock lock(m_mutex);
-		++path->m_ref_count;
+		MT::atomicIncrement(&path->m_ref_count);
 	}
 
 
 	void PathManager::decrementRefCount(PathInternal* path)
 	{
-		MT::SpinLock lock(m_mutex);
-		--path->m_ref_count;
-		if (path->m_ref_count == 0)
-		{
-			m_paths.erase(path->m_id);
-			LUMIX_DELETE(m_allocator, path);
-		}
+		// paths without references stay in the table until it's rebuilt or cleared
+		MT::atomicDecrement(&path->m_ref_count);
 	}
 
 
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "engine/associative_array.h"
+#include "engine/array.h"
 #include "engine/mt/sync.h"
 
 
@@ -70,15 +70,38 @@ public:
 	static const Path& getEmptyPath();
 
 private:
+	// open addressing, readers do not lock, only inserting a new path or rebuilding the table does
+	struct Table
+	{
+		PathInternal* volatile* slots;
+		u32 mask;
+		int count;
+	};
+
+	// freed once no thread can see it anymore
+	struct Retired
+	{
+		i32 epoch;
+		Table* table;
+		PathInternal* path;
+	};
+
 	PathInternal* getPath(u32 hash, const char* path);
 	PathInternal* getPath(u32 hash);
 	PathInternal* getPathMultithreadUnsafe(u32 hash, const char* path);
 	void incrementRefCount(PathInternal* path);
 	void decrementRefCount(PathInternal* path);
 
+	Table* createTable(u32 capacity);
+	void destroyTable(Table* table);
+	void collectGarbage(u32 min_capacity);
+	void reclaim();
+
 private:
 	IAllocator& m_allocator;
-	AssociativeArray<u32, PathInternal*> m_paths;
+	Table* volatile m_table;
+	Array<Retired> m_retired;
+	volatile i32 m_epoch;
 	MT::SpinMutex m_mutex;
 	Path* m_empty_path;
 };
@@ -157,6 +157,12 @@ struct SetterProxy<void (C::*)(Entity, int, A)>
 		auto value = readFromStream<Value>(stream);
 		(inst->*setter)(entity, index, value);
 	}
+
+	template <typename T>
+	static void invoke(C* inst, Setter setter, Entity entity, int index, const T& value)
+	{
+		(inst->*setter)(entity, index, value);
+	}
 };
 
 template <typename C, typename A>
@@ -169,6 +175,12 @@ struct SetterProxy<void (C::*)(Entity, A)>
 		auto value = readFromStream<Value>(stream);
 		(inst->*setter)(entity, value);
 	}
+
+	template <typename T>
+	static void invoke(C* inst, Setter setter, Entity entity, int index, const T& value)
+	{
+		(inst->*setter)(entity, value);
+	}
 };
 
 
@@ -222,7 +234,11 @@ struct ColorAttribute : IAttribute
 };
 
 
-template <typename T> struct Property : PropertyBase {};
+template <typename T> struct Property : PropertyBase
+{
+	// sets the property of count components in one scene, values are passed directly to the setter
+	virtual void setValues(IScene* scene, const Entity* entities, const T* values, int count, int index) const = 0;
+};
 
 
 struct IBlobProperty : PropertyBase {};
@@ -504,6 +520,16 @@ struct CommonProperty : Property<T>
 		detail::SetterProxy<Setter>::invoke(stream, inst, setter, cmp.entity, index);
 	}
 
+	void setValues(IScene* scene, const Entity* entities, const T* values, int count, int index) const override
+	{
+		using C = typename ClassOf<Getter>::Type;
+		C* inst = static_cast<C*>(scene);
+		for (int i = 0; i < count; ++i)
+		{
+			detail::SetterProxy<Setter>::invoke(inst, setter, entities[i], index, values[i]);
+		}
+	}
+
 
 	Tuple<Attributes...> attributes;
 	Getter getter;
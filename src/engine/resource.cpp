@@ -85,6 +85,9 @@ void Resource::fileLoaded(FS::IFile& file, bool success)
 		return;
 	}
 
+	ResourceManager& owner = m_resource_manager.getOwner();
+	// load() records the current dependencies
+	if (owner.isManifestRecording()) owner.clearManifestDependencies(m_path);
 	if (!load(file))
 	{
 		++m_failed_dep_count;
@@ -147,6 +150,11 @@ void Resource::addDependency(Resource& dependent_resource)
 	ASSERT(m_desired_state != State::EMPTY);
 
 	dependent_resource.m_cb.bind<Resource, &Resource::onStateChanged>(this);
+	ResourceManager& owner = m_resource_manager.getOwner();
+	if (owner.isManifestRecording())
+	{
+		owner.addManifestDependency(m_path, dependent_resource.getType(), dependent_resource.getPath());
+	}
 	if (dependent_resource.isEmpty()) ++m_empty_dep_count;
 	if (dependent_resource.isFailure()) ++m_failed_dep_count;
 
@@ -1,14 +1,72 @@
+#include "engine/blob.h"
+#include "engine/fs/file_system.h"
+#include "engine/log.h"
 #include "engine/path.h"
+#include "engine/profiler.h"
 #include "engine/resource.h"
 #include "engine/resource_manager.h"
 #include "engine/resource_manager_base.h"
 
 namespace Lumix
 {
+	static const u32 MANIFEST_MAGIC = 0x4e4d4c5f; // == '_LMN'
+	static const u32 MANIFEST_VERSION = 0;
+
+
+	const char* const ResourceManager::DEPENDENCY_MANIFEST_PATH = "resources.manifest";
+
+
+	struct ResourceManager::Preload
+	{
+		Preload(u32 id, const PreloadCallback& callback, IAllocator& allocator)
+			: id(id)
+			, callback(callback)
+			, resources(allocator)
+			, empty_count(0)
+			, failed_count(0)
+			, is_done(false)
+			, requested(allocator)
+		{
+		}
+
+		void onStateChanged(Resource::State old_state, Resource::State new_state, Resource&)
+		{
+			if (old_state == Resource::State::EMPTY) --empty_count;
+			if (old_state == Resource::State::FAILURE) --failed_count;
+			if (new_state == Resource::State::EMPTY) ++empty_count;
+			if (new_state == Resource::State::FAILURE) ++failed_count;
+			checkDone();
+		}
+
+		void checkDone()
+		{
+			if (is_done || empty_count > 0) return;
+			is_done = true;
+			callback.invoke(failed_count == 0);
+		}
+
+		u32 id;
+		PreloadCallback callback;
+		Array<Resource*> resources;
+		int empty_count;
+		int failed_count;
+		bool is_done;
+		// resources waiting for the manifest, they are loaded once it's loaded
+		Array<ResourceDesc> requested;
+	};
+
+
 	ResourceManager::ResourceManager(IAllocator& allocator) 
 		: m_resource_managers(allocator)
 		, m_allocator(allocator)
 		, m_file_system(nullptr)
+		, m_manifest(allocator)
+		, m_manifest_heads(allocator)
+		, m_removed_manifest_count(0)
+		, m_is_manifest_recording(false)
+		, m_preloads(allocator)
+		, m_last_preload_id(0)
+		, m_manifest_async_op(FS::FileSystem::INVALID_ASYNC)
 	{
 	}
 
@@ -18,10 +76,24 @@ namespace Lumix
 	void ResourceManager::create(FS::FileSystem& fs)
 	{
 		m_file_system = &fs;
+
+		FS::ReadCallback cb;
+		cb.bind<ResourceManager, &ResourceManager::manifestLoaded>(this);
+		m_manifest_async_op = fs.openAsync(fs.getDefaultDevice(), Path(DEPENDENCY_MANIFEST_PATH), FS::Mode::OPEN_AND_READ, cb);
 	}
 
 	void ResourceManager::destroy()
 	{
+		if (m_manifest_async_op != FS::FileSystem::INVALID_ASYNC)
+		{
+			m_file_system->cancelAsync(m_manifest_async_op);
+			m_manifest_async_op = FS::FileSystem::INVALID_ASYNC;
+		}
+		while (!m_preloads.empty())
+		{
+			g_log_error.log("Core") << "Leaking preload " << m_preloads.back()->id;
+			releasePreload(m_preloads.back()->id);
+		}
 	}
 	
 	ResourceManagerBase* ResourceManager::get(ResourceType type)
@@ -62,4 +134,264 @@ namespace Lumix
 			manager->reload(path);
 		}
 	}
+
+	void ResourceManager::reload(const Path* paths, int count)
+	{
+		PROFILE_FUNCTION();
+		HashMap<u32, Resource*> changed(m_allocator);
+		for (auto* manager : m_resource_managers)
+		{
+			auto& table = manager->getResourceTable();
+			for (int i = 0; i < count; ++i)
+			{
+				auto iter = table.find(paths[i].getHash());
+				if (iter.isValid()) changed.insert(paths[i].getHash(), iter.value());
+			}
+		}
+		PROFILE_INT("reloaded resources", changed.size());
+
+		// dependencies are reloaded before their dependents, so all the reads are in flight at once
+		// and a dependent is parsed after its dependencies, i.e. it becomes ready without waiting
+		// for another frame; dependents go empty once and get ready once all their dependencies do
+		struct StackItem
+		{
+			u32 hash;
+			int dep_idx;
+		};
+		Array<Resource*> sorted(m_allocator);
+		HashMap<u32, bool> visited(m_allocator);
+		Array<StackItem> stack(m_allocator);
+		auto push = [&](u32 hash) {
+			visited.insert(hash, true);
+			auto head = m_manifest_heads.find(hash);
+			stack.push({hash, head.isValid() ? head.value() : -1});
+		};
+		for (auto iter = changed.begin(), end = changed.end(); iter != end; ++iter)
+		{
+			if (visited.find(iter.key()).isValid()) continue;
+
+			// post-order DFS over the manifest, visited check handles cycles
+			push(iter.key());
+			while (!stack.empty())
+			{
+				StackItem& item = stack.back();
+				if (item.dep_idx >= 0)
+				{
+					u32 dep_hash = m_manifest[item.dep_idx].dependency.path.getHash();
+					item.dep_idx = m_manifest[item.dep_idx].next;
+					if (!visited.find(dep_hash).isValid()) push(dep_hash);
+					continue;
+				}
+
+				auto changed_iter = changed.find(item.hash);
+				if (changed_iter.isValid()) sorted.push(changed_iter.value());
+				stack.pop();
+			}
+		}
+
+		for (Resource* resource : sorted) resource->getResourceManager().reload(*resource);
+	}
+
+	u32 ResourceManager::preload(const ResourceDesc* resources, int count, const PreloadCallback& callback)
+	{
+		PROFILE_FUNCTION();
+		Preload* preload = LUMIX_NEW(m_allocator, Preload)(++m_last_preload_id, callback, m_allocator);
+		m_preloads.push(preload);
+		u32 id = preload->id;
+		if (m_manifest_async_op != FS::FileSystem::INVALID_ASYNC)
+		{
+			// without the manifest dependencies would be discovered one level per frame
+			for (int i = 0; i < count; ++i) preload->requested.push(resources[i]);
+			return id;
+		}
+
+		startPreload(*preload, resources, count);
+		preload->checkDone();
+		return id;
+	}
+
+	void ResourceManager::startPreload(Preload& preload, const ResourceDesc* resources, int count)
+	{
+		Array<ResourceDesc> to_load(m_allocator);
+		HashMap<u32, bool> visited(m_allocator);
+		for (int i = 0; i < count; ++i)
+		{
+			if (visited.find(resources[i].path.getHash()).isValid()) continue;
+			visited.insert(resources[i].path.getHash(), true);
+			to_load.push(resources[i]);
+		}
+
+		// the whole dependency tree is requested now, otherwise every level waits for its parent to be parsed
+		for (int i = 0; i < to_load.size(); ++i)
+		{
+			auto iter = m_manifest_heads.find(to_load[i].path.getHash());
+			if (!iter.isValid()) continue;
+
+			for (int dep_idx = iter.value(); dep_idx >= 0; dep_idx = m_manifest[dep_idx].next)
+			{
+				const ResourceDesc& dependency = m_manifest[dep_idx].dependency;
+				if (visited.find(dependency.path.getHash()).isValid()) continue;
+				visited.insert(dependency.path.getHash(), true);
+				to_load.push(dependency);
+			}
+		}
+
+		for (const ResourceDesc& desc : to_load)
+		{
+			auto iter = m_resource_managers.find(desc.type.type);
+			if (!iter.isValid())
+			{
+				g_log_warning.log("Core") << "Unknown type of " << desc.path.c_str() << ", it's not preloaded";
+				continue;
+			}
+
+			Resource* resource = iter.value()->load(desc.path);
+			if (!resource) continue;
+
+			preload.resources.push(resource);
+			if (resource->isEmpty()) ++preload.empty_count;
+			if (resource->isFailure()) ++preload.failed_count;
+			resource->getObserverCb().bind<Preload, &Preload::onStateChanged>(&preload);
+		}
+		PROFILE_INT("preloaded resources", preload.resources.size());
+	}
+
+	void ResourceManager::releasePreload(u32 id)
+	{
+		for (int i = 0; i < m_preloads.size(); ++i)
+		{
+			Preload* preload = m_preloads[i];
+			if (preload->id != id) continue;
+
+			for (Resource* resource : preload->resources)
+			{
+				resource->getObserverCb().unbind<Preload, &Preload::onStateChanged>(preload);
+				resource->getResourceManager().unload(*resource);
+			}
+			LUMIX_DELETE(m_allocator, preload);
+			m_preloads.eraseFast(i);
+			return;
+		}
+	}
+
+	void ResourceManager::addManifestDependency(const Path& resource, ResourceType dependency_type, const Path& dependency)
+	{
+		addManifestDependency(resource.getHash(), dependency_type, dependency);
+	}
+
+	void ResourceManager::clearManifestDependencies(const Path& resource)
+	{
+		auto iter = m_manifest_heads.find(resource.getHash());
+		if (!iter.isValid()) return;
+
+		// entries stay in the array, they are just not reachable anymore
+		for (int i = iter.value(); i >= 0; i = m_manifest[i].next) ++m_removed_manifest_count;
+		m_manifest_heads.erase(iter);
+	}
+
+	void ResourceManager::addManifestDependency(u32 resource_hash, ResourceType dependency_type, const Path& dependency)
+	{
+		int head = -1;
+		auto iter = m_manifest_heads.find(resource_hash);
+		if (iter.isValid())
+		{
+			head = iter.value();
+			for (int i = head; i >= 0; i = m_manifest[i].next)
+			{
+				if (m_manifest[i].dependency.path == dependency) return;
+			}
+		}
+
+		ManifestDependency& dep = m_manifest.emplace();
+		dep.resource_hash = resource_hash;
+		dep.next = head;
+		dep.dependency.type = dependency_type;
+		dep.dependency.path = dependency;
+		if (iter.isValid()) iter.value() = m_manifest.size() - 1;
+		else m_manifest_heads.insert(resource_hash, m_manifest.size() - 1);
+	}
+
+	void ResourceManager::serializeManifest(OutputBlob& blob) const
+	{
+		blob.write(MANIFEST_MAGIC);
+		blob.write(MANIFEST_VERSION);
+		blob.write(getManifestDependenciesCount());
+		for (int head : m_manifest_heads)
+		{
+			for (int i = head; i >= 0; i = m_manifest[i].next)
+			{
+				const ManifestDependency& dep = m_manifest[i];
+				blob.write(dep.resource_hash);
+				blob.write(dep.dependency.type.type);
+				blob.writeString(dep.dependency.path.c_str());
+			}
+		}
+	}
+
+	bool ResourceManager::deserializeManifest(InputBlob& blob)
+	{
+		u32 magic = 0;
+		u32 version = 0;
+		int count = 0;
+		blob.read(magic);
+		blob.read(version);
+		if (magic != MANIFEST_MAGIC || version > MANIFEST_VERSION) return false;
+		blob.read(count);
+
+		// resources recorded before the manifest is loaded are newer than what's in it
+		HashMap<u32, bool> recorded(m_allocator);
+		for (auto iter = m_manifest_heads.begin(), end = m_manifest_heads.end(); iter != end; ++iter)
+		{
+			recorded.insert(iter.key(), true);
+		}
+
+		for (int i = 0; i < count; ++i)
+		{
+			u32 resource_hash;
+			ResourceType type;
+			char path[MAX_PATH_LENGTH];
+			blob.read(resource_hash);
+			blob.read(type.type);
+			if (!blob.readString(path, lengthOf(path))) return false;
+			if (recorded.find(resource_hash).isValid()) continue;
+			addManifestDependency(resource_hash, type, Path(path));
+		}
+		return true;
+	}
+
+	void ResourceManager::manifestLoaded(FS::IFile& file, bool success)
+	{
+		m_manifest_async_op = FS::FileSystem::INVALID_ASYNC;
+		// the manifest is optional, it's recorded by the editor
+		if (success)
+		{
+			OutputBlob content(m_allocator);
+			file.getContents(content);
+			InputBlob blob(content);
+			if (!deserializeManifest(blob))
+			{
+				g_log_error.log("Core") << "Corrupted " << DEPENDENCY_MANIFEST_PATH;
+			}
+		}
+
+		// callbacks can release preloads, so they are looked up by id
+		Array<u32> waiting(m_allocator);
+		for (Preload* preload : m_preloads)
+		{
+			if (!preload->requested.empty()) waiting.push(preload->id);
+		}
+		for (u32 id : waiting)
+		{
+			for (Preload* preload : m_preloads)
+			{
+				if (preload->id != id) continue;
+
+				Array<ResourceDesc> requested(m_allocator);
+				requested.swap(preload->requested);
+				startPreload(*preload, &requested[0], requested.size());
+				preload->checkDone();
+				break;
+			}
+		}
+	}
 }
@@ -1,21 +1,24 @@
 #pragma once
 
 
+#include "engine/array.h"
+#include "engine/delegate.h"
 #include "engine/hash_map.h"
+#include "engine/resource.h"
 
 
 namespace Lumix
 {
 
 
-class Path;
-class Resource;
-struct ResourceType;
+class InputBlob;
+class OutputBlob;
 
 
 namespace FS
 {
 class FileSystem;
+struct IFile;
 }
 
 
@@ -26,6 +29,19 @@ class LUMIX_ENGINE_API ResourceManager
 {
 	typedef HashMap<u32, ResourceManagerBase*> ResourceManagerTable;
 
+public:
+	struct ResourceDesc
+	{
+		ResourceType type;
+		Path path;
+	};
+
+	// argument is false if any of the preloaded resources failed
+	typedef Delegate<void(bool)> PreloadCallback;
+
+	static const u32 INVALID_PRELOAD = 0xffffFFFF;
+	static const char* const DEPENDENCY_MANIFEST_PATH;
+
 public:
 	explicit ResourceManager(IAllocator& allocator);
 	~ResourceManager();
@@ -40,15 +56,55 @@ public:
 	void add(ResourceType type, ResourceManagerBase* rm);
 	void remove(ResourceType type);
 	void reload(const Path& path);
+	// Reloads all the resources at once, dependencies first according to the dependency manifest.
+	// Resources depending on several of them are notified only after all of them are ready again.
+	void reload(const Path* paths, int count);
 	void removeUnreferenced();
 	void enableUnload(bool enable);
 
+	// Loads the resources and everything they depend on according to the dependency manifest.
+	// All files are requested at once, callback is called once when nothing is loading anymore,
+	// possibly before preload returns. Resources are kept loaded until releasePreload.
+	// If the manifest is still loading, nothing is requested until it's loaded.
+	u32 preload(const ResourceDesc* resources, int count, const PreloadCallback& callback);
+	void releasePreload(u32 preload);
+
+	// resources record their dependencies in the manifest only if this is enabled, i.e. in the editor
+	void enableManifestRecording(bool enable) { m_is_manifest_recording = enable; }
+	bool isManifestRecording() const { return m_is_manifest_recording; }
+	void addManifestDependency(const Path& resource, ResourceType dependency_type, const Path& dependency);
+	void clearManifestDependencies(const Path& resource);
+	int getManifestDependenciesCount() const { return m_manifest.size() - m_removed_manifest_count; }
+	void serializeManifest(OutputBlob& blob) const;
+	bool deserializeManifest(InputBlob& blob);
+
 	FS::FileSystem& getFileSystem() { return *m_file_system; }
 
+private:
+	struct Preload;
+
+	struct ManifestDependency
+	{
+		u32 resource_hash;
+		int next;
+		ResourceDesc dependency;
+	};
+
+	void addManifestDependency(u32 resource_hash, ResourceType dependency_type, const Path& dependency);
+	void startPreload(Preload& preload, const ResourceDesc* resources, int count);
+	void manifestLoaded(FS::IFile& file, bool success);
+
 private:
 	IAllocator& m_allocator;
 	ResourceManagerTable m_resource_managers;
 	FS::FileSystem* m_file_system;
+	Array<ManifestDependency> m_manifest;
+	HashMap<u32, int> m_manifest_heads;
+	int m_removed_manifest_count;
+	bool m_is_manifest_recording;
+	Array<Preload*> m_preloads;
+	u32 m_last_preload_id;
+	u32 m_manifest_async_op;
 };
 
 
@@ -101,6 +101,19 @@ namespace Lumix
 		return _mm_max_ps(a, b);
 	}
 
+
+	LUMIX_FORCE_INLINE float4 f4CmpLT(float4 a, float4 b)
+	{
+		return _mm_cmplt_ps(a, b);
+	}
+
+
+	// picks b in lanes where mask (result of f4CmpXX) is set, a elsewhere
+	LUMIX_FORCE_INLINE float4 f4Blend(float4 a, float4 b, float4 mask)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+	}
+
 #else 
 	struct float4
 	{
@@ -239,6 +252,29 @@ namespace Lumix
 		};
 	}
 
+
+	// set lanes are negative, so f4MoveMask works on the result
+	LUMIX_FORCE_INLINE float4 f4CmpLT(float4 a, float4 b)
+	{
+		return{
+			a.x < b.x ? -1.0f : 0.0f,
+			a.y < b.y ? -1.0f : 0.0f,
+			a.z < b.z ? -1.0f : 0.0f,
+			a.w < b.w ? -1.0f : 0.0f
+		};
+	}
+
+
+	LUMIX_FORCE_INLINE float4 f4Blend(float4 a, float4 b, float4 mask)
+	{
+		return{
+			mask.x < 0 ? b.x : a.x,
+			mask.y < 0 ? b.y : a.y,
+			mask.z < 0 ? b.z : a.z,
+			mask.w < 0 ? b.w : a.w
+		};
+	}
+
 #endif
 
 
@@ -1,6 +1,7 @@
 #include "gui_scene.h"
 #include "gui_system.h"
 #include "sprite_manager.h"
+#include "engine/associative_array.h"
 #include "engine/engine.h"
 #include "engine/flag_set.h"
 #include "engine/iallocator.h"
@@ -1,6 +1,7 @@
 #include "lua_script_system.h"
 #include "animation/animation_scene.h"
 #include "engine/array.h"
+#include "engine/associative_array.h"
 #include "engine/binary_array.h"
 #include "engine/blob.h"
 #include "engine/crc32.h"
@@ -194,37 +194,49 @@ struct NavigationSceneImpl LUMIX_FINAL : public NavigationScene
 			int to_z = (int)Math::clamp(terrain_space_aabb.max.z / scaleXZ + 1, 0.0f, res.y - 1);
 			int from_x = (int)Math::clamp(terrain_space_aabb.min.x / scaleXZ - 1, 0.0f, res.x - 1);
 			int to_x = (int)Math::clamp(terrain_space_aabb.max.x / scaleXZ + 1, 0.0f, res.x - 1);
-			for (int j = from_z; j < to_z; ++j)
+			// skip whole blocks of cells the terrain does not reach into
+			const int BLOCK_SIZE = 16;
+			for (int block_z = from_z; block_z < to_z; block_z += BLOCK_SIZE)
 			{
-				for (int i = from_x; i < to_x; ++i)
+				for (int block_x = from_x; block_x < to_x; block_x += BLOCK_SIZE)
 				{
-					float x = i * scaleXZ;
-					float z = j * scaleXZ;
-					float h0 = render_scene->getTerrainHeightAt(entity, x, z);
-					Vec3 p0 = pos + rot.rotate(Vec3(x, h0, z));
-
-					x = (i + 1) * scaleXZ;
-					z = j * scaleXZ;
-					float h1 = render_scene->getTerrainHeightAt(entity, x, z);
-					Vec3 p1 = pos + rot.rotate(Vec3(x, h1, z));
-
-					x = (i + 1) * scaleXZ;
-					z = (j + 1) * scaleXZ;
-					float h2 = render_scene->getTerrainHeightAt(entity, x, z);
-					Vec3 p2 = pos + rot.rotate(Vec3(x, h2, z));
-
-					x = i * scaleXZ;
-					z = (j + 1) * scaleXZ;
-					float h3 = render_scene->getTerrainHeightAt(entity, x, z);
-					Vec3 p3 = pos + rot.rotate(Vec3(x, h3, z));
-
-					Vec3 n = crossProduct(p1 - p0, p0 - p2).normalized();
-					u8 area = n.y > walkable_threshold ? RC_WALKABLE_AREA : 0;
-					rcRasterizeTriangle(&ctx, &p0.x, &p1.x, &p2.x, area, solid);
-
-					n = crossProduct(p2 - p0, p0 - p3).normalized();
-					area = n.y > walkable_threshold ? RC_WALKABLE_AREA : 0;
-					rcRasterizeTriangle(&ctx, &p0.x, &p2.x, &p3.x, area, solid);
+					AABB block_aabb(Vec3(block_x * scaleXZ, terrain_space_aabb.min.y, block_z * scaleXZ),
+						Vec3((block_x + BLOCK_SIZE) * scaleXZ, terrain_space_aabb.max.y, (block_z + BLOCK_SIZE) * scaleXZ));
+					if (!render_scene->isTerrainOverlapping(entity, block_aabb)) continue;
+
+					for (int j = block_z; j < Math::minimum(block_z + BLOCK_SIZE, to_z); ++j)
+					{
+						for (int i = block_x; i < Math::minimum(block_x + BLOCK_SIZE, to_x); ++i)
+						{
+							float x = i * scaleXZ;
+							float z = j * scaleXZ;
+							float h0 = render_scene->getTerrainHeightAt(entity, x, z);
+							Vec3 p0 = pos + rot.rotate(Vec3(x, h0, z));
+
+							x = (i + 1) * scaleXZ;
+							z = j * scaleXZ;
+							float h1 = render_scene->getTerrainHeightAt(entity, x, z);
+							Vec3 p1 = pos + rot.rotate(Vec3(x, h1, z));
+
+							x = (i + 1) * scaleXZ;
+							z = (j + 1) * scaleXZ;
+							float h2 = render_scene->getTerrainHeightAt(entity, x, z);
+							Vec3 p2 = pos + rot.rotate(Vec3(x, h2, z));
+
+							x = i * scaleXZ;
+							z = (j + 1) * scaleXZ;
+							float h3 = render_scene->getTerrainHeightAt(entity, x, z);
+							Vec3 p3 = pos + rot.rotate(Vec3(x, h3, z));
+
+							Vec3 n = crossProduct(p1 - p0, p0 - p2).normalized();
+							u8 area = n.y > walkable_threshold ? RC_WALKABLE_AREA : 0;
+							rcRasterizeTriangle(&ctx, &p0.x, &p1.x, &p2.x, area, solid);
+
+							n = crossProduct(p2 - p0, p0 - p3).normalized();
+							area = n.y > walkable_threshold ? RC_WALKABLE_AREA : 0;
+							rcRasterizeTriangle(&ctx, &p0.x, &p2.x, &p3.x, area, solid);
+						}
+					}
 				}
 			}
 
@@ -263,6 +275,7 @@ struct NavigationSceneImpl LUMIX_FINAL : public NavigationScene
 				bool is16 = mesh.areIndices16();
 
 				if (mesh.material->isCustomFlag(no_navigation_flag)) continue;
+				if (!mesh.hasCPUData()) continue;
 				bool is_walkable = !mesh.material->isCustomFlag(nonwalkable_flag);
 				auto* vertices = &mesh.vertices[0];
 				if (is16)
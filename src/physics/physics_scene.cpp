@@ -1,3 +1,4 @@
+#include "engine/associative_array.h"
 #include "engine/blob.h"
 #include "engine/crc32.h"
 #include "engine/engine.h"
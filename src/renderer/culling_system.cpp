@@ -6,6 +6,7 @@
 #include "engine/lumix.h"
 #include "engine/profiler.h"
 #include "engine/simd.h"
+#include "renderer/occlusion_buffer.h"
 
 namespace Lumix
 {
@@ -20,10 +21,20 @@ static void doCulling(int start_index,
 	const u64* LUMIX_RESTRICT layer_masks,
 	const Entity* LUMIX_RESTRICT sphere_to_model_instance_map,
 	u64 layer_mask,
+	const OcclusionBuffer* occlusion_buffer,
 	CullingSystem::Subresults& results)
 {
 	PROFILE_FUNCTION();
 	int i = start_index;
+	const Sphere* spheres = start - start_index;
+	// instances inside the frustum are tested against the occlusion buffer in batches
+	int batch[64];
+	int batch_size = 0;
+	auto flush = [&]() {
+		int visible_count = occlusion_buffer ? occlusion_buffer->cullOccluded(spheres, batch, batch_size) : batch_size;
+		for (int j = 0; j < visible_count; ++j) results.push(sphere_to_model_instance_map[batch[j]]);
+		batch_size = 0;
+	};
 	ASSERT(results.empty());
 	PROFILE_INT("objects", int(end - start));
 	float4 px = f4Load(frustum->xs);
@@ -56,10 +67,67 @@ static void doCulling(int start_index,
 		t = f4Sub(t, r);
 		if (f4MoveMask(t)) continue;
 
-		if(layer_masks[i] & layer_mask) results.push(sphere_to_model_instance_map[i]);
+		if ((layer_masks[i] & layer_mask) == 0) continue;
+		batch[batch_size] = i;
+		++batch_size;
+		if (batch_size == lengthOf(batch)) flush();
 	}
+	flush();
 }
 
+static void doCullingViews(int start_index,
+	const Sphere* LUMIX_RESTRICT start,
+	const Sphere* LUMIX_RESTRICT end,
+	const Frustum* LUMIX_RESTRICT frustums,
+	int frustums_count,
+	const u64* LUMIX_RESTRICT layer_masks,
+	const Entity* LUMIX_RESTRICT sphere_to_model_instance_map,
+	u64 layer_mask,
+	CullingSystem::Subresults& results,
+	CullingSystem::SubresultsViewMasks& view_masks)
+{
+	PROFILE_FUNCTION();
+	ASSERT(results.empty());
+	ASSERT(view_masks.empty());
+	PROFILE_INT("objects", int(end - start));
+	int i = start_index;
+	for (const Sphere *sphere = start; sphere <= end; sphere++, ++i)
+	{
+		if ((layer_masks[i] & layer_mask) == 0) continue;
+
+		float4 cx = f4Splat(sphere->position.x);
+		float4 cy = f4Splat(sphere->position.y);
+		float4 cz = f4Splat(sphere->position.z);
+		float4 r = f4Splat(-sphere->radius);
+
+		u32 mask = 0;
+		for (int j = 0; j < frustums_count; ++j)
+		{
+			const Frustum& frustum = frustums[j];
+			float4 t = f4Mul(cx, f4Load(frustum.xs));
+			t = f4Add(t, f4Mul(cy, f4Load(frustum.ys)));
+			t = f4Add(t, f4Mul(cz, f4Load(frustum.zs)));
+			t = f4Add(t, f4Load(frustum.ds));
+			t = f4Sub(t, r);
+			if (f4MoveMask(t)) continue;
+
+			t = f4Mul(cx, f4Load(&frustum.xs[4]));
+			t = f4Add(t, f4Mul(cy, f4Load(&frustum.ys[4])));
+			t = f4Add(t, f4Mul(cz, f4Load(&frustum.zs[4])));
+			t = f4Add(t, f4Load(&frustum.ds[4]));
+			t = f4Sub(t, r);
+			if (f4MoveMask(t)) continue;
+
+			mask |= 1 << j;
+		}
+		if (mask == 0) continue;
+
+		results.push(sphere_to_model_instance_map[i]);
+		view_masks.push(mask);
+	}
+}
+
+
 struct CullingJobData
 {
 	const CullingSystem::InputSpheres* spheres;
@@ -70,6 +138,9 @@ struct CullingJobData
 	int start;
 	int end;
 	const Frustum* frustum;
+	const OcclusionBuffer* occlusion_buffer;
+	int frustums_count;
+	CullingSystem::SubresultsViewMasks* view_masks;
 };
 
 class CullingSystemImpl LUMIX_FINAL : public CullingSystem
@@ -80,6 +151,7 @@ public:
 		, m_job_allocator(allocator)
 		, m_spheres(allocator)
 		, m_result(allocator)
+		, m_view_masks(allocator)
 		, m_layer_masks(m_allocator)
 		, m_sphere_to_model_instance_map(m_allocator)
 		, m_model_instance_to_sphere_map(m_allocator)
@@ -93,6 +165,10 @@ public:
 		{
 			m_result.emplace(m_allocator);
 		}
+		while (m_view_masks.size() < m_result.size())
+		{
+			m_view_masks.emplace(m_allocator);
+		}
 	}
 
 
@@ -114,6 +190,12 @@ public:
 	}
 
 
+	const ResultsViewMasks& getViewMasks() override
+	{
+		return m_view_masks;
+	}
+
+
 	static void cullTask(void* data)
 	{
 		CullingJobData* cull_data = (CullingJobData*)data;
@@ -125,11 +207,12 @@ public:
 			, &(*cull_data->layer_masks)[0]
 			, &(*cull_data->sphere_to_model_instance_map)[0]
 			, cull_data->layer_mask
+			, cull_data->occlusion_buffer
 			, *cull_data->results);
 	}
 
 
-	Results& cull(const Frustum& frustum, u64 layer_mask) override
+	Results& cull(const Frustum& frustum, u64 layer_mask, const OcclusionBuffer* occlusion_buffer) override
 	{
 		int count = m_spheres.size();
 		for(auto& i : m_result) i.clear();
@@ -147,7 +230,10 @@ public:
 				layer_mask,
 				i * step,
 				i == m_result.size() - 1 ? count - 1 : (i + 1) * step - 1,
-				&frustum
+				&frustum,
+				occlusion_buffer,
+				1,
+				nullptr
 			};
 			jobs[i].data = &job_data[i];
 			jobs[i].task = &cullTask;
@@ -159,6 +245,56 @@ public:
 	}
 
 
+	static void cullViewsTask(void* data)
+	{
+		CullingJobData* cull_data = (CullingJobData*)data;
+		if (cull_data->end < cull_data->start) return;
+		doCullingViews(cull_data->start
+			, &(*cull_data->spheres)[cull_data->start]
+			, &(*cull_data->spheres)[cull_data->end]
+			, cull_data->frustum
+			, cull_data->frustums_count
+			, &(*cull_data->layer_masks)[0]
+			, &(*cull_data->sphere_to_model_instance_map)[0]
+			, cull_data->layer_mask
+			, *cull_data->results
+			, *cull_data->view_masks);
+	}
+
+
+	Results& cull(const Frustum* frustums, int frustums_count, u64 layer_mask) override
+	{
+		ASSERT(frustums_count > 0 && frustums_count <= MAX_VIEWS);
+		int count = m_spheres.size();
+		for (auto& i : m_result) i.clear();
+		for (auto& i : m_view_masks) i.clear();
+
+		int step = count / m_result.size();
+		for (int i = 0; i < m_result.size(); i++)
+		{
+			job_data[i] = {
+				&m_spheres,
+				&m_result[i],
+				&m_layer_masks,
+				&m_sphere_to_model_instance_map,
+				layer_mask,
+				i * step,
+				i == m_result.size() - 1 ? count - 1 : (i + 1) * step - 1,
+				frustums,
+				nullptr,
+				frustums_count,
+				&m_view_masks[i]
+			};
+			jobs[i].data = &job_data[i];
+			jobs[i].task = &cullViewsTask;
+		}
+		volatile int job_counter = 0;
+		JobSystem::runJobs(jobs, m_result.size(), &job_counter);
+		JobSystem::wait(&job_counter);
+		return m_result;
+	}
+
+
 	void setLayerMask(Entity model_instance, u64 layer) override
 	{
 		m_layer_masks[m_model_instance_to_sphere_map[model_instance.index]] = layer;
@@ -250,6 +386,7 @@ private:
 	FreeList<CullingJobData, 16> m_job_allocator;
 	InputSpheres m_spheres;
 	Results m_result;
+	ResultsViewMasks m_view_masks;
 	LayerMasks m_layer_masks;
 	ModelInstancetoSphereMap m_model_instance_to_sphere_map;
 	SphereToModelInstanceMap m_sphere_to_model_instance_map;
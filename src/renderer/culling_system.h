@@ -8,6 +8,7 @@ namespace Lumix
 {
 	template <typename T> class Array;
 	struct IAllocator;
+	class OcclusionBuffer;
 	struct Sphere;
 	struct Vec3;
 
@@ -20,6 +21,11 @@ namespace Lumix
 		typedef Array<Sphere> InputSpheres;
 		typedef Array<Entity> Subresults;
 		typedef Array<Subresults> Results;
+		// bit i is set if the instance is inside the i-th frustum
+		typedef Array<u32> SubresultsViewMasks;
+		typedef Array<SubresultsViewMasks> ResultsViewMasks;
+
+		enum { MAX_VIEWS = 32 };
 
 		CullingSystem() { }
 		virtual ~CullingSystem() { }
@@ -30,7 +36,12 @@ namespace Lumix
 		virtual void clear() = 0;
 		virtual const Results& getResult() = 0;
 
-		virtual Results& cull(const Frustum& frustum, u64 layer_mask) = 0;
+		// occlusion_buffer is optional, instances hidden behind its occluders are not in the results
+		virtual Results& cull(const Frustum& frustum, u64 layer_mask, const OcclusionBuffer* occlusion_buffer) = 0;
+		// tests every instance against all the frustums in a single pass, results contain instances inside
+		// at least one of them and getViewMasks tells which ones
+		virtual Results& cull(const Frustum* frustums, int frustums_count, u64 layer_mask) = 0;
+		virtual const ResultsViewMasks& getViewMasks() = 0;
 
 		virtual bool isAdded(Entity model_instance) = 0;
 		virtual void addStatic(Entity model_instance, const Sphere& sphere, u64 layer_mask) = 0;
@@ -242,6 +242,9 @@ void GameView::onStatsGUI(const ImVec2& view_pos)
 		const auto& stats = m_pipeline->getStats();
 		ImGui::LabelText("Draw calls", "%d", stats.draw_call_count);
 		ImGui::LabelText("Instances", "%d", stats.instance_count);
+		int batch_count = 0;
+		for (int i = 0; i < stats.view_count; ++i) batch_count += stats.views[i].batch_count;
+		ImGui::LabelText("Instanced batches", "%d", batch_count);
 		char buf[30];
 		toCStringPretty(stats.triangle_count, buf, lengthOf(buf));
 		ImGui::LabelText("Triangles", "%s", buf);
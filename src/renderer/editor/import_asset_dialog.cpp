@@ -1057,6 +1057,50 @@ struct FBXImporter
 	}
 
 
+	// one key per frame, so the runtime computes key indices directly instead of searching for them
+	static void samplePositions(Array<TranslationKey>& out,
+		int from_frame,
+		int to_frame,
+		float sample_period,
+		const ofbx::AnimationCurveNode* curve_node,
+		const ofbx::Object& bone,
+		float parent_scale)
+	{
+		out.clear();
+		if (!curve_node) return;
+		if (to_frame == from_frame) return;
+
+		ofbx::Vec3 lcl_rotation = bone.getLocalRotation();
+		for (int i = 0; i <= to_frame - from_frame; ++i)
+		{
+			float t = i * sample_period;
+			Vec3 pos = getTranslation(bone.evalLocal(curve_node->getNodeLocalTransform((from_frame + i) * sample_period), lcl_rotation));
+			out.push({pos * parent_scale, t, u16(i)});
+		}
+	}
+
+
+	static void sampleRotations(Array<RotationKey>& out,
+		int from_frame,
+		int to_frame,
+		float sample_period,
+		const ofbx::AnimationCurveNode* curve_node,
+		const ofbx::Object& bone)
+	{
+		out.clear();
+		if (!curve_node) return;
+		if (to_frame == from_frame) return;
+
+		ofbx::Vec3 lcl_translation = bone.getLocalTranslation();
+		for (int i = 0; i <= to_frame - from_frame; ++i)
+		{
+			float t = i * sample_period;
+			Quat rot = getRotation(bone.evalLocal(lcl_translation, curve_node->getNodeLocalTransform((from_frame + i) * sample_period)));
+			out.push({rot, t, u16(i)});
+		}
+	}
+
+
 	static float getScaleX(const ofbx::Matrix& mtx)
 	{
 		Vec3 v(float(mtx.m[0]), float(mtx.m[4]), float(mtx.m[8]));
@@ -1077,6 +1121,176 @@ struct FBXImporter
 	}
 
 
+	// bones are written in groups of Animation::QUANTIZED_GROUP_SIZE sharing key frames, so the runtime
+	// decodes a whole group at once; positions are quantized in the range of each bone, to as few bytes
+	// per axis as the position error allows
+	void writeQuantizedBones(const ImportAnimation& anim,
+		const ImportAnimation::Split& split,
+		float sampling_period,
+		IAllocator& allocator)
+	{
+		static const int GROUP_SIZE = Animation::QUANTIZED_GROUP_SIZE;
+
+		const ofbx::AnimationLayer* layer = anim.fbx->getLayer(0);
+		const ofbx::Object* root_bone = anim.root_motion_bone_idx >= 0 ? bones[anim.root_motion_bone_idx] : nullptr;
+		Array<const ofbx::Object*> used_bones(allocator);
+		for (const ofbx::Object* bone : bones)
+		{
+			if (&bone->getScene() != anim.scene) continue;
+
+			const ofbx::AnimationCurveNode* translation_node = layer->getCurveNode(*bone, "Lcl Translation");
+			const ofbx::AnimationCurveNode* rotation_node = layer->getCurveNode(*bone, "Lcl Rotation");
+			if (!translation_node && !rotation_node) continue;
+
+			used_bones.push(bone);
+			write(crc32(bone->name));
+			u8 channels = (translation_node ? Animation::POSITION : 0) | (rotation_node ? Animation::ROTATION : 0);
+			write(channels);
+		}
+
+		int frame_count = split.to_frame - split.from_frame;
+		Array<u8> is_key(allocator);
+		Array<Vec3> group_positions(allocator);
+		Array<Quat> group_rotations(allocator);
+		Array<TranslationKey> positions(allocator);
+		Array<RotationKey> rotations(allocator);
+		for (int first = 0; first < used_bones.size(); first += GROUP_SIZE)
+		{
+			is_key.resize(frame_count + 1);
+			setMemory(&is_key[0], uniform_keys ? 1 : 0, is_key.size());
+			is_key[0] = is_key[frame_count] = 1;
+			// frame-major, all lanes of a frame are next to each other
+			group_positions.clear();
+			group_rotations.clear();
+			for (int i = 0; i < GROUP_SIZE * (frame_count + 1); ++i)
+			{
+				group_positions.push({0, 0, 0});
+				group_rotations.push(Quat::IDENTITY);
+			}
+
+			for (int lane = 0; lane < GROUP_SIZE && first + lane < used_bones.size(); ++lane)
+			{
+				const ofbx::Object* bone = used_bones[first + lane];
+				const ofbx::AnimationCurveNode* translation_node = layer->getCurveNode(*bone, "Lcl Translation");
+				const ofbx::AnimationCurveNode* rotation_node = layer->getCurveNode(*bone, "Lcl Rotation");
+				float parent_scale = bone->getParent() ? (float)getScaleX(bone->getParent()->getGlobalTransform()) : 1;
+				samplePositions(positions, split.from_frame, split.to_frame, sampling_period, translation_node, *bone, parent_scale);
+				sampleRotations(rotations, split.from_frame, split.to_frame, sampling_period, rotation_node, *bone);
+				for (TranslationKey& key : positions)
+				{
+					Vec3 pos = key.pos * mesh_scale;
+					group_positions[key.frame * GROUP_SIZE + lane] = bone == root_bone ? fixRootOrientation(pos) : fixOrientation(pos);
+				}
+				for (RotationKey& key : rotations)
+				{
+					group_rotations[key.frame * GROUP_SIZE + lane] = bone == root_bone ? fixRootOrientation(key.rot) : fixOrientation(key.rot);
+				}
+				if (uniform_keys) continue;
+
+				// the group keeps a frame if any of its bones needs it
+				int depth = getDepth(bone);
+				compressPositions(positions, split.from_frame, split.to_frame, sampling_period, translation_node, *bone, position_error / depth, parent_scale);
+				compressRotations(rotations, split.from_frame, split.to_frame, sampling_period, rotation_node, *bone, rotation_error / depth);
+				for (TranslationKey& key : positions) is_key[key.frame] = 1;
+				for (RotationKey& key : rotations) is_key[key.frame] = 1;
+			}
+
+			float pos_min[3][GROUP_SIZE];
+			float pos_range[3][GROUP_SIZE];
+			float max_error = FLT_MAX;
+			for (int lane = 0; lane < GROUP_SIZE; ++lane)
+			{
+				Vec3 min = group_positions[lane];
+				Vec3 max = min;
+				for (int frame = 1; frame <= frame_count; ++frame)
+				{
+					if (!is_key[frame]) continue;
+					const Vec3& pos = group_positions[frame * GROUP_SIZE + lane];
+					min.set(Math::minimum(min.x, pos.x), Math::minimum(min.y, pos.y), Math::minimum(min.z, pos.z));
+					max.set(Math::maximum(max.x, pos.x), Math::maximum(max.y, pos.y), Math::maximum(max.z, pos.z));
+				}
+				for (int i = 0; i < 3; ++i)
+				{
+					pos_min[i][lane] = (&min.x)[i];
+					pos_range[i][lane] = (&max.x)[i] - (&min.x)[i];
+				}
+				if (first + lane < used_bones.size())
+				{
+					max_error = Math::minimum(max_error, position_error * mesh_scale / getDepth(used_bones[first + lane]));
+				}
+			}
+
+			// the error of a value quantized to n steps is at most half a step
+			u8 pos_bytes[4] = {};
+			float pos_scale[3][GROUP_SIZE];
+			for (int i = 0; i < 3; ++i)
+			{
+				float range = 0;
+				for (float r : pos_range[i]) range = Math::maximum(range, r);
+				if (range * 0.5f <= max_error)
+				{
+					for (int lane = 0; lane < GROUP_SIZE; ++lane) pos_min[i][lane] += pos_range[i][lane] * 0.5f;
+				}
+				else
+				{
+					pos_bytes[i] = range * 0.5f / 0xff <= max_error ? 1 : 2;
+				}
+				float steps = pos_bytes[i] == 1 ? 0xff : 0xffff;
+				for (int lane = 0; lane < GROUP_SIZE; ++lane)
+				{
+					pos_scale[i][lane] = pos_bytes[i] == 0 ? 0 : pos_range[i][lane] / steps;
+				}
+			}
+
+			int keys_count = 0;
+			for (u8 k : is_key) keys_count += k;
+			write(keys_count);
+			write(pos_bytes);
+			write(pos_min);
+			write(pos_scale);
+			for (int frame = 0; frame <= frame_count; ++frame)
+			{
+				if (is_key[frame]) write(u16(frame));
+			}
+			for (int frame = 0; frame <= frame_count; ++frame)
+			{
+				if (!is_key[frame]) continue;
+
+				for (int i = 0; i < 3; ++i)
+				{
+					if (pos_bytes[i] == 0) continue;
+
+					float steps = pos_bytes[i] == 1 ? 0xff : 0xffff;
+					u16 row[GROUP_SIZE];
+					for (int lane = 0; lane < GROUP_SIZE; ++lane)
+					{
+						const Vec3& pos = group_positions[frame * GROUP_SIZE + lane];
+						float scale = pos_scale[i][lane];
+						float q = scale > 0 ? ((&pos.x)[i] - pos_min[i][lane]) / scale + 0.5f : 0;
+						row[lane] = u16(Math::clamp(q, 0.0f, steps));
+					}
+					if (pos_bytes[i] == 2)
+					{
+						write(row);
+					}
+					else
+					{
+						for (u16 v : row) write(u8(v));
+					}
+				}
+				u16 rot_row[3][GROUP_SIZE];
+				for (int lane = 0; lane < GROUP_SIZE; ++lane)
+				{
+					u16 rot[3] = {};
+					Animation::quantizeRotation(group_rotations[frame * GROUP_SIZE + lane], rot);
+					for (int i = 0; i < 3; ++i) rot_row[i][lane] = rot[i];
+				}
+				write(rot_row);
+			}
+		}
+	}
+
+
 	void writeAnimations(const char* output_dir)
 	{
 		for (int anim_idx = 0; anim_idx < animations.size(); ++anim_idx)
@@ -1127,11 +1341,13 @@ struct FBXImporter
 				}
 				Animation::Header header;
 				header.magic = Animation::HEADER_MAGIC;
-				header.version = 3;
+				header.version = 4;
 				header.fps = (u32)(scene_frame_rate + 0.5f);
 				write(header);
 
 				write(anim.root_motion_bone_idx);
+				u32 flags = quantize_keys ? (u32)Animation::Flags::QUANTIZED : 0;
+				write(flags);
 				write(frame_count);
 				int used_bone_count = 0;
 
@@ -1146,6 +1362,13 @@ struct FBXImporter
 				}
 
 				write(used_bone_count);
+				if (quantize_keys)
+				{
+					writeQuantizedBones(anim, *split, sampling_period, allocator);
+					out_file.close();
+					continue;
+				}
+
 				Array<TranslationKey> positions(allocator);
 				Array<RotationKey> rotations(allocator);
 				for (const ofbx::Object* bone : bones)
@@ -1163,7 +1386,14 @@ struct FBXImporter
 
 					int depth = getDepth(bone);
 					float parent_scale = bone->getParent() ? (float)getScaleX(bone->getParent()->getGlobalTransform()) : 1;
-					compressPositions(positions, split->from_frame, split->to_frame, sampling_period, translation_node, *bone, position_error / depth, parent_scale);
+					if (uniform_keys)
+					{
+						samplePositions(positions, split->from_frame, split->to_frame, sampling_period, translation_node, *bone, parent_scale);
+					}
+					else
+					{
+						compressPositions(positions, split->from_frame, split->to_frame, sampling_period, translation_node, *bone, position_error / depth, parent_scale);
+					}
 					write(positions.size());
 
 					for (TranslationKey& key : positions) write(key.frame);
@@ -1179,7 +1409,14 @@ struct FBXImporter
 						}
 					}
 
-					compressRotations(rotations, split->from_frame, split->to_frame, sampling_period, rotation_node, *bone, rotation_error / depth);
+					if (uniform_keys)
+					{
+						sampleRotations(rotations, split->from_frame, split->to_frame, sampling_period, rotation_node, *bone);
+					}
+					else
+					{
+						compressRotations(rotations, split->from_frame, split->to_frame, sampling_period, rotation_node, *bone, rotation_error / depth);
+					}
 
 					write(rotations.size());
 					for (RotationKey& key : rotations) write(key.frame);
@@ -1335,9 +1572,8 @@ struct FBXImporter
 	}
 
 
-	void writeBillboardVertices(const AABB& aabb)
+	void writeBillboardVertices(const AABB& aabb, OutputBlob& blob) const
 	{
-		if (!create_billboard_lod) return;
 
 		Vec3 max = aabb.max;
 		Vec3 min = aabb.min;
@@ -1375,68 +1611,71 @@ struct FBXImporter
 
 		int vertex_data_size = sizeof(BillboardSceneData::Vertex);
 		vertex_data_size *= lengthOf(vertices);
-		write(vertex_data_size);
+		blob.write(vertex_data_size);
 		for (const BillboardSceneData::Vertex& vertex : vertices)
 		{
-			write(vertex.pos);
-			write(vertex.normal);
-			write(vertex.tangent);
-			write(vertex.uv);
+			blob.write(vertex.pos);
+			blob.write(vertex.normal);
+			blob.write(vertex.tangent);
+			blob.write(vertex.uv);
 		}
 	}
 
 
-	void writeGeometry()
+	static void writeBillboardIndices(OutputBlob& blob)
 	{
-		AABB aabb = {{0, 0, 0}, {0, 0, 0}};
-		float radius_squared = 0;
-		IAllocator& allocator = app.getWorldEditor().getAllocator();
+		const int index_size = sizeof(u16);
+		blob.write(index_size);
+		const u16 indices[] = {0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7, 8, 9, 10, 8, 10, 11, 12, 13, 14, 12, 14, 15};
+		const i32 len = lengthOf(indices);
+		blob.write(len);
+		blob.write(indices, sizeof(indices));
+	}
 
-		OutputBlob vertices_blob(allocator);
-		for (const ImportMesh& import_mesh : meshes)
+
+	void writeIndices(const ImportMesh& import_mesh, OutputBlob& blob) const
+	{
+		bool are_indices_16_bit = areIndices16Bit(import_mesh);
+		if (are_indices_16_bit)
 		{
-			if (!import_mesh.import) continue;
-			bool are_indices_16_bit = areIndices16Bit(import_mesh);
-			if (are_indices_16_bit)
+			int index_size = sizeof(u16);
+			blob.write(index_size);
+			blob.write(import_mesh.indices.size());
+			for (int i : import_mesh.indices)
 			{
-				int index_size = sizeof(u16);
-				write(index_size);
-				write(import_mesh.indices.size());
-				for (int i : import_mesh.indices)
-				{
-					assert(i <= (1 << 16));
-					u16 index = (u16)i;
-					write(index);
-				}
-			}
-			else
-			{
-				int index_size = sizeof(import_mesh.indices[0]);
-				write(index_size);
-				write(import_mesh.indices.size());
-				write(&import_mesh.indices[0], sizeof(import_mesh.indices[0]) * import_mesh.indices.size());
+				assert(i <= (1 << 16));
+				u16 index = (u16)i;
+				blob.write(index);
 			}
-			aabb.merge(import_mesh.aabb);
-			radius_squared = Math::maximum(radius_squared, import_mesh.radius_squared);
 		}
-
-		if (create_billboard_lod)
+		else
 		{
-			const int index_size = sizeof(u16);
-			write(index_size);
-			const u16 indices[] = {0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7, 8, 9, 10, 8, 10, 11, 12, 13, 14, 12, 14, 15};
-			const i32 len = lengthOf(indices);
-			write(len);
-			write(indices, sizeof(indices));
+			int index_size = sizeof(import_mesh.indices[0]);
+			blob.write(index_size);
+			blob.write(import_mesh.indices.size());
+			blob.write(&import_mesh.indices[0], sizeof(import_mesh.indices[0]) * import_mesh.indices.size());
 		}
+	}
+
 
+	void computeBoundingShapes(AABB* aabb, float* radius_squared) const
+	{
+		*aabb = {{0, 0, 0}, {0, 0, 0}};
+		*radius_squared = 0;
 		for (const ImportMesh& import_mesh : meshes)
 		{
 			if (!import_mesh.import) continue;
-			write(import_mesh.vertex_data.getPos());
-			write(import_mesh.vertex_data.getData(), import_mesh.vertex_data.getPos());
+			aabb->merge(import_mesh.aabb);
+			*radius_squared = Math::maximum(*radius_squared, import_mesh.radius_squared);
 		}
-		writeBillboardVertices(aabb);
+	}
+
+
+	void writeBoundingShapes()
+	{
+		AABB aabb;
+		float radius_squared;
+		computeBoundingShapes(&aabb, &radius_squared);
 
 		write(sqrtf(radius_squared) * bounding_shape_scale);
 		aabb.min *= bounding_shape_scale;
@@ -1445,6 +1684,148 @@ struct FBXImporter
 	}
 
 
+	// every LOD is written as a separate chunk, so the engine can load the coarse LODs first and stream the rest
+	void writeGeometry()
+	{
+		IAllocator& allocator = app.getWorldEditor().getAllocator();
+		AABB aabb;
+		float radius_squared;
+		computeBoundingShapes(&aabb, &radius_squared);
+
+		Array<const ImportMesh*> imported_meshes(allocator);
+		for (const ImportMesh& import_mesh : meshes)
+		{
+			if (import_mesh.import) imported_meshes.push(&import_mesh);
+		}
+
+		i32 lods[8];
+		int lod_count = getLODs(lods);
+		u32 chunk_sizes[8];
+		OutputBlob chunks_blob(allocator);
+		for (int lod = 0; lod < lod_count; ++lod)
+		{
+			int chunk_start = chunks_blob.getPos();
+			int from_mesh = lod > 0 ? lods[lod - 1] + 1 : 0;
+			for (int i = from_mesh; i <= lods[lod]; ++i)
+			{
+				// the billboard mesh is the one after all imported meshes
+				if (i < imported_meshes.size()) writeIndices(*imported_meshes[i], chunks_blob);
+				else writeBillboardIndices(chunks_blob);
+			}
+			for (int i = from_mesh; i <= lods[lod]; ++i)
+			{
+				if (i < imported_meshes.size())
+				{
+					const OutputBlob& vertex_data = imported_meshes[i]->vertex_data;
+					chunks_blob.write(vertex_data.getPos());
+					chunks_blob.write(vertex_data.getData(), vertex_data.getPos());
+				}
+				else
+				{
+					writeBillboardVertices(aabb, chunks_blob);
+				}
+			}
+			chunk_sizes[lod] = u32(chunks_blob.getPos() - chunk_start);
+		}
+
+		write(chunk_sizes, sizeof(chunk_sizes[0]) * lod_count);
+		write(chunks_blob.getData(), chunks_blob.getPos());
+	}
+
+
+	// occluder is made by vertex clustering - vertices of the first LOD are merged into the cells of a regular grid,
+	// triangles which collapse or which are already there are dropped
+	void writeOccluder()
+	{
+		IAllocator& allocator = app.getWorldEditor().getAllocator();
+		Array<Vec3> vertices(allocator);
+		Array<int> indices(allocator);
+		if (create_occluder && is_occluder)
+		{
+			AABB aabb = {{0, 0, 0}, {0, 0, 0}};
+			bool any_mesh = false;
+			for (const ImportMesh& import_mesh : meshes)
+			{
+				if (!import_mesh.import || import_mesh.lod != 0 || isSkinned(*import_mesh.fbx)) continue;
+				if (any_mesh) aabb.merge(import_mesh.aabb);
+				else aabb = import_mesh.aabb;
+				any_mesh = true;
+			}
+
+			const int cells = Math::clamp(occluder_cells, 1, 32);
+			Vec3 size = aabb.max - aabb.min;
+			Vec3 cell_scale(size.x > 0 ? cells / size.x : 0, size.y > 0 ? cells / size.y : 0, size.z > 0 ? cells / size.z : 0);
+			Array<int> cell_vertex(allocator);
+			cell_vertex.resize(cells * cells * cells);
+			for (int& i : cell_vertex) i = -1;
+			Array<int> cell_weights(allocator);
+			HashMap<u64, int> triangles(allocator);
+
+			for (const ImportMesh& import_mesh : meshes)
+			{
+				if (!import_mesh.import || import_mesh.lod != 0 || isSkinned(*import_mesh.fbx)) continue;
+
+				int vertex_size = getVertexSize(*import_mesh.fbx);
+				const u8* vertex_data = (const u8*)import_mesh.vertex_data.getData();
+				for (int i = 0, c = import_mesh.indices.size(); i + 2 < c; i += 3)
+				{
+					int tri[3];
+					for (int j = 0; j < 3; ++j)
+					{
+						Vec3 p = *(const Vec3*)&vertex_data[import_mesh.indices[i + j] * vertex_size];
+						Vec3 rel = p - aabb.min;
+						int x = Math::clamp(int(rel.x * cell_scale.x), 0, cells - 1);
+						int y = Math::clamp(int(rel.y * cell_scale.y), 0, cells - 1);
+						int z = Math::clamp(int(rel.z * cell_scale.z), 0, cells - 1);
+						int& vertex = cell_vertex[x + (y + z * cells) * cells];
+						if (vertex < 0)
+						{
+							vertex = vertices.size();
+							vertices.push({0, 0, 0});
+							cell_weights.push(0);
+						}
+						vertices[vertex] += p;
+						++cell_weights[vertex];
+						tri[j] = vertex;
+					}
+					if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) continue;
+
+					// rotate so the smallest index is first, it keeps the winding
+					while (tri[0] > tri[1] || tri[0] > tri[2])
+					{
+						int tmp = tri[0];
+						tri[0] = tri[1];
+						tri[1] = tri[2];
+						tri[2] = tmp;
+					}
+					u64 key = u64(tri[0]) | (u64(tri[1]) << 16) | (u64(tri[2]) << 32);
+					if (triangles.find(key).isValid()) continue;
+					triangles.insert(key, indices.size());
+					for (int j : tri) indices.push(j);
+				}
+			}
+			for (int i = 0; i < vertices.size(); ++i)
+			{
+				vertices[i] *= 1.0f / cell_weights[i];
+			}
+		}
+
+		const bool are_indices_16_bit = vertices.size() <= (1 << 16);
+		int index_size = are_indices_16_bit ? sizeof(u16) : sizeof(u32);
+		write(index_size);
+		write(indices.size());
+		if (indices.empty()) return;
+
+		for (int i : indices)
+		{
+			if (are_indices_16_bit) write((u16)i);
+			else write((u32)i);
+		}
+		write(vertices.size());
+		write(&vertices[0], sizeof(vertices[0]) * vertices.size());
+	}
+
+
 	void writeBillboardMesh(i32 attribute_array_offset, i32 indices_offset, const char* mesh_output_filename)
 	{
 		if (!create_billboard_lod) return;
@@ -1602,11 +1983,11 @@ struct FBXImporter
 	}
 
 
-	void writeLODs()
+	int getLODs(i32 (&lods)[8]) const
 	{
 		i32 lod_count = 1;
 		i32 last_mesh_idx = -1;
-		i32 lods[8] = {};
+		setMemory(lods, 0, sizeof(lods));
 		for (auto& mesh : meshes)
 		{
 			if (!mesh.import) continue;
@@ -1627,7 +2008,14 @@ struct FBXImporter
 			lods[lod_count] = last_mesh_idx + 1;
 			++lod_count;
 		}
+		return lod_count;
+	}
 
+
+	void writeLODs()
+	{
+		i32 lods[8];
+		i32 lod_count = getLODs(lods);
 		write((const char*)&lod_count, sizeof(lod_count));
 
 		for (int i = 0; i < lod_count; ++i)
@@ -1665,7 +2053,8 @@ struct FBXImporter
 		header.magic = 0x5f4c4d4f; // == '_LMO';
 		header.version = (u32)Model::FileVersion::LATEST;
 		write(header);
-		u32 flags = 0;
+		u32 flags = keep_cpu_data ? 0 : (u32)Model::FileFlags::NO_CPU_DATA;
+		if (!is_occluder) flags |= (u32)Model::FileFlags::NO_OCCLUSION;
 		write(flags);
 	}
 
@@ -1800,9 +2189,11 @@ struct FBXImporter
 		dialog.setImportMessage("Writing model...", 0.5f);
 		writeModelHeader();
 		writeMeshes(output_mesh_filename);
-		writeGeometry();
+		writeBoundingShapes();
 		writeSkeleton();
 		writeLODs();
+		writeGeometry();
+		writeOccluder();
 		out_file.close();
 	}
 
@@ -1847,13 +2238,19 @@ struct FBXImporter
 	float time_scale = 1.0f;
 	float position_error = 0.1f;
 	float rotation_error = 0.01f;
+	bool uniform_keys = false;
+	bool quantize_keys = false;
 	float bounding_shape_scale = 1.0f;
 	bool to_dds = false;
 	bool cancel_mesh_transforms = false;
 	bool ignore_skeleton = false;
 	bool import_vertex_colors = true;
+	bool keep_cpu_data = true;
 	bool make_convex = false;
 	bool create_billboard_lod = false;
+	bool is_occluder = true;
+	bool create_occluder = false;
+	int occluder_cells = 8;
 	Orientation orientation = Orientation::Y_UP;
 	Orientation root_orientation = Orientation::Y_UP;
 	Origin origin = Origin::SOURCE;
@@ -1982,8 +2379,14 @@ int setParams(lua_State* L)
 	LuaWrapper::getOptionalField(L, 1, "create_billboard", &dlg->m_fbx_importer->create_billboard_lod);
 	LuaWrapper::getOptionalField(L, 1, "cancel_mesh_transforms", &dlg->m_fbx_importer->cancel_mesh_transforms);
 	LuaWrapper::getOptionalField(L, 1, "import_vertex_colors", &dlg->m_fbx_importer->import_vertex_colors);
+	LuaWrapper::getOptionalField(L, 1, "keep_cpu_data", &dlg->m_fbx_importer->keep_cpu_data);
+	LuaWrapper::getOptionalField(L, 1, "is_occluder", &dlg->m_fbx_importer->is_occluder);
+	LuaWrapper::getOptionalField(L, 1, "create_occluder", &dlg->m_fbx_importer->create_occluder);
+	LuaWrapper::getOptionalField(L, 1, "occluder_cells", &dlg->m_fbx_importer->occluder_cells);
 	LuaWrapper::getOptionalField(L, 1, "scale", &dlg->m_fbx_importer->mesh_scale);
 	LuaWrapper::getOptionalField(L, 1, "time_scale", &dlg->m_fbx_importer->time_scale);
+	LuaWrapper::getOptionalField(L, 1, "uniform_keys", &dlg->m_fbx_importer->uniform_keys);
+	LuaWrapper::getOptionalField(L, 1, "quantize_keys", &dlg->m_fbx_importer->quantize_keys);
 	LuaWrapper::getOptionalField(L, 1, "to_dds", &dlg->m_convert_to_dds);
 	LuaWrapper::getOptionalField(L, 1, "normal_map", &dlg->m_is_normal_map);
 	if (lua_getfield(L, 1, "orientation") == LUA_TSTRING)
@@ -2767,6 +3170,10 @@ void ImportAssetDialog::onAnimationsGUI()
 	ImGui::DragFloat("Time scale", &m_fbx_importer->time_scale, 1.0f, 0, FLT_MAX, "%.5f");
 	ImGui::DragFloat("Max position error", &m_fbx_importer->position_error, 0, FLT_MAX);
 	ImGui::DragFloat("Max rotation error", &m_fbx_importer->rotation_error, 0, FLT_MAX);
+	ImGui::Checkbox("Uniform keys", &m_fbx_importer->uniform_keys);
+	if (ImGui::IsItemHovered()) ImGui::SetTooltip("%s", "Keep a key for every frame, bigger files but faster sampling");
+	ImGui::Checkbox("Quantize keys", &m_fbx_importer->quantize_keys);
+	if (ImGui::IsItemHovered()) ImGui::SetTooltip("%s", "Store keys in 16 bit per component, smaller files, slightly lower precision");
 
 	ImGui::Indent();
 	ImGui::Columns(4);
@@ -3445,6 +3852,16 @@ void ImportAssetDialog::onWindowGUI()
 			ImGui::Checkbox("Cancel mesh transforms", &m_fbx_importer->cancel_mesh_transforms);
 			ImGui::Combo("Origin", (int*)&m_fbx_importer->origin, "Source\0Center\0Bottom\0");
 			ImGui::Checkbox("Import Vertex Colors", &m_fbx_importer->import_vertex_colors);
+			ImGui::Checkbox("Keep CPU data", &m_fbx_importer->keep_cpu_data);
+			ImGui::Checkbox("Occluder", &m_fbx_importer->is_occluder);
+			if (m_fbx_importer->is_occluder)
+			{
+				ImGui::Checkbox("Create simplified occluder", &m_fbx_importer->create_occluder);
+				if (m_fbx_importer->create_occluder)
+				{
+					ImGui::DragInt("Occluder resolution", &m_fbx_importer->occluder_cells, 1, 1, 32);
+				}
+			}
 			ImGui::DragFloat("Scale", &m_fbx_importer->mesh_scale, 0.01f, 0.001f, 0);
 			ImGui::Combo("Orientation", &(int&)m_fbx_importer->orientation, "Y up\0Z up\0-Z up\0-X up\0X up\0");
 			ImGui::Combo("Root Orientation", &(int&)m_fbx_importer->root_orientation, "Y up\0Z up\0-Z up\0-X up\0X up\0");
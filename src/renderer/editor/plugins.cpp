@@ -1563,6 +1563,7 @@ struct FurPainter LUMIX_FINAL : public WorldEditor::Plugin
 		for (int i = 0, c = model->getMeshCount(); i < c; ++i)
 		{
 			Mesh& mesh = model->getMesh(i);
+			if (!mesh.hasCPUData()) continue;
 			const u16* idx16 = (const u16*)&mesh.indices[0];
 			const u32* idx32 = (const u32*)&mesh.indices[0];
 			const Vec3* vertices = &mesh.vertices[0];
@@ -1765,6 +1766,7 @@ struct FurPainter LUMIX_FINAL : public WorldEditor::Plugin
 		for (int i = 0, c = model->getMeshCount(); i < c; ++i)
 		{
 			const Mesh& mesh = model->getMesh(i);
+			if (!mesh.hasCPUData()) continue;
 			const u16* idx16 = (const u16*)&mesh.indices[0];
 			const u32* idx32 = (const u32*)&mesh.indices[0];
 			const Vec3* vertices = &mesh.vertices[0];
@@ -2106,6 +2108,7 @@ struct RenderInterfaceImpl LUMIX_FINAL : public RenderInterface
 		for (int i = 0, c = model->getMeshCount(); i < c; ++i)
 		{
 			Mesh& mesh = model->getMesh(i);
+			if (!mesh.hasCPUData()) continue;
 
 			if (mesh.areIndices16())
 			{
@@ -2420,7 +2423,7 @@ struct RenderInterfaceImpl LUMIX_FINAL : public RenderInterface
 
 	void getModelInstaces(Array<Entity>& entities, const Frustum& frustum, const Vec3& lod_ref_point, Entity camera) override
 	{
-		Array<Array<MeshInstance>>& res = m_render_scene->getModelInstanceInfos(frustum, lod_ref_point, camera, ~0ULL);
+		Array<Array<MeshInstance>>& res = m_render_scene->getModelInstanceInfos(frustum, lod_ref_point, camera, ~0ULL, nullptr);
 		for (auto& sub : res)
 		{
 			for (MeshInstance m : sub)
@@ -559,6 +559,11 @@ private:
 		auto texture = getDestinationTexture();
 		int bpp = texture->bytes_per_pixel;
 
+		// grass jobs read the heightmap and the splatmap, this waits for the running ones and drops their quads,
+		// new quads are generated from the updated data
+		auto* render_scene = static_cast<RenderScene*>(m_terrain.scene);
+		render_scene->forceGrassUpdate(m_terrain.entity);
+
 		for (int j = m_y; j < m_y + m_height; ++j)
 		{
 			for (int i = m_x; i < m_x + m_width; ++i)
@@ -571,11 +576,12 @@ private:
 			}
 		}
 		texture->onDataUpdated(m_x, m_y, m_width, m_height);
-		static_cast<RenderScene*>(m_terrain.scene)->forceGrassUpdate(m_terrain.entity);
 
 		if (m_action_type != TerrainEditor::LAYER && m_action_type != TerrainEditor::COLOR &&
 			m_action_type != TerrainEditor::ADD_GRASS && m_action_type != TerrainEditor::REMOVE_GRASS)
 		{
+			render_scene->updateTerrainHeightBounds(m_terrain.entity, m_x, m_y, m_x + m_width, m_y + m_height);
+
 			IScene* scene = m_world_editor.getUniverse()->getScene(crc32("physics"));
 			if (!scene) return;
 
@@ -1335,7 +1341,7 @@ void TerrainEditor::paintEntities(const Vec3& hit_pos)
 		Entity camera_entity = camera.entity;
 		Vec3 camera_pos = scene->getUniverse().getPosition(camera_entity);
 		
-		auto& meshes = scene->getModelInstanceInfos(frustum, camera_pos, camera.entity, ~0ULL);
+		auto& meshes = scene->getModelInstanceInfos(frustum, camera_pos, camera.entity, ~0ULL, nullptr);
 
 		Vec2 size = scene->getTerrainSize(m_component.entity);
 		float scale = 1.0f - Math::maximum(0.01f, m_terrain_brush_strength);
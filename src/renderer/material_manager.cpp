@@ -15,4 +15,25 @@ namespace Lumix
 	{
 		LUMIX_DELETE(m_allocator, static_cast<Material*>(&resource));
 	}
+
+	void MaterialManager::onTextureHandlesChanged(const Array<Texture*>& textures)
+	{
+		if (textures.empty()) return;
+
+		for (Resource* resource : getResourceTable())
+		{
+			Material* material = static_cast<Material*>(resource);
+			if (!material->isReady()) continue;
+
+			for (int i = 0, c = material->getTextureCount(); i < c; ++i)
+			{
+				Texture* texture = material->getTexture(i);
+				if (texture && textures.indexOf(texture) >= 0)
+				{
+					material->createCommandBuffer();
+					break;
+				}
+			}
+		}
+	}
 }
\ No newline at end of file
@@ -1,11 +1,13 @@
 #pragma once
 
+#include "engine/array.h"
 #include "engine/resource_manager_base.h"
 
 namespace Lumix
 {
 
 	class Renderer;
+	class Texture;
 
 	class LUMIX_RENDERER_API MaterialManager LUMIX_FINAL : public ResourceManagerBase
 	{
@@ -18,6 +20,7 @@ namespace Lumix
 		~MaterialManager() {}
 
 		Renderer& getRenderer() { return m_renderer; }
+		void onTextureHandlesChanged(const Array<Texture*>& textures);
 
 	protected:
 		Resource* createResource(const Path& path) override;
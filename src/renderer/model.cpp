@@ -5,6 +5,7 @@
 #include "engine/crc32.h"
 #include "engine/fs/file_system.h"
 #include "engine/log.h"
+#include "engine/mt/atomic.h"
 #include "engine/lua_wrapper.h"
 #include "engine/path_utils.h"
 #include "engine/profiler.h"
@@ -12,6 +13,7 @@
 #include "engine/resource_manager_base.h"
 #include "engine/vec.h"
 #include "renderer/material.h"
+#include "renderer/model_manager.h"
 #include "renderer/pose.h"
 #include "renderer/renderer.h"
 
@@ -79,7 +81,7 @@ void Mesh::setMaterial(Material* new_material, Model& model, Renderer& renderer)
 	}
 	else if (model.getBoneCount() > 0)
 	{
-		type = skin.empty() ? Mesh::RIGID_INSTANCED : Mesh::SKINNED;
+		type = isSkinned() ? Mesh::SKINNED : Mesh::RIGID_INSTANCED;
 	}
 	else type = Mesh::RIGID_INSTANCED;
 }
@@ -95,7 +97,17 @@ Model::Model(const Path& path, ResourceManagerBase& resource_manager, Renderer&
 	, m_bone_map(m_allocator)
 	, m_meshes(m_allocator)
 	, m_bones(m_allocator)
+	, m_lod_count(0)
+	, m_loaded_lods(ALL_LODS_LOADED)
+	, m_requested_lods(0)
+	, m_is_streamed(false)
+	, m_keep_cpu_data(true)
+	, m_is_occluder(true)
+	, m_occluder(nullptr, bgfx::VertexDecl(), "occluder", allocator)
+	, m_streaming_async_op(FS::FileSystem::INVALID_ASYNC)
+	, m_lod_loaded_cb(allocator)
 	, m_first_nonroot_bone_index(0)
+	, m_skeleton_id(0)
 	, m_renderer(renderer)
 {
 	m_lods[0] = { 0, -1, FLT_MAX };
@@ -144,8 +156,12 @@ RayCastModelHit Model::castRay(const Vec3& origin, const Vec3& dir, const Matrix
 
 	Matrix matrices[256];
 	ASSERT(!pose || pose->count <= lengthOf(matrices));
+	int lod = 0;
+	while (lod < m_lod_count - 1 && !isLODLoaded(lod)) ++lod;
+	const LOD& ray_lod = m_lods[lod];
+
 	bool is_skinned = false;
-	for (int mesh_index = m_lods[0].from_mesh; mesh_index <= m_lods[0].to_mesh; ++mesh_index)
+	for (int mesh_index = ray_lod.from_mesh; mesh_index <= ray_lod.to_mesh; ++mesh_index)
 	{
 		Mesh& mesh = m_meshes[mesh_index];
 		is_skinned = pose && !mesh.skin.empty() && pose->count <= lengthOf(matrices);
@@ -155,9 +171,10 @@ RayCastModelHit Model::castRay(const Vec3& origin, const Vec3& dir, const Matrix
 		computeSkinMatrices(*pose, *this, matrices);
 	}
 
-	for (int mesh_index = m_lods[0].from_mesh; mesh_index <= m_lods[0].to_mesh; ++mesh_index)
+	for (int mesh_index = ray_lod.from_mesh; mesh_index <= ray_lod.to_mesh; ++mesh_index)
 	{
 		Mesh& mesh = m_meshes[mesh_index];
+		if (!mesh.hasCPUData()) continue;
 		bool is_mesh_skinned = !mesh.skin.empty();
 		u16* indices16 = (u16*)&mesh.indices[0];
 		u32* indices32 = (u32*)&mesh.indices[0];
@@ -393,15 +410,20 @@ void Model::onBeforeReady()
 		}
 		else if (getBoneCount() > 0)
 		{
-			mesh.type = mesh.skin.empty() ? Mesh::RIGID_INSTANCED : Mesh::SKINNED;
+			mesh.type = mesh.isSkinned() ? Mesh::SKINNED : Mesh::RIGID_INSTANCED;
 		}
 		else mesh.type = Mesh::RIGID_INSTANCED;
 	}
 }
 
 
+static volatile i32 s_last_skeleton_id = 0;
+
+
 bool Model::parseBones(FS::IFile& file)
 {
+	m_skeleton_id = (u32)MT::atomicIncrement(&s_last_skeleton_id);
+
 	int bone_count;
 	file.read(&bone_count, sizeof(bone_count));
 	if (bone_count < 0) return false;
@@ -543,11 +565,26 @@ bool Model::parseMeshes(const bgfx::VertexDecl& global_vertex_decl, FS::IFile& f
 		mesh_name[str_size] = 0;
 		file.read(mesh_name, str_size);
 
-		m_meshes.emplace(material, vertex_decl, mesh_name, m_allocator);
+		Mesh& mesh = m_meshes.emplace(material, vertex_decl, mesh_name, m_allocator);
+		if (vertex_decl.has(bgfx::Attrib::Weight) && vertex_decl.has(bgfx::Attrib::Indices))
+		{
+			mesh.flags.set(Mesh::Flags::HAS_SKIN);
+		}
 		addDependency(*material);
 	}
 
-	for (int i = 0; i < object_count; ++i)
+	if (version <= FileVersion::LOD_CHUNKS && !parseGeometry(file, 0, object_count - 1, true)) return false;
+
+	file.read(&m_bounding_radius, sizeof(m_bounding_radius));
+	file.read(&m_aabb, sizeof(m_aabb));
+
+	return true;
+}
+
+
+bool Model::parseGeometry(FS::IFile& file, int from_mesh, int to_mesh, bool keep_cpu_data)
+{
+	for (int i = from_mesh; i <= to_mesh; ++i)
 	{
 		Mesh& mesh = m_meshes[i];
 		int index_size;
@@ -556,16 +593,25 @@ bool Model::parseMeshes(const bgfx::VertexDecl& global_vertex_decl, FS::IFile& f
 		if (index_size != 2 && index_size != 4) return false;
 		file.read(&indices_count, sizeof(indices_count));
 		if (indices_count <= 0) return false;
-		mesh.indices.resize(index_size * indices_count);
-		file.read(&mesh.indices[0], mesh.indices.size());
+		const bgfx::Memory* indices_mem;
+		if (keep_cpu_data)
+		{
+			mesh.indices.resize(index_size * indices_count);
+			file.read(&mesh.indices[0], mesh.indices.size());
+			indices_mem = bgfx::copy(&mesh.indices[0], mesh.indices.size());
+		}
+		else
+		{
+			indices_mem = bgfx::alloc(index_size * indices_count);
+			file.read(indices_mem->data, indices_mem->size);
+		}
 
 		if (index_size == 2) mesh.flags.set(Mesh::Flags::INDICES_16_BIT);
 		mesh.indices_count = indices_count;
-		const bgfx::Memory* indices_mem = bgfx::copy(&mesh.indices[0], mesh.indices.size());
 		mesh.index_buffer_handle = bgfx::createIndexBuffer(indices_mem);
 	}
 
-	for (int i = 0; i < object_count; ++i)
+	for (int i = from_mesh; i <= to_mesh; ++i)
 	{
 		Mesh& mesh = m_meshes[i];
 		int data_size;
@@ -581,7 +627,7 @@ bool Model::parseMeshes(const bgfx::VertexDecl& global_vertex_decl, FS::IFile& f
 		bool keep_skin = vertex_decl.has(bgfx::Attrib::Weight) && vertex_decl.has(bgfx::Attrib::Indices);
 
 		int vertex_size = mesh.vertex_decl.getStride();
-		int mesh_vertex_count = vertices_mem->size / mesh.vertex_decl.getStride();
+		int mesh_vertex_count = keep_cpu_data ? vertices_mem->size / mesh.vertex_decl.getStride() : 0;
 		mesh.vertices.resize(mesh_vertex_count);
 		mesh.uvs.resize(mesh_vertex_count);
 		if (keep_skin) mesh.skin.resize(mesh_vertex_count);
@@ -601,9 +647,6 @@ bool Model::parseMeshes(const bgfx::VertexDecl& global_vertex_decl, FS::IFile& f
 		}
 		mesh.vertex_buffer_handle = bgfx::createVertexBuffer(vertices_mem, mesh.vertex_decl);
 	}
-	file.read(&m_bounding_radius, sizeof(m_bounding_radius));
-	file.read(&m_aabb, sizeof(m_aabb));
-
 	return true;
 }
 
@@ -673,10 +716,14 @@ bool Model::parseMeshesOld(bgfx::VertexDecl global_vertex_decl, FS::IFile& file,
 		}
 
 
-		m_meshes.emplace(material,
+		Mesh& mesh = m_meshes.emplace(material,
 			vertex_decl,
 			mesh_name,
 			m_allocator);
+		if (vertex_decl.has(bgfx::Attrib::Weight) && vertex_decl.has(bgfx::Attrib::Indices))
+		{
+			mesh.flags.set(Mesh::Flags::HAS_SKIN);
+		}
 		addDependency(*material);
 	}
 
@@ -801,10 +848,139 @@ bool Model::parseLODs(FS::IFile& file)
 		file.read(&m_lods[i].distance, sizeof(m_lods[i].distance));
 		m_lods[i].from_mesh = i > 0 ? m_lods[i - 1].to_mesh + 1 : 0;
 	}
+	m_lod_count = lod_count;
+	return true;
+}
+
+
+bool Model::parseLODChunks(FS::IFile& file)
+{
+	u32 offset = u32(file.pos() + sizeof(u32) * m_lod_count);
+	for (int i = 0; i < m_lod_count; ++i)
+	{
+		u32 size;
+		file.read(&size, sizeof(size));
+		m_lod_chunks[i] = { offset, size };
+		offset += size;
+	}
+	if (offset > file.size()) return false;
+
+	ModelManager& manager = static_cast<ModelManager&>(m_resource_manager);
+	m_is_streamed = manager.isStreamingEnabled() && m_lod_count > 1;
+	m_loaded_lods = ALL_LODS_LOADED & ~((1 << m_lod_count) - 1);
+
+	// only the coarsest LOD is needed to be ready, finer LODs are streamed when getLODMeshIndices asks for them
+	for (int i = m_is_streamed ? m_lod_count - 1 : 0; i < m_lod_count; ++i)
+	{
+		if (!loadLODChunk(file, i)) return false;
+	}
+	if (m_is_streamed) manager.addStreamedModel(*this);
+	return true;
+}
+
+
+bool Model::loadLODChunk(FS::IFile& file, int lod)
+{
+	const LODChunk& chunk = m_lod_chunks[lod];
+	if (!file.seek(FS::SeekMode::BEGIN, chunk.offset)) return false;
+	if (!parseGeometry(file, m_lods[lod].from_mesh, m_lods[lod].to_mesh, m_keep_cpu_data)) return false;
+	if (file.pos() != chunk.offset + chunk.size) return false;
+
+	m_loaded_lods |= 1 << lod;
 	return true;
 }
 
 
+// the occluder is stored after the LOD chunks, it has only positions and indices and it is never uploaded to GPU
+bool Model::parseOccluder(FS::IFile& file)
+{
+	const LODChunk& last_chunk = m_lod_chunks[m_lod_count - 1];
+	if (!file.seek(FS::SeekMode::BEGIN, last_chunk.offset + last_chunk.size)) return false;
+
+	int index_size;
+	int indices_count;
+	file.read(&index_size, sizeof(index_size));
+	file.read(&indices_count, sizeof(indices_count));
+	if (indices_count == 0) return true;
+	if (index_size != 2 && index_size != 4) return false;
+	if (indices_count < 0 || indices_count % 3 != 0) return false;
+	m_occluder.indices.resize(index_size * indices_count);
+	file.read(&m_occluder.indices[0], m_occluder.indices.size());
+	if (index_size == 2) m_occluder.flags.set(Mesh::Flags::INDICES_16_BIT);
+	m_occluder.indices_count = indices_count;
+
+	int vertices_count;
+	file.read(&vertices_count, sizeof(vertices_count));
+	if (vertices_count <= 0) return false;
+	m_occluder.vertices.resize(vertices_count);
+	file.read(&m_occluder.vertices[0], m_occluder.vertices.size() * sizeof(m_occluder.vertices[0]));
+	return file.pos() == file.size();
+}
+
+
+int Model::requestLOD(int lod) const
+{
+	for (;;)
+	{
+		i32 requested = m_requested_lods;
+		if (requested & (1 << lod)) break;
+		if (MT::compareAndExchange(&m_requested_lods, requested | (1 << lod), requested)) break;
+	}
+
+	// render the closest coarser LOD until the requested one is streamed in
+	for (int i = lod + 1; i < m_lod_count - 1; ++i)
+	{
+		if (isLODLoaded(i)) return i;
+	}
+	return m_lod_count - 1;
+}
+
+
+u32 Model::getMissingLODs() const
+{
+	return m_requested_lods & ~m_loaded_lods;
+}
+
+
+void Model::streamLODs()
+{
+	if (m_streaming_async_op != FS::FileSystem::INVALID_ASYNC) return;
+
+	FS::FileSystem& fs = m_resource_manager.getOwner().getFileSystem();
+	FS::ReadCallback cb;
+	cb.bind<Model, &Model::streamedFileLoaded>(this);
+	m_streaming_async_op = fs.openAsync(fs.getDefaultDevice(), getPath(), FS::Mode::OPEN_AND_READ, cb);
+}
+
+
+void Model::streamedFileLoaded(FS::IFile& file, bool success)
+{
+	m_streaming_async_op = FS::FileSystem::INVALID_ASYNC;
+	if (!isReady()) return;
+
+	ModelManager& manager = static_cast<ModelManager&>(m_resource_manager);
+	if (!success)
+	{
+		g_log_error.log("Renderer") << "Could not stream LODs of " << getPath().c_str();
+		manager.removeStreamedModel(*this);
+		return;
+	}
+
+	u32 missing = getMissingLODs();
+	for (int i = 0; i < m_lod_count; ++i)
+	{
+		if ((missing & (1 << i)) == 0) continue;
+		if (!loadLODChunk(file, i))
+		{
+			g_log_error.log("Renderer") << "Corrupted LOD " << i << " in " << getPath().c_str();
+			manager.removeStreamedModel(*this);
+			break;
+		}
+	}
+	m_lod_loaded_cb.invoke(*this);
+}
+
+
 bool Model::load(FS::IFile& file)
 {
 	PROFILE_FUNCTION();
@@ -835,9 +1011,16 @@ bool Model::load(FS::IFile& file)
 		parseVertexDeclEx(file, &global_vertex_decl);
 	}
 
+	bool has_lod_chunks = header.version > (u32)FileVersion::LOD_CHUNKS;
+	bool has_occluder = header.version > (u32)FileVersion::OCCLUDER;
+	m_keep_cpu_data = !has_lod_chunks || (global_flags & (u32)FileFlags::NO_CPU_DATA) == 0;
+	m_is_occluder = (global_flags & (u32)FileFlags::NO_OCCLUSION) == 0;
+
 	if (parseMeshes(global_vertex_decl, file, (FileVersion)header.version, global_flags)
 		&& parseBones(file)
-		&& parseLODs(file))
+		&& parseLODs(file)
+		&& (!has_lod_chunks || parseLODChunks(file))
+		&& (!has_occluder || parseOccluder(file)))
 	{
 		m_size = file.size();
 		return true;
@@ -888,6 +1071,20 @@ void Model::registerLuaAPI(lua_State* L)
 
 void Model::unload()
 {
+	if (m_streaming_async_op != FS::FileSystem::INVALID_ASYNC)
+	{
+		m_resource_manager.getOwner().getFileSystem().cancelAsync(m_streaming_async_op);
+		m_streaming_async_op = FS::FileSystem::INVALID_ASYNC;
+	}
+	if (m_is_streamed)
+	{
+		static_cast<ModelManager&>(m_resource_manager).removeStreamedModel(*this);
+		m_is_streamed = false;
+	}
+	m_lod_count = 0;
+	m_loaded_lods = ALL_LODS_LOADED;
+	m_requested_lods = 0;
+
 	auto* material_manager = m_resource_manager.getOwner().get(Material::TYPE);
 	for (int i = 0; i < m_meshes.size(); ++i)
 	{
@@ -901,6 +1098,10 @@ void Model::unload()
 	}
 	m_meshes.clear();
 	m_bones.clear();
+	m_skeleton_id = 0;
+	m_occluder.vertices.clear();
+	m_occluder.indices.clear();
+	m_occluder.flags.clear();
 }
 
 
@@ -2,6 +2,7 @@
 
 
 #include "engine/array.h"
+#include "engine/delegate_list.h"
 #include "engine/flag_set.h"
 #include "engine/geometry.h"
 #include "engine/hash_map.h"
@@ -65,7 +66,8 @@ struct LUMIX_RENDERER_API Mesh
 
 	enum Flags : u8
 	{
-		INDICES_16_BIT = 1 << 0
+		INDICES_16_BIT = 1 << 0,
+		HAS_SKIN = 1 << 1
 	};
 
 	Mesh(Material* mat,
@@ -78,6 +80,9 @@ struct LUMIX_RENDERER_API Mesh
 	void setMaterial(Material* material, Model& model, Renderer& renderer);
 
 	bool areIndices16() const { return flags.isSet(Flags::INDICES_16_BIT); }
+	bool isSkinned() const { return flags.isSet(Flags::HAS_SKIN); }
+	// CPU copies (vertices, uvs, indices, skin) are not loaded for models imported without them
+	bool hasCPUData() const { return !vertices.empty(); }
 
 	Type type;
 	Array<u8> indices;
@@ -106,6 +111,7 @@ class LUMIX_RENDERER_API Model LUMIX_FINAL : public Resource
 {
 public:
 	typedef HashMap<u32, int> BoneMap;
+	typedef DelegateList<void(Model&)> LODLoadedCallback;
 
 	enum class Attrs
 	{
@@ -142,10 +148,19 @@ public:
 		SINGLE_VERTEX_DECL,
 		BOUNDING_SHAPES_PRECOMPUTED,
 		MULTIPLE_VERTEX_DECLS,
+		LOD_CHUNKS,
+		OCCLUDER,
 
 		LATEST // keep this last
 	};
 
+	enum class FileFlags : u32
+	{
+		// 1 << 0 is used by old versions for 16bit indices
+		NO_CPU_DATA = 1 << 1,
+		NO_OCCLUSION = 1 << 2
+	};
+
 	enum class LoadingFlags : u32
 	{
 		KEEP_SKIN_DEPRECATED = 1 << 0
@@ -189,6 +204,7 @@ public:
 	{
 		int i = 0;
 		while (squared_distance >= m_lods[i].distance) ++i;
+		if ((m_loaded_lods & (1 << i)) == 0) i = requestLOD(i);
 		return {m_lods[i].from_mesh, m_lods[i].to_mesh};
 	}
 
@@ -200,12 +216,20 @@ public:
 	const Bone& getBone(int i) const { return m_bones[i]; }
 	int getFirstNonrootBoneIndex() const { return m_first_nonroot_bone_index; }
 	BoneMap::iterator getBoneIndex(u32 hash) { return m_bone_map.find(hash); }
+	// unique for each loaded skeleton, tables built from bone indices can be cached by it
+	u32 getSkeletonId() const { return m_skeleton_id; }
 	void getPose(Pose& pose);
 	void getRelativePose(Pose& pose);
 	float getBoundingRadius() const { return m_bounding_radius; }
 	RayCastModelHit castRay(const Vec3& origin, const Vec3& dir, const Matrix& model_transform, const Pose* pose);
 	const AABB& getAABB() const { return m_aabb; }
 	LOD* getLODs() { return m_lods; }
+	bool isLODLoaded(int lod) const { return (m_loaded_lods & (1 << lod)) != 0; }
+	bool isStreamed() const { return m_is_streamed; }
+	LODLoadedCallback& getLODLoadedCallback() { return m_lod_loaded_cb; }
+	bool isOccluder() const { return m_is_occluder; }
+	// simplified mesh rasterized into the occlusion buffer instead of the LOD meshes, nullptr if not imported
+	Mesh* getOccluder() { return m_occluder.vertices.empty() ? nullptr : &m_occluder; }
 	void onBeforeReady() override;
 
 	static void registerLuaAPI(lua_State* L);
@@ -213,8 +237,17 @@ public:
 public:
 	static const u32 FILE_MAGIC = 0x5f4c4d4f; // == '_LMO'
 	static const int MAX_LOD_COUNT = 4;
+	static const u32 ALL_LODS_LOADED = (1 << MAX_LOD_COUNT) - 1;
 
 private:
+	friend class ModelManager;
+
+	struct LODChunk
+	{
+		u32 offset;
+		u32 size;
+	};
+
 	Model(const Model&);
 	void operator=(const Model&);
 
@@ -223,7 +256,15 @@ private:
 	bool parseBones(FS::IFile& file);
 	bool parseMeshes(const bgfx::VertexDecl& global_vertex_decl, FS::IFile& file, FileVersion version, u32 global_flags);
 	bool parseMeshesOld(bgfx::VertexDecl global_vertex_decl, FS::IFile& file, FileVersion version, u32 global_flags);
+	bool parseGeometry(FS::IFile& file, int from_mesh, int to_mesh, bool keep_cpu_data);
 	bool parseLODs(FS::IFile& file);
+	bool parseLODChunks(FS::IFile& file);
+	bool loadLODChunk(FS::IFile& file, int lod);
+	bool parseOccluder(FS::IFile& file);
+	int requestLOD(int lod) const;
+	u32 getMissingLODs() const;
+	void streamLODs();
+	void streamedFileLoaded(FS::IFile& file, bool success);
 	int getBoneIdx(const char* name);
 
 	void unload() override;
@@ -235,11 +276,22 @@ private:
 	Array<Mesh> m_meshes;
 	Array<Bone> m_bones;
 	LOD m_lods[MAX_LOD_COUNT];
+	LODChunk m_lod_chunks[MAX_LOD_COUNT];
+	int m_lod_count;
+	u32 m_loaded_lods;
+	mutable volatile i32 m_requested_lods;
+	bool m_is_streamed;
+	bool m_keep_cpu_data;
+	bool m_is_occluder;
+	Mesh m_occluder;
+	u32 m_streaming_async_op;
+	LODLoadedCallback m_lod_loaded_cb;
 	float m_bounding_radius;
 	BoneMap m_bone_map;
 	AABB m_aabb;
 	FlagSet<LoadingFlags, u32> m_loading_flags;
 	int m_first_nonroot_bone_index;
+	u32 m_skeleton_id;
 };
 
 
@@ -1,11 +1,16 @@
 #include "engine/lumix.h"
 #include "renderer/model_manager.h"
 
+#include "engine/fs/file_system.h"
+#include "engine/profiler.h"
 #include "engine/resource.h"
 #include "renderer/model.h"
 
 namespace Lumix
 {
+	static const int MAX_PENDING_STREAMING_REQUESTS = 4;
+
+
 	Resource* ModelManager::createResource(const Path& path)
 	{
 		return LUMIX_NEW(m_allocator, Model)(path, *this, m_renderer, m_allocator);
@@ -15,4 +20,36 @@ namespace Lumix
 	{
 		LUMIX_DELETE(m_allocator, static_cast<Model*>(&resource));
 	}
+
+	void ModelManager::addStreamedModel(Model& model)
+	{
+		m_streamed_models.push(&model);
+	}
+
+	void ModelManager::removeStreamedModel(Model& model)
+	{
+		m_streamed_models.eraseItemFast(&model);
+		model.m_is_streamed = false;
+	}
+
+	void ModelManager::updateStreaming()
+	{
+		PROFILE_FUNCTION();
+		int pending = 0;
+		for (Model* model : m_streamed_models)
+		{
+			if (model->m_streaming_async_op != FS::FileSystem::INVALID_ASYNC) ++pending;
+		}
+
+		for (Model* model : m_streamed_models)
+		{
+			if (pending >= MAX_PENDING_STREAMING_REQUESTS) break;
+			if (model->m_streaming_async_op != FS::FileSystem::INVALID_ASYNC) continue;
+			if (model->getMissingLODs() == 0) continue;
+
+			model->streamLODs();
+			++pending;
+		}
+		PROFILE_INT("pending model streaming requests", pending);
+	}
 }
\ No newline at end of file
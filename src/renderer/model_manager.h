@@ -1,30 +1,46 @@
 #pragma once
 
+#include "engine/array.h"
 #include "engine/resource_manager_base.h"
 
 namespace Lumix
 {
 
+	class Model;
 	class Renderer;
 
 
 	class LUMIX_RENDERER_API ModelManager LUMIX_FINAL : public ResourceManagerBase
 	{
+	friend class Model;
 	public:
 		ModelManager(Renderer& renderer, IAllocator& allocator)
 			: ResourceManagerBase(allocator)
 			, m_allocator(allocator)
 			, m_renderer(renderer)
+			, m_is_streaming_enabled(false)
+			, m_streamed_models(allocator)
 		{}
 
 		~ModelManager() {}
 
+		void enableStreaming(bool enable) { m_is_streaming_enabled = enable; }
+		bool isStreamingEnabled() const { return m_is_streaming_enabled; }
+		int getStreamedModelsCount() const { return m_streamed_models.size(); }
+		void updateStreaming();
+
 	protected:
 		Resource* createResource(const Path& path) override;
 		void destroyResource(Resource& resource) override;
 
+	private:
+		void addStreamedModel(Model& model);
+		void removeStreamedModel(Model& model);
+
 	private:
 		IAllocator& m_allocator;
 		Renderer& m_renderer;
+		bool m_is_streaming_enabled;
+		Array<Model*> m_streamed_models;
 	};
 }
\ No newline at end of file
@@ -4,12 +4,15 @@
 #include "occlusion_buffer.h"
 #include "engine/array.h"
 #include "engine/geometry.h"
+#include "engine/job_system.h"
 #include "engine/matrix.h"
 #include "engine/math_utils.h"
 #include "engine/profiler.h"
+#include "engine/simd.h"
 #include "engine/universe/universe.h"
 #include "renderer/model.h"
 #include "renderer/render_scene.h"
+#include <algorithm>
 
 
 namespace Lumix
@@ -20,18 +23,89 @@ static const int Z_SCALE = 1 << 30;
 static const int XY_SCALE = 1 << 16;
 static const int WIDTH = 384;
 static const int HEIGHT = 192;
+static const int TILE_SIZE = 64;
+static const int TILES_X = WIDTH / TILE_SIZE;
+static const int TILES_Y = HEIGHT / TILE_SIZE;
+static const int TILES_COUNT = TILES_X * TILES_Y;
+static const int MESHES_PER_JOB = 32;
+
+
+// triangle in pixel coordinates, x and y are scaled by (size - 1), z is in [0, 1]
+struct ScreenTriangle
+{
+	Vec3 v[3];
+};
+
+
+struct BinnedTriangles
+{
+	explicit BinnedTriangles(IAllocator& allocator)
+		: triangles(allocator)
+		, tiles(allocator)
+	{
+		for (int i = 0; i < TILES_COUNT; ++i) tiles.emplace(allocator);
+	}
+
+	void clear()
+	{
+		triangles.clear();
+		for (Array<int>& tile : tiles) tile.clear();
+	}
+
+	Array<ScreenTriangle> triangles;
+	// indices of triangles overlapping each tile
+	Array<Array<int>> tiles;
+};
+
+
+struct OcclusionBuffer::Bin : BinnedTriangles
+{
+	explicit Bin(IAllocator& allocator)
+		: BinnedTriangles(allocator)
+	{
+	}
+
+	OcclusionBuffer* buffer;
+	Universe* universe;
+	const MeshInstance* meshes;
+	int meshes_count;
+};
+
+
+struct OcclusionBuffer::TileJob
+{
+	OcclusionBuffer* buffer;
+	int tile;
+};
 
 
 OcclusionBuffer::OcclusionBuffer(IAllocator& allocator)
 	: m_mips(allocator)
 	, m_allocator(allocator)
+	, m_bins(allocator)
+	, m_bins_count(0)
+{
+}
+
+
+OcclusionBuffer::~OcclusionBuffer()
 {
+	for (Bin* bin : m_bins)
+	{
+		LUMIX_DELETE(m_allocator, bin);
+	}
 }
 
 
 void OcclusionBuffer::setCamera(const Matrix& view, const Matrix& projection)
 {
 	m_view_projection_matrix = projection * view;
+	// how far a point moves in clip space when it moves by one unit in world space
+	const Matrix& m = m_view_projection_matrix;
+	m_clip_scale.x = Vec3(m.m11, m.m21, m.m31).length();
+	m_clip_scale.y = Vec3(m.m12, m.m22, m.m32).length();
+	m_clip_scale.z = Vec3(m.m13, m.m23, m.m33).length();
+	m_clip_scale.w = Vec3(m.m14, m.m24, m.m34).length();
 }
 
 
@@ -107,6 +181,154 @@ bool OcclusionBuffer::isOccluded(const Matrix& world_transform, const AABB& aabb
 }
 
 
+LUMIX_ALIGN_BEGIN(16) struct SphereBatch
+{
+	float x[4];
+	float y[4];
+	float z[4];
+	float radius[4];
+} LUMIX_ALIGN_END(16);
+
+
+LUMIX_ALIGN_BEGIN(16) struct ScreenRects
+{
+	float min_x[4];
+	float min_y[4];
+	float max_x[4];
+	float max_y[4];
+	float z[4];
+	float behind_near[4];
+} LUMIX_ALIGN_END(16);
+
+
+// a sphere's clip space bounds are [c - r * scale, c + r * scale] on each axis, the screen rect is bounded by
+// the corners of the x, w and y, w ranges and the nearest depth is at the smallest w
+static void getScreenRects(const Matrix& mtx, const Vec4& clip_scale, const SphereBatch& spheres, ScreenRects& rects)
+{
+	float4 x = f4Load(spheres.x);
+	float4 y = f4Load(spheres.y);
+	float4 z = f4Load(spheres.z);
+	float4 r = f4Load(spheres.radius);
+
+	auto clip = [&](float a, float b, float c, float d) {
+		float4 res = f4Mul(x, f4Splat(a));
+		res = f4Add(res, f4Mul(y, f4Splat(b)));
+		res = f4Add(res, f4Mul(z, f4Splat(c)));
+		return f4Add(res, f4Splat(d));
+	};
+	float4 cx = clip(mtx.m11, mtx.m21, mtx.m31, mtx.m41);
+	float4 cy = clip(mtx.m12, mtx.m22, mtx.m32, mtx.m42);
+	float4 cz = clip(mtx.m13, mtx.m23, mtx.m33, mtx.m43);
+	float4 cw = clip(mtx.m14, mtx.m24, mtx.m34, mtx.m44);
+
+	float4 rx = f4Mul(r, f4Splat(clip_scale.x));
+	float4 ry = f4Mul(r, f4Splat(clip_scale.y));
+	float4 rw = f4Mul(r, f4Splat(clip_scale.w));
+	float4 w_min = f4Sub(cw, rw);
+	float4 w_max = f4Add(cw, rw);
+	f4Store(rects.behind_near, f4CmpLT(w_min, f4Splat(0.0001f)));
+	// keeps the divisions finite, such spheres are visible anyway
+	w_min = f4Max(w_min, f4Splat(0.0001f));
+	float4 one = f4Splat(1);
+	float4 inv_w_min = f4Div(one, w_min);
+	float4 inv_w_max = f4Div(one, w_max);
+
+	float4 half = f4Splat(0.5f);
+	auto toViewport = [&](float4 v, float size) {
+		return f4Mul(f4Add(f4Mul(v, half), half), f4Splat(size - 1));
+	};
+
+	float4 x0 = f4Sub(cx, rx);
+	float4 x1 = f4Add(cx, rx);
+	float4 min_x = f4Min(f4Mul(x0, inv_w_min), f4Mul(x0, inv_w_max));
+	float4 max_x = f4Max(f4Mul(x1, inv_w_min), f4Mul(x1, inv_w_max));
+	f4Store(rects.min_x, toViewport(min_x, WIDTH));
+	f4Store(rects.max_x, toViewport(max_x, WIDTH));
+
+	float4 y0 = f4Sub(cy, ry);
+	float4 y1 = f4Add(cy, ry);
+	float4 min_y = f4Min(f4Mul(y0, inv_w_min), f4Mul(y0, inv_w_max));
+	float4 max_y = f4Max(f4Mul(y1, inv_w_min), f4Mul(y1, inv_w_max));
+	f4Store(rects.min_y, toViewport(min_y, HEIGHT));
+	f4Store(rects.max_y, toViewport(max_y, HEIGHT));
+
+	float4 near_z = f4Mul(f4Sub(cz, f4Mul(r, f4Splat(clip_scale.z))), inv_w_min);
+	f4Store(rects.z, f4Add(f4Mul(near_z, half), half));
+}
+
+
+// picks the mip where the rect covers at most 2x2 texels, the mips keep the farthest depth so one texel
+// conservatively stands for all the pixels below it
+bool OcclusionBuffer::isRectOccluded(float min_x, float min_y, float max_x, float max_y, float z) const
+{
+	if (max_x < 0 || max_y < 0 || min_x > WIDTH - 1 || min_y > HEIGHT - 1) return false;
+
+	int x0 = Math::maximum(0, int(min_x));
+	int y0 = Math::maximum(0, int(min_y));
+	int x1 = Math::minimum(WIDTH - 1, int(max_x) + 1);
+	int y1 = Math::minimum(HEIGHT - 1, int(max_y) + 1);
+
+	int level = 0;
+	int size = Math::maximum(x1 - x0, y1 - y0);
+	while (size > 1 && level < m_mips.size() - 1)
+	{
+		size >>= 1;
+		++level;
+	}
+	x0 >>= level;
+	y0 >>= level;
+	x1 >>= level;
+	y1 >>= level;
+
+	const int w = WIDTH >> level;
+	const int depth_z = int(z * Z_SCALE);
+	const int* LUMIX_RESTRICT depth = &m_mips[level][0];
+	for (int j = y0; j <= y1; ++j)
+	{
+		for (int i = x0; i <= x1; ++i)
+		{
+			if (depth[i + j * w] > depth_z) return false;
+		}
+	}
+	return true;
+}
+
+
+int OcclusionBuffer::cullOccluded(const Sphere* spheres, int* indices, int count) const
+{
+	if (m_mips.empty()) return count;
+
+	int visible_count = 0;
+	for (int from = 0; from < count; from += 4)
+	{
+		const int batch_size = Math::minimum(4, count - from);
+		SphereBatch batch;
+		for (int i = 0; i < 4; ++i)
+		{
+			const Sphere& sphere = spheres[indices[from + Math::minimum(i, batch_size - 1)]];
+			batch.x[i] = sphere.position.x;
+			batch.y[i] = sphere.position.y;
+			batch.z[i] = sphere.position.z;
+			batch.radius[i] = sphere.radius;
+		}
+
+		ScreenRects rects;
+		getScreenRects(m_view_projection_matrix, m_clip_scale, batch, rects);
+		for (int i = 0; i < batch_size; ++i)
+		{
+			bool is_occluded = rects.behind_near[i] == 0
+				&& isRectOccluded(rects.min_x[i], rects.min_y[i], rects.max_x[i], rects.max_y[i], rects.z[i]);
+			if (!is_occluded)
+			{
+				indices[visible_count] = indices[from + i];
+				++visible_count;
+			}
+		}
+	}
+	return visible_count;
+}
+
+
 void OcclusionBuffer::init()
 {
 	PROFILE_FUNCTION();
@@ -122,24 +344,26 @@ void OcclusionBuffer::init()
 		w >>= 1;
 		h >>= 1;
 	}
+	// each tile builds its part of all mips
+	ASSERT((TILE_SIZE >> (m_mips.size() - 1)) > 0);
 }
 
 
-void OcclusionBuffer::buildHierarchy()
+static void buildTileHierarchy(Array<Array<int>>& mips, int tile_x, int tile_y)
 {
-	// TODO multithreading
-	PROFILE_FUNCTION();
-	for (int level = 1; level < m_mips.size(); ++level)
+	for (int level = 1; level < mips.size(); ++level)
 	{
 		int prev_w = WIDTH >> (level - 1);
 		int w = WIDTH >> level;
-		int h = HEIGHT >> level;
-		for (int j = 0; j < h; ++j)
+		int size = TILE_SIZE >> level;
+		int x = tile_x >> level;
+		int y = tile_y >> level;
+		for (int j = y; j < y + size; ++j)
 		{
 			int prev_j = j << 1;
-			const int* LUMIX_RESTRICT prev_mip = &m_mips[level - 1][prev_j * prev_w];
-			int* LUMIX_RESTRICT mip = &m_mips[level][j * w];
-			int* end = mip + w;
+			const int* LUMIX_RESTRICT prev_mip = &mips[level - 1][prev_j * prev_w + (x << 1)];
+			int* LUMIX_RESTRICT mip = &mips[level][j * w + x];
+			int* end = mip + size;
 			while (mip != end)
 			{
 				*mip = Math::maximum(prev_mip[0], prev_mip[1], prev_mip[prev_w], prev_mip[prev_w + 1]);
@@ -151,79 +375,144 @@ void OcclusionBuffer::buildHierarchy()
 }
 
 
-LUMIX_FORCE_INLINE void rasterizeProjectedTriangle(Vec3(&v)[3], int* depth)
+static void rasterizeTriangle(const ScreenTriangle& triangle, int tile_x, int tile_y, int* LUMIX_RESTRICT depth)
 {
-	Vec3 n = crossProduct(v[1] - v[0], v[2] - v[0]);
-	bool is_backface = n.z <= 0;
-	if (is_backface) return;
+	const Vec3& v0 = triangle.v[0];
+	const Vec3& v1 = triangle.v[1];
+	const Vec3& v2 = triangle.v[2];
+
+	// conservative bounds, pixels outside the triangle are rejected by edge functions
+	int min_x = Math::maximum(tile_x, int(Math::minimum(v0.x, v1.x, v2.x)));
+	int max_x = Math::minimum(tile_x + TILE_SIZE - 1, int(Math::maximum(v0.x, v1.x, v2.x)));
+	int min_y = Math::maximum(tile_y, int(Math::minimum(v0.y, v1.y, v2.y)));
+	int max_y = Math::minimum(tile_y + TILE_SIZE - 1, int(Math::maximum(v0.y, v1.y, v2.y)));
+	if (min_x > max_x || min_y > max_y) return;
+	min_x &= ~3;
+
+	// edge function e(x, y) = a * x + b * y + c is positive inside counter-clockwise triangles
+	float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = -(a0 * v1.x + b0 * v1.y);
+	float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = -(a1 * v2.x + b1 * v2.y);
+	float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = -(a2 * v0.x + b2 * v0.y);
+	float inv_area = 1 / (a0 * v0.x + b0 * v0.y + c0);
+	float za = (a0 * v0.z + a1 * v1.z + a2 * v2.z) * inv_area;
+	float zb = (b0 * v0.z + b1 * v1.z + b2 * v2.z) * inv_area;
+	float zc = (c0 * v0.z + c1 * v1.z + c2 * v2.z) * inv_area;
+
+	static const float LANES[] = { 0, 1, 2, 3 };
+	const float4 lanes = f4LoadUnaligned(LANES);
+	const float4 x_start = f4Add(f4Splat((float)min_x), lanes);
+	const float4 e0_dx = f4Splat(a0 * 4);
+	const float4 e1_dx = f4Splat(a1 * 4);
+	const float4 e2_dx = f4Splat(a2 * 4);
+	const float4 z_dx = f4Splat(za * 4 * Z_SCALE);
+	const float4 z_scale = f4Splat((float)Z_SCALE);
+
+	for (int y = min_y; y <= max_y; ++y)
+	{
+		const float fy = (float)y;
+		float4 e0 = f4Add(f4Mul(f4Splat(a0), x_start), f4Splat(b0 * fy + c0));
+		float4 e1 = f4Add(f4Mul(f4Splat(a1), x_start), f4Splat(b1 * fy + c1));
+		float4 e2 = f4Add(f4Mul(f4Splat(a2), x_start), f4Splat(b2 * fy + c2));
+		float4 z = f4Mul(f4Add(f4Mul(f4Splat(za), x_start), f4Splat(zb * fy + zc)), z_scale);
+		int* LUMIX_RESTRICT row = depth + y * WIDTH;
+		for (int x = min_x; x <= max_x; x += 4)
+		{
+			int outside = f4MoveMask(e0) | f4MoveMask(e1) | f4MoveMask(e2);
+			if (outside != 0xf)
+			{
+				const float* z_lanes = (const float*)&z;
+				for (int i = 0; i < 4; ++i)
+				{
+					if (outside & (1 << i)) continue;
+					int zi = int(z_lanes[i]);
+					if (zi < row[x + i]) row[x + i] = zi;
+				}
+			}
+			e0 = f4Add(e0, e0_dx);
+			e1 = f4Add(e1, e1_dx);
+			e2 = f4Add(e2, e2_dx);
+			z = f4Add(z, z_dx);
+		}
+	}
+}
+
 
-	if (v[0].y > v[2].y) Math::swap(v[0], v[2]);
-	if (v[0].y > v[1].y) Math::swap(v[0], v[1]);
-	if (v[1].y > v[2].y) Math::swap(v[1], v[2]);
+void OcclusionBuffer::rasterizeTile(int tile)
+{
+	int tile_x = (tile % TILES_X) * TILE_SIZE;
+	int tile_y = (tile / TILES_X) * TILE_SIZE;
+	int* depth = &m_mips[0][0];
+	for (int i = 0; i < m_bins_count; ++i)
+	{
+		const Bin& bin = *m_bins[i];
+		for (int triangle_idx : bin.tiles[tile])
+		{
+			rasterizeTriangle(bin.triangles[triangle_idx], tile_x, tile_y, depth);
+		}
+	}
+	buildTileHierarchy(m_mips, tile_x, tile_y);
+}
 
-	int width = WIDTH;
-	int height = HEIGHT;
 
-	struct Point { int x, y; };
-	Point p0 = { int(v[0].x * (width - 1) + 0.5f), int(v[0].y * (height - 1) + 0.5f) };
-	Point p1 = { int(v[1].x * (width - 1) + 0.5f), int(v[1].y * (height - 1) + 0.5f) };
-	Point p2 = { int(v[2].x * (width - 1) + 0.5f), int(v[2].y * (height - 1) + 0.5f) };
+void OcclusionBuffer::rasterizeTileJob(void* data)
+{
+	PROFILE_FUNCTION();
+	TileJob* job = (TileJob*)data;
+	job->buffer->rasterizeTile(job->tile);
+}
 
-	if (p0.y == p2.y) return;
 
-	float xdz = -n.x / n.z;
-	int xdz_int = int(xdz * Z_SCALE / WIDTH);
+void OcclusionBuffer::buildHierarchy()
+{
+	PROFILE_FUNCTION();
+	if (m_mips.empty()) return;
 
-	if (p1.y != p0.y)
+	TileJob tiles[TILES_COUNT];
+	JobSystem::JobDecl jobs[TILES_COUNT];
+	for (int i = 0; i < TILES_COUNT; ++i)
 	{
-		int dl = (p1.x - p0.x) * 2 * XY_SCALE / (2*p1.y - 2*p0.y + 1);
-		int dr = (p2.x - p0.x) * 2 * XY_SCALE / (2*p2.y - 2*p0.y + 1);
-		Vec3 left_p = dl > dr ? v[2] : v[1];
-		int dz_left = int((left_p.z - v[0].z) * Z_SCALE / (left_p.y - (v[0].y + 0.5f / HEIGHT)) / HEIGHT);
-		int z_left = int(v[0].z * Z_SCALE) + (dz_left >> 1);
-		if (dl > dr) Math::swap(dl, dr);
-		int left = p0.x * XY_SCALE + (dl >> 1);
-		int right = p0.x * XY_SCALE + (dr >> 1);
-		for (int y = p0.y; y <= p1.y; ++y)
-		{
-			int base = y * width + left / XY_SCALE;
-			int z = z_left;
-			for (int x = 0, n = right / XY_SCALE - left / XY_SCALE; x <= n; ++x)
-			{
-				if (z < depth[base + x]) depth[base + x] = z;
-				z += xdz_int;
-			}
-			left += dl;
-			right += dr;
-			z_left += dz_left;
-		}
+		tiles[i].buffer = this;
+		tiles[i].tile = i;
+		jobs[i].task = &OcclusionBuffer::rasterizeTileJob;
+		jobs[i].data = &tiles[i];
 	}
-	
-	if (p2.y == p1.y) return;
-
-	int dl = -(p1.x - p2.x) * 2 * XY_SCALE / (2 * p1.y - 2 * p2.y - 1);
-	int dr = -(p0.x - p2.x) * 2 * XY_SCALE / (2 * p0.y - 2 * p2.y - 1);
-	Vec3 left_p = dl > dr ? v[0] : v[1];
-	int dz_left = -int((left_p.z - v[2].z) * Z_SCALE / (left_p.y - (v[2].y - 0.5f / HEIGHT)) / HEIGHT);
-
-	if (dl > dr) Math::swap(dl, dr);
-	int left = p2.x * XY_SCALE + (dl >> 1);
-	int right = p2.x * XY_SCALE + (dr >> 1);
-	int z_left = int(v[2].z * Z_SCALE) + (dz_left >> 1);
-	for (int y = p2.y; y >= p1.y; --y)
+	volatile int counter = 0;
+	JobSystem::runJobs(jobs, TILES_COUNT, &counter);
+	JobSystem::wait(&counter);
+}
+
+
+static void binTriangle(const Vec3 (&v)[3], BinnedTriangles& bin)
+{
+	ScreenTriangle triangle;
+	for (int i = 0; i < 3; ++i)
+	{
+		triangle.v[i].set(v[i].x * (WIDTH - 1), v[i].y * (HEIGHT - 1), v[i].z);
+	}
+	const Vec3& v0 = triangle.v[0];
+	const Vec3& v1 = triangle.v[1];
+	const Vec3& v2 = triangle.v[2];
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	bool is_backface_or_degenerate = area <= 0;
+	if (is_backface_or_degenerate) return;
+
+	float max_x = Math::maximum(v0.x, v1.x, v2.x);
+	float max_y = Math::maximum(v0.y, v1.y, v2.y);
+	if (max_x < 0 || max_y < 0) return;
+	int min_tile_x = Math::maximum(0, int(Math::minimum(v0.x, v1.x, v2.x)) / TILE_SIZE);
+	int min_tile_y = Math::maximum(0, int(Math::minimum(v0.y, v1.y, v2.y)) / TILE_SIZE);
+	int max_tile_x = Math::minimum(TILES_X - 1, int(max_x) / TILE_SIZE);
+	int max_tile_y = Math::minimum(TILES_Y - 1, int(max_y) / TILE_SIZE);
+
+	int triangle_idx = bin.triangles.size();
+	bin.triangles.push(triangle);
+	for (int j = min_tile_y; j <= max_tile_y; ++j)
 	{
-		int base = y * width + left / XY_SCALE;
-		int z = z_left;
-		for (int x = 0, n = right / XY_SCALE - left / XY_SCALE; x <= n; ++x)
+		for (int i = min_tile_x; i <= max_tile_x; ++i)
 		{
-			if (z < depth[base + x]) depth[base + x] = z;
-			z += xdz_int;
+			bin.tiles[i + j * TILES_X].push(triangle_idx);
 		}
-		left += dl;
-		right += dr;
-		z_left += dz_left;
 	}
-
 }
 
 
@@ -292,7 +581,7 @@ static void clipTriangles(const Vec4& plane, Vec4* vertices, bool* triangles, in
 }
 
 
-LUMIX_FORCE_INLINE void rasterizeOccludingTriangle(Vec4 (&vertices)[64 * 3], int* depth)
+LUMIX_FORCE_INLINE void rasterizeOccludingTriangle(Vec4 (&vertices)[64 * 3], BinnedTriangles& bin)
 {
 	enum ClipMask
 	{
@@ -328,7 +617,7 @@ LUMIX_FORCE_INLINE void rasterizeOccludingTriangle(Vec4 (&vertices)[64 * 3], int
 	if (triangle_mask == 0)
 	{
 		Vec3 projected[] = { toViewport(vertices[0]), toViewport(vertices[1]), toViewport(vertices[2]) };
-		rasterizeProjectedTriangle(projected, depth);
+		binTriangle(projected, bin);
 	}
 	else
 	{
@@ -347,14 +636,14 @@ LUMIX_FORCE_INLINE void rasterizeOccludingTriangle(Vec4 (&vertices)[64 * 3], int
 			if (!triangles[i]) continue;
 			int index = i * 3;
 			Vec3 projected[] = { toViewport(vertices[index]), toViewport(vertices[index + 1]), toViewport(vertices[index + 2]) };
-			rasterizeProjectedTriangle(projected, depth);
+			binTriangle(projected, bin);
 		}
 	}
 }
 
 
 template <typename IndexType>
-static void rasterizeOccludingTriangles(const Mesh* mesh, const Matrix& mvp_mtx, int* depth)
+static void rasterizeOccludingTriangles(const Mesh* mesh, const Matrix& mvp_mtx, BinnedTriangles& bin)
 {
 	const Vec3* LUMIX_RESTRICT vertices = &mesh->vertices[0];
 	const IndexType* LUMIX_RESTRICT indices = (const IndexType*)&mesh->indices[0];
@@ -365,35 +654,99 @@ static void rasterizeOccludingTriangles(const Mesh* mesh, const Matrix& mvp_mtx,
 			mvp_mtx * Vec4(vertices[indices[i + 1]], 1),
 			mvp_mtx * Vec4(vertices[indices[i + 2]], 1)
 		};
-		rasterizeOccludingTriangle(v, depth);
+		rasterizeOccludingTriangle(v, bin);
 	}
 }
 
 
-void OcclusionBuffer::rasterize(Universe* universe, const Array<MeshInstance>& meshes)
+void OcclusionBuffer::binJob(void* data)
 {
 	PROFILE_FUNCTION();
-	if (m_mips.empty()) init();
-	int* depth = &m_mips[0][0];
-	for (const MeshInstance& mesh_instance : meshes)
+	Bin& bin = *(Bin*)data;
+	const Matrix& view_projection = bin.buffer->m_view_projection_matrix;
+	for (int i = 0; i < bin.meshes_count; ++i)
 	{
+		const MeshInstance& mesh_instance = bin.meshes[i];
 		const Mesh* mesh = mesh_instance.mesh;
-		Matrix mtx = m_view_projection_matrix * universe->getMatrix(mesh_instance.owner);
+		Matrix mtx = view_projection * bin.universe->getMatrix(mesh_instance.owner);
 		if (mesh->flags.isSet(Mesh::INDICES_16_BIT))
 		{
-			rasterizeOccludingTriangles<u16>(mesh, mtx, depth);
+			rasterizeOccludingTriangles<u16>(mesh, mtx, bin);
 		}
 		else
 		{
-			rasterizeOccludingTriangles<u32>(mesh, mtx, depth);
+			rasterizeOccludingTriangles<u32>(mesh, mtx, bin);
 		}
 	}
 }
 
 
+void OcclusionBuffer::rasterize(Universe* universe, const Array<MeshInstance>& meshes)
+{
+	PROFILE_FUNCTION();
+	if (m_mips.empty()) init();
+
+	static const int MAX_JOBS = 64;
+	JobSystem::JobDecl jobs[MAX_JOBS];
+	int jobs_count = 0;
+	volatile int counter = 0;
+	for (int from = 0; from < meshes.size(); from += MESHES_PER_JOB)
+	{
+		if (m_bins_count == m_bins.size()) m_bins.push(LUMIX_NEW(m_allocator, Bin)(m_allocator));
+		Bin* bin = m_bins[m_bins_count];
+		++m_bins_count;
+		bin->clear();
+		bin->buffer = this;
+		bin->universe = universe;
+		bin->meshes = &meshes[from];
+		bin->meshes_count = Math::minimum(MESHES_PER_JOB, meshes.size() - from);
+		jobs[jobs_count].task = &OcclusionBuffer::binJob;
+		jobs[jobs_count].data = bin;
+		++jobs_count;
+		if (jobs_count == MAX_JOBS)
+		{
+			JobSystem::runJobs(jobs, jobs_count, &counter);
+			jobs_count = 0;
+		}
+	}
+	if (jobs_count > 0) JobSystem::runJobs(jobs, jobs_count, &counter);
+	JobSystem::wait(&counter);
+}
+
+
+int OcclusionBuffer::selectOccluders(Array<OccluderCandidate>& candidates, int triangles_budget, Array<MeshInstance>& occluders)
+{
+	PROFILE_FUNCTION();
+	if (candidates.empty()) return 0;
+
+	// all candidates of an entity have the same screen size, so its duplicates end up next to each other
+	std::sort(candidates.begin(), candidates.end(), [](const OccluderCandidate& a, const OccluderCandidate& b) {
+		if (a.screen_size != b.screen_size) return a.screen_size > b.screen_size;
+		if (a.owner.index != b.owner.index) return a.owner.index < b.owner.index;
+		return a.mesh < b.mesh;
+	});
+
+	int triangles_count = 0;
+	for (int i = 0, c = candidates.size(); i < c; ++i)
+	{
+		const OccluderCandidate& candidate = candidates[i];
+		if (i > 0 && candidates[i - 1].owner == candidate.owner && candidates[i - 1].mesh == candidate.mesh) continue;
+
+		const Mesh* mesh = candidate.mesh;
+		int mesh_triangles = mesh->indices.size() / (mesh->areIndices16() ? sizeof(u16) : sizeof(u32)) / 3;
+		if (triangles_count + mesh_triangles > triangles_budget) continue;
+		triangles_count += mesh_triangles;
+		occluders.push({ candidate.owner, candidate.mesh, candidate.depth });
+	}
+	return triangles_count;
+}
+
+
 void OcclusionBuffer::clear()
 {
 	PROFILE_FUNCTION();
+	if (m_mips.empty()) init();
+	m_bins_count = 0;
 	for (auto& mip : m_mips)
 	{
 		for (int& i : mip)
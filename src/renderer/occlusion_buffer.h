@@ -2,6 +2,7 @@
 
 
 #include "engine/array.h"
+#include "engine/lumix.h"
 #include "engine/matrix.h"
 
 
@@ -14,29 +15,59 @@ struct IAllocator;
 struct Mesh;
 struct MeshInstance;
 struct AABB;
+struct Sphere;
 class Universe;
 
 
 class OcclusionBuffer
 {
+public:
+	struct OccluderCandidate
+	{
+		Entity owner;
+		Mesh* mesh;
+		float depth;
+		float screen_size;
+	};
+
 public:
 	OcclusionBuffer(IAllocator& allocator);
+	~OcclusionBuffer();
 
 	bool isOccluded(const Matrix& world_transform, const AABB& aabb);
+	// tests the spheres at indices against the depth hierarchy, four at once; indices of the hidden ones are removed,
+	// returns the number of the remaining ones
+	int cullOccluded(const Sphere* spheres, int* indices, int count) const;
 	void clear();
 	void setCamera(const Matrix& view, const Matrix& projection);
+	// transforms, clips and bins triangles into screen tiles, in jobs
 	void rasterize(Universe* universe, const Array<MeshInstance>& meshes);
+	// rasterizes the binned triangles and builds the mips, one job per screen tile
 	void buildHierarchy();
 	const int* getMip(int level) { return &m_mips[level][0]; }
+	// sorts the candidates, the biggest on screen first, and takes them until the triangle budget is spent;
+	// a mesh is taken once per entity, a simplified occluder standing in for several meshes of a model is
+	// a candidate for each of them; returns the number of taken triangles
+	static int selectOccluders(Array<OccluderCandidate>& candidates, int triangles_budget, Array<MeshInstance>& occluders);
 
 private:
+	struct Bin;
+	struct TileJob;
+
 	void init();
+	bool isRectOccluded(float min_x, float min_y, float max_x, float max_y, float z) const;
+	void rasterizeTile(int tile);
+	static void binJob(void* data);
+	static void rasterizeTileJob(void* data);
 
 	using Mip = Array<int>;
 
 	IAllocator& m_allocator;
 	Array<Mip> m_mips;
+	Array<Bin*> m_bins;
+	int m_bins_count;
 	Matrix m_view_projection_matrix;
+	Vec4 m_clip_scale;
 };
 
 
@@ -1,6 +1,7 @@
 #include "particle_system.h"
 #include "engine/blob.h"
 #include "engine/crc32.h"
+#include "engine/job_system.h"
 #include "engine/math_utils.h"
 #include "engine/profiler.h"
 #include "engine/reflection.h"
@@ -20,6 +21,12 @@ namespace Lumix
 {
 
 
+static const int PARTICLES_PER_JOB = 1024;
+static const int MAX_UPDATE_JOBS = 32;
+// particles processed by all fused ops of a kernel before moving to the next ones, so they stay in L1
+static const int KERNEL_TILE_SIZE = 64;
+
+
 enum class InstructionArgType : u8
 {
 	CHANNEL,
@@ -49,9 +56,69 @@ enum class Instructions : u8
 };
 
 
+static int getSizeClass(int capacity)
+{
+	int size_class = 0;
+	while ((ParticleChunkAllocator::MIN_CAPACITY << size_class) < capacity) ++size_class;
+	return size_class;
+}
+
+
+ParticleChunkAllocator::ParticleChunkAllocator(int channels_count, IAllocator& allocator)
+	: m_allocator(allocator)
+	, m_channels_count(channels_count)
+	, m_mutex(false)
+{
+	for (void*& free_list : m_free_lists) free_list = nullptr;
+}
+
+
+ParticleChunkAllocator::~ParticleChunkAllocator()
+{
+	for (void* free_list : m_free_lists)
+	{
+		while (free_list)
+		{
+			void* next = *(void**)free_list;
+			m_allocator.deallocate_aligned(free_list);
+			free_list = next;
+		}
+	}
+}
+
+
+float* ParticleChunkAllocator::allocate(int capacity)
+{
+	const int size_class = getSizeClass(capacity);
+	ASSERT(size_class < SIZE_CLASSES_COUNT);
+	ASSERT((MIN_CAPACITY << size_class) == capacity);
+	{
+		MT::SpinLock lock(m_mutex);
+		void* chunk = m_free_lists[size_class];
+		if (chunk)
+		{
+			m_free_lists[size_class] = *(void**)chunk;
+			return (float*)chunk;
+		}
+	}
+	return (float*)m_allocator.allocate_aligned(capacity * m_channels_count * sizeof(float), 16);
+}
+
+
+void ParticleChunkAllocator::deallocate(float* chunk, int capacity)
+{
+	const int size_class = getSizeClass(capacity);
+	MT::SpinLock lock(m_mutex);
+	*(void**)chunk = m_free_lists[size_class];
+	m_free_lists[size_class] = chunk;
+}
+
+
 ScriptedParticleEmitter::ScriptedParticleEmitter(Entity entity, IAllocator& allocator)
 	: m_allocator(allocator)
 	, m_bytecode(allocator)
+	, m_kernel_ops(allocator)
+	, m_kernel_stages(allocator)
 	, m_entity(entity)
 	, m_emit_buffer(allocator)
 {
@@ -305,7 +372,7 @@ void ScriptedParticleEmitter::parseInstruction(const char* instruction, ParseCon
 				else if (tmp[0] == '$')
 				{
 					flags |= ((u8)InstructionArgType::REGISTER) << (i * 2);
-					ctx.current_blob->write(tmp[1] - '0');
+					ctx.current_blob->write(u8(tmp[1] - '0'));
 				}
 				else if ((tmp[0] >= '0' && tmp[0] <= '9') || tmp[0] == '-')
 				{
@@ -469,6 +536,143 @@ void ScriptedParticleEmitter::compile(const char* code)
 	copyMemory(&m_bytecode[0], ctx.update_blob->getData(), ctx.update_blob->getPos());
 	copyMemory(&m_bytecode[m_output_bytecode_offset], output_blob.getData(), output_blob.getPos());
 	copyMemory(&m_bytecode[m_emit_bytecode_offset], emit_blob.getData(), emit_blob.getPos());
+
+	compileKernels();
+}
+
+
+void ScriptedParticleEmitter::compileKernels()
+{
+	m_kernel_ops.clear();
+	m_kernel_stages.clear();
+
+	InputBlob blob(&m_bytecode[0], m_output_bytecode_offset);
+	KernelStage stage = { 0, 0, -1 };
+	auto readArg = [&](u8 flag, int idx) {
+		KernelArg arg;
+		switch ((InstructionArgType)((flag >> (idx * 2)) & 3))
+		{
+			case InstructionArgType::CHANNEL: arg.channel = blob.read<u8>(); break;
+			case InstructionArgType::LITERAL: arg.value = blob.read<float>(); break;
+			case InstructionArgType::CONSTANT:
+			{
+				u8 constant = blob.read<u8>();
+				// time_delta is the only constant which changes after compilation
+				if (constant == 0)
+				{
+					arg.value = 1;
+					arg.times_time_delta = true;
+				}
+				else
+				{
+					arg.value = m_constants[constant].value;
+				}
+				break;
+			}
+			default: ASSERT(false); break;
+		}
+		return arg;
+	};
+	auto isValue = [](const KernelArg& arg) { return arg.channel < 0; };
+	auto pushOp = [&](Instructions opcode, u8 result, KernelArg a, KernelArg b, const KernelArg& c) {
+		if (opcode == Instructions::ADD)
+		{
+			if (isValue(a) && isValue(b) && a.times_time_delta == b.times_time_delta)
+			{
+				a.value += b.value;
+				b = KernelArg();
+			}
+			if (isValue(b) && b.value == 0 && a.channel == result) return;
+			if (stage.ops_count > 0 && isValue(b) && a.channel == result)
+			{
+				KernelOp& prev = m_kernel_ops.back();
+				KernelArg& prev_value = prev.args[1];
+				if (prev.opcode == (u8)Instructions::ADD && prev.result == result && prev.args[0].channel == result &&
+					isValue(prev_value) && prev_value.times_time_delta == b.times_time_delta)
+				{
+					prev_value.value += b.value;
+					return;
+				}
+			}
+		}
+		KernelOp& op = m_kernel_ops.emplace();
+		op.opcode = (u8)opcode;
+		op.result = result;
+		op.args[0] = a;
+		op.args[1] = b;
+		op.args[2] = c;
+		++stage.ops_count;
+	};
+
+	for (;;)
+	{
+		int instruction_offset = blob.getPosition();
+		Instructions instruction = (Instructions)blob.read<u8>();
+		u8 flag = blob.read<u8>();
+		switch (instruction)
+		{
+			case Instructions::END:
+				m_kernel_stages.push(stage);
+				return;
+			case Instructions::LT:
+			{
+				blob.read<u8>();
+				u8 size = blob.read<u8>();
+				blob.skip(size);
+				stage.condition_offset = instruction_offset;
+				m_kernel_stages.push(stage);
+				stage = { m_kernel_ops.size(), 0, -1 };
+				break;
+			}
+			case Instructions::MULTIPLY_ADD:
+			{
+				u8 result = blob.read<u8>();
+				KernelArg a = readArg(flag, 1);
+				KernelArg b = readArg(flag, 2);
+				KernelArg c = readArg(flag, 3);
+				if (isValue(a) && isValue(b) && !(a.times_time_delta && b.times_time_delta))
+				{
+					KernelArg product;
+					product.value = a.value * b.value;
+					product.times_time_delta = a.times_time_delta || b.times_time_delta;
+					pushOp(Instructions::ADD, result, c, product, KernelArg());
+				}
+				else
+				{
+					pushOp(Instructions::MULTIPLY_ADD, result, a, b, c);
+				}
+				break;
+			}
+			case Instructions::ADD:
+			{
+				u8 result = blob.read<u8>();
+				KernelArg a = readArg(flag, 1);
+				KernelArg b = readArg(flag, 2);
+				if (isValue(a)) pushOp(Instructions::ADD, result, b, a, KernelArg());
+				else pushOp(Instructions::ADD, result, a, b, KernelArg());
+				break;
+			}
+			case Instructions::SUB:
+			{
+				u8 result = blob.read<u8>();
+				KernelArg a = readArg(flag, 1);
+				KernelArg b = readArg(flag, 2);
+				if (isValue(b))
+				{
+					b.value = -b.value;
+					pushOp(Instructions::ADD, result, a, b, KernelArg());
+				}
+				else
+				{
+					pushOp(Instructions::SUB, result, a, b, KernelArg());
+				}
+				break;
+			}
+			default:
+				ASSERT(false);
+				return;
+		}
+	}
 }
 
 
@@ -522,138 +726,126 @@ void ScriptedParticleEmitter::execute(InputBlob& blob, int particle_index)
 }
 
 
-void ScriptedParticleEmitter::update(float dt)
+void ScriptedParticleEmitter::runKernel(const KernelStage& stage, float time_delta)
 {
-	PROFILE_FUNCTION();
-	PROFILE_INT("particle count", m_particles_count);
-	if (m_particles_count == 0) return;
+	if (stage.ops_count == 0) return;
 
-	m_emit_buffer.clear();
-	m_constants[0].value = dt;
-	InputBlob blob(&m_bytecode[0], m_bytecode.size());
-
-	for (;;)
+	const KernelOp* ops = &m_kernel_ops[stage.ops_offset];
+	for (int tile = 0; tile < m_particles_count; tile += KERNEL_TILE_SIZE)
 	{
-		u8 instruction = blob.read<u8>();
-		u8 flag = blob.read<u8>();
-		switch ((Instructions)instruction)
+		const int count = (Math::minimum(KERNEL_TILE_SIZE, m_particles_count - tile) + 3) >> 2;
+		for (int op_idx = 0; op_idx < stage.ops_count; ++op_idx)
 		{
-			case Instructions::END:
-				goto end;
-			case Instructions::LT:
+			const KernelOp& op = ops[op_idx];
+			// values are read through a zero stride, so all arg combinations share one loop per opcode
+			float4 values[3];
+			const float4* args[3];
+			int strides[3];
+			for (int i = 0; i < 3; ++i)
 			{
-				ASSERT(((flag >> 0) & 3) == (u8)InstructionArgType::CHANNEL);
-				u8 ch = blob.read<u8>();
-				u8 size = blob.read<u8>();
-				const float4* iter = (float4*)m_channels[ch].data;
-				const float4* end = iter + ((m_particles_count + 3) >> 2);
-				InputBlob subblob((u8*)blob.getData() + blob.getPosition(), blob.getSize() - blob.getPosition());
-				for (; iter != end; ++iter)
+				const KernelArg& arg = op.args[i];
+				if (arg.channel >= 0)
 				{
-					int m = f4MoveMask(*iter);
-					if (m) 
-					{
-						for (int i = 0; i < 4; ++i)
-						{
-							float f = *((float*)iter + i);
-							if (f < 0)
-							{
-								subblob.rewind();
-								execute(subblob, int(((float*)iter - m_channels[ch].data) + i));
-							}
-						}
-					}
+					args[i] = (const float4*)(m_channels[arg.channel].data + tile);
+					strides[i] = 1;
 				}
-				blob.skip(size);
-				break;
-			}
-			case Instructions::MULTIPLY_ADD:
-			{
-				ASSERT(((flag >> 0) & 3) == (u8)InstructionArgType::CHANNEL);
-				ASSERT(((flag >> 2) & 3) == (u8)InstructionArgType::CHANNEL);
-				ASSERT(((flag >> 4) & 3) == (u8)InstructionArgType::CONSTANT);
-				ASSERT(((flag >> 6) & 3) == (u8)InstructionArgType::CHANNEL);
-				u8 result_channel_idx = blob.read<u8>();
-				u8 multiply_channel_idx = blob.read<u8>();
-				u8 constant_index = blob.read<u8>();
-				u8 add_channel_idx = blob.read<u8>();
-
-				float4* result = (float4*)m_channels[result_channel_idx].data;
-				const float4* end = result + ((m_particles_count + 3) >> 2);
-				const float4* multiply = (float4*)m_channels[multiply_channel_idx].data;
-				const float4* add = (float4*)m_channels[add_channel_idx].data;
-				const float4 constant = f4Splat(m_constants[constant_index].value);
-				for (; result != end; ++result, ++multiply, ++add)
+				else
 				{
-					float4 r = f4Mul(*multiply, constant);
-					*result = f4Add(r, *add);
+					values[i] = f4Splat(arg.times_time_delta ? arg.value * time_delta : arg.value);
+					args[i] = &values[i];
+					strides[i] = 0;
 				}
-				break;
 			}
-			case Instructions::ADD:
+
+			float4* result = (float4*)(m_channels[op.result].data + tile);
+			switch ((Instructions)op.opcode)
 			{
-				ASSERT(((flag >> 0) & 3) == (u8)InstructionArgType::CHANNEL);
-				ASSERT(((flag >> 2) & 3) == (u8)InstructionArgType::CHANNEL);
-				u8 result_channel_idx = blob.read<u8>();
-				u8 op1_index = blob.read<u8>();
-
-				float4* result = (float4*)m_channels[result_channel_idx].data;
-				const float4* end = result + ((m_particles_count + 3) >> 2);
-				const float4* op1 = (float4*)m_channels[op1_index].data;
-				u8 op2_index = blob.read<u8>();
-				if (((flag >> 4) & 0x3) == (u8)InstructionArgType::CONSTANT)
-				{
-					const float4 constant = f4Splat(m_constants[op2_index].value);
-					for (; result != end; ++result, ++op1)
+				case Instructions::ADD:
+					for (int i = 0; i < count; ++i)
 					{
-						*result = f4Add(*op1, constant);
+						result[i] = f4Add(args[0][i * strides[0]], args[1][i * strides[1]]);
 					}
-				}
-				else
-				{
-					const float4* op2 = (float4*)m_channels[op2_index].data;
-					for (; result != end; ++result, ++op1, ++op2)
+					break;
+				case Instructions::SUB:
+					for (int i = 0; i < count; ++i)
 					{
-						*result = f4Add(*op1, *op2);
+						result[i] = f4Sub(args[0][i * strides[0]], args[1][i * strides[1]]);
 					}
-				}
-				break;
+					break;
+				case Instructions::MULTIPLY_ADD:
+					for (int i = 0; i < count; ++i)
+					{
+						float4 r = f4Mul(args[0][i * strides[0]], args[1][i * strides[1]]);
+						result[i] = f4Add(r, args[2][i * strides[2]]);
+					}
+					break;
+				default:
+					ASSERT(false);
+					break;
 			}
-			case Instructions::SUB:
+		}
+	}
+}
+
+
+void ScriptedParticleEmitter::runCondition(InputBlob& blob)
+{
+	u8 instruction = blob.read<u8>();
+	u8 flag = blob.read<u8>();
+	ASSERT((Instructions)instruction == Instructions::LT);
+	ASSERT(((flag >> 0) & 3) == (u8)InstructionArgType::CHANNEL);
+	u8 ch = blob.read<u8>();
+	u8 size = blob.read<u8>();
+	const float4* iter = (float4*)m_channels[ch].data;
+	const float4* end = iter + ((m_particles_count + 3) >> 2);
+	InputBlob subblob((u8*)blob.getData() + blob.getPosition(), size);
+	for (; iter != end; ++iter)
+	{
+		int m = f4MoveMask(*iter);
+		if (m) 
+		{
+			for (int i = 0; i < 4; ++i)
 			{
-				ASSERT(((flag >> 0) & 3) == (u8)InstructionArgType::CHANNEL);
-				ASSERT(((flag >> 2) & 3) == (u8)InstructionArgType::CHANNEL);
-				ASSERT(((flag >> 4) & 3) == (u8)InstructionArgType::CONSTANT);
-				u8 result_channel_idx = blob.read<u8>();
-				u8 op1_channel_idx = blob.read<u8>();
-				u8 constant_index = blob.read<u8>();
-
-				float4* result = (float4*)m_channels[result_channel_idx].data;
-				const float4* end = result + ((m_particles_count + 3) >> 2);
-				const float4* multiply = (float4*)m_channels[op1_channel_idx].data;
-				const float4 constant = f4Splat(m_constants[constant_index].value);
-				for (; result != end; ++result, ++multiply)
+				float f = *((float*)iter + i);
+				if (f < 0)
 				{
-					*result = f4Sub(*multiply, constant);
+					subblob.rewind();
+					execute(subblob, int(((float*)iter - m_channels[ch].data) + i));
 				}
-				break;
 			}
-			default:
-				ASSERT(false);
-				break;
 		}
 	}
+}
+
 
-	end:
-		InputBlob emit_buffer(m_emit_buffer);
-		while (emit_buffer.getPosition() < emit_buffer.getSize())
+void ScriptedParticleEmitter::update(float dt)
+{
+	PROFILE_FUNCTION();
+	PROFILE_INT("particle count", m_particles_count);
+	if (m_particles_count == 0) return;
+
+	m_emit_buffer.clear();
+	m_constants[0].value = dt;
+
+	for (const KernelStage& stage : m_kernel_stages)
+	{
+		runKernel(stage, dt);
+		if (stage.condition_offset >= 0)
 		{
-			u8 count = emit_buffer.read<u8>();
-			float args[16];
-			ASSERT(count <= lengthOf(args));
-			emit_buffer.read(args, sizeof(args[0]) * count);
-			emit(args);
+			InputBlob blob(&m_bytecode[stage.condition_offset], m_output_bytecode_offset - stage.condition_offset);
+			runCondition(blob);
 		}
+	}
+
+	InputBlob emit_buffer(m_emit_buffer);
+	while (emit_buffer.getPosition() < emit_buffer.getSize())
+	{
+		u8 count = emit_buffer.read<u8>();
+		float args[16];
+		ASSERT(count <= lengthOf(args));
+		emit_buffer.read(args, sizeof(args[0]) * count);
+		emit(args);
+	}
 }
 
 
@@ -803,14 +995,19 @@ void ParticleEmitter::ForceModule::deserialize(InputBlob& blob)
 }
 
 
-void ParticleEmitter::ForceModule::update(float time_delta)
+void ParticleEmitter::ForceModule::update(float time_delta, int from, int to)
 {
-	if (m_emitter.m_velocity.empty()) return;
-
-	Vec3* LUMIX_RESTRICT particle_velocity = &m_emitter.m_velocity[0];
-	for (int i = 0, c = m_emitter.m_velocity.size(); i < c; ++i)
+	float* LUMIX_RESTRICT vel_x = m_emitter.getChannel(VELOCITY_X);
+	float* LUMIX_RESTRICT vel_y = m_emitter.getChannel(VELOCITY_Y);
+	float* LUMIX_RESTRICT vel_z = m_emitter.getChannel(VELOCITY_Z);
+	const float4 dx = f4Splat(m_acceleration.x * time_delta);
+	const float4 dy = f4Splat(m_acceleration.y * time_delta);
+	const float4 dz = f4Splat(m_acceleration.z * time_delta);
+	for (int i = from; i < to; i += 4)
 	{
-		particle_velocity[i] += m_acceleration * time_delta;
+		f4Store(vel_x + i, f4Add(f4Load(vel_x + i), dx));
+		f4Store(vel_y + i, f4Add(f4Load(vel_y + i), dy));
+		f4Store(vel_z + i, f4Add(f4Load(vel_z + i), dz));
 	}
 }
 
@@ -832,6 +1029,7 @@ ParticleEmitter::AttractorModule::AttractorModule(ParticleEmitter& emitter)
 	, m_force(0)
 {
 	m_count = 0;
+	m_positions_count = 0;
 	for(auto& e : m_entities)
 	{
 		e = INVALID_ENTITY;
@@ -848,26 +1046,50 @@ void ParticleEmitter::AttractorModule::drawGizmo(WorldEditor& editor, RenderScen
 }
 
 
-void ParticleEmitter::AttractorModule::update(float time_delta)
+void ParticleEmitter::AttractorModule::prepareUpdate()
 {
-	if(m_emitter.m_alpha.empty()) return;
-
-	Vec3* LUMIX_RESTRICT particle_pos = &m_emitter.m_position[0];
-	Vec3* LUMIX_RESTRICT particle_vel = &m_emitter.m_velocity[0];
-
-	for(int i = 0; i < m_count; ++i)
+	m_positions_count = 0;
+	for (int i = 0; i < m_count; ++i)
 	{
 		auto entity = m_entities[i];
-		if(entity == INVALID_ENTITY) continue;
+		if (entity == INVALID_ENTITY) continue;
 		if (!m_emitter.m_universe.hasEntity(entity)) continue;
-		Vec3 pos = m_emitter.m_universe.getPosition(entity);
+		m_positions[m_positions_count] = m_emitter.m_universe.getPosition(entity);
+		++m_positions_count;
+	}
+}
+
 
-		for(int i = m_emitter.m_position.size() - 1; i >= 0; --i)
+void ParticleEmitter::AttractorModule::update(float time_delta, int from, int to)
+{
+	const float* LUMIX_RESTRICT pos_x = m_emitter.getChannel(POSITION_X);
+	const float* LUMIX_RESTRICT pos_y = m_emitter.getChannel(POSITION_Y);
+	const float* LUMIX_RESTRICT pos_z = m_emitter.getChannel(POSITION_Z);
+	float* LUMIX_RESTRICT vel_x = m_emitter.getChannel(VELOCITY_X);
+	float* LUMIX_RESTRICT vel_y = m_emitter.getChannel(VELOCITY_Y);
+	float* LUMIX_RESTRICT vel_z = m_emitter.getChannel(VELOCITY_Z);
+	const float4 force = f4Splat(m_force * time_delta);
+	const float4 min_dist2 = f4Splat(0.0001f);
+
+	for (int j = 0; j < m_positions_count; ++j)
+	{
+		const float4 center_x = f4Splat(m_positions[j].x);
+		const float4 center_y = f4Splat(m_positions[j].y);
+		const float4 center_z = f4Splat(m_positions[j].z);
+
+		for (int i = from; i < to; i += 4)
 		{
-			Vec3 to_center = pos - particle_pos[i];
-			float dist2 = to_center.squaredLength();
-			to_center *= 1 / sqrt(dist2);
-			particle_vel[i] = particle_vel[i] + to_center * (m_force / dist2) * time_delta;
+			const float4 to_center_x = f4Sub(center_x, f4Load(pos_x + i));
+			const float4 to_center_y = f4Sub(center_y, f4Load(pos_y + i));
+			const float4 to_center_z = f4Sub(center_z, f4Load(pos_z + i));
+			// clamped, a particle exactly at the center would divide by zero
+			const float4 dist2 = f4Max(f4Add(f4Add(f4Mul(to_center_x, to_center_x), f4Mul(to_center_y, to_center_y)),
+				f4Mul(to_center_z, to_center_z)), min_dist2);
+			// normalize(to_center) * force / dist2
+			const float4 k = f4Div(force, f4Mul(dist2, f4Sqrt(dist2)));
+			f4Store(vel_x + i, f4Add(f4Load(vel_x + i), f4Mul(to_center_x, k)));
+			f4Store(vel_y + i, f4Add(f4Load(vel_y + i), f4Mul(to_center_y, k)));
+			f4Store(vel_z + i, f4Add(f4Load(vel_z + i), f4Mul(to_center_z, k)));
 		}
 	}
 }
@@ -904,6 +1126,7 @@ ParticleEmitter::PlaneModule::PlaneModule(ParticleEmitter& emitter)
 	, m_bounce(0.5f)
 {
 	m_count = 0;
+	m_planes_count = 0;
 	for (auto& e : m_entities)
 	{
 		e = INVALID_ENTITY;
@@ -936,13 +1159,9 @@ void ParticleEmitter::PlaneModule::drawGizmo(WorldEditor& editor, RenderScene& s
 }
 
 
-void ParticleEmitter::PlaneModule::update(float time_delta)
+void ParticleEmitter::PlaneModule::prepareUpdate()
 {
-	if (m_emitter.m_alpha.empty()) return;
-
-	Vec3* LUMIX_RESTRICT particle_pos = &m_emitter.m_position[0];
-	Vec3* LUMIX_RESTRICT particle_vel = &m_emitter.m_velocity[0];
-
+	m_planes_count = 0;
 	for (int i = 0; i < m_count; ++i)
 	{
 		auto entity = m_entities[i];
@@ -950,15 +1169,47 @@ void ParticleEmitter::PlaneModule::update(float time_delta)
 		if (!m_emitter.m_universe.hasEntity(entity)) continue;
 		Vec3 normal = m_emitter.m_universe.getRotation(entity).rotate(Vec3(0, 1, 0));
 		float D = -dotProduct(normal, m_emitter.m_universe.getPosition(entity));
+		m_planes[m_planes_count].set(normal, D);
+		++m_planes_count;
+	}
+}
+
+
+void ParticleEmitter::PlaneModule::update(float time_delta, int from, int to)
+{
+	const float* LUMIX_RESTRICT pos_x = m_emitter.getChannel(POSITION_X);
+	const float* LUMIX_RESTRICT pos_y = m_emitter.getChannel(POSITION_Y);
+	const float* LUMIX_RESTRICT pos_z = m_emitter.getChannel(POSITION_Z);
+	float* LUMIX_RESTRICT vel_x = m_emitter.getChannel(VELOCITY_X);
+	float* LUMIX_RESTRICT vel_y = m_emitter.getChannel(VELOCITY_Y);
+	float* LUMIX_RESTRICT vel_z = m_emitter.getChannel(VELOCITY_Z);
+	const float4 zero = f4Splat(0);
+	const float4 bounce = f4Splat(m_bounce);
 
-		for (int i = m_emitter.m_position.size() - 1; i >= 0; --i)
+	for (int j = 0; j < m_planes_count; ++j)
+	{
+		const float4 normal_x = f4Splat(m_planes[j].x);
+		const float4 normal_y = f4Splat(m_planes[j].y);
+		const float4 normal_z = f4Splat(m_planes[j].z);
+		const float4 D = f4Splat(m_planes[j].w);
+
+		for (int i = from; i < to; i += 4)
 		{
-			const auto& pos = particle_pos[i];
-			if (dotProduct(normal, pos) + D < 0)
-			{
-				float NdotV = dotProduct(normal, particle_vel[i]);
-				particle_vel[i] = (particle_vel[i] - normal * (2 * NdotV)) * m_bounce;
-			}
+			const float4 dist = f4Add(f4Add(f4Mul(normal_x, f4Load(pos_x + i)), f4Mul(normal_y, f4Load(pos_y + i))),
+				f4Add(f4Mul(normal_z, f4Load(pos_z + i)), D));
+			const float4 mask = f4CmpLT(dist, zero);
+			if (f4MoveMask(mask) == 0) continue;
+
+			const float4 vx = f4Load(vel_x + i);
+			const float4 vy = f4Load(vel_y + i);
+			const float4 vz = f4Load(vel_z + i);
+			const float4 NdotV2 = f4Mul(f4Add(f4Add(f4Mul(normal_x, vx), f4Mul(normal_y, vy)), f4Mul(normal_z, vz)), f4Splat(2));
+			const float4 reflected_x = f4Mul(f4Sub(vx, f4Mul(normal_x, NdotV2)), bounce);
+			const float4 reflected_y = f4Mul(f4Sub(vy, f4Mul(normal_y, NdotV2)), bounce);
+			const float4 reflected_z = f4Mul(f4Sub(vz, f4Mul(normal_z, NdotV2)), bounce);
+			f4Store(vel_x + i, f4Blend(vx, reflected_x, mask));
+			f4Store(vel_y + i, f4Blend(vy, reflected_y, mask));
+			f4Store(vel_z + i, f4Blend(vz, reflected_z, mask));
 		}
 	}
 }
@@ -1009,7 +1260,9 @@ void ParticleEmitter::SpawnShapeModule::spawnParticle(int index)
 
 		if (v.squaredLength() < r2)
 		{
-			m_emitter.m_position[index] += v;
+			m_emitter.getChannel(POSITION_X)[index] += v.x;
+			m_emitter.getChannel(POSITION_Y)[index] += v.y;
+			m_emitter.getChannel(POSITION_Z)[index] += v.z;
 			return;
 		}
 	}
@@ -1042,12 +1295,14 @@ ParticleEmitter::LinearMovementModule::LinearMovementModule(ParticleEmitter& emi
 
 void ParticleEmitter::LinearMovementModule::spawnParticle(int index)
 {
-	Vec3& velocity = m_emitter.m_velocity[index];
+	Vec3 velocity;
 	velocity.x = m_x.getRandom();
 	velocity.y = m_y.getRandom();
 	velocity.z = m_z.getRandom();
-	Quat rot = m_emitter.m_universe.getRotation(m_emitter.m_entity);
-	velocity = rot.rotate(velocity);
+	velocity = m_emitter.m_entity_rotation.rotate(velocity);
+	m_emitter.getChannel(VELOCITY_X)[index] = velocity.x;
+	m_emitter.getChannel(VELOCITY_Y)[index] = velocity.y;
+	m_emitter.getChannel(VELOCITY_Z)[index] = velocity.z;
 }
 
 
@@ -1148,21 +1403,20 @@ void ParticleEmitter::AlphaModule::sample()
 }
 
 
-void ParticleEmitter::AlphaModule::update(float)
+void ParticleEmitter::AlphaModule::update(float, int from, int to)
 {
-	if(m_emitter.m_alpha.empty()) return;
-
-	float* LUMIX_RESTRICT particle_alpha = &m_emitter.m_alpha[0];
-	float* LUMIX_RESTRICT rel_life = &m_emitter.m_rel_life[0];
+	float* LUMIX_RESTRICT particle_alpha = m_emitter.getChannel(ALPHA);
+	const float* LUMIX_RESTRICT rel_life = m_emitter.getChannel(REL_LIFE);
+	const float* LUMIX_RESTRICT sampled = &m_sampled[0];
 	int size = m_sampled.size() - 1;
 	float float_size = (float)size;
-	for(int i = 0, c = m_emitter.m_size.size(); i < c; ++i)
+	for (int i = from; i < to; ++i)
 	{
-		float float_idx = float_size * rel_life[i];
+		float float_idx = float_size * Math::minimum(rel_life[i], 1.0f);
 		int idx = (int)float_idx;
 		int next_idx = Math::minimum(idx + 1, size);
 		float w = float_idx - idx;
-		particle_alpha[i] = m_sampled[idx] * (1 - w) + m_sampled[next_idx] * w;
+		particle_alpha[i] = sampled[idx] * (1 - w) + sampled[next_idx] * w;
 	}
 }
 
@@ -1212,22 +1466,20 @@ void ParticleEmitter::SizeModule::sample()
 }
 
 
-void ParticleEmitter::SizeModule::update(float)
+void ParticleEmitter::SizeModule::update(float, int from, int to)
 {
-	if (m_emitter.m_size.empty()) return;
-
-	float* LUMIX_RESTRICT particle_size = &m_emitter.m_size[0];
-	float* LUMIX_RESTRICT rel_life = &m_emitter.m_rel_life[0];
+	float* LUMIX_RESTRICT particle_size = m_emitter.getChannel(SIZE);
+	const float* LUMIX_RESTRICT rel_life = m_emitter.getChannel(REL_LIFE);
+	const float* LUMIX_RESTRICT sampled = &m_sampled[0];
 	int size = m_sampled.size() - 1;
 	float float_size = (float)size;
-	for (int i = 0, c = m_emitter.m_size.size(); i < c; ++i)
+	for (int i = from; i < to; ++i)
 	{
-		float float_idx = float_size * rel_life[i];
+		float float_idx = float_size * Math::minimum(rel_life[i], 1.0f);
 		int idx = (int)float_idx;
 		int next_idx = Math::minimum(idx + 1, size);
 		float w = float_idx - idx;
-		particle_size[i] = m_sampled[idx] * (1 - w) + m_sampled[next_idx] * w;
-		PROFILE_INT("Test", int(particle_size[i] * 1000));
+		particle_size[i] = sampled[idx] * (1 - w) + sampled[next_idx] * w;
 	}
 }
 
@@ -1243,7 +1495,7 @@ ParticleEmitter::RandomRotationModule::RandomRotationModule(ParticleEmitter& emi
 
 void ParticleEmitter::RandomRotationModule::spawnParticle(int index)
 {
-	m_emitter.m_rotation[index] = Math::randFloat(0, Math::PI * 2);
+	m_emitter.getChannel(ROTATION)[index] = Math::randFloat(0, Math::PI * 2);
 }
 
 
@@ -1290,22 +1542,21 @@ float Interval::getRandom() const
 }
 
 
-ParticleEmitter::ParticleEmitter(Entity entity, Universe& universe, IAllocator& allocator)
+ParticleEmitter::ParticleEmitter(Entity entity,
+	Universe& universe,
+	ParticleChunkAllocator& chunk_allocator,
+	IAllocator& allocator)
 	: m_allocator(allocator)
-	, m_rel_life(allocator)
-	, m_life(allocator)
 	, m_modules(allocator)
-	, m_position(allocator)
-	, m_velocity(allocator)
-	, m_rotation(allocator)
-	, m_rotational_speed(allocator)
-	, m_alpha(allocator)
 	, m_universe(universe)
 	, m_entity(entity)
-	, m_size(allocator)
 	, m_subimage_module(nullptr)
 	, m_autoemit(true)
 	, m_local_space(false)
+	, m_chunk_allocator(chunk_allocator)
+	, m_pool(nullptr)
+	, m_capacity(0)
+	, m_particles_count(0)
 {
 	init();
 }
@@ -1319,6 +1570,7 @@ ParticleEmitter::~ParticleEmitter()
 	{
 		LUMIX_DELETE(m_allocator, module);
 	}
+	if (m_pool) m_chunk_allocator.deallocate(m_pool, m_capacity);
 }
 
 
@@ -1333,19 +1585,25 @@ void ParticleEmitter::init()
 	m_material = nullptr;
 	m_next_spawn_time = 0;
 	m_is_valid = true;
+	m_entity_position.set(0, 0, 0);
+	m_entity_rotation.set(0, 0, 0, 1);
+}
+
+
+void ParticleEmitter::prepareUpdate()
+{
+	m_entity_position = m_universe.getPosition(m_entity);
+	m_entity_rotation = m_universe.getRotation(m_entity);
+	for (auto* module : m_modules)
+	{
+		module->prepareUpdate();
+	}
 }
 
 
 void ParticleEmitter::reset()
 {
-	m_rel_life.clear();
-	m_life.clear();
-	m_size.clear();
-	m_position.clear();
-	m_velocity.clear();
-	m_alpha.clear();
-	m_rotation.clear();
-	m_rotational_speed.clear();
+	m_particles_count = 0;
 }
 
 
@@ -1359,26 +1617,45 @@ void ParticleEmitter::setMaterial(Material* material)
 }
 
 
-void ParticleEmitter::spawnParticle()
+void ParticleEmitter::grow()
 {
-	if (m_local_space)
-	{
-		m_position.emplace(0.0f, 0.0f, 0.0f);
-	}
-	else
+	const int new_capacity = Math::maximum(ParticleChunkAllocator::MIN_CAPACITY, m_capacity << 1);
+	float* new_pool = m_chunk_allocator.allocate(new_capacity);
+	if (m_pool)
 	{
-		m_position.push(m_universe.getPosition(m_entity));
+		for (int i = 0; i < CHANNELS_COUNT; ++i)
+		{
+			copyMemory(new_pool + i * new_capacity, m_pool + i * m_capacity, m_particles_count * sizeof(float));
+		}
+		m_chunk_allocator.deallocate(m_pool, m_capacity);
 	}
-	m_rotation.push(0);
-	m_rotational_speed.push(0);
-	m_life.push(m_initial_life.getRandom());
-	m_rel_life.push(0.0f);
-	m_alpha.push(1);
-	m_velocity.push(Vec3(0, 0, 0));
-	m_size.push(m_initial_size.getRandom());
+	m_pool = new_pool;
+	m_capacity = new_capacity;
+}
+
+
+void ParticleEmitter::spawnParticle()
+{
+	if (m_particles_count == m_capacity) grow();
+
+	const int index = m_particles_count;
+	++m_particles_count;
+	const Vec3 pos = m_local_space ? Vec3(0, 0, 0) : m_entity_position;
+	getChannel(POSITION_X)[index] = pos.x;
+	getChannel(POSITION_Y)[index] = pos.y;
+	getChannel(POSITION_Z)[index] = pos.z;
+	getChannel(VELOCITY_X)[index] = 0;
+	getChannel(VELOCITY_Y)[index] = 0;
+	getChannel(VELOCITY_Z)[index] = 0;
+	getChannel(LIFE)[index] = m_initial_life.getRandom();
+	getChannel(REL_LIFE)[index] = 0;
+	getChannel(SIZE)[index] = m_initial_size.getRandom();
+	getChannel(ALPHA)[index] = 1;
+	getChannel(ROTATION)[index] = 0;
+	getChannel(ROTATIONAL_SPEED)[index] = 0;
 	for (auto* module : m_modules)
 	{
-		module->spawnParticle(m_life.size() - 1);
+		module->spawnParticle(index);
 	}
 }
 
@@ -1400,37 +1677,45 @@ void ParticleEmitter::addModule(ModuleBase* module)
 }
 
 
-void ParticleEmitter::destroyParticle(int index)
-{
-	for (auto* module : m_modules)
-	{
-		module->destoryParticle(index);
-	}
-	m_life.eraseFast(index);
-	m_rel_life.eraseFast(index);
-	m_position.eraseFast(index);
-	m_velocity.eraseFast(index);
-	m_rotation.eraseFast(index);
-	m_rotational_speed.eraseFast(index);
-	m_alpha.eraseFast(index);
-	m_size.eraseFast(index);
-}
 
 
 void ParticleEmitter::updateLives(float time_delta)
 {
-	for (int i = 0, c = m_rel_life.size(); i < c; ++i)
+	float* LUMIX_RESTRICT rel_life = getChannel(REL_LIFE);
+	const float* LUMIX_RESTRICT life = getChannel(LIFE);
+	for (int i = 0; i < m_particles_count; ++i)
+	{
+		rel_life[i] += time_delta / life[i];
+	}
+
+	// remove dead particles in a single pass, living ones keep their order
+	int alive_count = 0;
+	for (int i = 0; i < m_particles_count; ++i)
 	{
-		float rel_life = m_rel_life[i];
-		rel_life += time_delta / m_life[i];
-		m_rel_life[i] = rel_life;
+		if (rel_life[i] > 1) continue;
 
-		if (rel_life > 1)
+		if (alive_count != i)
 		{
-			destroyParticle(i);
-			--i;
-			--c;
+			for (int j = 0; j < CHANNELS_COUNT; ++j)
+			{
+				float* channel = m_pool + j * m_capacity;
+				channel[alive_count] = channel[i];
+			}
 		}
+		++alive_count;
+	}
+	m_particles_count = alive_count;
+}
+
+
+void ParticleEmitter::clearTailLanes()
+{
+	const int end = (m_particles_count + 3) & ~3;
+	if (end == m_particles_count) return;
+
+	for (int i = 0; i < CHANNELS_COUNT; ++i)
+	{
+		setMemory(m_pool + i * m_capacity + m_particles_count, 0, (end - m_particles_count) * sizeof(float));
 	}
 }
 
@@ -1492,38 +1777,85 @@ void ParticleEmitter::deserialize(InputBlob& blob, ResourceManager& manager)
 }
 
 
-void ParticleEmitter::updatePositions(float time_delta)
+void ParticleEmitter::updateParticles(float time_delta, int from, int to)
 {
-	for (int i = 0, c = m_position.size(); i < c; ++i)
+	float* LUMIX_RESTRICT pos_x = getChannel(POSITION_X);
+	float* LUMIX_RESTRICT pos_y = getChannel(POSITION_Y);
+	float* LUMIX_RESTRICT pos_z = getChannel(POSITION_Z);
+	const float* LUMIX_RESTRICT vel_x = getChannel(VELOCITY_X);
+	const float* LUMIX_RESTRICT vel_y = getChannel(VELOCITY_Y);
+	const float* LUMIX_RESTRICT vel_z = getChannel(VELOCITY_Z);
+	float* LUMIX_RESTRICT rotation = getChannel(ROTATION);
+	const float* LUMIX_RESTRICT rotational_speed = getChannel(ROTATIONAL_SPEED);
+	const float4 td = f4Splat(time_delta);
+	for (int i = from; i < to; i += 4)
 	{
-		m_position[i] += m_velocity[i] * time_delta;
+		f4Store(pos_x + i, f4Add(f4Load(pos_x + i), f4Mul(f4Load(vel_x + i), td)));
+		f4Store(pos_y + i, f4Add(f4Load(pos_y + i), f4Mul(f4Load(vel_y + i), td)));
+		f4Store(pos_z + i, f4Add(f4Load(pos_z + i), f4Mul(f4Load(vel_z + i), td)));
+		f4Store(rotation + i, f4Add(f4Load(rotation + i), f4Mul(f4Load(rotational_speed + i), td)));
+	}
+	for (auto* module : m_modules)
+	{
+		module->update(time_delta, from, to);
 	}
 }
 
 
-void ParticleEmitter::updateRotations(float time_delta)
+void ParticleEmitter::updateParticlesJob(void* data)
 {
-	for (int i = 0, c = m_rotation.size(); i < c; ++i)
-	{
-		m_rotation[i] += m_rotational_speed[i] * time_delta;
-	}
+	UpdateJob* job = (UpdateJob*)data;
+	job->emitter->updateParticles(job->time_delta, job->from, job->to);
 }
 
 
 void ParticleEmitter::update(float time_delta)
 {
+	PROFILE_FUNCTION();
 	spawnParticles(time_delta);
 	updateLives(time_delta);
-	updatePositions(time_delta);
-	updateRotations(time_delta);
-	for (auto* module : m_modules)
+	clearTailLanes();
+
+	// particles do not affect each other from now on, so big emitters are split into jobs
+	const int count = m_particles_count;
+	if (count <= PARTICLES_PER_JOB)
 	{
-		module->update(time_delta);
+		updateParticles(time_delta, 0, count);
+		return;
 	}
+
+	// ranges start at multiples of 4 so modules can process whole float4 lanes
+	int particles_per_job = Math::maximum(PARTICLES_PER_JOB, (count + MAX_UPDATE_JOBS - 1) / MAX_UPDATE_JOBS);
+	particles_per_job = (particles_per_job + 3) & ~3;
+	UpdateJob jobs_data[MAX_UPDATE_JOBS];
+	JobSystem::JobDecl jobs[MAX_UPDATE_JOBS];
+	int jobs_count = 0;
+	for (int from = 0; from < count; from += particles_per_job)
+	{
+		UpdateJob& job_data = jobs_data[jobs_count];
+		job_data.emitter = this;
+		job_data.time_delta = time_delta;
+		job_data.from = from;
+		job_data.to = Math::minimum(from + particles_per_job, count);
+		jobs[jobs_count].task = &ParticleEmitter::updateParticlesJob;
+		jobs[jobs_count].data = &job_data;
+		++jobs_count;
+	}
+	volatile int counter = 0;
+	JobSystem::runJobs(jobs, jobs_count, &counter);
+	JobSystem::wait(&counter);
 }
 
 
 void ParticleEmitter::emit()
+{
+	m_entity_position = m_universe.getPosition(m_entity);
+	m_entity_rotation = m_universe.getRotation(m_entity);
+	emitParticles();
+}
+
+
+void ParticleEmitter::emitParticles()
 {
 	int spawn_count = m_spawn_count.getRandom();
 	for (int i = 0; i < spawn_count; ++i)
@@ -1541,7 +1873,7 @@ void ParticleEmitter::spawnParticles(float time_delta)
 	while (m_next_spawn_time < 0)
 	{
 		m_next_spawn_time += m_spawn_period.getRandom();
-		emit();
+		emitParticles();
 	}
 }
 
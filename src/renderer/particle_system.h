@@ -4,6 +4,8 @@
 #include "engine/lumix.h"
 #include "engine/array.h"
 #include "engine/blob.h"
+#include "engine/mt/sync.h"
+#include "engine/quat.h"
 #include "engine/vec.h"
 
 
@@ -63,6 +65,30 @@ struct Interval
 };
 
 
+// Memory for particle pools of all emitters in a scene. Pools have power of two capacity,
+// released pools are kept in free lists and reused, so emitters do not hit the heap.
+class LUMIX_RENDERER_API ParticleChunkAllocator
+{
+public:
+	static const int MIN_CAPACITY = 64;
+
+	ParticleChunkAllocator(int channels_count, IAllocator& allocator);
+	~ParticleChunkAllocator();
+
+	// returns 16B aligned memory for capacity * channels_count floats, thread safe
+	float* allocate(int capacity);
+	void deallocate(float* chunk, int capacity);
+
+private:
+	static const int SIZE_CLASSES_COUNT = 20;
+
+	IAllocator& m_allocator;
+	int m_channels_count;
+	void* m_free_lists[SIZE_CLASSES_COUNT];
+	MT::SpinMutex m_mutex;
+};
+
+
 class LUMIX_RENDERER_API ScriptedParticleEmitter
 {
 public:
@@ -79,6 +105,8 @@ public:
 	void setMaterial(Material* material);
 	int getChannel(const char* name) const;
 	int getConstant(const char* name) const;
+	int getParticlesCount() const { return m_particles_count; }
+	const float* getChannelData(int channel) const { return m_channels[channel].data; }
 	
 	Entity m_entity;
 
@@ -95,12 +123,40 @@ private:
 		float value = 0;
 	};
 
+	// operand of a fused op, either a channel or a value folded at compile time
+	struct KernelArg
+	{
+		int channel = -1;
+		float value = 0;
+		bool times_time_delta = false;
+	};
+
+	struct KernelOp
+	{
+		u8 opcode;
+		u8 result;
+		KernelArg args[3];
+	};
+
+	// consecutive channel ops run together tile by tile, optionally followed by a condition
+	struct KernelStage
+	{
+		int ops_offset;
+		int ops_count;
+		int condition_offset;
+	};
+
 	void parseInstruction(const char* instruction, struct ParseContext& ctx);
+	void compileKernels();
+	void runKernel(const KernelStage& stage, float time_delta);
+	void runCondition(InputBlob& blob);
 	void execute(InputBlob& blob, int particle_index);
 	void kill(int particle_index);
 
 	IAllocator& m_allocator;
 	Array<u8> m_bytecode;
+	Array<KernelOp> m_kernel_ops;
+	Array<KernelStage> m_kernel_stages;
 	OutputBlob m_emit_buffer;
 	int m_output_bytecode_offset;
 	int m_emit_bytecode_offset;
@@ -124,8 +180,11 @@ public:
 
 		virtual ~ModuleBase() {}
 		virtual void spawnParticle(int /*index*/) {}
-		virtual void destoryParticle(int /*index*/) {}
-		virtual void update(float /*time_delta*/) {}
+		// called on the main thread, reads everything update needs from the universe
+		virtual void prepareUpdate() {}
+		// called from jobs, possibly several at once for different particle ranges;
+		// from is a multiple of 4, particles up to the next multiple of 4 after to can be processed
+		virtual void update(float /*time_delta*/, int /*from*/, int /*to*/) {}
 		virtual void serialize(OutputBlob& blob) = 0;
 		virtual void deserialize(InputBlob& blob) = 0;
 		virtual ComponentType getType() const = 0;
@@ -186,7 +245,8 @@ public:
 		explicit PlaneModule(ParticleEmitter& emitter);
 		void serialize(OutputBlob& blob) override;
 		void deserialize(InputBlob& blob) override;
-		void update(float time_delta) override;
+		void prepareUpdate() override;
+		void update(float time_delta, int from, int to) override;
 		ComponentType getType() const override { return s_type; }
 		void drawGizmo(WorldEditor& editor, RenderScene& scene) override;
 
@@ -194,6 +254,8 @@ public:
 		Entity m_entities[8];
 		float m_bounce;
 		int m_count;
+		Vec4 m_planes[8];
+		int m_planes_count;
 	};
 
 
@@ -202,7 +264,8 @@ public:
 		explicit AttractorModule(ParticleEmitter& emitter);
 		void serialize(OutputBlob& blob) override;
 		void deserialize(InputBlob& blob) override;
-		void update(float time_delta) override;
+		void prepareUpdate() override;
+		void update(float time_delta, int from, int to) override;
 		ComponentType getType() const override { return s_type; }
 		void drawGizmo(WorldEditor& editor, RenderScene& scene) override;
 
@@ -210,6 +273,8 @@ public:
 		Entity m_entities[8];
 		float m_force;
 		int m_count;
+		Vec3 m_positions[8];
+		int m_positions_count;
 	};
 
 
@@ -218,7 +283,7 @@ public:
 		explicit ForceModule(ParticleEmitter& emitter);
 		void serialize(OutputBlob& blob) override;
 		void deserialize(InputBlob& blob) override;
-		void update(float time_delta) override;
+		void update(float time_delta, int from, int to) override;
 		ComponentType getType() const override { return s_type; }
 
 		static const ComponentType s_type;
@@ -229,7 +294,7 @@ public:
 	struct LUMIX_RENDERER_API AlphaModule LUMIX_FINAL : public ModuleBase
 	{
 		explicit AlphaModule(ParticleEmitter& emitter);
-		void update(float time_delta) override;
+		void update(float time_delta, int from, int to) override;
 		void serialize(OutputBlob&) override;
 		void deserialize(InputBlob&) override;
 		ComponentType getType() const override { return s_type; }
@@ -245,7 +310,7 @@ public:
 	struct LUMIX_RENDERER_API SizeModule LUMIX_FINAL : public ModuleBase
 	{
 		explicit SizeModule(ParticleEmitter& emitter);
-		void update(float time_delta) override;
+		void update(float time_delta, int from, int to) override;
 		void serialize(OutputBlob&) override;
 		void deserialize(InputBlob&) override;
 		ComponentType getType() const override { return s_type; }
@@ -270,12 +335,32 @@ public:
 	};
 
 
+	// particle data are stored per channel, channels are contiguous in a pool
+	enum Channel : int
+	{
+		POSITION_X,
+		POSITION_Y,
+		POSITION_Z,
+		VELOCITY_X,
+		VELOCITY_Y,
+		VELOCITY_Z,
+		LIFE,
+		REL_LIFE,
+		SIZE,
+		ALPHA,
+		ROTATION,
+		ROTATIONAL_SPEED,
+
+		CHANNELS_COUNT
+	};
+
 public:
-	ParticleEmitter(Entity entity, Universe& universe, IAllocator& allocator);
+	ParticleEmitter(Entity entity, Universe& universe, ParticleChunkAllocator& chunk_allocator, IAllocator& allocator);
 	~ParticleEmitter();
 
 	void reset();
 	void init();
+	void prepareUpdate();
 	void drawGizmo(WorldEditor& editor, RenderScene& scene);
 	void serialize(OutputBlob& blob);
 	void deserialize(InputBlob& blob, ResourceManager& manager);
@@ -286,17 +371,11 @@ public:
 	void addModule(ModuleBase* module);
 	ModuleBase* getModule(ComponentType hash);
 	void emit();
+	int getParticlesCount() const { return m_particles_count; }
+	float* getChannel(Channel channel) { return m_pool + channel * m_capacity; }
+	const float* getChannel(Channel channel) const { return m_pool + channel * m_capacity; }
 
 public:
-	Array<float> m_rel_life;
-	Array<float> m_life;
-	Array<float> m_size;
-	Array<Vec3> m_position;
-	Array<Vec3> m_velocity;
-	Array<float> m_alpha;
-	Array<float> m_rotation;
-	Array<float> m_rotational_speed;
-
 	Interval m_spawn_period;
 	Interval m_initial_life;
 	Interval m_initial_size;
@@ -310,18 +389,38 @@ public:
 	bool m_local_space;
 
 private:
+	struct UpdateJob
+	{
+		ParticleEmitter* emitter;
+		float time_delta;
+		int from;
+		int to;
+	};
+
 	void spawnParticle();
-	void destroyParticle(int index);
+	void grow();
+	void emitParticles();
 	void spawnParticles(float time_delta);
 	void updateLives(float time_delta);
-	void updatePositions(float time_delta);
-	void updateRotations(float time_delta);
+	// float4 loops process lanes up to the next multiple of 4, those past the last particle are zeroed,
+	// so they do not hold stale values of dead particles or uninitialized memory of a grown pool
+	void clearTailLanes();
+	void updateParticles(float time_delta, int from, int to);
+	static void updateParticlesJob(void* data);
 
 private:
 	IAllocator& m_allocator;
 	float m_next_spawn_time;
 	Universe& m_universe;
 	Material* m_material;
+	ParticleChunkAllocator& m_chunk_allocator;
+	// one channel after another, each m_capacity floats; the pool is replaced by a twice as big one when full
+	float* m_pool;
+	int m_capacity;
+	int m_particles_count;
+	// emitter's transform read in prepareUpdate, so update does not touch the universe
+	Vec3 m_entity_position;
+	Quat m_entity_rotation;
 };
 
 
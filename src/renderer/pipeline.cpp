@@ -29,6 +29,7 @@
 #include "renderer/texture_manager.h"
 #include "engine/universe/universe.h"
 #include <bgfx/bgfx.h>
+#include <algorithm>
 #include <cmath>
 
 
@@ -37,7 +38,10 @@ namespace Lumix
 
 	
 static const float SHADOW_CAM_NEAR = 50.0f;
+static const int SHADOW_CASCADES_COUNT = 4;
 static const float SHADOW_CAM_FAR = 5000.0f;
+static const int MAX_INSTANCE_BATCH_JOBS = 16;
+static const int MIN_INSTANCES_PER_BATCH_JOB = 256;
 
 
 struct InstanceData
@@ -264,6 +268,33 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	};
 
 
+	// all visible instances sharing the same draw state, drawn with a single submit
+	struct InstanceBatch
+	{
+		const Mesh* mesh;
+		int view_idx;
+		int offset;
+		int count;
+	};
+
+
+	struct InstanceBatchJob
+	{
+		PipelineImpl* that;
+		const bgfx::InstanceDataBuffer* instance_buffer;
+		int from;
+		int to;
+	};
+
+
+	struct ShadowCascade
+	{
+		Frustum frustum;
+		Matrix view;
+		Matrix projection;
+	};
+
+
 	struct BaseVertex
 	{
 		float x, y, z;
@@ -300,11 +331,21 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		, m_draw2d(allocator)
 		, m_is_first_render(true)
 		, m_occlusion_buffer(allocator)
+		, m_occluder_candidates(allocator)
+		, m_occluders(allocator)
+		, m_omni_light_meshes(allocator)
+		, m_batch_items(allocator)
+		, m_batches(allocator)
+		, m_shadow_cascades_meshes(nullptr)
+		, m_shadow_cascades_camera(INVALID_ENTITY)
+		, m_shadow_cascades_layer_mask(0)
+		, m_shadow_cascades_framebuffer(nullptr)
 	{
 		for (auto& handle : m_debug_vertex_buffers)
 		{
 			handle = BGFX_INVALID_HANDLE;
 		}
+		for (int i = 0; i < 4; ++i) m_omni_light_meshes.emplace(allocator);
 		m_deferred_point_light_vertex_decl.begin()
 			.add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
 			.end();
@@ -648,7 +689,8 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	{
 		if (!m_current_view) return;
 
-		if (emitter.m_life.empty()) return;
+		const int count = emitter.getParticlesCount();
+		if (count == 0) return;
 		if (!emitter.getMaterial()) return;
 		if (!emitter.getMaterial()->isReady()) return;
 
@@ -675,8 +717,15 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 			bgfx::setUniform(m_emitter_matrix_uniform, &mtx);
 			bgfx::submit(view.bgfx_id, material->getShaderInstance().getProgramHandle(view.pass_idx));
 		};
+		const float* pos_x = emitter.getChannel(ParticleEmitter::POSITION_X);
+		const float* pos_y = emitter.getChannel(ParticleEmitter::POSITION_Y);
+		const float* pos_z = emitter.getChannel(ParticleEmitter::POSITION_Z);
+		const float* size = emitter.getChannel(ParticleEmitter::SIZE);
+		const float* alpha = emitter.getChannel(ParticleEmitter::ALPHA);
+		const float* rotation = emitter.getChannel(ParticleEmitter::ROTATION);
 		if (emitter.m_subimage_module)
 		{
+			const float* rel_life = emitter.getChannel(ParticleEmitter::REL_LIFE);
 			struct Instance
 			{
 				Vec4 pos;
@@ -689,14 +738,14 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 			float w = 1.0f / cols;
 			float h = 1.0f / rows;
 			material->setDefine(subimage_define_idx, true);
-			int size = emitter.m_subimage_module->rows * emitter.m_subimage_module->cols;
-			bgfx::allocInstanceDataBuffer(&instance_buffer, emitter.m_life.size(), sizeof(Instance));
+			int subimages_count = emitter.m_subimage_module->rows * emitter.m_subimage_module->cols;
+			bgfx::allocInstanceDataBuffer(&instance_buffer, count, sizeof(Instance));
 			Instance* instance = (Instance*)instance_buffer.data;
-			for (int i = 0, c = emitter.m_life.size(); i < c; ++i)
+			for (int i = 0; i < count; ++i)
 			{
-				instance->pos.set(emitter.m_position[i], emitter.m_size[i]);
-				instance->alpha_and_rotation.set(emitter.m_alpha[i], emitter.m_rotation[i], 0, 0);
-				float fidx = emitter.m_rel_life[i] * size;
+				instance->pos.set(pos_x[i], pos_y[i], pos_z[i], size[i]);
+				instance->alpha_and_rotation.set(alpha[i], rotation[i], 0, 0);
+				float fidx = rel_life[i] * subimages_count;
 				int idx = int(fidx);
 				float t = fidx - idx;
 				float row0 = h * (idx / cols);
@@ -707,7 +756,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 				instance->uv_params1.set(col1, row1, t, 0);
 				++instance;
 			}
-			draw(instance_buffer, emitter.m_life.size());
+			draw(instance_buffer, count);
 		}
 		else
 		{
@@ -717,15 +766,15 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 				Vec4 alpha_and_rotation;
 			};
 			material->setDefine(subimage_define_idx, false);
-			bgfx::allocInstanceDataBuffer(&instance_buffer, emitter.m_life.size(), sizeof(Instance));
+			bgfx::allocInstanceDataBuffer(&instance_buffer, count, sizeof(Instance));
 			Instance* instance = (Instance*)instance_buffer.data;
-			for (int i = 0, c = emitter.m_life.size(); i < c; ++i)
+			for (int i = 0; i < count; ++i)
 			{
-				instance->pos = Vec4(emitter.m_position[i], emitter.m_size[i]);
-				instance->alpha_and_rotation = Vec4(emitter.m_alpha[i], emitter.m_rotation[i], 0, 0);
+				instance->pos.set(pos_x[i], pos_y[i], pos_z[i], size[i]);
+				instance->alpha_and_rotation.set(alpha[i], rotation[i], 0, 0);
 				++instance;
 			}
-			draw(instance_buffer, emitter.m_life.size());
+			draw(instance_buffer, count);
 		}
 	}
 
@@ -1500,26 +1549,17 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		shadowmap_info.light = light;
 		//setPointLightUniforms(light);
 
-		IAllocator& frame_allocator = m_renderer.getEngine().getLIFOAllocator();
+		float fovx = Math::degreesToRadians(143.98570868f + 3.51f);
+		float fovy = Math::degreesToRadians(125.26438968f + 9.85f);
+		float aspect = tanf(fovx * 0.5f) / tanf(fovy * 0.5f);
+		Matrix projection_matrix;
+		projection_matrix.setPerspective(fovx, aspect, 0.01f, range, bgfx::getCaps()->homogeneousDepth, true);
+
+		Matrix view_matrices[4];
+		Frustum frustums[4];
 		for (int i = 0; i < 4; ++i)
 		{
-			newView("omnilight", 0xff);
-
-			bgfx::setViewClear(m_current_view->bgfx_id, BGFX_CLEAR_DEPTH, 0, 0.0f, 0);
-			bgfx::touch(m_current_view->bgfx_id);
-			u16 view_x = u16(shadowmap_width * viewports[i * 2]);
-			u16 view_y = u16(shadowmap_height * viewports[i * 2 + 1]);
-			bgfx::setViewRect(
-				m_current_view->bgfx_id, view_x, view_y, shadowmap_width >> 1, shadowmap_height >> 1);
-
-			float fovx = Math::degreesToRadians(143.98570868f + 3.51f);
-			float fovy = Math::degreesToRadians(125.26438968f + 9.85f);
-			float aspect = tanf(fovx * 0.5f) / tanf(fovy * 0.5f);
-
-			Matrix projection_matrix;
-			projection_matrix.setPerspective(fovx, aspect, 0.01f, range, bgfx::getCaps()->homogeneousDepth, true);
-
-			Matrix view_matrix;
+			Matrix& view_matrix = view_matrices[i];
 			if (bgfx::getCaps()->originBottomLeft)
 			{
 				view_matrix.fromEuler(YPR_gl[i][0], YPR_gl[i][1], YPR_gl[i][2]);
@@ -1529,34 +1569,43 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 				view_matrix.fromEuler(YPR[i][0], YPR[i][1], YPR[i][2]);
 			}
 			view_matrix.setTranslation(light_pos);
-			Frustum frustum;
-			frustum.computePerspective(light_pos,
+			frustums[i].computePerspective(light_pos,
 				-view_matrix.getZVector(),
 				view_matrix.getYVector(),
 				fovx,
 				aspect,
 				0.01f,
 				range);
-
 			view_matrix.fastInverse();
+		}
+
+		// all four faces are culled in one pass over the light's geometry; the four arrays grow together, so they
+		// can't live in the LIFO allocator and are kept between frames instead
+		for (Array<MeshInstance>& meshes : m_omni_light_meshes) meshes.clear();
+		Vec3 lod_ref_point = m_scene->getUniverse().getPosition(m_applied_camera);
+		m_scene->getPointLightInfluencedGeometry(
+			light, m_applied_camera, lod_ref_point, frustums, lengthOf(frustums), &m_omni_light_meshes[0]);
+
+		for (int i = 0; i < 4; ++i)
+		{
+			newView("omnilight", 0xff);
 
-			bgfx::setViewTransform(m_current_view->bgfx_id, &view_matrix.m11, &projection_matrix.m11);
+			bgfx::setViewClear(m_current_view->bgfx_id, BGFX_CLEAR_DEPTH, 0, 0.0f, 0);
+			bgfx::touch(m_current_view->bgfx_id);
+			u16 view_x = u16(shadowmap_width * viewports[i * 2]);
+			u16 view_y = u16(shadowmap_height * viewports[i * 2 + 1]);
+			bgfx::setViewRect(
+				m_current_view->bgfx_id, view_x, view_y, shadowmap_width >> 1, shadowmap_height >> 1);
+
+			bgfx::setViewTransform(m_current_view->bgfx_id, &view_matrices[i].m11, &projection_matrix.m11);
 
 			float ymul = bgfx::getCaps()->originBottomLeft ? 0.5f : -0.5f;
 			static const Matrix biasMatrix(
 				0.5, 0.0, 0.0, 0.0, 0.0, ymul, 0.0, 0.0, 0.0, 0.0, 0.5, 0.0, 0.5, 0.5, 0.5, 1.0);
-			shadowmap_info.matrices[i] = biasMatrix * (projection_matrix * view_matrix);
+			shadowmap_info.matrices[i] = biasMatrix * (projection_matrix * view_matrices[i]);
 
-			Array<MeshInstance> tmp_meshes(frame_allocator);
 			m_is_current_light_global = false;
-			Vec3 lod_ref_point = m_scene->getUniverse().getPosition(m_applied_camera);
-			m_scene->getPointLightInfluencedGeometry(light
-				, m_applied_camera
-				, lod_ref_point
-				, frustum
-				, tmp_meshes);
-
-			renderMeshes(tmp_meshes, false);
+			renderMeshes(m_omni_light_meshes[i]);
 		}
 	}
 
@@ -1640,34 +1689,17 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	}
 
 
-	void renderShadowmap(int split_index)
+	void computeShadowCascade(int split_index, ShadowCascade* cascade)
 	{
-		if (!m_current_view) return;
 		Universe& universe = m_scene->getUniverse();
 		Entity light = m_scene->getActiveGlobalLight();
-		if (!light.isValid() || !m_applied_camera.isValid()) return;
-		float camera_height = m_scene->getCameraScreenHeight(m_applied_camera);
-		if (!camera_height) return;
-
 		Matrix light_mtx = universe.getMatrix(light);
-		m_global_light_shadowmap = m_current_framebuffer;
-		float shadowmap_height = (float)m_current_framebuffer->getHeight();
 		float shadowmap_width = (float)m_current_framebuffer->getWidth();
-		float viewports[] = { 0, 0, 0.5f, 0, 0, 0.5f, 0.5f, 0.5f };
-		float viewports_gl[] = { 0, 0.5f, 0.5f, 0.5f, 0, 0, 0.5f, 0};
+		float camera_height = m_scene->getCameraScreenHeight(m_applied_camera);
 		float camera_fov = m_scene->getCameraFOV(m_applied_camera);
 		float camera_ratio = m_scene->getCameraScreenWidth(m_applied_camera) / camera_height;
 		Vec4 cascades = m_scene->getShadowmapCascades(light);
 		float split_distances[] = {0.1f, cascades.x, cascades.y, cascades.z, cascades.w};
-		m_is_rendering_in_shadowmap = true;
-		bgfx::setViewClear(m_current_view->bgfx_id, BGFX_CLEAR_DEPTH | BGFX_CLEAR_COLOR, 0xffffffff, 0, 0);
-		bgfx::touch(m_current_view->bgfx_id);
-		float* viewport = (bgfx::getCaps()->originBottomLeft ? viewports_gl : viewports) + split_index * 2;
-		bgfx::setViewRect(m_current_view->bgfx_id,
-			(u16)(1 + shadowmap_width * viewport[0]),
-			(u16)(1 + shadowmap_height * viewport[1]),
-			(u16)(0.5f * shadowmap_width - 2),
-			(u16)(0.5f * shadowmap_height - 2));
 
 		Frustum camera_frustum;
 		Matrix camera_matrix = universe.getMatrix(m_applied_camera);
@@ -1684,28 +1716,78 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		float bb_size = frustum_bounding_sphere.radius;
 		shadow_cam_pos = shadowmapTexelAlign(shadow_cam_pos, 0.5f * shadowmap_width - 2, bb_size, light_mtx);
 
-		Matrix projection_matrix;
-		projection_matrix.setOrtho(-bb_size, bb_size, -bb_size, bb_size, SHADOW_CAM_NEAR, SHADOW_CAM_FAR, bgfx::getCaps()->homogeneousDepth, true);
+		cascade->projection.setOrtho(-bb_size, bb_size, -bb_size, bb_size, SHADOW_CAM_NEAR, SHADOW_CAM_FAR, bgfx::getCaps()->homogeneousDepth, true);
 		Vec3 light_forward = light_mtx.getZVector();
 		shadow_cam_pos -= light_forward * SHADOW_CAM_FAR * 0.5f;
-		Matrix view_matrix;
-		view_matrix.lookAt(shadow_cam_pos, shadow_cam_pos + light_forward, light_mtx.getYVector());
-		bgfx::setViewTransform(m_current_view->bgfx_id, &view_matrix.m11, &projection_matrix.m11);
+		cascade->view.lookAt(shadow_cam_pos, shadow_cam_pos + light_forward, light_mtx.getYVector());
+
+		cascade->frustum.computeOrtho(
+			shadow_cam_pos, -light_forward, light_mtx.getYVector(), bb_size, bb_size, SHADOW_CAM_NEAR, SHADOW_CAM_FAR);
+
+		findExtraShadowcasterPlanes(light_forward, camera_frustum, camera_matrix.getTranslation(), &cascade->frustum);
+	}
+
+
+	// the first rendered split computes all the cascades and culls them together, the other splits reuse the results
+	void cullShadowCascades(u64 layer_mask)
+	{
+		if (m_shadow_cascades_camera == m_applied_camera
+			&& m_shadow_cascades_layer_mask == layer_mask
+			&& m_shadow_cascades_framebuffer == m_current_framebuffer)
+		{
+			return;
+		}
+
+		PROFILE_FUNCTION();
+		Frustum frustums[SHADOW_CASCADES_COUNT];
+		for (int i = 0; i < lengthOf(frustums); ++i)
+		{
+			computeShadowCascade(i, &m_shadow_cascades[i]);
+			frustums[i] = m_shadow_cascades[i].frustum;
+		}
+		Vec3 lod_ref_point = m_scene->getUniverse().getPosition(m_applied_camera);
+		m_shadow_cascades_meshes = &m_scene->getModelInstanceInfos(frustums, lengthOf(frustums), lod_ref_point, m_applied_camera, layer_mask);
+		m_shadow_cascades_camera = m_applied_camera;
+		m_shadow_cascades_layer_mask = layer_mask;
+		m_shadow_cascades_framebuffer = m_current_framebuffer;
+	}
+
+
+	void renderShadowmap(int split_index)
+	{
+		if (!m_current_view) return;
+		Entity light = m_scene->getActiveGlobalLight();
+		if (!light.isValid() || !m_applied_camera.isValid()) return;
+		float camera_height = m_scene->getCameraScreenHeight(m_applied_camera);
+		if (!camera_height) return;
+
+		m_global_light_shadowmap = m_current_framebuffer;
+		float shadowmap_height = (float)m_current_framebuffer->getHeight();
+		float shadowmap_width = (float)m_current_framebuffer->getWidth();
+		float viewports[] = { 0, 0, 0.5f, 0, 0, 0.5f, 0.5f, 0.5f };
+		float viewports_gl[] = { 0, 0.5f, 0.5f, 0.5f, 0, 0, 0.5f, 0};
+		m_is_rendering_in_shadowmap = true;
+		bgfx::setViewClear(m_current_view->bgfx_id, BGFX_CLEAR_DEPTH | BGFX_CLEAR_COLOR, 0xffffffff, 0, 0);
+		bgfx::touch(m_current_view->bgfx_id);
+		float* viewport = (bgfx::getCaps()->originBottomLeft ? viewports_gl : viewports) + split_index * 2;
+		bgfx::setViewRect(m_current_view->bgfx_id,
+			(u16)(1 + shadowmap_width * viewport[0]),
+			(u16)(1 + shadowmap_height * viewport[1]),
+			(u16)(0.5f * shadowmap_width - 2),
+			(u16)(0.5f * shadowmap_height - 2));
+
+		cullShadowCascades(m_current_view->layer_mask);
+		const ShadowCascade& cascade = m_shadow_cascades[split_index];
+		bgfx::setViewTransform(m_current_view->bgfx_id, &cascade.view.m11, &cascade.projection.m11);
 		float ymul = bgfx::getCaps()->originBottomLeft ? 0.5f : -0.5f;
 		static const Matrix biasMatrix(
 			0.5, 0.0, 0.0, 0.0, 
 			0.0, ymul, 0.0, 0.0, 
 			0.0, 0.0, 0.5, 0.0, 
 			0.5, 0.5, 0.5, 1.0);
-		m_shadow_viewprojection[split_index] = biasMatrix * (projection_matrix * view_matrix);
-
-		Frustum shadow_camera_frustum;
-		shadow_camera_frustum.computeOrtho(
-			shadow_cam_pos, -light_forward, light_mtx.getYVector(), bb_size, bb_size, SHADOW_CAM_NEAR, SHADOW_CAM_FAR);
-
-		findExtraShadowcasterPlanes(light_forward, camera_frustum, camera_matrix.getTranslation(), &shadow_camera_frustum);
+		m_shadow_viewprojection[split_index] = biasMatrix * (cascade.projection * cascade.view);
 
-		renderAll(shadow_camera_frustum, false, m_applied_camera, m_current_view->layer_mask, false);
+		renderShadowCasters(cascade.frustum, (*m_shadow_cascades_meshes)[split_index]);
 
 		m_is_rendering_in_shadowmap = false;
 	}
@@ -2061,7 +2143,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		Array<MeshInstance> tmp_meshes(m_renderer.getEngine().getLIFOAllocator());
 		Vec3 lod_ref_point = m_scene->getUniverse().getPosition(m_applied_camera);
 		m_scene->getPointLightInfluencedGeometry(light, m_applied_camera, lod_ref_point, tmp_meshes);
-		renderMeshes(tmp_meshes, false);
+		renderMeshes(tmp_meshes);
 	}
 
 
@@ -2086,7 +2168,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 					, lod_ref_point
 					, frustum
 					, tmp_meshes);
-				renderMeshes(tmp_meshes, false);
+				renderMeshes(tmp_meshes);
 			}
 
 			{
@@ -2265,8 +2347,11 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 
 		JobSystem::JobDecl jobs[3];
 		JobSystem::LambdaJob job_storage[3];
-		JobSystem::fromLambda([this, &frustum, &lod_ref_point, layer_mask, camera]() {
-			m_mesh_buffer = &m_scene->getModelInstanceInfos(frustum, lod_ref_point, camera, layer_mask);
+		// occluders are rasterized by rasterizeOccluders earlier in the same frame, hidden instances are culled
+		// before their meshes are expanded and sorted
+		const OcclusionBuffer* occlusion_buffer = use_occlusion_culling ? &m_occlusion_buffer : nullptr;
+		JobSystem::fromLambda([this, &frustum, &lod_ref_point, layer_mask, camera, occlusion_buffer]() {
+			m_mesh_buffer = &m_scene->getModelInstanceInfos(frustum, lod_ref_point, camera, layer_mask, occlusion_buffer);
 		}, &job_storage[0], &jobs[0], nullptr);
 
 		JobSystem::fromLambda([this, &frustum, &lod_ref_point]() {
@@ -2285,12 +2370,28 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		JobSystem::wait(&counter);
 		
 		renderTerrains(m_terrains_buffer);
-		renderMeshes(*m_mesh_buffer, use_occlusion_culling);
+		renderMeshes(*m_mesh_buffer);
 		
 		if(render_grass) renderGrasses(m_grasses_buffer);
 	}
 
 
+	// same as renderAll without grass, meshes are already culled
+	void renderShadowCasters(const Frustum& frustum, const Array<Array<MeshInstance>>& meshes)
+	{
+		PROFILE_FUNCTION();
+
+		Vec3 lod_ref_point = m_scene->getUniverse().getPosition(m_applied_camera);
+		m_is_current_light_global = true;
+
+		m_terrains_buffer.clear();
+		m_scene->getTerrainInfos(frustum, lod_ref_point, m_terrains_buffer);
+
+		renderTerrains(m_terrains_buffer);
+		renderMeshes(meshes);
+	}
+
+
 	void rasterizeOccluders(u64 layer_mask)
 	{
 		PROFILE_FUNCTION();
@@ -2299,19 +2400,87 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 
 		Vec3 lod_ref_point = m_scene->getUniverse().getPosition(m_applied_camera);
 		Frustum frustum = m_scene->getCameraFrustum(m_applied_camera);
-		m_mesh_buffer = &m_scene->getModelInstanceInfos(frustum, lod_ref_point, m_applied_camera, layer_mask);
+		m_mesh_buffer = &m_scene->getModelInstanceInfos(frustum, lod_ref_point, m_applied_camera, layer_mask, nullptr);
 
 		m_occlusion_buffer.clear();
 		Universe* universe = &m_scene->getUniverse();
-		Matrix projection = m_scene->getCameraProjection(m_applied_camera);
+		Matrix projection = getOcclusionProjection(m_applied_camera);
 		Matrix view = universe->getMatrix(m_applied_camera);
 		view.fastInverse();
 		m_occlusion_buffer.setCamera(view, projection);
-		for (auto& meshes : *m_mesh_buffer)
+		selectOccluders(*m_mesh_buffer);
+		if (!m_occluders.empty()) m_occlusion_buffer.rasterize(universe, m_occluders);
+		m_occlusion_buffer.buildHierarchy();
+	}
+
+
+	// occlusion buffer keeps the nearest depth with standard depth range, camera's projection uses reversed Z
+	Matrix getOcclusionProjection(Entity camera)
+	{
+		Matrix projection;
+		float width = m_scene->getCameraScreenWidth(camera);
+		float height = m_scene->getCameraScreenHeight(camera);
+		float ratio = height > 0 ? width / height : 1;
+		float near_plane = m_scene->getCameraNearPlane(camera);
+		float far_plane = m_scene->getCameraFarPlane(camera);
+		if (m_scene->isCameraOrtho(camera))
 		{
-			m_occlusion_buffer.rasterize(universe, meshes);
+			float size = m_scene->getCameraOrthoSize(camera);
+			projection.setOrtho(-size * ratio, size * ratio, -size, size, near_plane, far_plane, true, false);
 		}
-		m_occlusion_buffer.buildHierarchy();
+		else
+		{
+			projection.setPerspective(m_scene->getCameraFOV(camera), ratio, near_plane, far_plane, true, false);
+		}
+		return projection;
+	}
+
+
+	// only big enough static meshes of models imported as occluders are rasterized, the biggest ones on screen first,
+	// until the per-frame triangle budget is spent; models with a simplified occluder rasterize it instead of their meshes
+	void selectOccluders(const Array<Array<MeshInstance>>& meshes)
+	{
+		PROFILE_FUNCTION();
+		static const float MIN_OCCLUDER_SCREEN_SIZE = 0.1f;
+		static const int OCCLUDER_TRIANGLES_BUDGET = 100000;
+
+		Universe& universe = m_scene->getUniverse();
+		m_occluder_candidates.clear();
+		m_occluders.clear();
+		for (const Array<MeshInstance>& submeshes : meshes)
+		{
+			for (const MeshInstance& mesh_instance : submeshes)
+			{
+				Mesh* mesh = mesh_instance.mesh;
+				if (mesh->type == Mesh::RIGID || mesh->isSkinned()) continue;
+
+				Model* model = m_scene->getModelInstanceModel(mesh_instance.owner);
+				if (!model->isOccluder()) continue;
+
+				// depth is the squared distance scaled by FOV, so this is the bounding sphere's size on screen
+				float radius = model->getBoundingRadius() * universe.getScale(mesh_instance.owner);
+				float screen_size = radius / sqrtf(Math::maximum(mesh_instance.depth, 0.0001f));
+				if (screen_size < MIN_OCCLUDER_SCREEN_SIZE) continue;
+
+				// the simplified occluder replaces all meshes of the model, it's deduplicated per entity when selected
+				Mesh* occluder = model->getOccluder();
+				if (occluder)
+				{
+					mesh = occluder;
+				}
+				else if (!mesh->hasCPUData())
+				{
+					continue;
+				}
+
+				m_occluder_candidates.push({ mesh_instance.owner, mesh, mesh_instance.depth, screen_size });
+			}
+		}
+
+		int triangles_count =
+			OcclusionBuffer::selectOccluders(m_occluder_candidates, OCCLUDER_TRIANGLES_BUDGET, m_occluders);
+		PROFILE_INT("occluders", m_occluders.size());
+		PROFILE_INT("occluder triangles", triangles_count);
 	}
 
 
@@ -2942,100 +3111,236 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	}
 
 
-	void renderMeshes(const Array<MeshInstance>& meshes, bool use_occlusion_culling)
+	void renderMeshes(const Array<MeshInstance>& meshes)
 	{
-		bgfx::Encoder* encoder = m_renderer.getEncoder();
 		PROFILE_FUNCTION();
-		int mesh_count = 0;
-		ModelInstance* model_instances = m_scene->getModelInstances();
-		if (use_occlusion_culling)
-		{
-			mesh_count += meshes.size();
-			for (auto& mesh : meshes)
-			{
-				ModelInstance& model_instance = model_instances[mesh.owner.index];
-				switch (mesh.mesh->type)
-				{
-				case Mesh::RIGID_INSTANCED:
-					if (m_occlusion_buffer.isOccluded(model_instance.matrix, model_instance.model->getAABB())) break;
-					renderRigidMeshInstanced(encoder, s_instance_data, model_instance.matrix, *mesh.mesh);
-					break;
-				case Mesh::RIGID:
-					renderRigidMesh(encoder, model_instance.matrix, *mesh.mesh, mesh.depth);
-					break;
-				case Mesh::SKINNED:
-					renderSkinnedMesh(encoder, *model_instance.pose, *model_instance.model, model_instance.matrix, *mesh.mesh);
-					break;
-				case Mesh::MULTILAYER_SKINNED:
-					renderMultilayerSkinnedMesh(encoder, *model_instance.pose, *model_instance.model, model_instance.matrix, *mesh.mesh);
-					break;
-				case Mesh::MULTILAYER_RIGID:
-					renderMultilayerRigidMesh(encoder, *model_instance.model, model_instance.matrix, *mesh.mesh);
-					break;
-				}
-			}
-		}
-		else
-		{
-			mesh_count += meshes.size();
-			for (auto& mesh : meshes)
-			{
-				ModelInstance& model_instance = model_instances[mesh.owner.index];
-				switch (mesh.mesh->type)
-				{
-				case Mesh::RIGID_INSTANCED:
-					renderRigidMeshInstanced(encoder, s_instance_data, model_instance.matrix, *mesh.mesh);
-					break;
-				case Mesh::RIGID:
-					renderRigidMesh(encoder, model_instance.matrix, *mesh.mesh, mesh.depth);
-					break;
-				case Mesh::SKINNED:
-					renderSkinnedMesh(encoder, *model_instance.pose, *model_instance.model, model_instance.matrix, *mesh.mesh);
-					break;
-				case Mesh::MULTILAYER_SKINNED:
-					renderMultilayerSkinnedMesh(encoder, *model_instance.pose, *model_instance.model, model_instance.matrix, *mesh.mesh);
-					break;
-				case Mesh::MULTILAYER_RIGID:
-					renderMultilayerRigidMesh(encoder, *model_instance.model, model_instance.matrix, *mesh.mesh);
-					break;
-				}
-			}
-		}
-		finishInstances(encoder);
-		s_instance_data.buffer.data = nullptr;
-		s_instance_data.instances_count = 0;
-		s_instance_data.offset = 0;
-		PROFILE_INT("mesh count", mesh_count);
+		bgfx::InstanceDataBuffer instance_buffer;
+		InstanceBatchJob batch_data[MAX_INSTANCE_BATCH_JOBS];
+		JobSystem::JobDecl jobs[MAX_INSTANCE_BATCH_JOBS];
+		compileInstanceBatches(&meshes, 1);
+		int jobs_count = createInstanceBatchJobs(instance_buffer, batch_data, jobs);
+
+		volatile int counter = 0;
+		if (jobs_count > 0) JobSystem::runJobs(jobs, jobs_count, &counter);
+		renderNonInstancedMeshes(meshes);
+		JobSystem::wait(&counter);
 	}
 
 
-	void renderMeshes(const Array<Array<MeshInstance>>& meshes, bool use_occlusion_culling)
+	void renderMeshes(const Array<Array<MeshInstance>>& meshes)
 	{
 		PROFILE_FUNCTION();
 		struct Data
 		{
 			PipelineImpl* that;
 			const Array<MeshInstance>* meshes;
-			bool use_occlusion_culling;
 		} data[64];
-		JobSystem::JobDecl jobs[64];
-		volatile int counter = 0;
+		bgfx::InstanceDataBuffer instance_buffer;
+		InstanceBatchJob batch_data[MAX_INSTANCE_BATCH_JOBS];
+		JobSystem::JobDecl jobs[64 + MAX_INSTANCE_BATCH_JOBS];
+		compileInstanceBatches(meshes.begin(), meshes.size());
+		int jobs_count = createInstanceBatchJobs(instance_buffer, batch_data, jobs);
 		for (int i = 0; i < meshes.size(); ++i)
 		{
 			data[i].that = this;
-			data[i].use_occlusion_culling = use_occlusion_culling;
 			data[i].meshes = &meshes[i];
-			jobs[i].data = &data[i];
-			jobs[i].task = [](void* data) {
+			JobSystem::JobDecl& job = jobs[jobs_count];
+			job.data = &data[i];
+			job.task = [](void* data) {
 				Data* job_data = (Data*)data;
-				job_data->that->renderMeshes(*job_data->meshes, job_data->use_occlusion_culling);
+				job_data->that->renderNonInstancedMeshes(*job_data->meshes);
 			};
+			++jobs_count;
 		}
-		JobSystem::runJobs(jobs, meshes.size(), &counter);
+		if (jobs_count == 0) return;
+
+		volatile int counter = 0;
+		JobSystem::runJobs(jobs, jobs_count, &counter);
 		JobSystem::wait(&counter);
 	}
 
 
+	void renderNonInstancedMeshes(const Array<MeshInstance>& meshes)
+	{
+		bgfx::Encoder* encoder = m_renderer.getEncoder();
+		PROFILE_FUNCTION();
+		ModelInstance* model_instances = m_scene->getModelInstances();
+		for (auto& mesh : meshes)
+		{
+			ModelInstance& model_instance = model_instances[mesh.owner.index];
+			switch (mesh.mesh->type)
+			{
+			case Mesh::RIGID_INSTANCED:
+				// drawn by submitInstanceBatches
+				break;
+			case Mesh::RIGID:
+				renderRigidMesh(encoder, model_instance.matrix, *mesh.mesh, mesh.depth);
+				break;
+			case Mesh::SKINNED:
+				renderSkinnedMesh(encoder, *model_instance.pose, *model_instance.model, model_instance.matrix, *mesh.mesh);
+				break;
+			case Mesh::MULTILAYER_SKINNED:
+				renderMultilayerSkinnedMesh(encoder, *model_instance.pose, *model_instance.model, model_instance.matrix, *mesh.mesh);
+				break;
+			case Mesh::MULTILAYER_RIGID:
+				renderMultilayerRigidMesh(encoder, *model_instance.model, model_instance.matrix, *mesh.mesh);
+				break;
+			}
+		}
+		PROFILE_INT("mesh count", meshes.size());
+	}
+
+
+	static bool isSameInstanceBatch(const Mesh& a, const Mesh& b)
+	{
+		// the define mask is a property of the material, so it does not need its own key
+		return a.material == b.material
+			&& a.vertex_buffer_handle.idx == b.vertex_buffer_handle.idx
+			&& a.index_buffer_handle.idx == b.index_buffer_handle.idx;
+	}
+
+
+	// groups instanced meshes from all subresults by draw state, so each (mesh, material) pair is drawn
+	// by one submit regardless of how many model instances and culling jobs it comes from
+	void compileInstanceBatches(const Array<MeshInstance>* meshes, int count)
+	{
+		PROFILE_FUNCTION();
+		m_batch_items.clear();
+		m_batches.clear();
+		for (int i = 0; i < count; ++i)
+		{
+			for (const MeshInstance& mesh : meshes[i])
+			{
+				if (mesh.mesh->type == Mesh::RIGID_INSTANCED) m_batch_items.push(mesh);
+			}
+		}
+		if (m_batch_items.empty()) return;
+
+		std::sort(m_batch_items.begin(), m_batch_items.end(), [](const MeshInstance& a, const MeshInstance& b) {
+			const Mesh& mesh_a = *a.mesh;
+			const Mesh& mesh_b = *b.mesh;
+			if (mesh_a.material != mesh_b.material) return mesh_a.material < mesh_b.material;
+			if (mesh_a.vertex_buffer_handle.idx != mesh_b.vertex_buffer_handle.idx)
+			{
+				return mesh_a.vertex_buffer_handle.idx < mesh_b.vertex_buffer_handle.idx;
+			}
+			if (mesh_a.index_buffer_handle.idx != mesh_b.index_buffer_handle.idx)
+			{
+				return mesh_a.index_buffer_handle.idx < mesh_b.index_buffer_handle.idx;
+			}
+			return a.depth < b.depth;
+		});
+
+		for (int i = 0, c = m_batch_items.size(); i < c; ++i)
+		{
+			const Mesh& mesh = *m_batch_items[i].mesh;
+			if (m_batches.empty() || !isSameInstanceBatch(*m_batches.back().mesh, mesh))
+			{
+				int view_idx = m_layer_to_view_map[mesh.material->getRenderLayer()];
+				ASSERT(view_idx >= 0);
+				InstanceBatch& batch = m_batches.emplace();
+				batch.mesh = &mesh;
+				batch.view_idx = view_idx >= 0 ? view_idx : 0;
+				batch.offset = i;
+				batch.count = 0;
+			}
+			++m_batches.back().count;
+		}
+		PROFILE_INT("instance batches", m_batches.size());
+	}
+
+
+	// splits compiled batches into jobs with roughly the same number of instances,
+	// all jobs pack their transforms into one shared instance buffer
+	int createInstanceBatchJobs(bgfx::InstanceDataBuffer& instance_buffer, InstanceBatchJob* data, JobSystem::JobDecl* jobs)
+	{
+		if (m_batches.empty()) return 0;
+
+		u32 instances_count = m_batch_items.size();
+		u32 avail_count = bgfx::getAvailInstanceDataBuffer(instances_count, sizeof(Matrix));
+		if (avail_count < instances_count)
+		{
+			g_log_warning.log("Renderer") << "Instance data buffer is full, " << instances_count - avail_count
+				<< " instances are not drawn";
+			if (avail_count == 0) return 0;
+
+			// batches are packed in order, so only the tail does not fit
+			while (m_batches.back().offset >= (int)avail_count) m_batches.pop();
+			InstanceBatch& last = m_batches.back();
+			last.count = Math::minimum(last.count, (int)avail_count - last.offset);
+			instances_count = avail_count;
+		}
+		bgfx::allocInstanceDataBuffer(&instance_buffer, instances_count, sizeof(Matrix));
+
+		const int instances_per_job = Math::maximum(
+			MIN_INSTANCES_PER_BATCH_JOB, int(instances_count + MAX_INSTANCE_BATCH_JOBS - 1) / MAX_INSTANCE_BATCH_JOBS);
+		int jobs_count = 0;
+		int job_instances = 0;
+		for (int i = 0, c = m_batches.size(); i < c; ++i)
+		{
+			if (job_instances == 0)
+			{
+				InstanceBatchJob& job_data = data[jobs_count];
+				job_data.that = this;
+				job_data.instance_buffer = &instance_buffer;
+				job_data.from = i;
+				jobs[jobs_count].data = &job_data;
+				jobs[jobs_count].task = [](void* data) {
+					InstanceBatchJob* job_data = (InstanceBatchJob*)data;
+					job_data->that->submitInstanceBatches(*job_data->instance_buffer, job_data->from, job_data->to);
+				};
+				++jobs_count;
+			}
+			job_instances += m_batches[i].count;
+			data[jobs_count - 1].to = i + 1;
+			if (job_instances >= instances_per_job && jobs_count < MAX_INSTANCE_BATCH_JOBS) job_instances = 0;
+		}
+		return jobs_count;
+	}
+
+
+	void submitInstanceBatches(const bgfx::InstanceDataBuffer& instance_buffer, int from, int to)
+	{
+		PROFILE_FUNCTION();
+		bgfx::Encoder* encoder = m_renderer.getEncoder();
+		const ModelInstance* model_instances = m_scene->getModelInstances();
+		Matrix* matrices = (Matrix*)instance_buffer.data;
+		for (int i = from; i < to; ++i)
+		{
+			const InstanceBatch& batch = m_batches[i];
+			for (int j = batch.offset, end = batch.offset + batch.count; j < end; ++j)
+			{
+				matrices[j] = model_instances[m_batch_items[j].owner.index].matrix;
+			}
+
+			const Mesh& mesh = *batch.mesh;
+			Material* material = mesh.material;
+			material->setDefine(m_instanced_define_idx, true);
+			View& view = m_views[batch.view_idx];
+
+			executeCommandBuffer(encoder, material->getCommandBuffer(), material);
+			executeCommandBuffer(encoder, view.command_buffer.buffer, material);
+
+			encoder->setVertexBuffer(0, mesh.vertex_buffer_handle);
+			encoder->setIndexBuffer(mesh.index_buffer_handle);
+			encoder->setStencil(view.stencil, BGFX_STENCIL_NONE);
+			encoder->setState(view.render_state | material->getRenderStates());
+			bgfx::InstanceDataBuffer batch_buffer = instance_buffer;
+			batch_buffer.offset += batch.offset * sizeof(Matrix);
+			encoder->setInstanceDataBuffer(&batch_buffer, 0, batch.count);
+			ShaderInstance& shader_instance = material->getShaderInstance();
+			encoder->submit(view.bgfx_id, shader_instance.getProgramHandle(view.pass_idx));
+
+			MT::atomicIncrement(&m_stats.draw_call_count);
+			MT::atomicAdd(&m_stats.instance_count, batch.count);
+			MT::atomicAdd(&m_stats.triangle_count, batch.count * mesh.indices_count / 3);
+			Stats::ViewStats& view_stats = m_stats.views[batch.view_idx];
+			MT::atomicIncrement(&view_stats.batch_count);
+			MT::atomicAdd(&view_stats.batched_instance_count, batch.count);
+		}
+	}
+
+
 	void resize(int w, int h) override
 	{
 		if (m_width == w && m_height == h) return;
@@ -3097,6 +3402,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 		s_instance_data.instances_count = 0;
 		s_instance_data.offset = 0;
 		m_point_light_shadowmaps.clear();
+		m_shadow_cascades_camera = INVALID_ENTITY;
 		clearLayerToViewMap();
 		for (int i = 0; i < lengthOf(m_terrain_instances); ++i)
 		{
@@ -3120,6 +3426,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 			lua_pop(m_lua_state, 1);
 		}
 		ASSERT(!s_instance_data.mesh);
+		m_stats.view_count = m_view_idx + 1;
 		return success;
 	}
 
@@ -3246,7 +3553,7 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	u32 m_debug_flags;
 	int m_view_idx;
 	u64 m_layer_mask;
-	View m_views[64];
+	View m_views[Stats::MAX_VIEWS];
 	View* m_current_view;
 	int m_pass_idx;
 	Draw2D m_draw2d;
@@ -3314,6 +3621,16 @@ struct PipelineImpl LUMIX_FINAL : public Pipeline
 	bgfx::DynamicVertexBufferHandle m_debug_vertex_buffers[32];
 	bgfx::DynamicIndexBufferHandle m_debug_index_buffer;
 	OcclusionBuffer m_occlusion_buffer;
+	Array<OcclusionBuffer::OccluderCandidate> m_occluder_candidates;
+	Array<MeshInstance> m_occluders;
+	Array<Array<MeshInstance>> m_omni_light_meshes;
+	Array<MeshInstance> m_batch_items;
+	Array<InstanceBatch> m_batches;
+	ShadowCascade m_shadow_cascades[SHADOW_CASCADES_COUNT];
+	Array<Array<Array<MeshInstance>>>* m_shadow_cascades_meshes;
+	Entity m_shadow_cascades_camera;
+	u64 m_shadow_cascades_layer_mask;
+	FrameBuffer* m_shadow_cascades_framebuffer;
 	int m_debug_buffer_idx;
 	int m_has_shadowmap_define_idx;
 	int m_instanced_define_idx;
@@ -70,9 +70,19 @@ class LUMIX_RENDERER_API Pipeline
 	public:
 		struct Stats
 		{
+			enum { MAX_VIEWS = 64 };
+
+			struct ViewStats
+			{
+				int batch_count;
+				int batched_instance_count;
+			};
+
 			int draw_call_count;
 			int instance_count;
 			int triangle_count;
+			int view_count;
+			ViewStats views[MAX_VIEWS];
 		};
 
 		struct CustomCommandHandler
@@ -2,6 +2,8 @@
 #include "engine/matrix.h"
 #include "engine/quat.h"
 #include "engine/profiler.h"
+#include "engine/simd.h"
+#include "engine/string.h"
 #include "engine/vec.h"
 #include "renderer/model.h"
 
@@ -88,4 +90,339 @@ void Pose::computeRelative(Model& model)
 }
 
 
+static int getPaddedCount(int count)
+{
+	return (count + 3) & ~3;
+}
+
+
+PoseSoA::PoseSoA(IAllocator& allocator)
+	: allocator(allocator)
+{
+	for (float*& p : positions) p = nullptr;
+	for (float*& r : rotations) r = nullptr;
+	count = 0;
+	is_absolute = false;
+}
+
+
+PoseSoA::~PoseSoA()
+{
+	allocator.deallocate_aligned(positions[0]);
+}
+
+
+void PoseSoA::resize(int count)
+{
+	is_absolute = false;
+	allocator.deallocate_aligned(positions[0]);
+	this->count = count;
+	if (count == 0)
+	{
+		for (float*& p : positions) p = nullptr;
+		for (float*& r : rotations) r = nullptr;
+		return;
+	}
+
+	int padded_count = getPaddedCount(count);
+	float* data = (float*)allocator.allocate_aligned(sizeof(float) * padded_count * 7, 16);
+	for (int i = 0; i < 3; ++i) positions[i] = data + i * padded_count;
+	for (int i = 0; i < 4; ++i) rotations[i] = data + (3 + i) * padded_count;
+	setMemory(data, 0, sizeof(float) * padded_count * 6);
+	for (int i = 0; i < padded_count; ++i) rotations[3][i] = 1;
+}
+
+
+void PoseSoA::copy(const PoseSoA& rhs)
+{
+	if (count != rhs.count) resize(rhs.count);
+	is_absolute = rhs.is_absolute;
+	if (count > 0) copyMemory(positions[0], rhs.positions[0], sizeof(float) * getPaddedCount(count) * 7);
+}
+
+
+void PoseSoA::fromPose(const Pose& pose)
+{
+	if (count != pose.count) resize(pose.count);
+	is_absolute = pose.is_absolute;
+	for (int i = 0; i < count; ++i)
+	{
+		positions[0][i] = pose.positions[i].x;
+		positions[1][i] = pose.positions[i].y;
+		positions[2][i] = pose.positions[i].z;
+		rotations[0][i] = pose.rotations[i].x;
+		rotations[1][i] = pose.rotations[i].y;
+		rotations[2][i] = pose.rotations[i].z;
+		rotations[3][i] = pose.rotations[i].w;
+	}
+}
+
+
+void PoseSoA::toPose(Pose& pose) const
+{
+	if (pose.count != count) pose.resize(count);
+	pose.is_absolute = is_absolute;
+	for (int i = 0; i < count; ++i)
+	{
+		pose.positions[i].set(positions[0][i], positions[1][i], positions[2][i]);
+		pose.rotations[i].set(rotations[0][i], rotations[1][i], rotations[2][i], rotations[3][i]);
+	}
+}
+
+
+static LUMIX_FORCE_INLINE float4 dot4(const float4* a, const float4* b)
+{
+	return f4Add(f4Add(f4Mul(a[0], b[0]), f4Mul(a[1], b[1])), f4Add(f4Mul(a[2], b[2]), f4Mul(a[3], b[3])));
+}
+
+
+// same as nlerp() for four rotations
+static LUMIX_FORCE_INLINE void nlerp4(const float4* a, const float4* b, float4 t, float4* out)
+{
+	float4 flip = f4CmpLT(dot4(a, b), f4Splat(0));
+	float4 tmp[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		float4 to = f4Blend(b[i], f4Sub(f4Splat(0), b[i]), flip);
+		tmp[i] = f4Add(a[i], f4Mul(f4Sub(to, a[i]), t));
+	}
+	float4 inv_len = f4Div(f4Splat(1), f4Sqrt(dot4(tmp, tmp)));
+	for (int i = 0; i < 4; ++i) out[i] = f4Mul(tmp[i], inv_len);
+}
+
+
+// same as Quat::operator*
+static LUMIX_FORCE_INLINE void mul4(const float4* a, const float4* b, float4* out)
+{
+	float4 x = f4Add(f4Add(f4Mul(a[3], b[0]), f4Mul(b[3], a[0])), f4Sub(f4Mul(a[1], b[2]), f4Mul(b[1], a[2])));
+	float4 y = f4Add(f4Add(f4Mul(a[3], b[1]), f4Mul(b[3], a[1])), f4Sub(f4Mul(a[2], b[0]), f4Mul(b[2], a[0])));
+	float4 z = f4Add(f4Add(f4Mul(a[3], b[2]), f4Mul(b[3], a[2])), f4Sub(f4Mul(a[0], b[1]), f4Mul(b[0], a[1])));
+	float4 w = f4Sub(f4Mul(a[3], b[3]), f4Add(f4Add(f4Mul(a[0], b[0]), f4Mul(a[1], b[1])), f4Mul(a[2], b[2])));
+	out[0] = x;
+	out[1] = y;
+	out[2] = z;
+	out[3] = w;
+}
+
+
+static LUMIX_FORCE_INLINE void cross4(const float4* a, const float4* b, float4* out)
+{
+	out[0] = f4Sub(f4Mul(a[1], b[2]), f4Mul(a[2], b[1]));
+	out[1] = f4Sub(f4Mul(a[2], b[0]), f4Mul(a[0], b[2]));
+	out[2] = f4Sub(f4Mul(a[0], b[1]), f4Mul(a[1], b[0]));
+}
+
+
+// same as Quat::rotate
+static LUMIX_FORCE_INLINE void rotate4(const float4* q, const float4* v, float4* out)
+{
+	float4 uv[3], uuv[3];
+	cross4(q, v, uv);
+	cross4(q, uv, uuv);
+	float4 two_w = f4Add(q[3], q[3]);
+	for (int i = 0; i < 3; ++i)
+	{
+		out[i] = f4Add(v[i], f4Add(f4Mul(uv[i], two_w), f4Add(uuv[i], uuv[i])));
+	}
+}
+
+
+void PoseSoA::blend(const PoseSoA& rhs, float weight)
+{
+	ASSERT(count == rhs.count);
+	if (weight <= 0.001f) return;
+	weight = Math::clamp(weight, 0.0f, 1.0f);
+	float4 t = f4Splat(weight);
+	for (int i = 0, c = getPaddedCount(count); i < c; i += 4)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			float4 a = f4Load(positions[j] + i);
+			float4 b = f4Load(rhs.positions[j] + i);
+			f4Store(positions[j] + i, f4Add(a, f4Mul(f4Sub(b, a), t)));
+		}
+
+		float4 a[4], b[4], res[4];
+		for (int j = 0; j < 4; ++j)
+		{
+			a[j] = f4Load(rotations[j] + i);
+			b[j] = f4Load(rhs.rotations[j] + i);
+		}
+		nlerp4(a, b, t, res);
+		for (int j = 0; j < 4; ++j) f4Store(rotations[j] + i, res[j]);
+	}
+}
+
+
+void PoseSoA::blendAdditive(const PoseSoA& rhs, float weight)
+{
+	ASSERT(count == rhs.count);
+	if (weight <= 0.001f) return;
+	weight = Math::clamp(weight, 0.0f, 1.0f);
+	float4 t = f4Splat(weight);
+	float4 identity[4] = { f4Splat(0), f4Splat(0), f4Splat(0), f4Splat(1) };
+	for (int i = 0, c = getPaddedCount(count); i < c; i += 4)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			float4 a = f4Load(positions[j] + i);
+			float4 b = f4Load(rhs.positions[j] + i);
+			f4Store(positions[j] + i, f4Add(a, f4Mul(b, t)));
+		}
+
+		float4 a[4], b[4], weighted[4], res[4];
+		for (int j = 0; j < 4; ++j)
+		{
+			a[j] = f4Load(rotations[j] + i);
+			b[j] = f4Load(rhs.rotations[j] + i);
+		}
+		nlerp4(identity, b, t, weighted);
+		mul4(a, weighted, res);
+		for (int j = 0; j < 4; ++j) f4Store(rotations[j] + i, res[j]);
+	}
+}
+
+
+// bone indices sorted by depth in the hierarchy, roots are skipped
+struct BoneLevels
+{
+	BoneLevels(const int* parents, int count)
+	{
+		int depths[Model::Bone::MAX_COUNT];
+		int level_sizes[Model::Bone::MAX_COUNT + 1] = {};
+		levels_count = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			ASSERT(parents[i] < i);
+			depths[i] = parents[i] < 0 ? 0 : depths[parents[i]] + 1;
+			++level_sizes[depths[i]];
+			levels_count = Math::maximum(levels_count, depths[i] + 1);
+		}
+		level_starts[0] = 0;
+		for (int i = 0; i < levels_count; ++i) level_starts[i + 1] = level_starts[i] + level_sizes[i];
+		int cursors[Model::Bone::MAX_COUNT];
+		for (int i = 0; i < levels_count; ++i) cursors[i] = level_starts[i];
+		for (int i = 0; i < count; ++i) bones[cursors[depths[i]]++] = i;
+	}
+
+	int bones[Model::Bone::MAX_COUNT];
+	int level_starts[Model::Bone::MAX_COUNT + 1];
+	int levels_count;
+};
+
+
+// four bones of one level, the last group of a level repeats its first bone, which writes the same values twice
+static LUMIX_FORCE_INLINE void getLevelGroup(const BoneLevels& levels, const int* parents, int level, int i, int* bones, int* bone_parents)
+{
+	int end = levels.level_starts[level + 1];
+	for (int k = 0; k < 4; ++k)
+	{
+		int idx = i + k < end ? i + k : i;
+		bones[k] = levels.bones[idx];
+		bone_parents[k] = parents[bones[k]];
+	}
+}
+
+
+static LUMIX_FORCE_INLINE float4 gather(const float* src, const int* indices)
+{
+	float tmp[4] = { src[indices[0]], src[indices[1]], src[indices[2]], src[indices[3]] };
+	return f4LoadUnaligned(tmp);
+}
+
+
+static LUMIX_FORCE_INLINE void scatter(float* dst, const int* indices, float4 value)
+{
+	float tmp[4];
+	f4Store(tmp, value);
+	for (int k = 0; k < 4; ++k) dst[indices[k]] = tmp[k];
+}
+
+
+void PoseSoA::computeAbsolute(const int* parents)
+{
+	PROFILE_FUNCTION();
+	if (is_absolute) return;
+	ASSERT(count <= Model::Bone::MAX_COUNT);
+
+	BoneLevels levels(parents, count);
+	for (int level = 1; level < levels.levels_count; ++level)
+	{
+		for (int i = levels.level_starts[level], end = levels.level_starts[level + 1]; i < end; i += 4)
+		{
+			int bones[4], bone_parents[4];
+			getLevelGroup(levels, parents, level, i, bones, bone_parents);
+			float4 pos[3], parent_pos[3], rot[4], parent_rot[4];
+			for (int j = 0; j < 3; ++j)
+			{
+				pos[j] = gather(positions[j], bones);
+				parent_pos[j] = gather(positions[j], bone_parents);
+			}
+			for (int j = 0; j < 4; ++j)
+			{
+				rot[j] = gather(rotations[j], bones);
+				parent_rot[j] = gather(rotations[j], bone_parents);
+			}
+
+			float4 abs_pos[3], abs_rot[4];
+			rotate4(parent_rot, pos, abs_pos);
+			mul4(parent_rot, rot, abs_rot);
+			for (int j = 0; j < 3; ++j) scatter(positions[j], bones, f4Add(abs_pos[j], parent_pos[j]));
+			for (int j = 0; j < 4; ++j) scatter(rotations[j], bones, abs_rot[j]);
+		}
+	}
+	is_absolute = true;
+}
+
+
+void PoseSoA::computeRelative(const int* parents)
+{
+	PROFILE_FUNCTION();
+	if (!is_absolute) return;
+	ASSERT(count <= Model::Bone::MAX_COUNT);
+
+	// from the deepest level, so parents are still absolute
+	BoneLevels levels(parents, count);
+	for (int level = levels.levels_count - 1; level >= 1; --level)
+	{
+		for (int i = levels.level_starts[level], end = levels.level_starts[level + 1]; i < end; i += 4)
+		{
+			int bones[4], bone_parents[4];
+			getLevelGroup(levels, parents, level, i, bones, bone_parents);
+			float4 pos[3], rot[4], inv_parent_rot[4];
+			for (int j = 0; j < 3; ++j)
+			{
+				pos[j] = f4Sub(gather(positions[j], bones), gather(positions[j], bone_parents));
+			}
+			for (int j = 0; j < 4; ++j) rot[j] = gather(rotations[j], bones);
+			for (int j = 0; j < 3; ++j) inv_parent_rot[j] = gather(rotations[j], bone_parents);
+			inv_parent_rot[3] = f4Sub(f4Splat(0), gather(rotations[3], bone_parents));
+
+			float4 rel_pos[3], rel_rot[4];
+			rotate4(inv_parent_rot, pos, rel_pos);
+			mul4(inv_parent_rot, rot, rel_rot);
+			for (int j = 0; j < 3; ++j) scatter(positions[j], bones, rel_pos[j]);
+			for (int j = 0; j < 4; ++j) scatter(rotations[j], bones, rel_rot[j]);
+		}
+	}
+	is_absolute = false;
+}
+
+
+void PoseSoA::computeAbsolute(Model& model)
+{
+	int parents[Model::Bone::MAX_COUNT];
+	for (int i = 0; i < count; ++i) parents[i] = model.getBone(i).parent_idx;
+	computeAbsolute(parents);
+}
+
+
+void PoseSoA::computeRelative(Model& model)
+{
+	int parents[Model::Bone::MAX_COUNT];
+	for (int i = 0; i < count; ++i) parents[i] = model.getBone(i).parent_idx;
+	computeRelative(parents);
+}
+
+
 } // namespace Lumix
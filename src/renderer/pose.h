@@ -37,4 +37,36 @@ struct LUMIX_RENDERER_API Pose
 };
 
 
+// structure of arrays pose, bones are processed four at a time; lanes past count are padding
+struct LUMIX_RENDERER_API PoseSoA
+{
+	explicit PoseSoA(IAllocator& allocator);
+	~PoseSoA();
+
+	void resize(int count);
+	void copy(const PoseSoA& rhs);
+	void fromPose(const Pose& pose);
+	void toPose(Pose& pose) const;
+	void blend(const PoseSoA& rhs, float weight);
+	// rhs is a difference from a reference pose, applied in each bone's local space
+	void blendAdditive(const PoseSoA& rhs, float weight);
+	void computeAbsolute(Model& model);
+	void computeRelative(Model& model);
+	// parents[i] < i, -1 for roots; bones with the same depth do not depend on each other,
+	// so each depth level is processed four bones at a time
+	void computeAbsolute(const int* parents);
+	void computeRelative(const int* parents);
+
+	IAllocator& allocator;
+	bool is_absolute;
+	i32 count;
+	float* positions[3];
+	float* rotations[4];
+
+	private:
+		PoseSoA(const PoseSoA&);
+		void operator =(const PoseSoA&);
+};
+
+
 } // namespace Lumix
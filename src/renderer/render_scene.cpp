@@ -30,6 +30,7 @@
 #include "renderer/renderer.h"
 #include "renderer/terrain.h"
 #include "renderer/texture.h"
+#include "renderer/texture_manager.h"
 #include <cfloat>
 #include <cmath>
 #include <algorithm>
@@ -83,6 +84,16 @@ static const ComponentType ENVIRONMENT_PROBE_TYPE = Reflection::getComponentType
 static const ComponentType TEXT_MESH_TYPE = Reflection::getComponentType("text_mesh");
 
 
+static void requestTextureStreaming(const Material& material, float squared_distance)
+{
+	for (int i = 0, c = material.getTextureCount(); i < c; ++i)
+	{
+		Texture* texture = material.getTexture(i);
+		if (texture && texture->is_streamed) texture->requestStreaming(squared_distance);
+	}
+}
+
+
 struct Decal : public DecalInfo
 {
 	Entity entity;
@@ -238,11 +249,13 @@ private:
 			, m_model(model)
 		{
 			m_model->getObserverCb().bind<RenderSceneImpl, &RenderSceneImpl::modelStateChanged>(&scene);
+			m_model->getLODLoadedCallback().bind<RenderSceneImpl, &RenderSceneImpl::modelLODLoaded>(&scene);
 		}
 
 		~ModelLoadedCallback()
 		{
 			m_model->getObserverCb().unbind<RenderSceneImpl, &RenderSceneImpl::modelStateChanged>(&m_scene);
+			m_model->getLODLoadedCallback().unbind<RenderSceneImpl, &RenderSceneImpl::modelLODLoaded>(&m_scene);
 		}
 
 		Model* m_model;
@@ -352,7 +365,9 @@ public:
 
 	void updateEmitter(Entity entity, float time_delta) override
 	{
-		m_particle_emitters[entity]->update(time_delta);
+		ParticleEmitter* emitter = m_particle_emitters[entity];
+		emitter->prepareUpdate();
+		emitter->update(time_delta);
 	}
 
 
@@ -675,17 +690,55 @@ public:
 			}
 		}
 
-		if (m_is_game_running && !paused)
+		if (m_is_game_running && !paused) updateParticleEmitters(dt);
+	}
+
+
+	void updateParticleEmitters(float time_delta)
+	{
+		PROFILE_FUNCTION();
+		struct EmitterJob
 		{
-			for (auto* emitter : m_particle_emitters)
-			{
-				if (emitter->m_is_valid) emitter->update(dt);
-			}
-			for (auto* emitter : m_scripted_particle_emitters)
-			{
-				emitter->update(dt);
-			}
+			void* emitter;
+			float time_delta;
+		};
+
+		const int max_jobs = m_particle_emitters.size() + m_scripted_particle_emitters.size();
+		if (max_jobs == 0) return;
+
+		Array<EmitterJob> jobs_data(m_allocator);
+		Array<JobSystem::JobDecl> jobs(m_allocator);
+		jobs_data.reserve(max_jobs);
+		jobs.reserve(max_jobs);
+		for (auto* emitter : m_particle_emitters)
+		{
+			if (!emitter->m_is_valid) continue;
+
+			// jobs must not touch the universe
+			emitter->prepareUpdate();
+			jobs_data.push({emitter, time_delta});
+			JobSystem::JobDecl& job = jobs.emplace();
+			job.data = &jobs_data.back();
+			job.task = [](void* data) {
+				EmitterJob* job = (EmitterJob*)data;
+				((ParticleEmitter*)job->emitter)->update(job->time_delta);
+			};
+		}
+		for (auto* emitter : m_scripted_particle_emitters)
+		{
+			jobs_data.push({emitter, time_delta});
+			JobSystem::JobDecl& job = jobs.emplace();
+			job.data = &jobs_data.back();
+			job.task = [](void* data) {
+				EmitterJob* job = (EmitterJob*)data;
+				((ScriptedParticleEmitter*)job->emitter)->update(job->time_delta);
+			};
 		}
+		if (jobs.empty()) return;
+
+		volatile int counter = 0;
+		JobSystem::runJobs(&jobs[0], jobs.size(), &counter);
+		JobSystem::wait(&counter);
 	}
 
 
@@ -1243,7 +1296,7 @@ public:
 
 	void deserializeParticleEmitter(IDeserializer& serializer, Entity entity, int scene_version)
 	{
-		ParticleEmitter* emitter = LUMIX_NEW(m_allocator, ParticleEmitter)(entity, m_universe, m_allocator);
+		ParticleEmitter* emitter = LUMIX_NEW(m_allocator, ParticleEmitter)(entity, m_universe, m_particle_chunk_allocator, m_allocator);
 		emitter->m_entity = entity;
 		serializer.read(&emitter->m_autoemit);
 		serializer.read(&emitter->m_local_space);
@@ -1733,7 +1786,7 @@ public:
 		m_particle_emitters.reserve(count);
 		for(int i = 0; i < count; ++i)
 		{
-			ParticleEmitter* emitter = LUMIX_NEW(m_allocator, ParticleEmitter)(INVALID_ENTITY, m_universe, m_allocator);
+			ParticleEmitter* emitter = LUMIX_NEW(m_allocator, ParticleEmitter)(INVALID_ENTITY, m_universe, m_particle_chunk_allocator, m_allocator);
 			serializer.read(emitter->m_is_valid);
 			if (emitter->m_is_valid)
 			{
@@ -2660,7 +2713,7 @@ public:
 	{
 		int index = m_particle_emitters.find(entity);
 		if (index >= 0) return index;
-		return m_particle_emitters.insert(entity, LUMIX_NEW(m_allocator, ParticleEmitter)(entity, m_universe, m_allocator));
+		return m_particle_emitters.insert(entity, LUMIX_NEW(m_allocator, ParticleEmitter)(entity, m_universe, m_particle_chunk_allocator, m_allocator));
 	}
 
 
@@ -2832,6 +2885,18 @@ public:
 	}
 
 
+	bool isTerrainOverlapping(Entity entity, const AABB& terrain_space_aabb) override
+	{
+		return m_terrains[entity]->isOverlapping(terrain_space_aabb);
+	}
+
+
+	void updateTerrainHeightBounds(Entity entity, int from_x, int from_z, int to_x, int to_z) override
+	{
+		m_terrains[entity]->updateHeightBounds(from_x, from_z, to_x, to_z);
+	}
+
+
 	AABB getTerrainAABB(Entity entity) override
 	{
 		return m_terrains[entity]->getAABB();
@@ -3464,12 +3529,24 @@ public:
 		const Vec3& lod_ref_point,
 		const Frustum& frustum,
 		Array<MeshInstance>& infos) override
+	{
+		getPointLightInfluencedGeometry(light, camera, lod_ref_point, &frustum, 1, &infos);
+	}
+
+
+	void getPointLightInfluencedGeometry(Entity light,
+		Entity camera,
+		const Vec3& lod_ref_point,
+		const Frustum* frustums,
+		int frustums_count,
+		Array<MeshInstance>* infos) override
 	{
 		PROFILE_FUNCTION();
 
 		int light_index = m_point_lights_map[light];
 		float lod_multiplier = getCameraLODMultiplier(camera);
 		float final_lod_multiplier = m_lod_multiplier * lod_multiplier;
+		bool stream_textures = m_renderer.getTextureManager().isStreamingEnabled();
 		for (int j = 0, cj = m_light_influenced_geometry[light_index].size(); j < cj; ++j)
 		{
 			Entity model_instance_entity = m_light_influenced_geometry[light_index][j];
@@ -3478,14 +3555,26 @@ public:
 			float squared_distance = (model_instance.matrix.getTranslation() - lod_ref_point).squaredLength();
 			squared_distance *= final_lod_multiplier;
 
-			if (frustum.isSphereInside(sphere.position, sphere.radius))
+			LODMeshIndices lod = { 0, -1 };
+			for (int view = 0; view < frustums_count; ++view)
 			{
-				LODMeshIndices lod = model_instance.model->getLODMeshIndices(squared_distance);
+				if (!frustums[view].isSphereInside(sphere.position, sphere.radius)) continue;
+
+				// LOD is selected only if the instance is inside any of the frustums
+				if (lod.to < lod.from)
+				{
+					lod = model_instance.model->getLODMeshIndices(squared_distance);
+					for (int k = lod.from, c = lod.to; stream_textures && k <= c; ++k)
+					{
+						requestTextureStreaming(*model_instance.model->getMesh(k).material, squared_distance);
+					}
+				}
 				for (int k = lod.from, c = lod.to; k <= c; ++k)
 				{
-					auto& info = infos.emplace();
+					auto& info = infos[view].emplace();
 					info.mesh = &model_instance.model->getMesh(k);
 					info.owner = model_instance_entity;
+					info.depth = squared_distance;
 				}
 			}
 		}
@@ -3523,7 +3612,7 @@ public:
 	{
 		PROFILE_FUNCTION();
 
-		auto& results = m_culling_system->cull(frustum, ~0ULL);
+		auto& results = m_culling_system->cull(frustum, ~0ULL, nullptr);
 
 		for (auto& subresults : results)
 		{
@@ -3554,10 +3643,11 @@ public:
 	Array<Array<MeshInstance>>& getModelInstanceInfos(const Frustum& frustum,
 		const Vec3& lod_ref_point,
 		Entity camera,
-		u64 layer_mask) override
+		u64 layer_mask,
+		const OcclusionBuffer* occlusion_buffer) override
 	{
 		for (auto& i : m_temporary_infos) i.clear();
-		const CullingSystem::Results& results = m_culling_system->cull(frustum, layer_mask);
+		const CullingSystem::Results& results = m_culling_system->cull(frustum, layer_mask, occlusion_buffer);
 
 		while (m_temporary_infos.size() < results.size())
 		{
@@ -3573,12 +3663,13 @@ public:
 		ASSERT(results.size() <= lengthOf(jobs));
 
 		volatile int counter = 0;
+		bool stream_textures = m_renderer.getTextureManager().isStreamingEnabled();
 		for (int subresult_index = 0; subresult_index < results.size(); ++subresult_index)
 		{
 			Array<MeshInstance>& subinfos = m_temporary_infos[subresult_index];
 			subinfos.clear();
 
-			JobSystem::fromLambda([&layer_mask, &subinfos, this, &results, subresult_index, lod_ref_point, camera]() {
+			JobSystem::fromLambda([&layer_mask, &subinfos, this, &results, subresult_index, lod_ref_point, camera, stream_textures]() {
 				PROFILE_BLOCK("Temporary Info Job");
 				PROFILE_INT("ModelInstance count", results[subresult_index].size());
 				if (results[subresult_index].empty()) return;
@@ -3605,6 +3696,7 @@ public:
 						info.owner = raw_subresults[i];
 						info.mesh = &mesh;
 						info.depth = squared_distance;
+						if (stream_textures) requestTextureStreaming(*mesh.material, squared_distance);
 					}
 				}
 				if (!subinfos.empty())
@@ -3630,6 +3722,97 @@ public:
 	}
 
 
+
+	Array<Array<Array<MeshInstance>>>& getModelInstanceInfos(const Frustum* frustums,
+		int frustums_count,
+		const Vec3& lod_ref_point,
+		Entity camera,
+		u64 layer_mask) override
+	{
+		PROFILE_FUNCTION();
+		const CullingSystem::Results& results = m_culling_system->cull(frustums, frustums_count, layer_mask);
+		const CullingSystem::ResultsViewMasks& view_masks = m_culling_system->getViewMasks();
+
+		while (m_temporary_view_infos.size() < frustums_count)
+		{
+			m_temporary_view_infos.emplace(m_allocator);
+		}
+		while (m_temporary_view_infos.size() > frustums_count)
+		{
+			m_temporary_view_infos.pop();
+		}
+		for (Array<Array<MeshInstance>>& view_infos : m_temporary_view_infos)
+		{
+			while (view_infos.size() < results.size()) view_infos.emplace(m_allocator);
+			while (view_infos.size() > results.size()) view_infos.pop();
+			for (Array<MeshInstance>& subinfos : view_infos) subinfos.clear();
+		}
+
+		JobSystem::JobDecl jobs[64];
+		JobSystem::LambdaJob job_storage[64];
+		ASSERT(results.size() <= lengthOf(jobs));
+
+		volatile int counter = 0;
+		bool stream_textures = m_renderer.getTextureManager().isStreamingEnabled();
+		for (int subresult_index = 0; subresult_index < results.size(); ++subresult_index)
+		{
+			JobSystem::fromLambda([&layer_mask, this, &results, &view_masks, subresult_index, frustums_count, lod_ref_point, camera, stream_textures]() {
+				PROFILE_BLOCK("Temporary Views Info Job");
+				PROFILE_INT("ModelInstance count", results[subresult_index].size());
+				if (results[subresult_index].empty()) return;
+
+				float lod_multiplier = getCameraLODMultiplier(camera);
+				float final_lod_multiplier = m_lod_multiplier * lod_multiplier;
+				const Entity* LUMIX_RESTRICT raw_subresults = &results[subresult_index][0];
+				const u32* LUMIX_RESTRICT raw_view_masks = &view_masks[subresult_index][0];
+				ModelInstance* LUMIX_RESTRICT model_instances = &m_model_instances[0];
+				for (int i = 0, c = results[subresult_index].size(); i < c; ++i)
+				{
+					const ModelInstance* LUMIX_RESTRICT model_instance = &model_instances[raw_subresults[i].index];
+					float squared_distance = (model_instance->matrix.getTranslation() - lod_ref_point).squaredLength();
+					squared_distance *= final_lod_multiplier;
+
+					// LOD is selected once for all the views
+					const Model* LUMIX_RESTRICT model = model_instance->model;
+					LODMeshIndices lod = model->getLODMeshIndices(squared_distance);
+					u32 view_mask = raw_view_masks[i];
+					for (int j = lod.from, c = lod.to; j <= c; ++j)
+					{
+						Mesh& mesh = model_instance->meshes[j];
+						if ((mesh.layer_mask & layer_mask) == 0) continue;
+						if (stream_textures) requestTextureStreaming(*mesh.material, squared_distance);
+
+						for (int view = 0; view < frustums_count; ++view)
+						{
+							if ((view_mask & (1 << view)) == 0) continue;
+							MeshInstance& info = m_temporary_view_infos[view][subresult_index].emplace();
+							info.owner = raw_subresults[i];
+							info.mesh = &mesh;
+							info.depth = squared_distance;
+						}
+					}
+				}
+
+				auto cmp = [](const MeshInstance& a, const MeshInstance& b) -> bool {
+					if (a.mesh != b.mesh) return a.mesh < b.mesh;
+					return (a.depth < b.depth);
+				};
+				for (int view = 0; view < frustums_count; ++view)
+				{
+					Array<MeshInstance>& subinfos = m_temporary_view_infos[view][subresult_index];
+					if (subinfos.empty()) continue;
+					PROFILE_BLOCK("Sort");
+					std::sort(subinfos.begin(), subinfos.end(), cmp);
+				}
+			}, &job_storage[subresult_index], &jobs[subresult_index], nullptr);
+		}
+		JobSystem::runJobs(jobs, results.size(), &counter);
+		JobSystem::wait(&counter);
+
+		return m_temporary_view_infos;
+	}
+
+
 	void setCameraSlot(Entity entity, const char* slot) override
 	{
 		auto& camera = m_cameras[entity];
@@ -4674,7 +4857,7 @@ public:
 			for (int i = 0; i < model->getMeshCount(); ++i)
 			{
 				Mesh& mesh = model->getMesh(i);
-				mesh.material->setDefine(skinned_define_idx, !mesh.skin.empty());
+				mesh.material->setDefine(skinned_define_idx, mesh.isSkinned());
 			}
 		}
 		r.matrix = m_universe.getMatrix(r.entity);
@@ -4742,6 +4925,22 @@ public:
 	}
 
 
+	void modelLODLoaded(Model& model)
+	{
+		for (int i = 0, c = m_model_instances.size(); i < c; ++i)
+		{
+			ModelInstance& r = m_model_instances[i];
+			if (r.entity == INVALID_ENTITY || r.model != &model || !hasCustomMeshes(r)) continue;
+
+			// custom meshes copy buffer handles, pick up the ones of the streamed in LODs
+			for (int j = 0; j < r.mesh_count; ++j)
+			{
+				if (!bgfx::isValid(r.meshes[j].vertex_buffer_handle)) r.meshes[j].set(model.getMesh(j));
+			}
+		}
+	}
+
+
 	ModelLoadedCallback& getModelLoadedCallback(Model* model)
 	{
 		int idx = m_model_loaded_callbacks.find(model);
@@ -4812,7 +5011,7 @@ public:
 		Material* new_material = static_cast<Material*>(material_manager->load(path));
 
 		const int skinned_define_idx = m_renderer.getShaderDefineIdx("SKINNED");
-		new_material->setDefine(skinned_define_idx, !r.meshes[index].skin.empty());
+		new_material->setDefine(skinned_define_idx, r.meshes[index].isSkinned());
 
 		r.meshes[index].setMaterial(new_material, *r.model, m_renderer);
 	}
@@ -4880,7 +5079,7 @@ public:
 	{
 		int light_idx = m_point_lights_map[entity];
 		Frustum frustum = getPointLightFrustum(light_idx);
-		const CullingSystem::Results& results = m_culling_system->cull(frustum, ~0ULL);
+		const CullingSystem::Results& results = m_culling_system->cull(frustum, ~0ULL, nullptr);
 		auto& influenced_geometry = m_light_influenced_geometry[light_idx];
 		influenced_geometry.clear();
 		for (int i = 0; i < results.size(); ++i)
@@ -5221,6 +5420,7 @@ private:
 	AssociativeArray<Entity, BoneAttachment> m_bone_attachments;
 	AssociativeArray<Entity, EnvironmentProbe> m_environment_probes;
 	HashMap<Entity, Terrain*> m_terrains;
+	ParticleChunkAllocator m_particle_chunk_allocator;
 	AssociativeArray<Entity, ParticleEmitter*> m_particle_emitters;
 	AssociativeArray<Entity, ScriptedParticleEmitter*> m_scripted_particle_emitters;
 
@@ -5229,6 +5429,7 @@ private:
 	Array<DebugPoint> m_debug_points;
 
 	Array<Array<MeshInstance>> m_temporary_infos;
+	Array<Array<Array<MeshInstance>>> m_temporary_view_infos;
 
 	float m_time;
 	float m_lod_multiplier;
@@ -5303,9 +5504,11 @@ RenderSceneImpl::RenderSceneImpl(Renderer& renderer,
 	, m_debug_lines(m_allocator)
 	, m_debug_points(m_allocator)
 	, m_temporary_infos(m_allocator)
+	, m_temporary_view_infos(m_allocator)
 	, m_active_global_light_entity(INVALID_ENTITY)
 	, m_is_grass_enabled(true)
 	, m_is_game_running(false)
+	, m_particle_chunk_allocator(ParticleEmitter::CHANNELS_COUNT, m_allocator)
 	, m_particle_emitters(m_allocator)
 	, m_scripted_particle_emitters(m_allocator)
 	, m_point_lights_map(m_allocator)
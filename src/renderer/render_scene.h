@@ -21,6 +21,7 @@ class LIFOAllocator;
 class Material;
 struct Mesh;
 class Model;
+class OcclusionBuffer;
 class Path;
 struct Pose;
 struct RayCastModelHit;
@@ -319,6 +320,13 @@ public:
 	virtual Array<Array<MeshInstance>>& getModelInstanceInfos(const Frustum& frustum,
 		const Vec3& lod_ref_point,
 		Entity entity,
+		u64 layer_mask,
+		const OcclusionBuffer* occlusion_buffer) = 0;
+	// culls against all the frustums in one pass, result is indexed by frustum and then by culling job
+	virtual Array<Array<Array<MeshInstance>>>& getModelInstanceInfos(const Frustum* frustums,
+		int frustums_count,
+		const Vec3& lod_ref_point,
+		Entity camera,
 		u64 layer_mask) = 0;
 	virtual void getModelInstanceEntities(const Frustum& frustum, Array<Entity>& entities) = 0;
 	virtual Entity getFirstModelInstance() = 0;
@@ -337,6 +345,8 @@ public:
 	virtual void forceGrassUpdate(Entity entity) = 0;
 	virtual void getTerrainInfos(const Frustum& frustum, const Vec3& lod_ref_point, Array<TerrainInfo>& infos) = 0;
 	virtual float getTerrainHeightAt(Entity entity, float x, float z) = 0;
+	virtual bool isTerrainOverlapping(Entity entity, const AABB& terrain_space_aabb) = 0;
+	virtual void updateTerrainHeightBounds(Entity entity, int from_x, int from_z, int to_x, int to_z) = 0;
 	virtual Vec3 getTerrainNormalAt(Entity entity, float x, float z) = 0;
 	virtual void setTerrainMaterialPath(Entity entity, const Path& path) = 0;
 	virtual Path getTerrainMaterialPath(Entity entity) = 0;
@@ -377,6 +387,13 @@ public:
 		const Vec3& lod_ref_point,
 		const Frustum& frustum,
 		Array<MeshInstance>& infos) = 0;
+	// infos[i] are meshes inside frustums[i], the geometry is walked only once
+	virtual void getPointLightInfluencedGeometry(Entity light,
+		Entity camera,
+		const Vec3& lod_ref_point,
+		const Frustum* frustums,
+		int frustums_count,
+		Array<MeshInstance>* infos) = 0;
 	virtual void setLightCastShadows(Entity entity, bool cast_shadows) = 0;
 	virtual bool getLightCastShadows(Entity entity) = 0;
 	virtual float getLightAttenuation(Entity entity) = 0;
@@ -515,6 +515,14 @@ struct RendererImpl LUMIX_FINAL : public Renderer
 				m_vsync = false;
 				break;
 			}
+			else if (cmd_line_parser.currentEquals("-texture_streaming"))
+			{
+				m_texture_manager.enableStreaming(true);
+			}
+			else if (cmd_line_parser.currentEquals("-model_streaming"))
+			{
+				m_model_manager.enableStreaming(true);
+			}
 		}
 
 		bgfx::Init init;
@@ -706,6 +714,10 @@ struct RendererImpl LUMIX_FINAL : public Renderer
 		}
 		bgfx::frame(capture);
 		m_view_counter = 0;
+
+		m_material_manager.onTextureHandlesChanged(m_texture_manager.getStreamingChanges());
+		m_texture_manager.updateStreaming();
+		m_model_manager.updateStreaming();
 	}
 
 
@@ -2,6 +2,7 @@
 #include "engine/blob.h"
 #include "engine/crc32.h"
 #include "engine/geometry.h"
+#include "engine/job_system.h"
 #include "engine/lifo_allocator.h"
 #include "engine/log.h"
 #include "engine/math_utils.h"
@@ -27,9 +28,32 @@ namespace Lumix
 static const float GRASS_QUAD_SIZE = 10.0f;
 static const float GRASS_QUAD_RADIUS = GRASS_QUAD_SIZE * 0.7072f;
 static const int GRID_SIZE = 16;
+static const int HEIGHT_BOUNDS_BLOCK_SIZE = 8; // in heightmap cells
 static const ComponentType TERRAIN_HASH = Reflection::getComponentType("terrain");
 static const char* TEX_COLOR_UNIFORM = "u_texColor";
 
+
+// counter-based random number generator - the n-th number depends only on the key and n,
+// so grass quads generate the same instances in any order and on any thread
+struct GrassRandom
+{
+	explicit GrassRandom(u32 key) : key(key), counter(0) {}
+
+	float randFloat(float from, float to)
+	{
+		u32 x = key ^ (++counter * 0x9E3779B9);
+		x ^= x >> 16;
+		x *= 0x85EBCA6B;
+		x ^= x >> 13;
+		x *= 0xC2B2AE35;
+		x ^= x >> 16;
+		return from + (to - from) * (x >> 8) * (1.0f / (1 << 24));
+	}
+
+	u32 key;
+	u32 counter;
+};
+
 struct Sample
 {
 	Vec3 pos;
@@ -191,6 +215,9 @@ Terrain::Terrain(Renderer& renderer, Entity entity, RenderScene& scene, IAllocat
 	, m_grass_types(m_allocator)
 	, m_renderer(renderer)
 	, m_force_grass_update(false)
+	, m_height_bounds(m_allocator)
+	, m_height_bounds_levels(0)
+	, m_height_bounds_size(0)
 {
 	generateGeometry();
 }
@@ -214,7 +241,7 @@ Terrain::~Terrain()
 		Array<GrassQuad*>& quads = m_grass_quads.at(j);
 		for (int i = 0; i < quads.size(); ++i)
 		{
-			LUMIX_DELETE(m_allocator, quads[i]);
+			destroyGrassQuad(quads[i]);
 		}
 	}
 }
@@ -357,7 +384,7 @@ void Terrain::forceGrassUpdate()
 		Array<GrassQuad*>& quads = m_grass_quads.at(i);
 		for (GrassQuad* quad : quads)
 		{
-			LUMIX_DELETE(m_allocator, quad);
+			destroyGrassQuad(quad);
 		}
 		quads.clear();
 	}
@@ -375,6 +402,13 @@ Array<Terrain::GrassQuad*>& Terrain::getQuads(Entity camera)
 }
 
 
+void Terrain::destroyGrassQuad(GrassQuad* quad)
+{
+	JobSystem::wait(&quad->m_job_counter);
+	LUMIX_DELETE(m_allocator, quad);
+}
+
+
 void Terrain::generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& terrain_tr, const Vec2& quad_pos)
 {
 	ASSERT(quad_pos.x >= 0);
@@ -392,9 +426,8 @@ void Terrain::generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& ter
 		Math::minimum(grass_quad_size_hm_space, m_heightmap->height - quad_pos.y)
 	};
 
-	struct { float x, y; void* type; } hashed_patch = { quad_pos.x, quad_pos.y, patch.m_type };
-	const u32 hash = crc32(&hashed_patch, sizeof(hashed_patch));
-	Math::seedRandom(hash);
+	struct { float x, y; int type; } hashed_patch = { quad_pos.x, quad_pos.y, patch.m_type->m_idx };
+	GrassRandom random(crc32(&hashed_patch, sizeof(hashed_patch)));
 	const int max_idx = splat_map->width * splat_map->height;
 
 	const Vec2 step = quad_size * (1 / (float)patch.m_type->m_density);
@@ -415,8 +448,8 @@ void Terrain::generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& ter
 			const int ground_mask = (pixel_value >> 16) & 0xffff;
 			if ((ground_mask & (1 << patch.m_type->m_idx)) == 0) continue;
 
-			const float x = (quad_pos.x + dx + step.x * Math::randFloat(-0.5f, 0.5f)) * m_scale.x;
-			const float z = (quad_pos.y + dy + step.y * Math::randFloat(-0.5f, 0.5f)) * m_scale.z;
+			const float x = (quad_pos.x + dx + step.x * random.randFloat(-0.5f, 0.5f)) * m_scale.x;
+			const float z = (quad_pos.y + dy + step.y * random.randFloat(-0.5f, 0.5f)) * m_scale.z;
 			const Vec3 instance_rel_pos(x, getHeight(x, z), z);
 			Quat instance_rel_rot;
 			
@@ -424,20 +457,20 @@ void Terrain::generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& ter
 			{
 				case GrassType::RotationMode::Y_UP:
 				{
-					instance_rel_rot = Quat(Vec3(0, 1, 0), Math::randFloat(0, Math::PI * 2));
+					instance_rel_rot = Quat(Vec3(0, 1, 0), random.randFloat(0, Math::PI * 2));
 				}
 				break;
 				case GrassType::RotationMode::ALL_RANDOM:
 				{
-					const Vec3 random_axis(Math::randFloat(-1, 1), Math::randFloat(-1, 1), Math::randFloat(-1, 1));
-					const float random_angle = Math::randFloat(0, Math::PI * 2);
+					const Vec3 random_axis(random.randFloat(-1, 1), random.randFloat(-1, 1), random.randFloat(-1, 1));
+					const float random_angle = random.randFloat(0, Math::PI * 2);
 					instance_rel_rot = Quat(random_axis.normalized(), random_angle);
 				}
 				break;
 				case GrassType::RotationMode::ALIGN_WITH_NORMAL:
 				{
 					const Vec3 normal = getNormal(x, z);
-					const Quat random_base(Vec3(0, 1, 0), Math::randFloat(0, Math::PI * 2));
+					const Quat random_base(Vec3(0, 1, 0), random.randFloat(0, Math::PI * 2));
 					const Quat to_normal = Quat::vec3ToVec3({0, 1, 0}, normal);
 					instance_rel_rot = to_normal * random_base;
 				}
@@ -447,7 +480,7 @@ void Terrain::generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& ter
 
 			GrassPatch::InstanceData& instance_data = patch.instance_data.emplace();
 			const Vec3 instance_pos = terrain_tr.pos + terrain_tr.rot * instance_rel_pos;
-			instance_data.pos_scale.set(instance_pos, Math::randFloat(0.9f, 1.1f));
+			instance_data.pos_scale.set(instance_pos, random.randFloat(0.9f, 1.1f));
 			instance_data.rot = terrain_tr.rot * instance_rel_rot;
 			instance_data.normal = Vec4(getNormal(x, z), 0);
 		}
@@ -496,7 +529,7 @@ void Terrain::updateGrass(Entity camera)
 		if (quad->pos.x < from_quad_x || quad->pos.x > to_quad_x || quad->pos.z < from_quad_z ||
 			quad->pos.z > to_quad_z)
 		{
-			LUMIX_DELETE(m_allocator, quads[i]);
+			destroyGrassQuad(quads[i]);
 			quads.eraseFast(i);
 		}
 	}
@@ -512,35 +545,54 @@ void Terrain::updateGrass(Entity camera)
 				quad_z <= old_bounds[3])
 				continue;
 
-			PROFILE_BLOCK("generate quad");
-			GrassQuad* quad = LUMIX_NEW(m_allocator, GrassQuad)(m_allocator);
+			GrassQuad* quad = LUMIX_NEW(m_allocator, GrassQuad)(*this, m_allocator);
 			quads.push(quad);
 			quad->pos.x = quad_x;
 			quad->pos.z = quad_z;
+			quad->m_terrain_tr = terrain_tr;
 			quad->m_patches.reserve(m_grass_types.size());
 
-			float min_y = FLT_MAX;
-			float max_y = -FLT_MAX;
 			for (auto& grass_type : m_grass_types)
 			{
 				Model* model = grass_type.m_grass_model;
 				if (!model || !model->isReady()) continue;
 				GrassPatch& patch = quad->m_patches.emplace(m_allocator);
 				patch.m_type = &grass_type;
-
-				generateGrassTypeQuad(patch, terrain_tr, {quad_x / m_scale.x, quad_z / m_scale.z});
-				for (auto instance_data : patch.instance_data)
-				{
-					min_y = Math::minimum(instance_data.pos_scale.y, min_y);
-					max_y = Math::maximum(instance_data.pos_scale.y, max_y);
-				}
 			}
 
-			quad->pos.y = (max_y + min_y) * 0.5f;
-			quad->radius = Math::maximum((max_y - min_y) * 0.5f, GRASS_QUAD_SIZE) * Math::SQRT2;
+			JobSystem::JobDecl job;
+			job.task = &Terrain::generateGrassQuadJob;
+			job.data = quad;
+			JobSystem::runJobs(&job, 1, &quad->m_job_counter);
+		}
+	}
+}
+
+
+void Terrain::generateGrassQuadJob(void* data)
+{
+	GrassQuad* quad = (GrassQuad*)data;
+	quad->m_terrain.generateGrassQuad(*quad);
+}
+
 
+void Terrain::generateGrassQuad(GrassQuad& quad)
+{
+	PROFILE_FUNCTION();
+	float min_y = FLT_MAX;
+	float max_y = -FLT_MAX;
+	for (GrassPatch& patch : quad.m_patches)
+	{
+		generateGrassTypeQuad(patch, quad.m_terrain_tr, {quad.pos.x / m_scale.x, quad.pos.z / m_scale.z});
+		for (auto instance_data : patch.instance_data)
+		{
+			min_y = Math::minimum(instance_data.pos_scale.y, min_y);
+			max_y = Math::maximum(instance_data.pos_scale.y, max_y);
 		}
 	}
+
+	quad.pos.y = (max_y + min_y) * 0.5f;
+	quad.radius = Math::maximum((max_y - min_y) * 0.5f, GRASS_QUAD_SIZE) * Math::SQRT2;
 }
 
 
@@ -562,6 +614,8 @@ void Terrain::getGrassInfos(const Frustum& frustum, Array<GrassInfo>& infos, Ent
 	Matrix mtx = universe.getMatrix(m_entity);
 	for (GrassQuad* quad : quads)
 	{
+		if (!quad->isReady()) continue;
+
 		Vec3 quad_center(quad->pos.x + GRASS_QUAD_SIZE * 0.5f, quad->pos.y, quad->pos.z + GRASS_QUAD_SIZE * 0.5f);
 		quad_center = mtx.transformPoint(quad_center);
 		if (!frustum.isSphereInside(quad_center, quad->radius)) continue;
@@ -592,6 +646,8 @@ void Terrain::setMaterial(Material* material)
 			m_material->getResourceManager().unload(*m_material);
 			m_material->getObserverCb().unbind<Terrain, &Terrain::onMaterialLoaded>(this);
 		}
+		// grass jobs read the material's textures
+		forceGrassUpdate();
 		m_material = material;
 		m_splatmap = nullptr;
 		m_heightmap = nullptr;
@@ -758,6 +814,131 @@ void Terrain::setHeight(int x, int z, float h)
 	ASSERT(t->bytes_per_pixel == 2);
 	int idx = Math::clamp(x, 0, m_width) + Math::clamp(z, 0, m_height) * m_width;
 	((u16*)t->getData())[idx] = (u16)(h * (65535.0f / m_scale.y));
+	updateHeightBounds(x, z, x + 1, z + 1);
+}
+
+
+void Terrain::initHeightBounds()
+{
+	int blocks = (Math::maximum(m_width, m_height) - 1 + HEIGHT_BOUNDS_BLOCK_SIZE - 1) / HEIGHT_BOUNDS_BLOCK_SIZE;
+	m_height_bounds_size = Math::maximum(1, (int)Math::nextPow2(blocks));
+	m_height_bounds_levels = Math::log2(m_height_bounds_size) + 1;
+
+	int count = 0;
+	for (int i = 0; i < m_height_bounds_levels; ++i)
+	{
+		const int size = m_height_bounds_size >> i;
+		count += size * size;
+	}
+	m_height_bounds.resize(count);
+	updateHeightBounds(0, 0, m_width, m_height);
+}
+
+
+const Terrain::HeightBounds& Terrain::getHeightBounds(int level, int x, int z) const
+{
+	int offset = 0;
+	for (int i = 0; i < level; ++i)
+	{
+		const int size = m_height_bounds_size >> i;
+		offset += size * size;
+	}
+	return m_height_bounds[offset + x + z * (m_height_bounds_size >> level)];
+}
+
+
+Terrain::HeightBounds& Terrain::getHeightBounds(int level, int x, int z)
+{
+	return const_cast<HeightBounds&>(static_cast<const Terrain*>(this)->getHeightBounds(level, x, z));
+}
+
+
+void Terrain::updateHeightBounds(int from_x, int from_z, int to_x, int to_z)
+{
+	if (m_height_bounds.empty() || !m_heightmap || !m_heightmap->getData()) return;
+
+	PROFILE_FUNCTION();
+	// a sample is shared by cells on both sides of it
+	int from_bx = Math::maximum(from_x - 1, 0) / HEIGHT_BOUNDS_BLOCK_SIZE;
+	int from_bz = Math::maximum(from_z - 1, 0) / HEIGHT_BOUNDS_BLOCK_SIZE;
+	int to_bx = Math::minimum(Math::maximum(to_x - 1, 0) / HEIGHT_BOUNDS_BLOCK_SIZE, m_height_bounds_size - 1);
+	int to_bz = Math::minimum(Math::maximum(to_z - 1, 0) / HEIGHT_BOUNDS_BLOCK_SIZE, m_height_bounds_size - 1);
+
+	const u16* data = (const u16*)m_heightmap->getData();
+	for (int bz = from_bz; bz <= to_bz; ++bz)
+	{
+		for (int bx = from_bx; bx <= to_bx; ++bx)
+		{
+			HeightBounds& bounds = getHeightBounds(0, bx, bz);
+			bounds.min = 0xffff;
+			bounds.max = 0;
+			const int x0 = bx * HEIGHT_BOUNDS_BLOCK_SIZE;
+			const int z0 = bz * HEIGHT_BOUNDS_BLOCK_SIZE;
+			if (x0 >= m_width - 1 || z0 >= m_height - 1) continue;
+
+			const int x1 = Math::minimum(x0 + HEIGHT_BOUNDS_BLOCK_SIZE, m_width - 1);
+			const int z1 = Math::minimum(z0 + HEIGHT_BOUNDS_BLOCK_SIZE, m_height - 1);
+			for (int z = z0; z <= z1; ++z)
+			{
+				for (int x = x0; x <= x1; ++x)
+				{
+					const u16 h = data[x + z * m_width];
+					bounds.min = Math::minimum(bounds.min, h);
+					bounds.max = Math::maximum(bounds.max, h);
+				}
+			}
+		}
+	}
+
+	for (int level = 1; level < m_height_bounds_levels; ++level)
+	{
+		from_bx >>= 1;
+		from_bz >>= 1;
+		to_bx >>= 1;
+		to_bz >>= 1;
+		for (int bz = from_bz; bz <= to_bz; ++bz)
+		{
+			for (int bx = from_bx; bx <= to_bx; ++bx)
+			{
+				HeightBounds& bounds = getHeightBounds(level, bx, bz);
+				bounds.min = 0xffff;
+				bounds.max = 0;
+				for (int i = 0; i < 4; ++i)
+				{
+					const HeightBounds& child = getHeightBounds(level - 1, bx * 2 + (i & 1), bz * 2 + (i >> 1));
+					bounds.min = Math::minimum(bounds.min, child.min);
+					bounds.max = Math::maximum(bounds.max, child.max);
+				}
+			}
+		}
+	}
+}
+
+
+bool Terrain::isOverlapping(const AABB& aabb) const
+{
+	if (m_height_bounds.empty()) return false;
+	return isOverlapping(aabb, m_height_bounds_levels - 1, 0, 0);
+}
+
+
+bool Terrain::isOverlapping(const AABB& aabb, int level, int x, int z) const
+{
+	const HeightBounds& bounds = getHeightBounds(level, x, z);
+	if (bounds.min > bounds.max) return false;
+
+	const float y_scale = m_scale.y / 65535.0f;
+	const float size = float(HEIGHT_BOUNDS_BLOCK_SIZE << level) * m_scale.x;
+	if (aabb.max.x < x * size || aabb.min.x > (x + 1) * size) return false;
+	if (aabb.max.z < z * size || aabb.min.z > (z + 1) * size) return false;
+	if (aabb.max.y < bounds.min * y_scale || aabb.min.y > bounds.max * y_scale) return false;
+	if (level == 0) return true;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		if (isOverlapping(aabb, level - 1, x * 2 + (i & 1), z * 2 + (i >> 1))) return true;
+	}
+	return false;
 }
 
 
@@ -803,74 +984,109 @@ bool getRayTriangleIntersection(const Vec3& local_origin, const Vec3& local_dir,
 }
 
 
+static bool isRayHittingBox(const Vec3& origin, const Vec3& dir, const Vec3& min, const Vec3& max)
+{
+	float t_near = 0;
+	float t_far = FLT_MAX;
+	for (int i = 0; i < 3; ++i)
+	{
+		const float o = (&origin.x)[i];
+		const float d = (&dir.x)[i];
+		const float box_min = (&min.x)[i];
+		const float box_max = (&max.x)[i];
+		if (Math::abs(d) < 1e-7f)
+		{
+			if (o < box_min || o > box_max) return false;
+			continue;
+		}
+		float t0 = (box_min - o) / d;
+		float t1 = (box_max - o) / d;
+		if (t0 > t1) Math::swap(t0, t1);
+		t_near = Math::maximum(t_near, t0);
+		t_far = Math::minimum(t_far, t1);
+		if (t_near > t_far) return false;
+	}
+	return true;
+}
+
+
 RayCastModelHit Terrain::castRay(const Vec3& origin, const Vec3& dir)
 {
+	PROFILE_FUNCTION();
 	RayCastModelHit hit;
 	hit.m_is_hit = false;
-	if (m_root)
-	{
-		Matrix mtx = m_scene.getUniverse().getMatrix(m_entity);
-		mtx.fastInverse();
-		Vec3 rel_origin = mtx.transformPoint(origin);
-		Vec3 rel_dir = (mtx * Vec4(dir, 0)).xyz();
-		Vec3 start;
-		Vec3 size(m_root->m_size * m_scale.x, m_scale.y * 65535.0f, m_root->m_size * m_scale.x);
-		if (Math::getRayAABBIntersection(rel_origin, rel_dir, m_root->m_min, size, start))
-		{
-			int hx = (int)(start.x / m_scale.x);
-			int hz = (int)(start.z / m_scale.x);
+	if (!m_root || m_height_bounds.empty()) return hit;
+
+	Matrix mtx = m_scene.getUniverse().getMatrix(m_entity);
+	mtx.fastInverse();
+	Vec3 rel_origin = mtx.transformPoint(origin);
+	Vec3 rel_dir = (mtx * Vec4(dir, 0)).xyz();
+	float t;
+	if (castRay(rel_origin, rel_dir, m_height_bounds_levels - 1, 0, 0, t))
+	{
+		hit.m_is_hit = true;
+		hit.m_origin = origin;
+		hit.m_dir = dir;
+		hit.m_t = t;
+	}
+	return hit;
+}
 
-			float next_x = fabs(rel_dir.x) < 0.01f ? hx : ((hx + (rel_dir.x < 0 ? 0 : 1)) * m_scale.x - rel_origin.x) / rel_dir.x;
-			float next_z = fabs(rel_dir.z) < 0.01f ? hz : ((hz + (rel_dir.z < 0 ? 0 : 1)) * m_scale.x - rel_origin.z) / rel_dir.z;
 
-			float delta_x = fabs(rel_dir.x) < 0.01f ? 0 : m_scale.x / Math::abs(rel_dir.x);
-			float delta_z = fabs(rel_dir.z) < 0.01f ? 0 : m_scale.x / Math::abs(rel_dir.z);
-			int step_x = (int)Math::signum(rel_dir.x);
-			int step_z = (int)Math::signum(rel_dir.z);
+bool Terrain::castRay(const Vec3& origin, const Vec3& dir, int level, int x, int z, float& t) const
+{
+	const HeightBounds& bounds = getHeightBounds(level, x, z);
+	if (bounds.min > bounds.max) return false;
+
+	const float y_scale = m_scale.y / 65535.0f;
+	const float size = float(HEIGHT_BOUNDS_BLOCK_SIZE << level) * m_scale.x;
+	const float pad = m_scale.x * 0.01f;
+	const Vec3 min(x * size - pad, bounds.min * y_scale - y_scale, z * size - pad);
+	const Vec3 max((x + 1) * size + pad, bounds.max * y_scale + y_scale, (z + 1) * size + pad);
+	if (!isRayHittingBox(origin, dir, min, max)) return false;
 
-			while (hx >= 0 && hz >= 0 && hx + step_x < m_width && hz + step_z < m_height)
+	if (level > 0)
+	{
+		// children are visited front to back, so the first hit is the closest one
+		const int first = (dir.x < 0 ? 1 : 0) | (dir.z < 0 ? 2 : 0);
+		for (int i = 0; i < 4; ++i)
+		{
+			const int child = i ^ first;
+			if (castRay(origin, dir, level - 1, x * 2 + (child & 1), z * 2 + (child >> 1), t)) return true;
+		}
+		return false;
+	}
+
+	bool is_hit = false;
+	t = FLT_MAX;
+	const int x0 = x * HEIGHT_BOUNDS_BLOCK_SIZE;
+	const int z0 = z * HEIGHT_BOUNDS_BLOCK_SIZE;
+	const int x1 = Math::minimum(x0 + HEIGHT_BOUNDS_BLOCK_SIZE, m_width - 1);
+	const int z1 = Math::minimum(z0 + HEIGHT_BOUNDS_BLOCK_SIZE, m_height - 1);
+	for (int hz = z0; hz < z1; ++hz)
+	{
+		for (int hx = x0; hx < x1; ++hx)
+		{
+			const float cell_x = hx * m_scale.x;
+			const float cell_z = hz * m_scale.x;
+			const Vec3 p0(cell_x, getHeight(hx, hz), cell_z);
+			const Vec3 p1(cell_x + m_scale.x, getHeight(hx + 1, hz), cell_z);
+			const Vec3 p2(cell_x + m_scale.x, getHeight(hx + 1, hz + 1), cell_z + m_scale.x);
+			const Vec3 p3(cell_x, getHeight(hx, hz + 1), cell_z + m_scale.x);
+			float cell_t;
+			if (getRayTriangleIntersection(origin, dir, p0, p1, p2, cell_t) && cell_t < t)
 			{
-				float t;
-				float x = hx * m_scale.x;
-				float z = hz * m_scale.x;
-				Vec3 p0(x, getHeight(x, z), z);
-				Vec3 p1(x + m_scale.x, getHeight(x + m_scale.x, z), z);
-				Vec3 p2(x + m_scale.x, getHeight(x + m_scale.x, z + m_scale.x), z + m_scale.x);
-				Vec3 p3(x, getHeight(x, z + m_scale.x), z + m_scale.x);
-				if (getRayTriangleIntersection(rel_origin, rel_dir, p0, p1, p2, t))
-				{
-					hit.m_is_hit = true;
-					hit.m_origin = origin;
-					hit.m_dir = dir;
-					hit.m_t = t;
-					return hit;
-				}
-				if (getRayTriangleIntersection(rel_origin, rel_dir, p0, p2, p3, t))
-				{
-					hit.m_is_hit = true;
-					hit.m_origin = origin;
-					hit.m_dir = dir;
-					hit.m_t = t;
-					return hit;
-				}
-				if (next_x < next_z)
-				{
-					next_x += delta_x;
-					hx += step_x;
-				}
-				else
-				{
-					next_z += delta_z;
-					hz += step_z;
-				}
-				if (delta_x == 0 && delta_z == 0)
-				{
-					return hit;
-				}
+				t = cell_t;
+				is_hit = true;
+			}
+			if (getRayTriangleIntersection(origin, dir, p0, p2, p3, cell_t) && cell_t < t)
+			{
+				t = cell_t;
+				is_hit = true;
 			}
 		}
 	}
-	return hit;
+	return is_hit;
 }
 
 
@@ -979,6 +1195,7 @@ void Terrain::onMaterialLoaded(Resource::State, Resource::State new_state, Resou
 				m_width = m_heightmap->width;
 				m_height = m_heightmap->height;
 				m_root = generateQuadTree((float)m_width);
+				initHeightBounds();
 			}
 		}
 	}
@@ -986,6 +1203,7 @@ void Terrain::onMaterialLoaded(Resource::State, Resource::State new_state, Resou
 	{
 		LUMIX_DELETE(m_allocator, m_root);
 		m_root = nullptr;
+		m_height_bounds.clear();
 	}
 }
 
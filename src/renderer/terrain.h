@@ -72,13 +72,21 @@ class Terrain
 
 		struct GrassQuad
 		{
-			explicit GrassQuad(IAllocator& allocator)
+			GrassQuad(Terrain& terrain, IAllocator& allocator)
 				: m_patches(allocator)
+				, m_terrain(terrain)
+				, m_job_counter(0)
 			{}
 
+			// instances are generated in a job, the quad must not be rendered until it's ready
+			bool isReady() const { return m_job_counter == 0; }
+
 			Array<GrassPatch> m_patches;
 			Vec3 pos;
 			float radius;
+			Terrain& m_terrain;
+			RigidTransform m_terrain_tr;
+			volatile int m_job_counter;
 		};
 
 	public:
@@ -121,18 +129,38 @@ class Terrain
 		void getGrassInfos(const Frustum& frustum, Array<GrassInfo>& infos, Entity camera);
 
 		RayCastModelHit castRay(const Vec3& origin, const Vec3& dir);
+		// aabb is in terrain space, the test is conservative - it's at block granularity
+		bool isOverlapping(const AABB& aabb) const;
+		// must be called whenever heightmap data in [from, to) changes
+		void updateHeightBounds(int from_x, int from_z, int to_x, int to_z);
 		void serialize(OutputBlob& serializer);
 		void deserialize(InputBlob& serializer, Universe& universe, RenderScene& scene);
 
 		void addGrassType(int index);
 		void removeGrassType(int index);
+		// waits for running grass jobs and drops all quads, call it before changing data the jobs read
 		void forceGrassUpdate();
 
+	private: 
+		struct HeightBounds
+		{
+			u16 min;
+			u16 max;
+		};
+
 	private: 
 		Array<Terrain::GrassQuad*>& getQuads(Entity camera);
+		void initHeightBounds();
+		const HeightBounds& getHeightBounds(int level, int x, int z) const;
+		HeightBounds& getHeightBounds(int level, int x, int z);
+		bool castRay(const Vec3& origin, const Vec3& dir, int level, int x, int z, float& t) const;
+		bool isOverlapping(const AABB& aabb, int level, int x, int z) const;
 		TerrainQuad* generateQuadTree(float size);
 		void updateGrass(Entity camera);
+		void generateGrassQuad(GrassQuad& quad);
 		void generateGrassTypeQuad(GrassPatch& patch, const RigidTransform& terrain_tr, const Vec2& quad_pos_hm_space);
+		void destroyGrassQuad(GrassQuad* quad);
+		static void generateGrassQuadJob(void* data);
 		void generateGeometry();
 		void onMaterialLoaded(Resource::State, Resource::State new_state, Resource&);
 		void grassLoaded(Resource::State, Resource::State, Resource&);
@@ -156,6 +184,10 @@ class Terrain
 		AssociativeArray<Entity, Vec3> m_last_camera_position;
 		bool m_force_grass_update;
 		Renderer& m_renderer;
+		// min/max mip pyramid of heightmap blocks, finest level first
+		Array<HeightBounds> m_height_bounds;
+		int m_height_bounds_levels;
+		int m_height_bounds_size;
 };
 
 
@@ -1,6 +1,7 @@
 #include "engine/fs/file_system.h"
 #include "engine/log.h"
 #include "engine/math_utils.h"
+#include "engine/mt/atomic.h"
 #include "engine/path_utils.h"
 #include "engine/profiler.h"
 #include "engine/resource_manager.h"
@@ -17,6 +18,15 @@ namespace Lumix
 const ResourceType Texture::TYPE("texture");
 
 
+static i32 squaredDistanceToBits(float squared_distance)
+{
+	// non-negative floats keep their ordering when compared as integers
+	i32 bits;
+	copyMemory(&bits, &squared_distance, sizeof(bits));
+	return bits;
+}
+
+
 Texture::Texture(const Path& path, ResourceManagerBase& resource_manager, IAllocator& _allocator)
 	: Resource(path, resource_manager, _allocator)
 	, data_reference(0)
@@ -25,6 +35,13 @@ Texture::Texture(const Path& path, ResourceManagerBase& resource_manager, IAlloc
 	, bytes_per_pixel(-1)
 	, depth(-1)
 	, layers(1)
+	, mip_skip(0)
+	, is_streamed(false)
+	, m_streaming_distance(NO_STREAMING_REQUEST)
+	, m_streaming_max_skip(0)
+	, m_streaming_requested_skip(0)
+	, m_streaming_async_op(FS::FileSystem::INVALID_ASYNC)
+	, m_streaming_last_use(0)
 {
 	bgfx_flags = 0;
 	is_cubemap = false;
@@ -624,11 +641,55 @@ void Texture::removeDataReference()
 }
 
 
-static bool loadDDSorKTX(Texture& texture, FS::IFile& file)
+void Texture::requestStreaming(float squared_distance)
+{
+	// called from culling jobs, keep the smallest distance requested this frame
+	i32 value = squaredDistanceToBits(squared_distance);
+	for (;;)
+	{
+		i32 current = m_streaming_distance;
+		if (current <= value) return;
+		if (MT::compareAndExchange(&m_streaming_distance, value, current)) return;
+	}
+}
+
+
+static bool getDDSorKTXInfo(FS::IFile& file, bool is_ktx, int* width, int* height, int* mips)
+{
+	const u8* mem = (const u8*)file.getBuffer();
+	size_t size = file.size();
+	u32 w, h, m;
+	if (is_ktx)
+	{
+		if (size < 64) return false;
+		copyMemory(&w, mem + 36, sizeof(w));
+		copyMemory(&h, mem + 40, sizeof(h));
+		copyMemory(&m, mem + 56, sizeof(m));
+	}
+	else
+	{
+		if (size < 32) return false;
+		copyMemory(&h, mem + 12, sizeof(h));
+		copyMemory(&w, mem + 16, sizeof(w));
+		copyMemory(&m, mem + 28, sizeof(m));
+	}
+	*width = (int)w;
+	*height = (int)h;
+	*mips = Math::maximum((int)m, 1);
+	return true;
+}
+
+
+static bool loadDDSorKTX(Texture& texture, FS::IFile& file, int skip)
 {
 	bgfx::TextureInfo info;
 	const auto* mem = bgfx::copy(file.getBuffer(), (u32)file.size());
-	texture.handle = bgfx::createTexture(mem, texture.bgfx_flags, 0, &info);
+	bgfx::TextureHandle handle = bgfx::createTexture(mem, texture.bgfx_flags, (u8)skip, &info);
+	if (!bgfx::isValid(handle)) return false;
+
+	// streaming replaces the handle of a ready texture, bgfx defers the destruction until the frame is done
+	if (bgfx::isValid(texture.handle)) bgfx::destroy(texture.handle);
+	texture.handle = handle;
 	bgfx::setName(texture.handle, texture.getPath().c_str());
 	texture.width = info.width;
 	texture.mips = info.numMips;
@@ -636,7 +697,37 @@ static bool loadDDSorKTX(Texture& texture, FS::IFile& file)
 	texture.depth = info.depth;
 	texture.layers = info.numLayers;
 	texture.is_cubemap = info.cubeMap;
-	return bgfx::isValid(texture.handle);
+	texture.mip_skip = skip;
+	return true;
+}
+
+
+void Texture::streamMips(int skip)
+{
+	ASSERT(is_streamed);
+	m_streaming_requested_skip = skip;
+	if (m_streaming_async_op != FS::FileSystem::INVALID_ASYNC) return;
+
+	FS::FileSystem& fs = m_resource_manager.getOwner().getFileSystem();
+	FS::ReadCallback cb;
+	cb.bind<Texture, &Texture::streamedFileLoaded>(this);
+	m_streaming_async_op = fs.openAsync(fs.getDefaultDevice(), getPath(), FS::Mode::OPEN_AND_READ, cb);
+}
+
+
+void Texture::streamedFileLoaded(FS::IFile& file, bool success)
+{
+	m_streaming_async_op = FS::FileSystem::INVALID_ASYNC;
+	if (!isReady() || m_streaming_requested_skip == mip_skip) return;
+
+	if (!success || !loadDDSorKTX(*this, file, m_streaming_requested_skip))
+	{
+		g_log_warning.log("Renderer") << "Could not stream mips of " << getPath().c_str();
+		m_streaming_requested_skip = mip_skip;
+		return;
+	}
+
+	static_cast<TextureManager&>(m_resource_manager).onStreamedTextureChanged(*this);
 }
 
 
@@ -649,7 +740,26 @@ bool Texture::load(FS::IFile& file)
 	bool loaded = false;
 	if (len > 3 && (equalStrings(path + len - 4, ".dds") || equalStrings(path + len - 4, ".ktx")))
 	{
-		loaded = loadDDSorKTX(*this, file);
+		// streamed textures start with only the mips up to the minimal size, the rest is requested later
+		TextureManager& manager = static_cast<TextureManager&>(getResourceManager());
+		bool is_ktx = equalStrings(path + len - 4, ".ktx");
+		int full_width, full_height, total_mips;
+		int skip = 0;
+		if (manager.isStreamingEnabled() && data_reference == 0 &&
+			getDDSorKTXInfo(file, is_ktx, &full_width, &full_height, &total_mips))
+		{
+			int min_size = manager.getStreamingMinSize();
+			while (skip < total_mips - 1 && Math::maximum(full_width >> skip, full_height >> skip) > min_size) ++skip;
+			m_streaming_max_skip = skip;
+		}
+		loaded = loadDDSorKTX(*this, file, skip);
+		if (loaded && skip > 0)
+		{
+			is_streamed = true;
+			m_streaming_requested_skip = skip;
+			m_streaming_distance = NO_STREAMING_REQUEST;
+			manager.addStreamedTexture(*this);
+		}
 	}
 	else if (len > 3 && equalStrings(path + len - 4, ".raw"))
 	{
@@ -672,6 +782,17 @@ bool Texture::load(FS::IFile& file)
 
 void Texture::unload()
 {
+	if (m_streaming_async_op != FS::FileSystem::INVALID_ASYNC)
+	{
+		m_resource_manager.getOwner().getFileSystem().cancelAsync(m_streaming_async_op);
+		m_streaming_async_op = FS::FileSystem::INVALID_ASYNC;
+	}
+	if (is_streamed)
+	{
+		static_cast<TextureManager&>(m_resource_manager).removeStreamedTexture(*this);
+		is_streamed = false;
+	}
+	mip_skip = 0;
 	if (bgfx::isValid(handle))
 	{
 		bgfx::destroy(handle);
@@ -53,6 +53,7 @@ class LUMIX_RENDERER_API Texture LUMIX_FINAL : public Resource
 		void setFlag(u32 flag, bool value);
 		u32 getPixelNearest(int x, int y) const;
 		u32 getPixel(float x, float y) const;
+		void requestStreaming(float squared_distance);
 
 		static unsigned int compareTGA(FS::IFile* file1, FS::IFile* file2, int difference, IAllocator& allocator);
 		static bool saveTGA(FS::IFile* file,
@@ -79,11 +80,26 @@ class LUMIX_RENDERER_API Texture LUMIX_FINAL : public Resource
 		IAllocator& allocator;
 		int data_reference;
 		Array<u8> data;
+		int mip_skip;
+		bool is_streamed;
 
 	private:
+		friend class TextureManager;
+
 		void unload() override;
 		bool load(FS::IFile& file) override;
 		bool loadTGA(FS::IFile& file);
+		void streamMips(int skip);
+		void streamedFileLoaded(FS::IFile& file, bool success);
+
+	private:
+		static const i32 NO_STREAMING_REQUEST = 0x7f7fFFFF; // FLT_MAX bits
+
+		volatile i32 m_streaming_distance;
+		int m_streaming_max_skip;
+		int m_streaming_requested_skip;
+		u32 m_streaming_async_op;
+		u32 m_streaming_last_use;
 };
 
 
@@ -1,14 +1,38 @@
 #include "engine/lumix.h"
 #include "renderer/texture_manager.h"
 
+#include "engine/fs/file_system.h"
+#include "engine/math_utils.h"
+#include "engine/profiler.h"
 #include "engine/resource.h"
 #include "renderer/texture.h"
+#include <algorithm>
 
 namespace Lumix
 {
+	static const int MAX_PENDING_STREAMING_REQUESTS = 8;
+	static const u32 STREAMING_DROP_FRAMES = 120;
+
+
+	static u64 getStreamedSize(const Texture& texture, int skip)
+	{
+		// each mip level has a quarter of the texels of the previous one
+		return (u64)texture.size() >> (2 * skip);
+	}
+
+
 	TextureManager::TextureManager(IAllocator& allocator)
 		: ResourceManagerBase(allocator)
 		, m_allocator(allocator)
+		, m_is_streaming_enabled(false)
+		, m_streaming_budget(256 * 1024 * 1024)
+		, m_streaming_memory(0)
+		, m_streaming_distance(10)
+		, m_streaming_min_size(64)
+		, m_streaming_frame(0)
+		, m_streamed_textures(allocator)
+		, m_streaming_changes(allocator)
+		, m_streaming_requests(allocator)
 	{
 		m_buffer = nullptr;
 		m_buffer_size = -1;
@@ -46,4 +70,109 @@ namespace Lumix
 		}
 		return m_buffer;
 	}
-}
\ No newline at end of file
+
+	void TextureManager::addStreamedTexture(Texture& texture)
+	{
+		texture.m_streaming_last_use = m_streaming_frame;
+		m_streamed_textures.push(&texture);
+	}
+
+	void TextureManager::removeStreamedTexture(Texture& texture)
+	{
+		m_streamed_textures.eraseItemFast(&texture);
+		m_streaming_changes.eraseItemFast(&texture);
+	}
+
+	void TextureManager::onStreamedTextureChanged(Texture& texture)
+	{
+		if (m_streaming_changes.indexOf(&texture) < 0) m_streaming_changes.push(&texture);
+	}
+
+	int TextureManager::getDesiredMipSkip(const Texture& texture, i32 distance_bits) const
+	{
+		float squared_distance;
+		copyMemory(&squared_distance, &distance_bits, sizeof(squared_distance));
+		float ratio = squared_distance / (m_streaming_distance * m_streaming_distance);
+		if (ratio <= 1) return 0;
+		if (ratio >= 0xffffFFFF) return texture.m_streaming_max_skip;
+
+		// log4 of squared distance ratio == log2 of distance ratio, i.e. one mip per doubled distance
+		int skip = Math::log2((u32)ratio) >> 1;
+		return Math::minimum(skip, texture.m_streaming_max_skip);
+	}
+
+	void TextureManager::updateStreaming()
+	{
+		PROFILE_FUNCTION();
+		m_streaming_changes.clear();
+		if (!m_is_streaming_enabled) return;
+
+		++m_streaming_frame;
+		m_streaming_requests.clear();
+		u64 memory = 0;
+		int pending = 0;
+		for (Texture* texture : m_streamed_textures)
+		{
+			memory += getStreamedSize(*texture, texture->m_streaming_requested_skip);
+			if (texture->m_streaming_async_op != FS::FileSystem::INVALID_ASYNC) ++pending;
+		}
+
+		for (Texture* texture : m_streamed_textures)
+		{
+			i32 distance_bits = texture->m_streaming_distance;
+			texture->m_streaming_distance = Texture::NO_STREAMING_REQUEST;
+			int current_skip = texture->m_streaming_requested_skip;
+			int skip;
+			if (distance_bits != Texture::NO_STREAMING_REQUEST)
+			{
+				texture->m_streaming_last_use = m_streaming_frame;
+				skip = getDesiredMipSkip(*texture, distance_bits);
+			}
+			else if (m_streaming_frame - texture->m_streaming_last_use > STREAMING_DROP_FRAMES)
+			{
+				skip = texture->m_streaming_max_skip;
+			}
+			else
+			{
+				continue;
+			}
+
+			if (skip > current_skip)
+			{
+				// dropping mips frees memory, do not wait for the budget
+				memory -= getStreamedSize(*texture, current_skip) - getStreamedSize(*texture, skip);
+				if (texture->m_streaming_async_op == FS::FileSystem::INVALID_ASYNC) ++pending;
+				texture->streamMips(skip);
+			}
+			else if (skip < current_skip)
+			{
+				m_streaming_requests.push({texture, distance_bits, skip});
+			}
+		}
+
+		if (!m_streaming_requests.empty())
+		{
+			StreamingRequest* begin = &m_streaming_requests[0];
+			std::sort(begin, begin + m_streaming_requests.size(), [](const StreamingRequest& a, const StreamingRequest& b) {
+				return a.distance_bits < b.distance_bits;
+			});
+		}
+
+		for (const StreamingRequest& request : m_streaming_requests)
+		{
+			if (pending >= MAX_PENDING_STREAMING_REQUESTS) break;
+
+			Texture* texture = request.texture;
+			u64 current_size = getStreamedSize(*texture, texture->m_streaming_requested_skip);
+			u64 new_memory = memory - current_size + getStreamedSize(*texture, request.skip);
+			if (new_memory > m_streaming_budget) continue;
+
+			memory = new_memory;
+			if (texture->m_streaming_async_op == FS::FileSystem::INVALID_ASYNC) ++pending;
+			texture->streamMips(request.skip);
+		}
+		m_streaming_memory = memory;
+		PROFILE_INT("streamed textures", m_streamed_textures.size());
+		PROFILE_INT("pending streaming requests", pending);
+	}
+}
@@ -1,24 +1,63 @@
 #pragma once
 
+#include "engine/array.h"
 #include "engine/resource_manager_base.h"
 
 namespace Lumix
 {
+	class Texture;
+
 	class LUMIX_RENDERER_API TextureManager LUMIX_FINAL : public ResourceManagerBase
 	{
+	friend class Texture;
 	public:
 		explicit TextureManager(IAllocator& allocator);
 		~TextureManager();
 
 		u8* getBuffer(i32 size);
 
+		void enableStreaming(bool enable) { m_is_streaming_enabled = enable; }
+		bool isStreamingEnabled() const { return m_is_streaming_enabled; }
+		void setStreamingBudget(u64 bytes) { m_streaming_budget = bytes; }
+		u64 getStreamingBudget() const { return m_streaming_budget; }
+		u64 getStreamingMemory() const { return m_streaming_memory; }
+		void setStreamingDistance(float distance) { m_streaming_distance = distance; }
+		float getStreamingDistance() const { return m_streaming_distance; }
+		int getStreamingMinSize() const { return m_streaming_min_size; }
+		int getStreamedTexturesCount() const { return m_streamed_textures.size(); }
+		// textures which got a new handle since the last updateStreaming
+		const Array<Texture*>& getStreamingChanges() const { return m_streaming_changes; }
+		void updateStreaming();
+
 	protected:
 		Resource* createResource(const Path& path) override;
 		void destroyResource(Resource& resource) override;
 
 	private:
+		void addStreamedTexture(Texture& texture);
+		void removeStreamedTexture(Texture& texture);
+		void onStreamedTextureChanged(Texture& texture);
+		int getDesiredMipSkip(const Texture& texture, i32 distance_bits) const;
+
+	private:
+		struct StreamingRequest
+		{
+			Texture* texture;
+			i32 distance_bits;
+			int skip;
+		};
+
 		IAllocator& m_allocator;
 		u8* m_buffer;
 		i32 m_buffer_size;
+		bool m_is_streaming_enabled;
+		u64 m_streaming_budget;
+		u64 m_streaming_memory;
+		float m_streaming_distance;
+		int m_streaming_min_size;
+		u32 m_streaming_frame;
+		Array<Texture*> m_streamed_textures;
+		Array<Texture*> m_streaming_changes;
+		Array<StreamingRequest> m_streaming_requests;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,489 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "animation/animation.h"
+#include "engine/blob.h"
+#include "engine/crc32.h"
+#include "engine/fs/file_system.h"
+#include "engine/fs/ifile_device.h"
+#include "engine/log.h"
+#include "engine/math_utils.h"
+#include "engine/mt/thread.h"
+#include "engine/path.h"
+#include "engine/quat.h"
+#include "engine/resource_manager.h"
+#include "engine/string.h"
+#include "engine/timer.h"
+#include "engine/vec.h"
+#include "renderer/pose.h"
+
+
+using namespace Lumix;
+
+
+namespace
+{
+
+
+struct AnimationFileDevice;
+
+
+struct AnimationFile LUMIX_FINAL : public FS::IFile
+{
+	AnimationFile(FS::IFileDevice& device, const OutputBlob& blob)
+		: m_device(device)
+		, m_blob(blob)
+		, m_pos(0)
+	{}
+
+	bool open(const Path& path, FS::Mode mode) override
+	{
+		m_pos = 0;
+		return endsWith(path.c_str(), ".ani");
+	}
+
+	void close() override {}
+	bool write(const void* buffer, size_t size) override { return false; }
+	const void* getBuffer() const override { return m_blob.getData(); }
+	size_t size() override { return m_blob.getPos(); }
+	size_t pos() override { return m_pos; }
+	FS::IFileDevice& getDevice() override { return m_device; }
+
+	bool read(void* buffer, size_t size) override
+	{
+		if (m_pos + size > (size_t)m_blob.getPos()) return false;
+		copyMemory(buffer, (const u8*)m_blob.getData() + m_pos, size);
+		m_pos += size;
+		return true;
+	}
+
+	bool seek(FS::SeekMode base, size_t pos) override
+	{
+		if (base != FS::SeekMode::BEGIN || pos > (size_t)m_blob.getPos()) return false;
+		m_pos = pos;
+		return true;
+	}
+
+	FS::IFileDevice& m_device;
+	const OutputBlob& m_blob;
+	size_t m_pos;
+};
+
+
+// every file on this device has the content of the blob
+struct AnimationFileDevice LUMIX_FINAL : public FS::IFileDevice
+{
+	AnimationFileDevice(const OutputBlob& blob, IAllocator& allocator)
+		: m_blob(blob)
+		, m_allocator(allocator)
+	{}
+
+	FS::IFile* createFile(FS::IFile*) override { return LUMIX_NEW(m_allocator, AnimationFile)(*this, m_blob); }
+	void destroyFile(FS::IFile* file) override { LUMIX_DELETE(m_allocator, file); }
+	const char* name() const override { return "anim"; }
+
+	const OutputBlob& m_blob;
+	IAllocator& m_allocator;
+};
+
+
+// each bone moves linearly from (bone, 0, 0) to (bone, frames_count, 0), with a key every key_step frames
+void writeAnimation(OutputBlob& blob, int bones_count, int frames_count, int key_step)
+{
+	Animation::Header header;
+	header.magic = Animation::HEADER_MAGIC;
+	header.version = 3;
+	header.fps = 30;
+	blob.write(header);
+	blob.write(-1); // root motion bone
+	blob.write(frames_count);
+	blob.write(bones_count);
+	int keys_count = (frames_count + key_step - 1) / key_step + 1;
+	for (int i = 0; i < bones_count; ++i)
+	{
+		StaticString<32> name("bone", i);
+		blob.write(crc32(name.data));
+		for (int k = 0; k < 2; ++k)
+		{
+			blob.write(keys_count);
+			for (int j = 0; j < keys_count; ++j) blob.write(u16(Math::minimum(j * key_step, frames_count)));
+			for (int j = 0; j < keys_count; ++j)
+			{
+				if (k == 0) blob.write(Vec3(float(i), float(Math::minimum(j * key_step, frames_count)), 0));
+				else blob.write(Quat::IDENTITY);
+			}
+		}
+	}
+}
+
+
+// same motion as writeAnimation, keys on every frame, rotating around Z by 0.05 radians per frame;
+// z is constant and not stored in keys, x is stored in one byte, y in two bytes
+void writeQuantizedAnimation(OutputBlob& blob, int bones_count, int frames_count)
+{
+	static const int GROUP_SIZE = Animation::QUANTIZED_GROUP_SIZE;
+
+	Animation::Header header;
+	header.magic = Animation::HEADER_MAGIC;
+	header.version = 4;
+	header.fps = 30;
+	blob.write(header);
+	blob.write(-1); // root motion bone
+	blob.write((u32)Animation::Flags::QUANTIZED);
+	blob.write(frames_count);
+	blob.write(bones_count);
+	for (int i = 0; i < bones_count; ++i)
+	{
+		StaticString<32> name("bone", i);
+		blob.write(crc32(name.data));
+		blob.write(u8(Animation::POSITION | Animation::ROTATION));
+	}
+	for (int first = 0; first < bones_count; first += GROUP_SIZE)
+	{
+		blob.write(frames_count + 1);
+		u8 pos_bytes[4] = { 1, 2, 0, 0 };
+		blob.write(pos_bytes);
+		float pos_min[3][GROUP_SIZE];
+		float pos_scale[3][GROUP_SIZE];
+		for (int lane = 0; lane < GROUP_SIZE; ++lane)
+		{
+			pos_min[0][lane] = float(first + lane);
+			pos_min[1][lane] = pos_min[2][lane] = 0;
+			pos_scale[0][lane] = 1 / 255.0f;
+			pos_scale[2][lane] = 0;
+			pos_scale[1][lane] = frames_count / 65535.0f;
+		}
+		blob.write(pos_min);
+		blob.write(pos_scale);
+		for (int j = 0; j <= frames_count; ++j) blob.write(u16(j));
+		for (int j = 0; j <= frames_count; ++j)
+		{
+			u8 x_key[GROUP_SIZE] = {};
+			u16 key[4 * GROUP_SIZE] = {};
+			Quat rot(Vec3(0, 0, 1), j * 0.05f);
+			for (int lane = 0; lane < GROUP_SIZE; ++lane)
+			{
+				key[lane] = u16(j * 65535.0f / frames_count + 0.5f);
+				u16 rot_key[3] = {};
+				Animation::quantizeRotation(rot, rot_key);
+				for (int k = 0; k < 3; ++k) key[(1 + k) * GROUP_SIZE + lane] = rot_key[k];
+			}
+			blob.write(x_key);
+			blob.write(key);
+		}
+	}
+}
+
+
+void resetPose(Pose& pose)
+{
+	for (int i = 0; i < pose.count; ++i)
+	{
+		pose.positions[i].set(0, 0, -1);
+		pose.rotations[i] = Quat::IDENTITY;
+	}
+}
+
+
+struct AnimationTest
+{
+	AnimationTest(int bones_count, int frames_count, int key_step, IAllocator& allocator, bool quantized = false)
+		: blob(allocator)
+		, device(blob, allocator)
+		, resource_manager(allocator)
+		, manager(allocator)
+	{
+		if (quantized) writeQuantizedAnimation(blob, bones_count, frames_count);
+		else writeAnimation(blob, bones_count, frames_count, key_step);
+		file_system = FS::FileSystem::create(allocator);
+		file_system->mount(&device);
+		file_system->setDefaultDevice("anim");
+		resource_manager.create(*file_system);
+		manager.create(Animation::TYPE, resource_manager);
+
+		animation = static_cast<Animation*>(manager.load(Path("test.ani")));
+		for (int i = 0; i < 1000 && animation->isEmpty(); ++i)
+		{
+			file_system->updateAsyncTransactions();
+			MT::sleep(1);
+		}
+	}
+
+	~AnimationTest()
+	{
+		manager.unload(*animation);
+		manager.destroy();
+		resource_manager.destroy();
+		file_system->unMount(&device);
+		FS::FileSystem::destroy(file_system);
+	}
+
+	OutputBlob blob;
+	AnimationFileDevice device;
+	FS::FileSystem* file_system;
+	ResourceManager resource_manager;
+	AnimationManager manager;
+	Animation* animation;
+};
+
+
+void UT_animation_remap(const char* params)
+{
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	{
+		AnimationTest test(3, 10, 1, allocator);
+		Animation& animation = *test.animation;
+		LUMIX_EXPECT(animation.isReady());
+		LUMIX_EXPECT(animation.getBoneCount() == 3);
+
+		Pose pose(allocator);
+		pose.resize(3);
+		resetPose(pose);
+
+		// animation bone 0 drives model bone 2, animation bone 2 is not in the model
+		const int model_bones[] = { 2, 0, -1 };
+		animation.getRelativePose(5 / 30.0f, pose, model_bones, nullptr);
+		LUMIX_EXPECT_CLOSE_EQ(pose.positions[2].x, 0, 0.001f);
+		LUMIX_EXPECT_CLOSE_EQ(pose.positions[2].y, 5, 0.001f);
+		LUMIX_EXPECT_CLOSE_EQ(pose.positions[0].x, 1, 0.001f);
+		LUMIX_EXPECT_CLOSE_EQ(pose.positions[0].y, 5, 0.001f);
+		LUMIX_EXPECT_CLOSE_EQ(pose.positions[1].z, -1, 0.001f);
+
+		// only model bone 0 is in the mask
+		const u64 mask_bits[] = { 1 };
+		resetPose(pose);
+		animation.getRelativePose(5 / 30.0f, pose, model_bones, mask_bits, 0.5f);
+		LUMIX_EXPECT_CLOSE_EQ(pose.positions[0].y, 2.5f, 0.001f);
+		LUMIX_EXPECT_CLOSE_EQ(pose.positions[2].z, -1, 0.001f);
+	}
+}
+
+
+void UT_animation_sampling_bench(const char* params)
+{
+	static const int CHARACTERS_COUNT = 300;
+	static const int CLIPS_COUNT = 3;
+	static const int BONES_COUNT = 80;
+	static const int FRAMES_COUNT = 20;
+
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	{
+		AnimationTest test(BONES_COUNT, 30, 1, allocator);
+		Animation& animation = *test.animation;
+		LUMIX_EXPECT(animation.isReady());
+
+		HashMap<u32, int> bone_map(allocator);
+		u32 bone_names[BONES_COUNT];
+		for (int i = 0; i < BONES_COUNT; ++i)
+		{
+			StaticString<32> name("bone", i);
+			bone_names[i] = crc32(name.data);
+			bone_map.insert(bone_names[i], BONES_COUNT - 1 - i);
+		}
+		int model_bones[BONES_COUNT];
+		Pose pose(allocator);
+		pose.resize(BONES_COUNT);
+		resetPose(pose);
+
+		// remap built from the bone names on every sample, as it is done without the cached tables
+		ScopedTimer lookup_timer("Sampling with lookups", allocator);
+		for (int frame = 0; frame < FRAMES_COUNT; ++frame)
+		{
+			for (int i = 0; i < CHARACTERS_COUNT * CLIPS_COUNT; ++i)
+			{
+				for (int j = 0; j < BONES_COUNT; ++j)
+				{
+					auto iter = bone_map.find(bone_names[j]);
+					model_bones[j] = iter.isValid() ? iter.value() : -1;
+				}
+				resetPose(pose);
+				animation.getRelativePose(frame / 30.0f, pose, model_bones, nullptr, 0.5f);
+			}
+		}
+		float lookup_time = lookup_timer.getTimeSinceStart();
+
+		ScopedTimer remap_timer("Sampling with remap table", allocator);
+		for (int frame = 0; frame < FRAMES_COUNT; ++frame)
+		{
+			for (int i = 0; i < CHARACTERS_COUNT * CLIPS_COUNT; ++i)
+			{
+				resetPose(pose);
+				animation.getRelativePose(frame / 30.0f, pose, model_bones, nullptr, 0.5f);
+			}
+		}
+		float remap_time = remap_timer.getTimeSinceStart();
+
+		g_log_info.log("unit") << "bench: " << FRAMES_COUNT << " frames of " << CHARACTERS_COUNT << " characters x "
+			<< CLIPS_COUNT << " clips x " << BONES_COUNT << " bones sampled in " << lookup_time
+			<< "s with bone lookups, " << remap_time << "s with remap table";
+		LUMIX_EXPECT(model_bones[0] == BONES_COUNT - 1);
+	}
+}
+
+
+void UT_animation_keys(const char* params)
+{
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	{
+		// keys on every third frame are searched, keys on every frame are indexed directly
+		AnimationTest sparse(1, 10, 3, allocator);
+		AnimationTest uniform(1, 10, 1, allocator);
+		LUMIX_EXPECT(sparse.animation->isReady());
+		LUMIX_EXPECT(uniform.animation->isReady());
+
+		Pose pose(allocator);
+		pose.resize(1);
+		const int model_bones[] = { 0 };
+		for (int frame = 0; frame < 10; ++frame)
+		{
+			float time = (frame + 0.5f) / 30.0f;
+			sparse.animation->getRelativePose(time, pose, model_bones, nullptr);
+			LUMIX_EXPECT_CLOSE_EQ(pose.positions[0].y, frame + 0.5f, 0.001f);
+			uniform.animation->getRelativePose(time, pose, model_bones, nullptr);
+			LUMIX_EXPECT_CLOSE_EQ(pose.positions[0].y, frame + 0.5f, 0.001f);
+			LUMIX_EXPECT_CLOSE_EQ(sparse.animation->getBoneTransform(time, 0).pos.y, frame + 0.5f, 0.001f);
+		}
+	}
+}
+
+
+void UT_animation_clip_length_bench(const char* params)
+{
+	static const int BONES_COUNT = 80;
+	static const int SAMPLES_COUNT = 2000;
+
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	{
+		Pose pose(allocator);
+		pose.resize(BONES_COUNT);
+		resetPose(pose);
+		int model_bones[BONES_COUNT];
+		for (int i = 0; i < BONES_COUNT; ++i) model_bones[i] = i;
+
+		const int frames_counts[] = { 30, 3000, 30000 };
+		for (int key_step = 1; key_step <= 2; ++key_step)
+		{
+			for (int frames_count : frames_counts)
+			{
+				AnimationTest test(BONES_COUNT, frames_count, key_step, allocator);
+				LUMIX_EXPECT(test.animation->isReady());
+
+				// sample near the end, where a linear key search would be the slowest
+				float time = (frames_count - 1) / 30.0f;
+				ScopedTimer timer("Animation sampling", allocator);
+				for (int i = 0; i < SAMPLES_COUNT; ++i)
+				{
+					test.animation->getRelativePose(time, pose, model_bones, nullptr);
+				}
+				float sampling_time = timer.getTimeSinceStart();
+				g_log_info.log("unit") << "bench: " << SAMPLES_COUNT << " samples of " << BONES_COUNT << " bones at the end of "
+					<< frames_count << " frames long clip with a key every " << key_step << " frames in " << sampling_time << "s";
+				LUMIX_EXPECT_CLOSE_EQ(pose.positions[0].y, float(frames_count - 1), 0.1f);
+			}
+		}
+	}
+}
+
+
+void UT_animation_quantized(const char* params)
+{
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	{
+		// 6 bones, so the second group is only partially used
+		AnimationTest test(6, 20, 1, allocator, true);
+		Animation& animation = *test.animation;
+		LUMIX_EXPECT(animation.isReady());
+		LUMIX_EXPECT(animation.isQuantized());
+		LUMIX_EXPECT(animation.getBoneCount() == 6);
+
+		Pose pose(allocator);
+		pose.resize(6);
+		resetPose(pose);
+		const int model_bones[] = { 5, 4, 3, 2, 1, 0 };
+		for (int frame = 0; frame < 20; ++frame)
+		{
+			float time = (frame + 0.5f) / 30.0f;
+			animation.getRelativePose(time, pose, model_bones, nullptr);
+			Quat expected_rot(Vec3(0, 0, 1), (frame + 0.5f) * 0.05f);
+			for (int i = 0; i < 6; ++i)
+			{
+				const Vec3& pos = pose.positions[model_bones[i]];
+				const Quat& rot = pose.rotations[model_bones[i]];
+				LUMIX_EXPECT_CLOSE_EQ(pos.x, float(i), 0.001f);
+				LUMIX_EXPECT_CLOSE_EQ(pos.y, frame + 0.5f, 0.01f);
+				LUMIX_EXPECT_CLOSE_EQ(pos.z, 0, 0.001f);
+				LUMIX_EXPECT_CLOSE_EQ(Math::abs(rot.z * expected_rot.z + rot.w * expected_rot.w), 1, 0.001f);
+				LUMIX_EXPECT_CLOSE_EQ(rot.x, 0, 0.001f);
+			}
+			RigidTransform tr = animation.getBoneTransform(time, 5);
+			LUMIX_EXPECT_CLOSE_EQ(tr.pos.x, 5, 0.001f);
+			LUMIX_EXPECT_CLOSE_EQ(tr.pos.y, frame + 0.5f, 0.01f);
+		}
+
+		// past the end the last key is used
+		animation.getRelativePose(1.0f, pose, model_bones, nullptr);
+		LUMIX_EXPECT_CLOSE_EQ(pose.positions[0].y, 20, 0.01f);
+
+		// masked bones are left untouched, weighted ones are blended
+		const u64 mask_bits[] = { 1 };
+		resetPose(pose);
+		animation.getRelativePose(10 / 30.0f, pose, model_bones, mask_bits, 0.5f);
+		LUMIX_EXPECT_CLOSE_EQ(pose.positions[0].x, 2.5f, 0.001f);
+		LUMIX_EXPECT_CLOSE_EQ(pose.positions[0].y, 5, 0.01f);
+		LUMIX_EXPECT_CLOSE_EQ(pose.positions[1].z, -1, 0.001f);
+	}
+}
+
+
+void UT_animation_quantized_bench(const char* params)
+{
+	static const int BONES_COUNT = 80;
+	static const int FRAMES_COUNT = 300;
+	static const int SAMPLES_COUNT = 20000;
+
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	{
+		Pose pose(allocator);
+		pose.resize(BONES_COUNT);
+		resetPose(pose);
+		int model_bones[BONES_COUNT];
+		for (int i = 0; i < BONES_COUNT; ++i) model_bones[i] = i;
+
+		float times[2];
+		size_t sizes[2];
+		for (int quantized = 0; quantized < 2; ++quantized)
+		{
+			AnimationTest test(BONES_COUNT, FRAMES_COUNT, 1, allocator, quantized != 0);
+			LUMIX_EXPECT(test.animation->isReady());
+			ScopedTimer timer("Animation sampling", allocator);
+			for (int i = 0; i < SAMPLES_COUNT; ++i)
+			{
+				float time = (i % (FRAMES_COUNT * 10)) / 300.0f;
+				resetPose(pose);
+				test.animation->getRelativePose(time, pose, model_bones, nullptr, 0.5f);
+			}
+			times[quantized] = timer.getTimeSinceStart();
+			sizes[quantized] = test.animation->size();
+		}
+		g_log_info.log("unit") << "bench: " << SAMPLES_COUNT << " samples of " << BONES_COUNT << " bones in "
+			<< times[0] << "s from " << (int)sizes[0] << " bytes, " << times[1] << "s from " << (int)sizes[1]
+			<< " bytes quantized";
+		LUMIX_EXPECT(sizes[1] * 3 < sizes[0]);
+	}
+}
+
+
+} // anonymous namespace
+
+
+REGISTER_TEST("unit_tests/animation/animation/remap", UT_animation_remap, "")
+REGISTER_TEST("unit_tests/animation/animation/sampling_bench", UT_animation_sampling_bench, "")
+REGISTER_TEST("unit_tests/animation/animation/keys", UT_animation_keys, "")
+REGISTER_TEST("unit_tests/animation/animation/clip_length_bench", UT_animation_clip_length_bench, "")
+REGISTER_TEST("unit_tests/animation/animation/quantized", UT_animation_quantized, "")
+REGISTER_TEST("unit_tests/animation/animation/quantized_bench", UT_animation_quantized_bench, "")
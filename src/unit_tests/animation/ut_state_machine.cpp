@@ -0,0 +1,343 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "animation/controller.h"
+#include "animation/state_machine.h"
+#include "engine/log.h"
+#include "engine/math_utils.h"
+#include "engine/path.h"
+#include "engine/timer.h"
+
+
+using namespace Lumix;
+
+
+namespace
+{
+
+
+// state machine with a layer node and a blend node, each with two animations
+struct StateMachineTest
+{
+	explicit StateMachineTest(IAllocator& _allocator)
+		: allocator(_allocator)
+		, manager(_allocator)
+	{
+		resource = LUMIX_NEW(allocator, Anim::ControllerResource)(Path("test.act"), manager, allocator);
+		root = LUMIX_NEW(allocator, Anim::StateMachine)(*resource, allocator);
+		resource->m_root = root;
+
+		layers = LUMIX_NEW(allocator, Anim::LayersNode)(*resource, allocator);
+		blend = LUMIX_NEW(allocator, Anim::Blend1DNode)(*resource, allocator);
+		root->children.push(layers);
+		root->children.push(blend);
+		for (int i = 0; i < 2; ++i)
+		{
+			layers->children.push(LUMIX_NEW(allocator, Anim::AnimationNode)(*resource, allocator));
+			blend->children.push(LUMIX_NEW(allocator, Anim::AnimationNode)(*resource, allocator));
+		}
+	}
+
+	~StateMachineTest()
+	{
+		resource->destroy();
+		LUMIX_DELETE(allocator, resource);
+	}
+
+	IAllocator& allocator;
+	Anim::ControllerManager manager;
+	Anim::ControllerResource* resource;
+	Anim::StateMachine* root;
+	Anim::LayersNode* layers;
+	Anim::Blend1DNode* blend;
+};
+
+
+void UT_state_machine_instance_pool(const char* params)
+{
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	{
+		StateMachineTest test(allocator);
+		LUMIX_EXPECT(test.root->getComponentsCount() == 7);
+
+		Anim::InstancePool pool(*test.resource, allocator);
+
+		// a freed slot is the next one to be reused
+		Anim::ComponentInstance* layers = test.layers->createInstance(pool);
+		LUMIX_DELETE(pool, layers);
+		Anim::ComponentInstance* blend = test.blend->createInstance(pool);
+		LUMIX_EXPECT((void*)blend == (void*)layers);
+		LUMIX_DELETE(pool, blend);
+
+		// more instances than the resource has components still fit, the pool grows
+		Anim::ComponentInstance* instances[40];
+		for (auto*& instance : instances)
+		{
+			instance = test.root->children[1]->createInstance(pool);
+		}
+		for (int i = 0; i < lengthOf(instances); ++i)
+		{
+			for (int j = i + 1; j < lengthOf(instances); ++j)
+			{
+				LUMIX_EXPECT(instances[i] != instances[j]);
+			}
+		}
+		for (auto* instance : instances)
+		{
+			LUMIX_DELETE(pool, instance);
+		}
+	}
+}
+
+
+void UT_state_machine_instance_pool_bench(const char* params)
+{
+	static const int CONTROLLERS_COUNT = 1000;
+	static const int ITERATIONS = 100;
+
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	{
+		StateMachineTest test(allocator);
+		Anim::ComponentInstance* instances[CONTROLLERS_COUNT];
+		Anim::Component* nodes[] = { test.layers, test.blend, test.root };
+
+		ScopedTimer allocator_timer("Allocator", allocator);
+		for (int i = 0; i < ITERATIONS; ++i)
+		{
+			for (Anim::Component* node : nodes)
+			{
+				for (auto*& instance : instances) instance = node->createInstance(allocator);
+				for (auto* instance : instances) LUMIX_DELETE(allocator, instance);
+			}
+		}
+		float allocator_time = allocator_timer.getTimeSinceStart();
+
+		Anim::InstancePool* pools[CONTROLLERS_COUNT];
+		for (auto*& pool : pools) pool = LUMIX_NEW(allocator, Anim::InstancePool)(*test.resource, allocator);
+		ScopedTimer pool_timer("Instance pool", allocator);
+		for (int i = 0; i < ITERATIONS; ++i)
+		{
+			for (Anim::Component* node : nodes)
+			{
+				for (int j = 0; j < CONTROLLERS_COUNT; ++j) instances[j] = node->createInstance(*pools[j]);
+				for (int j = 0; j < CONTROLLERS_COUNT; ++j) LUMIX_DELETE(*pools[j], instances[j]);
+			}
+		}
+		float pool_time = pool_timer.getTimeSinceStart();
+		for (auto* pool : pools) LUMIX_DELETE(allocator, pool);
+
+		g_log_info.log("unit") << "bench: " << ITERATIONS * lengthOf(nodes) << " state changes of " << CONTROLLERS_COUNT
+			<< " controllers in " << allocator_time << "s with allocator, " << pool_time << "s with instance pools";
+	}
+}
+
+
+void createInputDecl(Anim::InputDecl& decl)
+{
+	const struct { const char* name; Anim::InputDecl::Type type; } inputs[] = {
+		{ "grounded", Anim::InputDecl::BOOL },
+		{ "speed", Anim::InputDecl::FLOAT },
+		{ "weapon", Anim::InputDecl::INT },
+		{ "aim", Anim::InputDecl::FLOAT }
+	};
+	for (const auto& input : inputs)
+	{
+		int idx = decl.addInput();
+		decl.inputs[idx].name = input.name;
+		decl.inputs[idx].type = input.type;
+	}
+	decl.recalculateOffsets();
+	int idx = decl.addConstant();
+	decl.constants[idx].name = "RIFLE";
+	decl.constants[idx].type = Anim::InputDecl::INT;
+	decl.constants[idx].i_value = 2;
+}
+
+
+void setInputs(u8* input, const Anim::InputDecl& decl, bool grounded, float speed, int weapon)
+{
+	*(bool*)&input[decl.inputs[0].offset] = grounded;
+	*(float*)&input[decl.inputs[1].offset] = speed;
+	*(int*)&input[decl.inputs[2].offset] = weapon;
+	*(float*)&input[decl.inputs[3].offset] = 0;
+}
+
+
+void UT_state_machine_condition(const char* params)
+{
+	DefaultAllocator allocator;
+	Anim::InputDecl decl;
+	createInputDecl(decl);
+	u8 input[16];
+	setInputs(input, decl, true, 3, 2);
+
+	Anim::RunningContext rc;
+	rc.input = input;
+
+	Anim::Condition condition(allocator);
+	const struct { const char* expression; bool result; } tests[] = {
+		{ "", true },
+		{ "true", true },
+		{ "false", false },
+		{ "speed > 2", true },
+		{ "speed < 2", false },
+		{ "speed - 1 > 1.5 and grounded", true },
+		{ "-speed * 2 < -7 or not grounded", false },
+		{ "weapon = RIFLE", true },
+		{ "weapon <> RIFLE", false },
+		{ "(speed + 1) / 2 > 1.9", true },
+	};
+	for (const auto& test : tests)
+	{
+		LUMIX_EXPECT(condition.compile(test.expression, decl) == Anim::Condition::Error::NONE);
+		LUMIX_EXPECT(condition(rc) == test.result);
+		LUMIX_EXPECT(!condition.uses_instance);
+	}
+
+	// only inputs referenced by the expression make it dirty
+	condition.compile("speed > 2 and grounded", decl);
+	u32 speed_mask = Anim::InputDecl::getDirtyMask(decl.inputs[1].offset, Anim::InputDecl::FLOAT);
+	u32 weapon_mask = Anim::InputDecl::getDirtyMask(decl.inputs[2].offset, Anim::InputDecl::INT);
+	u32 aim_mask = Anim::InputDecl::getDirtyMask(decl.inputs[3].offset, Anim::InputDecl::FLOAT);
+	LUMIX_EXPECT(condition.needsUpdate(speed_mask));
+	LUMIX_EXPECT(!condition.needsUpdate(aim_mask));
+	LUMIX_EXPECT(!condition.needsUpdate(0));
+	// inputs are packed, weapon shares 4 bytes with speed
+	LUMIX_EXPECT(condition.needsUpdate(weapon_mask));
+
+	condition.compile("time() > 0.5", decl);
+	LUMIX_EXPECT(condition.uses_instance);
+	LUMIX_EXPECT(condition.needsUpdate(0));
+
+	LUMIX_EXPECT(condition.compile("speed >", decl) != Anim::Condition::Error::NONE);
+	LUMIX_EXPECT(!condition(rc));
+}
+
+
+void UT_state_machine_recompiled_condition(const char* params)
+{
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	{
+		StateMachineTest test(allocator);
+		Anim::InputDecl decl;
+		createInputDecl(decl);
+		u8 input[16];
+		setInputs(input, decl, true, 1, 0);
+
+		Anim::AnimationNode* idle = LUMIX_NEW(allocator, Anim::AnimationNode)(*test.resource, allocator);
+		Anim::AnimationNode* run = LUMIX_NEW(allocator, Anim::AnimationNode)(*test.resource, allocator);
+		Anim::Edge* edge = LUMIX_NEW(allocator, Anim::Edge)(*test.resource, allocator);
+		edge->from = idle;
+		edge->to = run;
+		idle->out_edges.push(edge);
+		test.root->children.push(idle);
+		test.root->children.push(run);
+		test.root->children.push(edge);
+		LUMIX_EXPECT(edge->condition.compile("speed > 2", decl) == Anim::Condition::Error::NONE);
+
+		Anim::RunningContext rc;
+		rc.time_delta = 0;
+		rc.input = input;
+		rc.dirty_inputs = 0xffFFffFF;
+		rc.allocator = &allocator;
+		rc.anim_set = nullptr;
+		rc.event_stream = nullptr;
+		rc.controller = INVALID_ENTITY;
+		Anim::ComponentInstance* instance = idle->createInstance(allocator);
+		instance->enter(rc, nullptr);
+		LUMIX_EXPECT(instance->update(rc, true) == instance);
+
+		// the condition is recompiled in the editor while inputs do not change, the cached false result is stale
+		rc.dirty_inputs = 0;
+		u32 old_generation = edge->condition.generation;
+		LUMIX_EXPECT(edge->condition.compile("speed < 2", decl) == Anim::Condition::Error::NONE);
+		LUMIX_EXPECT(edge->condition.generation != old_generation);
+		Anim::ComponentInstance* new_instance = instance->update(rc, true);
+		LUMIX_EXPECT(new_instance != instance);
+		LUMIX_DELETE(allocator, new_instance);
+	}
+}
+
+
+void UT_state_machine_condition_bench(const char* params)
+{
+	static const int CONTROLLERS_COUNT = 1000;
+	static const int FRAMES = 100;
+	static const int EDGES_COUNT = 8;
+
+	DefaultAllocator allocator;
+	Anim::InputDecl decl;
+	createInputDecl(decl);
+
+	const char* expressions[EDGES_COUNT] = {
+		"speed > 5 and grounded",
+		"speed < 0.1 and grounded",
+		"not grounded",
+		"weapon = RIFLE and speed < 2",
+		"weapon <> RIFLE and aim > 0.5",
+		"aim * 2 - 1 > 0.9",
+		"speed * speed > 100",
+		"weapon = RIFLE or aim < -0.5",
+	};
+	Array<Anim::Condition> conditions(allocator);
+	for (const char* expression : expressions)
+	{
+		conditions.emplace(allocator).compile(expression, decl);
+	}
+
+	// only the speed of some controllers changes every frame
+	Array<u8> inputs(allocator);
+	inputs.resize(CONTROLLERS_COUNT * 16);
+	for (int i = 0; i < CONTROLLERS_COUNT; ++i) setInputs(&inputs[i * 16], decl, true, 1, 0);
+	u32 speed_mask = Anim::InputDecl::getDirtyMask(decl.inputs[1].offset, Anim::InputDecl::FLOAT);
+
+	Anim::RunningContext rc;
+	int evaluated[2] = {};
+	float times[2];
+	for (int dirty_tracking = 0; dirty_tracking < 2; ++dirty_tracking)
+	{
+		Array<u32> false_edges(allocator);
+		false_edges.resize(CONTROLLERS_COUNT);
+		setMemory(&false_edges[0], 0, false_edges.size() * sizeof(false_edges[0]));
+		ScopedTimer timer("Conditions", allocator);
+		for (int frame = 0; frame < FRAMES; ++frame)
+		{
+			for (int i = 0; i < CONTROLLERS_COUNT; ++i)
+			{
+				rc.input = &inputs[i * 16];
+				rc.dirty_inputs = dirty_tracking ? 0 : 0xffFFffFF;
+				if (i % 10 == frame % 10)
+				{
+					*(float*)&rc.input[decl.inputs[1].offset] = Math::randFloat(0.5f, 1.5f);
+					rc.dirty_inputs |= speed_mask;
+				}
+				for (int j = 0; j < EDGES_COUNT; ++j)
+				{
+					const Anim::Condition& condition = conditions[j];
+					if ((false_edges[i] & (1 << j)) && !condition.needsUpdate(rc.dirty_inputs)) continue;
+					++evaluated[dirty_tracking];
+					if (condition(rc)) continue;
+					false_edges[i] |= 1 << j;
+				}
+			}
+		}
+		times[dirty_tracking] = timer.getTimeSinceStart();
+	}
+
+	g_log_info.log("unit") << "bench: " << FRAMES << " frames of " << CONTROLLERS_COUNT << " controllers x " << EDGES_COUNT
+		<< " edges in " << times[0] << "s evaluating all " << evaluated[0] << " conditions, " << times[1]
+		<< "s evaluating " << evaluated[1] << " conditions with dirty inputs";
+	LUMIX_EXPECT(evaluated[1] < evaluated[0]);
+}
+
+
+} // anonymous namespace
+
+
+REGISTER_TEST("unit_tests/animation/state_machine/instance_pool", UT_state_machine_instance_pool, "")
+REGISTER_TEST("unit_tests/animation/state_machine/instance_pool_bench", UT_state_machine_instance_pool_bench, "")
+REGISTER_TEST("unit_tests/animation/state_machine/condition", UT_state_machine_condition, "")
+REGISTER_TEST("unit_tests/animation/state_machine/recompiled_condition", UT_state_machine_recompiled_condition, "")
+REGISTER_TEST("unit_tests/animation/state_machine/condition_bench", UT_state_machine_condition_bench, "")
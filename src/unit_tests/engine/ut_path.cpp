@@ -2,7 +2,10 @@
 
 #include "engine/path.h"
 #include "engine/crc32.h"
+#include "engine/mt/task.h"
+#include "engine/mt/thread.h"
 #include "engine/string.h"
+#include "engine/timer.h"
 
 
 using namespace Lumix;
@@ -22,4 +25,95 @@ void UT_path(const char* params)
 	LUMIX_EXPECT(path.getHash() == crc32(res_path));
 }
 
+
+
+namespace
+{
+
+
+const int PATH_NAMES_COUNT = 512;
+const int PATH_ITERATIONS = 200000;
+
+
+struct PathTask : MT::Task
+{
+	PathTask(const char (*names)[32], int seed, IAllocator& allocator)
+		: MT::Task(allocator)
+		, m_names(names)
+		, m_seed(seed)
+		, m_errors(0)
+	{
+	}
+
+	int task() override
+	{
+		u32 rnd = m_seed;
+		for (int i = 0; i < PATH_ITERATIONS; ++i)
+		{
+			rnd = rnd * 1103515245 + 12345;
+			const char* name = m_names[(rnd >> 8) % PATH_NAMES_COUNT];
+			Path path(name);
+			Path copy(path);
+			if (copy.getHash() != crc32(name) || !equalStrings(copy.c_str(), name)) ++m_errors;
+		}
+		return 0;
+	}
+
+	const char (*m_names)[32];
+	int m_seed;
+	int m_errors;
+};
+
+
+} // anonymous namespace
+
+
+void UT_path_multithreaded(const char* params)
+{
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+
+	char names[PATH_NAMES_COUNT][32];
+	for (int i = 0; i < PATH_NAMES_COUNT; ++i)
+	{
+		copyString(names[i], "textures/t");
+		char tmp[16];
+		toCString(i, tmp, lengthOf(tmp));
+		catString(names[i], tmp);
+		catString(names[i], ".dds");
+	}
+
+	PathTask* tasks[4];
+	ScopedTimer timer("Path multithreaded", allocator);
+	for (int i = 0; i < lengthOf(tasks); ++i)
+	{
+		tasks[i] = LUMIX_NEW(allocator, PathTask)(names, i + 1, allocator);
+		tasks[i]->create("path_task");
+	}
+	for (PathTask* task : tasks)
+	{
+		while (!task->isFinished()) MT::yield();
+		task->destroy();
+	}
+	float time = timer.getTimeSinceStart();
+	g_log_info.log("unit") << "bench: " << lengthOf(tasks) << " threads x " << PATH_ITERATIONS
+		<< " paths created and dropped in " << time << "s";
+
+	for (PathTask* task : tasks)
+	{
+		LUMIX_EXPECT(task->m_errors == 0);
+		LUMIX_DELETE(allocator, task);
+	}
+
+	// paths interned from several threads at once must not be duplicated
+	Path a(names[0]);
+	Path b(names[0]);
+	LUMIX_EXPECT(a.c_str() == b.c_str());
+	path_manager.clear();
+	Path c(names[0]);
+	LUMIX_EXPECT(a.c_str() == c.c_str());
+}
+
+
 REGISTER_TEST("unit_tests/engine/path/path", UT_path, "")
+REGISTER_TEST("unit_tests/engine/path/multithreaded", UT_path_multithreaded, "")
@@ -0,0 +1,296 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/blob.h"
+#include "engine/fs/file_system.h"
+#include "engine/fs/ifile_device.h"
+#include "engine/mt/thread.h"
+#include "engine/path.h"
+#include "engine/resource.h"
+#include "engine/resource_manager.h"
+#include "engine/resource_manager_base.h"
+#include "engine/string.h"
+
+
+using namespace Lumix;
+
+
+namespace
+{
+
+
+struct TestFileDevice;
+
+
+struct TestFile LUMIX_FINAL : public FS::IFile
+{
+	explicit TestFile(FS::IFileDevice& device) : m_device(device) {}
+
+	// only resources of the test type exist
+	bool open(const Path& path, FS::Mode mode) override { return endsWith(path.c_str(), ".test"); }
+	void close() override {}
+	bool read(void* buffer, size_t size) override { return size == 0; }
+	bool write(const void* buffer, size_t size) override { return false; }
+	const void* getBuffer() const override { return nullptr; }
+	size_t size() override { return 0; }
+	bool seek(FS::SeekMode base, size_t pos) override { return pos == 0; }
+	size_t pos() override { return 0; }
+
+	FS::IFileDevice& getDevice() override { return m_device; }
+
+	FS::IFileDevice& m_device;
+};
+
+
+struct TestFileDevice LUMIX_FINAL : public FS::IFileDevice
+{
+	explicit TestFileDevice(IAllocator& allocator) : m_allocator(allocator) {}
+
+	FS::IFile* createFile(FS::IFile*) override { return LUMIX_NEW(m_allocator, TestFile)(*this); }
+	void destroyFile(FS::IFile* file) override { LUMIX_DELETE(m_allocator, file); }
+	const char* name() const override { return "test"; }
+
+	IAllocator& m_allocator;
+};
+
+
+const ResourceType TEST_TYPE("test");
+
+
+struct TestResource LUMIX_FINAL : public Resource
+{
+	TestResource(const Path& path, ResourceManagerBase& manager, IAllocator& allocator)
+		: Resource(path, manager, allocator)
+	{
+	}
+
+	ResourceType getType() const override { return TEST_TYPE; }
+	void dependOn(Resource& resource) { addDependency(resource); }
+	void removeDependencyOn(Resource& resource) { removeDependency(resource); }
+	void unload() override {}
+	bool load(FS::IFile& file) override { return true; }
+};
+
+
+struct TestResourceManager LUMIX_FINAL : public ResourceManagerBase
+{
+	explicit TestResourceManager(IAllocator& allocator)
+		: ResourceManagerBase(allocator)
+		, m_allocator(allocator)
+	{
+	}
+
+	Resource* createResource(const Path& path) override
+	{
+		return LUMIX_NEW(m_allocator, TestResource)(path, *this, m_allocator);
+	}
+
+	void destroyResource(Resource& resource) override { LUMIX_DELETE(m_allocator, static_cast<TestResource*>(&resource)); }
+
+	Resource* getResource(const Path& path) { return get(path); }
+	TestResource* loadResource(const Path& path) { return static_cast<TestResource*>(load(path)); }
+
+	IAllocator& m_allocator;
+};
+
+
+struct PreloadListener
+{
+	void onPreloaded(bool success)
+	{
+		++calls;
+		this->success = success;
+	}
+
+	int calls = 0;
+	bool success = false;
+};
+
+
+void UT_resource_manager_preload(const char* params)
+{
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	FS::FileSystem* file_system = FS::FileSystem::create(allocator);
+	TestFileDevice device(allocator);
+	file_system->mount(&device);
+	file_system->setDefaultDevice("test");
+
+	{
+		ResourceManager resource_manager(allocator);
+		resource_manager.create(*file_system);
+		TestResourceManager manager(allocator);
+		manager.create(TEST_TYPE, resource_manager);
+
+		resource_manager.addManifestDependency(Path("a.test"), TEST_TYPE, Path("b.test"));
+		resource_manager.addManifestDependency(Path("b.test"), TEST_TYPE, Path("c.test"));
+		resource_manager.addManifestDependency(Path("a.test"), TEST_TYPE, Path("c.test"));
+		resource_manager.addManifestDependency(Path("a.test"), TEST_TYPE, Path("b.test"));
+		LUMIX_EXPECT(resource_manager.getManifestDependenciesCount() == 3);
+
+		PreloadListener listener;
+		ResourceManager::PreloadCallback cb;
+		cb.bind<PreloadListener, &PreloadListener::onPreloaded>(&listener);
+		ResourceManager::ResourceDesc desc = {TEST_TYPE, Path("a.test")};
+		u32 preload = resource_manager.preload(&desc, 1, cb);
+		LUMIX_EXPECT(preload != ResourceManager::INVALID_PRELOAD);
+
+		// nothing is requested until the manifest is loaded, then the dependencies are requested
+		// together with the preloaded resource
+		LUMIX_EXPECT(manager.getResource(Path("a.test")) == nullptr);
+		LUMIX_EXPECT(listener.calls == 0);
+
+		for (int i = 0; i < 1000 && listener.calls == 0; ++i)
+		{
+			file_system->updateAsyncTransactions();
+			MT::sleep(1);
+		}
+		Resource* c = manager.getResource(Path("c.test"));
+		LUMIX_EXPECT(c != nullptr);
+		LUMIX_EXPECT(listener.calls == 1);
+		LUMIX_EXPECT(listener.success);
+		LUMIX_EXPECT(c->isReady());
+		LUMIX_EXPECT(manager.getResource(Path("a.test"))->isReady());
+		LUMIX_EXPECT(manager.getResource(Path("b.test"))->isReady());
+
+		resource_manager.releasePreload(preload);
+		LUMIX_EXPECT(c->isEmpty());
+
+		ResourceManager::ResourceDesc missing_desc = {TEST_TYPE, Path("missing.txt")};
+		preload = resource_manager.preload(&missing_desc, 1, cb);
+		for (int i = 0; i < 1000 && listener.calls == 1; ++i)
+		{
+			file_system->updateAsyncTransactions();
+			MT::sleep(1);
+		}
+		LUMIX_EXPECT(listener.calls == 2);
+		LUMIX_EXPECT(!listener.success);
+		resource_manager.releasePreload(preload);
+
+		manager.destroy();
+		resource_manager.destroy();
+	}
+
+	file_system->unMount(&device);
+	FS::FileSystem::destroy(file_system);
+}
+
+
+struct StateListener
+{
+	void onStateChanged(Resource::State old_state, Resource::State new_state, Resource&)
+	{
+		if (new_state == Resource::State::EMPTY) ++emptied;
+		if (new_state == Resource::State::READY) ++readied;
+	}
+
+	int emptied = 0;
+	int readied = 0;
+};
+
+
+void UT_resource_manager_batch_reload(const char* params)
+{
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	FS::FileSystem* file_system = FS::FileSystem::create(allocator);
+	TestFileDevice device(allocator);
+	file_system->mount(&device);
+	file_system->setDefaultDevice("test");
+
+	{
+		ResourceManager resource_manager(allocator);
+		resource_manager.create(*file_system);
+		TestResourceManager manager(allocator);
+		manager.create(TEST_TYPE, resource_manager);
+
+		TestResource* a = manager.loadResource(Path("a.test"));
+		TestResource* b = manager.loadResource(Path("b.test"));
+		TestResource* c = manager.loadResource(Path("c.test"));
+		for (int i = 0; i < 1000 && !(a->isReady() && b->isReady() && c->isReady()); ++i)
+		{
+			file_system->updateAsyncTransactions();
+			MT::sleep(1);
+		}
+		LUMIX_EXPECT(a->isReady());
+		LUMIX_EXPECT(b->isReady());
+		LUMIX_EXPECT(c->isReady());
+		a->dependOn(*b);
+		a->dependOn(*c);
+
+		StateListener listener;
+		a->getObserverCb().bind<StateListener, &StateListener::onStateChanged>(&listener);
+
+		Path changed[] = {Path("b.test"), Path("c.test"), Path("unknown.test")};
+		resource_manager.reload(changed, lengthOf(changed));
+		LUMIX_EXPECT(b->isEmpty());
+		LUMIX_EXPECT(c->isEmpty());
+		LUMIX_EXPECT(a->isEmpty());
+		for (int i = 0; i < 1000 && !a->isReady(); ++i)
+		{
+			file_system->updateAsyncTransactions();
+			MT::sleep(1);
+		}
+		LUMIX_EXPECT(b->isReady());
+		LUMIX_EXPECT(c->isReady());
+		// the dependent resource is notified only once, after all its dependencies are reloaded
+		LUMIX_EXPECT(listener.emptied == 1);
+		LUMIX_EXPECT(listener.readied == 1);
+
+		a->getObserverCb().unbind<StateListener, &StateListener::onStateChanged>(&listener);
+		a->removeDependencyOn(*b);
+		a->removeDependencyOn(*c);
+		manager.unload(*a);
+		manager.unload(*b);
+		manager.unload(*c);
+		manager.destroy();
+		resource_manager.destroy();
+	}
+
+	file_system->unMount(&device);
+	FS::FileSystem::destroy(file_system);
+}
+
+
+void UT_resource_manager_manifest(const char* params)
+{
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+
+	ResourceManager resource_manager(allocator);
+	resource_manager.addManifestDependency(Path("models/a.msh"), ResourceType("material"), Path("models/a.mat"));
+	resource_manager.addManifestDependency(Path("models/a.mat"), ResourceType("texture"), Path("models/a.dds"));
+	resource_manager.addManifestDependency(Path("models/a.mat"), ResourceType("shader"), Path("shaders/rigid.shd"));
+
+	OutputBlob blob(allocator);
+	resource_manager.serializeManifest(blob);
+
+	ResourceManager loaded(allocator);
+	InputBlob input(blob);
+	LUMIX_EXPECT(loaded.deserializeManifest(input));
+	LUMIX_EXPECT(loaded.getManifestDependenciesCount() == 3);
+
+	OutputBlob reserialized(allocator);
+	loaded.serializeManifest(reserialized);
+	LUMIX_EXPECT(reserialized.getPos() == blob.getPos());
+
+	loaded.clearManifestDependencies(Path("models/a.mat"));
+	LUMIX_EXPECT(loaded.getManifestDependenciesCount() == 1);
+	OutputBlob cleared(allocator);
+	loaded.serializeManifest(cleared);
+	ResourceManager cleared_loaded(allocator);
+	InputBlob cleared_input(cleared);
+	LUMIX_EXPECT(cleared_loaded.deserializeManifest(cleared_input));
+	LUMIX_EXPECT(cleared_loaded.getManifestDependenciesCount() == 1);
+
+	u32 invalid = 0;
+	InputBlob corrupted(&invalid, sizeof(invalid));
+	LUMIX_EXPECT(!loaded.deserializeManifest(corrupted));
+}
+
+
+} // anonymous namespace
+
+
+REGISTER_TEST("unit_tests/engine/resource_manager/preload", UT_resource_manager_preload, "")
+REGISTER_TEST("unit_tests/engine/resource_manager/batch_reload", UT_resource_manager_batch_reload, "")
+REGISTER_TEST("unit_tests/engine/resource_manager/manifest", UT_resource_manager_manifest, "")
@@ -152,6 +152,21 @@ void UT_simd_min_max(const char* params)
 }
 
 
+void UT_simd_cmp_blend(const char* params)
+{
+	float4 a = f4Load(c0);
+	float4 b = f4Load(c1);
+	float4 mask = f4CmpLT(a, b);
+	LUMIX_EXPECT(f4MoveMask(mask) == 0x3);
+
+	float4 res = f4Blend(a, b, mask);
+	float LUMIX_ALIGN_BEGIN(16) tmp[4] LUMIX_ALIGN_END(16);
+	f4Store(tmp, res);
+
+	LUMIX_EXPECT_FLOAT4_EQUAL(tmp, c13);
+}
+
+
 REGISTER_TEST("unit_tests/engine/simd/load_store", UT_simd_load_store, "")
 REGISTER_TEST("unit_tests/engine/simd/add", UT_simd_add, "")
 REGISTER_TEST("unit_tests/engine/simd/sub", UT_simd_sub, "")
@@ -161,3 +176,4 @@ REGISTER_TEST("unit_tests/engine/simd/rcp", UT_simd_rcp, "")
 REGISTER_TEST("unit_tests/engine/simd/sqrt", UT_simd_sqrt, "")
 REGISTER_TEST("unit_tests/engine/simd/rsqrt", UT_simd_rsqrt, "")
 REGISTER_TEST("unit_tests/engine/simd/min_max", UT_simd_min_max, "")
+REGISTER_TEST("unit_tests/engine/simd/cmp_blend", UT_simd_cmp_blend, "")
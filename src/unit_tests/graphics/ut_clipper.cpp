@@ -6,6 +6,7 @@
 #include "engine/log.h"
 
 #include "renderer/culling_system.h"
+#include <cmath>
 
 
 using namespace Lumix;
@@ -68,7 +69,7 @@ namespace
 
 			ScopedTimer timer("Culling System Async", allocator);
 
-			culling_system->cull(clipping_frustum, 1);
+			culling_system->cull(clipping_frustum, 1, nullptr);
 
 			const CullingSystem::Results& result = culling_system->getResult();
 
@@ -85,6 +86,78 @@ namespace
 		CullingSystem::destroy(*culling_system);
 		JobSystem::shutdown();
 	}
+
+
+	void UT_culling_system_views(const char* params)
+	{
+		static const int SPHERES_COUNT = 200000;
+		static const int VIEWS_COUNT = 4;
+
+		DefaultAllocator allocator;
+		JobSystem::init(allocator);
+		Array<Sphere> spheres(allocator);
+		Array<Entity> model_instances(allocator);
+		for (int i = 0; i < SPHERES_COUNT; ++i)
+		{
+			spheres.push(Sphere(Math::randFloat(-200, 200), Math::randFloat(-20, 20), Math::randFloat(-200, 200), 1));
+			model_instances.push({i});
+		}
+
+		Frustum frustums[VIEWS_COUNT];
+		for (int i = 0; i < VIEWS_COUNT; ++i)
+		{
+			float angle = Math::PI * 0.5f * i;
+			frustums[i].computePerspective(
+				Vec3(0, 0, 0), Vec3(sinf(angle), 0, cosf(angle)), Vec3(0, 1, 0), Math::degreesToRadians(60), 1.0f, 0.1f, 150.0f);
+		}
+
+		CullingSystem* culling_system = CullingSystem::create(allocator);
+		culling_system->insert(spheres, model_instances);
+
+		Array<int> expected_masks(allocator);
+		expected_masks.resize(SPHERES_COUNT);
+		for (int& mask : expected_masks) mask = 0;
+		ScopedTimer separate_timer("Separate culls", allocator);
+		for (int i = 0; i < VIEWS_COUNT; ++i)
+		{
+			const CullingSystem::Results& results = culling_system->cull(frustums[i], 1, nullptr);
+			for (const CullingSystem::Subresults& subresults : results)
+			{
+				for (Entity entity : subresults) expected_masks[entity.index] |= 1 << i;
+			}
+		}
+		float separate_time = separate_timer.getTimeSinceStart();
+
+		ScopedTimer shared_timer("Shared cull", allocator);
+		const CullingSystem::Results& results = culling_system->cull(frustums, VIEWS_COUNT, 1);
+		float shared_time = shared_timer.getTimeSinceStart();
+		const CullingSystem::ResultsViewMasks& view_masks = culling_system->getViewMasks();
+
+		int visible_count = 0;
+		int mismatches = 0;
+		for (int i = 0; i < results.size(); ++i)
+		{
+			LUMIX_EXPECT(results[i].size() == view_masks[i].size());
+			for (int j = 0; j < results[i].size(); ++j)
+			{
+				if (expected_masks[results[i][j].index] != (int)view_masks[i][j]) ++mismatches;
+				++visible_count;
+			}
+		}
+		int expected_visible_count = 0;
+		for (int mask : expected_masks)
+		{
+			if (mask != 0) ++expected_visible_count;
+		}
+		LUMIX_EXPECT(mismatches == 0);
+		LUMIX_EXPECT(visible_count == expected_visible_count);
+		g_log_info.log("unit") << "bench: " << SPHERES_COUNT << " spheres culled against " << VIEWS_COUNT
+			<< " frustums separately in " << separate_time << "s, together in " << shared_time << "s";
+
+		CullingSystem::destroy(*culling_system);
+		JobSystem::shutdown();
+	}
 }
 
 REGISTER_TEST("unit_tests/graphics/culling_system_async", UT_culling_system_async, "");
+REGISTER_TEST("unit_tests/graphics/culling_system_views", UT_culling_system_views, "");
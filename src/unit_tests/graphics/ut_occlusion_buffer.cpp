@@ -0,0 +1,243 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/geometry.h"
+#include "engine/job_system.h"
+#include "engine/log.h"
+#include "engine/math_utils.h"
+#include "engine/path.h"
+#include "engine/timer.h"
+#include "engine/universe/universe.h"
+#include "renderer/model.h"
+#include "renderer/occlusion_buffer.h"
+#include "renderer/render_scene.h"
+#include <bgfx/bgfx.h>
+
+
+using namespace Lumix;
+
+
+namespace
+{
+
+
+// quads x quads grid in the XY plane from -1 to 1, facing +Z
+void createGrid(Mesh& mesh, int quads, IAllocator& allocator)
+{
+	for (int j = 0; j <= quads; ++j)
+	{
+		for (int i = 0; i <= quads; ++i)
+		{
+			mesh.vertices.push({ 2.0f * i / quads - 1, 2.0f * j / quads - 1, 0 });
+		}
+	}
+	Array<u16> indices(allocator);
+	for (int j = 0; j < quads; ++j)
+	{
+		for (int i = 0; i < quads; ++i)
+		{
+			u16 idx = u16(i + j * (quads + 1));
+			u16 quad[] = { idx, u16(idx + 1), u16(idx + quads + 2), idx, u16(idx + quads + 2), u16(idx + quads + 1) };
+			for (u16 k : quad) indices.push(k);
+		}
+	}
+	mesh.indices.resize(indices.size() * sizeof(u16));
+	copyMemory(&mesh.indices[0], &indices[0], mesh.indices.size());
+	mesh.flags.set(Mesh::INDICES_16_BIT);
+}
+
+
+Matrix getProjection()
+{
+	Matrix projection;
+	projection.setPerspective(Math::degreesToRadians(60), 2, 0.1f, 100, true, false);
+	return projection;
+}
+
+
+void UT_occlusion_buffer(const char* params)
+{
+	DefaultAllocator allocator;
+	JobSystem::init(allocator);
+	PathManager path_manager(allocator);
+	{
+		Universe universe(allocator);
+		Mesh wall(nullptr, bgfx::VertexDecl(), "wall", allocator);
+		createGrid(wall, 4, allocator);
+		Entity wall_entity = universe.createEntity({ 0, 0, -10 }, { 0, 0, 0, 1 });
+		universe.setScale(wall_entity, 2);
+		Array<MeshInstance> meshes(allocator);
+		meshes.push({ wall_entity, &wall, 0 });
+
+		OcclusionBuffer buffer(allocator);
+		buffer.clear();
+		buffer.setCamera(Matrix::IDENTITY, getProjection());
+		buffer.rasterize(&universe, meshes);
+		buffer.buildHierarchy();
+
+		AABB aabb({ -0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, 0.5f });
+		Matrix mtx = Matrix::IDENTITY;
+		mtx.setTranslation({ 0, 0, -20 });
+		LUMIX_EXPECT(buffer.isOccluded(mtx, aabb));
+		mtx.setTranslation({ 0, 0, -5 });
+		LUMIX_EXPECT(!buffer.isOccluded(mtx, aabb));
+		mtx.setTranslation({ 8, 0, -20 });
+		LUMIX_EXPECT(!buffer.isOccluded(mtx, aabb));
+
+		// upper mips are conservative, they keep the farthest depth of the pixels below
+		const int* mip0 = buffer.getMip(0);
+		const int* mip1 = buffer.getMip(1);
+		LUMIX_EXPECT(mip1[0] >= mip0[0]);
+		LUMIX_EXPECT(mip1[96 * 192 + 96] >= mip0[192 * 384 + 192]);
+	}
+	JobSystem::shutdown();
+}
+
+
+void UT_occlusion_buffer_spheres(const char* params)
+{
+	static const int SPHERES_COUNT = 100000;
+
+	DefaultAllocator allocator;
+	JobSystem::init(allocator);
+	PathManager path_manager(allocator);
+	{
+		Universe universe(allocator);
+		Mesh wall(nullptr, bgfx::VertexDecl(), "wall", allocator);
+		createGrid(wall, 4, allocator);
+		Entity wall_entity = universe.createEntity({ 0, 0, -10 }, { 0, 0, 0, 1 });
+		universe.setScale(wall_entity, 2);
+		Array<MeshInstance> meshes(allocator);
+		meshes.push({ wall_entity, &wall, 0 });
+
+		OcclusionBuffer buffer(allocator);
+		buffer.clear();
+		buffer.setCamera(Matrix::IDENTITY, getProjection());
+		buffer.rasterize(&universe, meshes);
+		buffer.buildHierarchy();
+
+		Sphere spheres[] = {
+			{ 0, 0, -20, 0.5f },	// behind the wall
+			{ 0, 0, -5, 0.5f },		// in front of the wall
+			{ 8, 0, -20, 0.5f },	// next to the wall
+			{ 0, 0, -9, 2 },		// intersects the wall
+			{ 0, 0, -20, 50 },		// contains the camera
+			{ 1, 1, -30, 0.5f },	// behind the wall
+		};
+		int indices[] = { 0, 1, 2, 3, 4, 5 };
+		int count = buffer.cullOccluded(spheres, indices, lengthOf(indices));
+		LUMIX_EXPECT(count == 4);
+		LUMIX_EXPECT(indices[0] == 1);
+		LUMIX_EXPECT(indices[1] == 2);
+		LUMIX_EXPECT(indices[2] == 3);
+		LUMIX_EXPECT(indices[3] == 4);
+
+		Array<Sphere> many_spheres(allocator);
+		Array<int> many_indices(allocator);
+		for (int i = 0; i < SPHERES_COUNT; ++i)
+		{
+			many_spheres.push({ Math::randFloat(-30, 30), Math::randFloat(-15, 15), Math::randFloat(-40, -1), 0.5f });
+			many_indices.push(i);
+		}
+		ScopedTimer timer("Occlusion culling", allocator);
+		int visible_count = buffer.cullOccluded(&many_spheres[0], &many_indices[0], many_indices.size());
+		float time = timer.getTimeSinceStart();
+		g_log_info.log("unit") << "bench: " << SPHERES_COUNT << " spheres tested against occlusion buffer in " << time
+			<< "s, " << visible_count << " visible";
+		LUMIX_EXPECT(visible_count < SPHERES_COUNT);
+	}
+	JobSystem::shutdown();
+}
+
+
+void UT_occlusion_buffer_bench(const char* params)
+{
+	static const int INSTANCES_COUNT = 400;
+	static const int GRID_QUADS = 16;
+	static const int ITERATIONS = 10;
+
+	DefaultAllocator allocator;
+	JobSystem::init(allocator);
+	PathManager path_manager(allocator);
+	{
+		Universe universe(allocator);
+		Mesh grid(nullptr, bgfx::VertexDecl(), "grid", allocator);
+		createGrid(grid, GRID_QUADS, allocator);
+		Array<MeshInstance> meshes(allocator);
+		for (int i = 0; i < INSTANCES_COUNT; ++i)
+		{
+			Vec3 pos(Math::randFloat(-20, 20), Math::randFloat(-10, 10), Math::randFloat(-60, -30));
+			Entity entity = universe.createEntity(pos, { 0, 0, 0, 1 });
+			meshes.push({ entity, &grid, 0 });
+		}
+
+		OcclusionBuffer buffer(allocator);
+		ScopedTimer timer("Occlusion buffer", allocator);
+		for (int i = 0; i < ITERATIONS; ++i)
+		{
+			buffer.clear();
+			buffer.setCamera(Matrix::IDENTITY, getProjection());
+			buffer.rasterize(&universe, meshes);
+			buffer.buildHierarchy();
+		}
+		float time = timer.getTimeSinceStart();
+		g_log_info.log("unit") << "bench: " << ITERATIONS << " x " << INSTANCES_COUNT * GRID_QUADS * GRID_QUADS * 2
+			<< " occluder triangles rasterized in " << time << "s";
+	}
+	JobSystem::shutdown();
+}
+
+
+void UT_occlusion_buffer_select(const char* params)
+{
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	{
+		Universe universe(allocator);
+		Mesh occluder(nullptr, bgfx::VertexDecl(), "occluder", allocator);
+		createGrid(occluder, 2, allocator);
+		Mesh wall(nullptr, bgfx::VertexDecl(), "wall", allocator);
+		createGrid(wall, 4, allocator);
+		Mesh door(nullptr, bgfx::VertexDecl(), "door", allocator);
+		createGrid(door, 1, allocator);
+		Mesh big(nullptr, bgfx::VertexDecl(), "big", allocator);
+		createGrid(big, 32, allocator);
+
+		// instance with overridden materials has its own copies of the meshes, each of them that passes the filters
+		// stands in with the model's simplified occluder
+		Entity overridden = universe.createEntity({ 0, 0, -10 }, { 0, 0, 0, 1 });
+		Entity another = universe.createEntity({ 0, 0, -20 }, { 0, 0, 0, 1 });
+		// model without a simplified occluder rasterizes its own meshes
+		Entity house = universe.createEntity({ 0, 0, -30 }, { 0, 0, 0, 1 });
+		Entity mountain = universe.createEntity({ 0, 0, -40 }, { 0, 0, 0, 1 });
+
+		Array<OcclusionBuffer::OccluderCandidate> candidates(allocator);
+		candidates.push({ another, &occluder, 400, 0.5f });
+		candidates.push({ overridden, &occluder, 100, 1 });
+		candidates.push({ house, &wall, 900, 0.3f });
+		candidates.push({ mountain, &big, 1600, 2 });
+		candidates.push({ overridden, &occluder, 100, 1 });
+		candidates.push({ house, &door, 900, 0.3f });
+		candidates.push({ another, &occluder, 400, 0.5f });
+
+		Array<MeshInstance> occluders(allocator);
+		int triangles_count = OcclusionBuffer::selectOccluders(candidates, 100, occluders);
+		LUMIX_EXPECT(triangles_count == 8 + 8 + 32 + 2);
+		LUMIX_EXPECT(occluders.size() == 4);
+		LUMIX_EXPECT(occluders[0].owner == overridden);
+		LUMIX_EXPECT(occluders[0].mesh == &occluder);
+		LUMIX_EXPECT(occluders[1].owner == another);
+		LUMIX_EXPECT(occluders[1].mesh == &occluder);
+		LUMIX_EXPECT(occluders[2].owner == house);
+		LUMIX_EXPECT(occluders[3].owner == house);
+		LUMIX_EXPECT(occluders[2].mesh != occluders[3].mesh);
+	}
+}
+
+
+} // anonymous namespace
+
+
+REGISTER_TEST("unit_tests/graphics/occlusion_buffer/rasterize", UT_occlusion_buffer, "")
+REGISTER_TEST("unit_tests/graphics/occlusion_buffer/spheres", UT_occlusion_buffer_spheres, "")
+REGISTER_TEST("unit_tests/graphics/occlusion_buffer/select", UT_occlusion_buffer_select, "")
+REGISTER_TEST("unit_tests/graphics/occlusion_buffer/bench", UT_occlusion_buffer_bench, "")
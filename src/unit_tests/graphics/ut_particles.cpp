@@ -0,0 +1,118 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/log.h"
+#include "engine/path.h"
+#include "engine/timer.h"
+#include "engine/universe/universe.h"
+#include "renderer/particle_system.h"
+
+
+using namespace Lumix;
+
+
+namespace
+{
+
+
+void UT_scripted_particles_update(const char* params)
+{
+	DefaultAllocator allocator;
+	ScriptedParticleEmitter emitter(INVALID_ENTITY, allocator);
+	const int first = emitter.getParticlesCount();
+	float args[] = { 1, 1000, 2 };
+	emitter.emit(args);
+
+	const int pos_x = emitter.getChannel("pos_x");
+	const int pos_y = emitter.getChannel("pos_y");
+	const int pos_z = emitter.getChannel("pos_z");
+	const int vel_x = emitter.getChannel("vel_x");
+	const int vel_y = emitter.getChannel("vel_y");
+	LUMIX_EXPECT_CLOSE_EQ(emitter.getChannelData(pos_y)[first], 1000, 0.001f);
+	LUMIX_EXPECT_CLOSE_EQ(emitter.getChannelData(pos_z)[first], 2, 0.001f);
+	const float velocity_x = emitter.getChannelData(vel_x)[first];
+
+	const float time_delta = 0.5f;
+	emitter.update(time_delta);
+	LUMIX_EXPECT(emitter.getParticlesCount() == first + 1);
+	LUMIX_EXPECT_CLOSE_EQ(emitter.getChannelData(vel_y)[first], 20 - 0.16f, 0.001f);
+	LUMIX_EXPECT_CLOSE_EQ(emitter.getChannelData(pos_x)[first], 1 + velocity_x * time_delta, 0.001f);
+	LUMIX_EXPECT_CLOSE_EQ(emitter.getChannelData(pos_y)[first], 1000 + (20 - 0.16f) * time_delta, 0.001f);
+
+	// falling below zero kills the particle and emits five new ones at its position
+	args[1] = -1000;
+	emitter.emit(args);
+	emitter.update(time_delta);
+	LUMIX_EXPECT(emitter.getParticlesCount() == first + 1 + 5);
+}
+
+
+void UT_particle_emitter_attractor(const char* params)
+{
+	DefaultAllocator allocator;
+	PathManager path_manager(allocator);
+	{
+		Universe universe(allocator);
+		Entity entity = universe.createEntity({ 0, 0, 0 }, { 0, 0, 0, 1 });
+		ParticleChunkAllocator chunk_allocator(ParticleEmitter::CHANNELS_COUNT, allocator);
+		ParticleEmitter emitter(entity, universe, chunk_allocator, allocator);
+		emitter.m_autoemit = false;
+		emitter.m_spawn_count.from = emitter.m_spawn_count.to = 5;
+
+		// particles spawn exactly at the attractor
+		auto* attractor = LUMIX_NEW(allocator, ParticleEmitter::AttractorModule)(emitter);
+		attractor->m_entities[0] = entity;
+		attractor->m_count = 1;
+		attractor->m_force = 1;
+		emitter.addModule(attractor);
+
+		emitter.prepareUpdate();
+		emitter.emit();
+		emitter.update(0.1f);
+		LUMIX_EXPECT(emitter.getParticlesCount() == 5);
+
+		// the last group of four is processed whole, lanes past the last particle stay zero
+		const float* vel_x = emitter.getChannel(ParticleEmitter::VELOCITY_X);
+		const float* pos_x = emitter.getChannel(ParticleEmitter::POSITION_X);
+		for (int i = 0; i < 8; ++i)
+		{
+			LUMIX_EXPECT(vel_x[i] == vel_x[i]);
+			LUMIX_EXPECT(pos_x[i] == pos_x[i]);
+		}
+		for (int i = 5; i < 8; ++i)
+		{
+			LUMIX_EXPECT_CLOSE_EQ(vel_x[i], 0, 0.0001f);
+			LUMIX_EXPECT_CLOSE_EQ(pos_x[i], 0, 0.0001f);
+		}
+	}
+}
+
+
+void UT_scripted_particles_bench(const char* params)
+{
+	static const int PARTICLES_COUNT = 100000;
+	static const int UPDATES_COUNT = 100;
+
+	DefaultAllocator allocator;
+	ScriptedParticleEmitter emitter(INVALID_ENTITY, allocator);
+	float args[] = { 0, 1000, 0 };
+	while (emitter.getParticlesCount() < PARTICLES_COUNT) emitter.emit(args);
+
+	ScopedTimer timer("Scripted particles", allocator);
+	for (int i = 0; i < UPDATES_COUNT; ++i)
+	{
+		emitter.update(0.016f);
+	}
+	float time = timer.getTimeSinceStart();
+	g_log_info.log("unit") << "bench: " << UPDATES_COUNT << " updates of " << PARTICLES_COUNT
+		<< " scripted particles in " << time << "s";
+
+	LUMIX_EXPECT(emitter.getParticlesCount() == PARTICLES_COUNT);
+}
+
+
+} // anonymous namespace
+
+
+REGISTER_TEST("unit_tests/graphics/scripted_particles/update", UT_scripted_particles_update, "")
+REGISTER_TEST("unit_tests/graphics/particle_emitter/attractor", UT_particle_emitter_attractor, "")
+REGISTER_TEST("unit_tests/graphics/scripted_particles/bench", UT_scripted_particles_bench, "")
@@ -0,0 +1,188 @@
+#include "unit_tests/suite/lumix_unit_tests.h"
+
+#include "engine/log.h"
+#include "engine/math_utils.h"
+#include "engine/quat.h"
+#include "engine/timer.h"
+#include "engine/vec.h"
+#include "renderer/pose.h"
+
+
+using namespace Lumix;
+
+
+namespace
+{
+
+
+static const int BONES_COUNT = 81;
+
+
+// a spine with four limbs of 20 bones
+void createSkeleton(int* parents)
+{
+	parents[0] = -1;
+	for (int i = 1; i < BONES_COUNT; ++i)
+	{
+		parents[i] = (i - 1) % 20 == 0 ? 0 : i - 1;
+	}
+}
+
+
+void randomPose(Pose& pose)
+{
+	for (int i = 0; i < pose.count; ++i)
+	{
+		pose.positions[i].set(Math::randFloat(-1, 1), Math::randFloat(-1, 1), Math::randFloat(-1, 1));
+		Vec3 axis(Math::randFloat(-1, 1), Math::randFloat(-1, 1), Math::randFloat(0.1f, 1));
+		axis.normalize();
+		pose.rotations[i] = Quat(axis, Math::randFloat(-Math::PI, Math::PI));
+	}
+	pose.is_absolute = false;
+}
+
+
+// the same as Pose::computeAbsolute, without a model
+void computeAbsolute(Pose& pose, const int* parents)
+{
+	for (int i = 1; i < pose.count; ++i)
+	{
+		int parent = parents[i];
+		pose.positions[i] = pose.rotations[parent].rotate(pose.positions[i]) + pose.positions[parent];
+		pose.rotations[i] = pose.rotations[parent] * pose.rotations[i];
+	}
+	pose.is_absolute = true;
+}
+
+
+void expectSamePose(const Pose& a, const Pose& b, float tolerance)
+{
+	for (int i = 0; i < a.count; ++i)
+	{
+		LUMIX_EXPECT_CLOSE_EQ(a.positions[i].x, b.positions[i].x, tolerance);
+		LUMIX_EXPECT_CLOSE_EQ(a.positions[i].y, b.positions[i].y, tolerance);
+		LUMIX_EXPECT_CLOSE_EQ(a.positions[i].z, b.positions[i].z, tolerance);
+		const Quat& qa = a.rotations[i];
+		const Quat& qb = b.rotations[i];
+		float dot = qa.x * qb.x + qa.y * qb.y + qa.z * qb.z + qa.w * qb.w;
+		LUMIX_EXPECT_CLOSE_EQ(Math::abs(dot), 1, tolerance);
+	}
+}
+
+
+void UT_pose_soa(const char* params)
+{
+	DefaultAllocator allocator;
+	int parents[BONES_COUNT];
+	createSkeleton(parents);
+
+	Pose a(allocator);
+	Pose b(allocator);
+	Pose result(allocator);
+	a.resize(BONES_COUNT);
+	b.resize(BONES_COUNT);
+	randomPose(a);
+	randomPose(b);
+
+	PoseSoA soa(allocator);
+	PoseSoA soa_b(allocator);
+	soa.fromPose(a);
+	soa_b.fromPose(b);
+	soa.toPose(result);
+	expectSamePose(a, result, 0.00001f);
+
+	soa.blend(soa_b, 0.3f);
+	soa.toPose(result);
+	a.blend(b, 0.3f);
+	expectSamePose(a, result, 0.0001f);
+
+	soa.computeAbsolute(parents);
+	soa.toPose(result);
+	LUMIX_EXPECT(result.is_absolute);
+	computeAbsolute(a, parents);
+	expectSamePose(a, result, 0.001f);
+
+	soa.computeRelative(parents);
+	soa.computeAbsolute(parents);
+	soa.toPose(result);
+	expectSamePose(a, result, 0.001f);
+
+	// full additive rotation is applied in the bone's local space
+	soa.fromPose(b);
+	PoseSoA additive(allocator);
+	Pose additive_aos(allocator);
+	additive_aos.resize(BONES_COUNT);
+	for (int i = 0; i < BONES_COUNT; ++i)
+	{
+		additive_aos.positions[i].set(0, 1, 0);
+		additive_aos.rotations[i] = Quat(Vec3(0, 0, 1), 0.5f);
+	}
+	additive.fromPose(additive_aos);
+	soa.blendAdditive(additive, 1);
+	soa.toPose(result);
+	for (int i = 0; i < BONES_COUNT; ++i)
+	{
+		b.positions[i].y += 1;
+		b.rotations[i] = b.rotations[i] * additive_aos.rotations[i];
+	}
+	expectSamePose(b, result, 0.0001f);
+}
+
+
+void UT_pose_soa_bench(const char* params)
+{
+	static const int ITERATIONS = 10000;
+
+	DefaultAllocator allocator;
+	int parents[BONES_COUNT];
+	createSkeleton(parents);
+
+	Pose a(allocator);
+	Pose b(allocator);
+	a.resize(BONES_COUNT);
+	b.resize(BONES_COUNT);
+	randomPose(a);
+	randomPose(b);
+
+	Pose out(allocator);
+	out.resize(BONES_COUNT);
+	PoseSoA soa(allocator);
+	PoseSoA soa_a(allocator);
+	PoseSoA soa_b(allocator);
+	soa.resize(BONES_COUNT);
+	soa_a.fromPose(a);
+	soa_b.fromPose(b);
+
+	// both loops do what a frame interpolated between two animation LOD samples does
+	ScopedTimer aos_timer("AoS pose", allocator);
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		copyMemory(out.positions, a.positions, sizeof(a.positions[0]) * BONES_COUNT);
+		copyMemory(out.rotations, a.rotations, sizeof(a.rotations[0]) * BONES_COUNT);
+		out.is_absolute = false;
+		out.blend(b, 0.5f);
+		computeAbsolute(out, parents);
+	}
+	float aos_time = aos_timer.getTimeSinceStart();
+
+	ScopedTimer soa_timer("SoA pose", allocator);
+	for (int i = 0; i < ITERATIONS; ++i)
+	{
+		soa.copy(soa_a);
+		soa.blend(soa_b, 0.5f);
+		soa.computeAbsolute(parents);
+		soa.toPose(out);
+	}
+	float soa_time = soa_timer.getTimeSinceStart();
+
+	g_log_info.log("unit") << "bench: " << ITERATIONS << " blends and hierarchy transforms of " << BONES_COUNT
+		<< " bones in " << aos_time << "s with AoS pose, " << soa_time << "s with SoA pose including conversion";
+	LUMIX_EXPECT(soa.is_absolute);
+}
+
+
+} // anonymous namespace
+
+
+REGISTER_TEST("unit_tests/graphics/pose/soa", UT_pose_soa, "")
+REGISTER_TEST("unit_tests/graphics/pose/soa_bench", UT_pose_soa_bench, "")